@@ -0,0 +1,129 @@
+#include <QBuffer>
+#include <QtTest>
+
+#include "bufferutil.h"
+#include "controlmsg.h"
+
+// serialization of the input messages: the fixed layout serializer into a caller buffer
+// and into a QByteArray, against the QBuffer path it replaced
+class BenchControlMsg : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void touchLayout();
+    void emptyInjectText();
+    void touchQBuffer();
+    void touchSerializeData();
+    void touchSerializeTo();
+    void keycodeSerializeTo();
+    void textSerializeTo();
+
+private:
+    static void setTouch(ControlMsg &controlMsg);
+    // the former path: a fresh QByteArray written byte by byte through QBuffer
+    static QByteArray touchByQBuffer(const ControlMsg &controlMsg);
+};
+
+void BenchControlMsg::setTouch(ControlMsg &controlMsg)
+{
+    controlMsg.setInjectTouchMsgData(POINTER_ID_MOUSE, AMOTION_EVENT_ACTION_MOVE, AMOTION_EVENT_BUTTON_PRIMARY, AMOTION_EVENT_BUTTON_PRIMARY,
+                                     QRect(540, 960, 1080, 1920), 1.0f);
+}
+
+QByteArray BenchControlMsg::touchByQBuffer(const ControlMsg &controlMsg)
+{
+    QByteArray byteArray;
+    QBuffer buffer(&byteArray);
+    buffer.open(QBuffer::WriteOnly);
+    buffer.putChar(ControlMsg::CMT_INJECT_TOUCH);
+    buffer.putChar(AMOTION_EVENT_ACTION_MOVE);
+    BufferUtil::write64(buffer, controlMsg.touchId());
+    BufferUtil::write32(buffer, 540);
+    BufferUtil::write32(buffer, 960);
+    BufferUtil::write16(buffer, 1080);
+    BufferUtil::write16(buffer, 1920);
+    BufferUtil::write16(buffer, 0xffff);
+    BufferUtil::write32(buffer, AMOTION_EVENT_BUTTON_PRIMARY);
+    BufferUtil::write32(buffer, AMOTION_EVENT_BUTTON_PRIMARY);
+    buffer.close();
+    return byteArray;
+}
+
+void BenchControlMsg::touchLayout()
+{
+    // both paths put the same bytes on the wire
+    ControlMsg controlMsg(ControlMsg::CMT_INJECT_TOUCH);
+    setTouch(controlMsg);
+    QByteArray data = controlMsg.serializeData();
+    QCOMPARE(int(data.size()), CONTROL_MSG_INJECT_TOUCH_SIZE);
+    QCOMPARE(data, touchByQBuffer(controlMsg));
+}
+
+void BenchControlMsg::emptyInjectText()
+{
+    ControlMsg controlMsg(ControlMsg::CMT_INJECT_TEXT);
+    QCOMPARE(controlMsg.serializedSize(), 5);
+    QCOMPARE(controlMsg.serializeData(), QByteArray("\x01\x00\x00\x00\x00", 5));
+}
+
+void BenchControlMsg::touchQBuffer()
+{
+    ControlMsg controlMsg(ControlMsg::CMT_INJECT_TOUCH);
+    setTouch(controlMsg);
+    QBENCHMARK {
+        QByteArray data = touchByQBuffer(controlMsg);
+        Q_UNUSED(data)
+    }
+}
+
+void BenchControlMsg::touchSerializeData()
+{
+    ControlMsg controlMsg(ControlMsg::CMT_INJECT_TOUCH);
+    setTouch(controlMsg);
+    QBENCHMARK {
+        QByteArray data = controlMsg.serializeData();
+        Q_UNUSED(data)
+    }
+}
+
+void BenchControlMsg::touchSerializeTo()
+{
+    ControlMsg controlMsg(ControlMsg::CMT_INJECT_TOUCH);
+    setTouch(controlMsg);
+    uchar buf[CONTROL_MSG_FIXED_MAX_SIZE];
+    int len = 0;
+    QBENCHMARK {
+        len = controlMsg.serializeTo(buf, sizeof(buf));
+    }
+    QCOMPARE(len, CONTROL_MSG_INJECT_TOUCH_SIZE);
+}
+
+void BenchControlMsg::keycodeSerializeTo()
+{
+    ControlMsg controlMsg(ControlMsg::CMT_INJECT_KEYCODE);
+    controlMsg.setInjectKeycodeMsgData(AKEY_EVENT_ACTION_DOWN, AKEYCODE_A, 0, AMETA_NONE);
+    uchar buf[CONTROL_MSG_FIXED_MAX_SIZE];
+    int len = 0;
+    QBENCHMARK {
+        len = controlMsg.serializeTo(buf, sizeof(buf));
+    }
+    QCOMPARE(len, CONTROL_MSG_INJECT_KEYCODE_SIZE);
+}
+
+void BenchControlMsg::textSerializeTo()
+{
+    QString text("the quick brown fox jumps over the lazy dog");
+    ControlMsg controlMsg(ControlMsg::CMT_INJECT_TEXT);
+    controlMsg.setInjectTextMsgData(text);
+    QByteArray buffer(controlMsg.serializedSize(), Qt::Uninitialized);
+    int len = 0;
+    QBENCHMARK {
+        len = controlMsg.serializeTo(reinterpret_cast<uchar *>(buffer.data()), buffer.size());
+    }
+    QCOMPARE(len, 5 + int(text.size()));
+}
+
+QTEST_GUILESS_MAIN(BenchControlMsg)
+
+#include "bench_controlmsg.moc"
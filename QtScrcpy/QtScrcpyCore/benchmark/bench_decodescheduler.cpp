@@ -0,0 +1,253 @@
+#include <atomic>
+#include <chrono>
+#include <deque>
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <QtTest>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+#include "decodescheduler.h"
+
+#define DECODE_ROUNDS 90
+#define DECODE_FRAME_MS 33
+#define DECODE_PACKET_SIZE 4096
+// passes over the packet standing in for the decode work, roughly 0.1-0.2ms
+#define DECODE_WORK_PASSES 48
+
+// decoding many simulated devices at 30 fps: the shared decode scheduler against one decode
+// thread per device, with the same synthetic work per packet
+class BenchDecodeScheduler : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void decode_data();
+    void decode();
+};
+
+namespace {
+qint64 steadyNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// pts is the round, pos carries the push time for the latency
+struct SimDecoder
+{
+    std::atomic<int> decoded { 0 };
+    std::atomic<int> outOfOrder { 0 };
+    std::atomic<qint64> latencySumNs { 0 };
+    std::atomic<qint64> latencyMaxNs { 0 };
+    std::atomic<quint32> sink { 0 };
+    // -1 after a flush, any packet may follow
+    qint64 nextPts = -1;
+
+    void decode(const AVPacket *packet)
+    {
+        if (!packet) {
+            nextPts = -1;
+            return;
+        }
+        quint32 sum = 0;
+        for (int pass = 0; pass < DECODE_WORK_PASSES; ++pass) {
+            for (int i = 0; i < packet->size; ++i) {
+                sum = sum * 31 + packet->data[i] + pass;
+            }
+        }
+        sink += sum;
+        if (nextPts >= 0 && packet->pts != nextPts) {
+            outOfOrder++;
+        }
+        nextPts = packet->pts + 1;
+
+        qint64 latencyNs = steadyNowNs() - packet->pos;
+        latencySumNs += latencyNs;
+        qint64 maxNs = latencyMaxNs.load();
+        while (latencyNs > maxNs && !latencyMaxNs.compare_exchange_weak(maxNs, latencyNs)) {
+        }
+        decoded++;
+    }
+};
+
+class PoolDecoder : public DecodeScheduler::Queue, public SimDecoder
+{
+public:
+    void decodePacket(const AVPacket *packet) override
+    {
+        decode(packet);
+    }
+};
+
+// the former model: a thread of its own waiting for the packets of its device
+class ThreadDecoder : public QThread, public SimDecoder
+{
+public:
+    ~ThreadDecoder()
+    {
+        m_mutex.lock();
+        m_quit = true;
+        m_cond.wakeAll();
+        m_mutex.unlock();
+        wait();
+        for (AVPacket *packet : m_packets) {
+            av_packet_free(&packet);
+        }
+    }
+
+    void push(const AVPacket *packet)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_packets.push_back(av_packet_clone(packet));
+        m_cond.wakeOne();
+    }
+
+protected:
+    void run() override
+    {
+        for (;;) {
+            AVPacket *packet = Q_NULLPTR;
+            {
+                QMutexLocker locker(&m_mutex);
+                while (!m_quit && m_packets.empty()) {
+                    m_cond.wait(&m_mutex);
+                }
+                if (m_quit) {
+                    return;
+                }
+                packet = m_packets.front();
+                m_packets.pop_front();
+            }
+            decode(packet);
+            av_packet_free(&packet);
+        }
+    }
+
+private:
+    QMutex m_mutex;
+    QWaitCondition m_cond;
+    std::deque<AVPacket *> m_packets;
+    bool m_quit = false;
+};
+
+struct Usage
+{
+    qint64 cpuUs = 0;
+    qint64 switches = 0;
+
+    static Usage now()
+    {
+        Usage result;
+#ifdef Q_OS_UNIX
+        struct rusage usage = {};
+        getrusage(RUSAGE_SELF, &usage);
+        result.cpuUs = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000LL + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+        result.switches = usage.ru_nvcsw + usage.ru_nivcsw;
+#endif
+        return result;
+    }
+};
+}
+
+void BenchDecodeScheduler::decode_data()
+{
+    QTest::addColumn<int>("devices");
+    QTest::addColumn<bool>("shared");
+    for (int devices : { 16, 64, 200 }) {
+        QTest::newRow(qPrintable(QString("%1 threads").arg(devices))) << devices << false;
+        QTest::newRow(qPrintable(QString("%1 shared").arg(devices))) << devices << true;
+    }
+}
+
+void BenchDecodeScheduler::decode()
+{
+    QFETCH(int, devices);
+    QFETCH(bool, shared);
+
+    DecodeScheduler &scheduler = DecodeScheduler::instance();
+    QList<PoolDecoder *> poolDecoders;
+    QList<ThreadDecoder *> threadDecoders;
+    QList<SimDecoder *> decoders;
+    for (int i = 0; i < devices; ++i) {
+        if (shared) {
+            PoolDecoder *decoder = new PoolDecoder();
+            scheduler.add(decoder);
+            poolDecoders << decoder;
+            decoders << decoder;
+        } else {
+            ThreadDecoder *decoder = new ThreadDecoder();
+            decoder->start();
+            threadDecoders << decoder;
+            decoders << decoder;
+        }
+    }
+
+    AVPacket *packet = av_packet_alloc();
+    QVERIFY(packet && 0 == av_new_packet(packet, DECODE_PACKET_SIZE));
+    for (int i = 0; i < DECODE_PACKET_SIZE; ++i) {
+        packet->data[i] = static_cast<uint8_t>(i);
+    }
+
+    Usage start = Usage::now();
+    qint64 startNs = steadyNowNs();
+    for (int round = 0; round < DECODE_ROUNDS; ++round) {
+        packet->pts = round;
+        packet->pos = steadyNowNs();
+        for (int i = 0; i < devices; ++i) {
+            if (shared) {
+                scheduler.push(poolDecoders[i], packet);
+            } else {
+                threadDecoders[i]->push(packet);
+            }
+        }
+        // the next frame of every device
+        qint64 waitNs = startNs + (round + 1) * DECODE_FRAME_MS * 1000000LL - steadyNowNs();
+        if (waitNs > 0) {
+            QThread::usleep(static_cast<unsigned long>(waitNs / 1000));
+        }
+    }
+
+    // until everything is decoded, or dropped by a lane that fell behind
+    int total = devices * DECODE_ROUNDS;
+    int decoded = 0;
+    int last = -1;
+    while (decoded < total && decoded != last) {
+        last = decoded;
+        QThread::msleep(200);
+        decoded = 0;
+        for (SimDecoder *decoder : decoders) {
+            decoded += decoder->decoded;
+        }
+    }
+    Usage end = Usage::now();
+
+    qint64 latencySumNs = 0;
+    qint64 latencyMaxNs = 0;
+    int outOfOrder = 0;
+    for (SimDecoder *decoder : decoders) {
+        latencySumNs += decoder->latencySumNs;
+        latencyMaxNs = qMax(latencyMaxNs, decoder->latencyMaxNs.load());
+        outOfOrder += decoder->outOfOrder;
+    }
+
+    for (PoolDecoder *decoder : poolDecoders) {
+        scheduler.remove(decoder);
+    }
+    qDeleteAll(poolDecoders);
+    qDeleteAll(threadDecoders);
+    av_packet_free(&packet);
+
+    // each device is decoded in order on either model
+    QCOMPARE(outOfOrder, 0);
+    qInfo("%3d devices %-7s: %3d decode threads, cpu %6lldms, %7lld context switches, latency avg %6.2fms max %7.2fms, %d/%d decoded",
+          devices, shared ? "shared" : "threads", shared ? scheduler.threadCount() : devices, (end.cpuUs - start.cpuUs) / 1000,
+          end.switches - start.switches, decoded ? latencySumNs / 1000000.0 / decoded : 0.0, latencyMaxNs / 1000000.0, decoded, total);
+}
+
+QTEST_GUILESS_MAIN(BenchDecodeScheduler)
+
+#include "bench_decodescheduler.moc"
@@ -0,0 +1,253 @@
+#include <atomic>
+
+#include <QElapsedTimer>
+#include <QThread>
+#include <QtEndian>
+#include <QtTest>
+
+#ifdef Q_OS_LINUX
+#include <errno.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "demuxreactor.h"
+
+#define DEMUX_PACKETS 300
+#define DEMUX_PACKET_SIZE 8192
+// pts: 8 bytes; size: 4 bytes, like the scrcpy frame header
+#define DEMUX_HEADER_SIZE 12
+
+// receiving many simulated video streams: the shared reactor against one thread per device
+// blocked in a read, both parse the frame headers of the same byte streams
+class BenchDemuxReactor : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void receive_data();
+    void receive();
+};
+
+#ifdef Q_OS_LINUX
+namespace {
+// one device's stream, parsed incrementally whatever the read sizes
+struct Stream
+{
+    QByteArray buffer;
+    int packets = 0;
+    std::atomic<bool> done { false };
+
+    void consume(const char *data, int len)
+    {
+        buffer.append(data, len);
+        int offset = 0;
+        while (buffer.size() - offset >= DEMUX_HEADER_SIZE) {
+            quint32 size = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(buffer.constData() + offset + 8));
+            if (buffer.size() - offset < DEMUX_HEADER_SIZE + static_cast<int>(size)) {
+                break;
+            }
+            offset += DEMUX_HEADER_SIZE + size;
+            packets++;
+        }
+        buffer.remove(0, offset);
+    }
+};
+
+class ReactorStream : public DemuxReactor::Source, public Stream
+{
+public:
+    bool readReady(int fd) override
+    {
+        char chunk[64 * 1024];
+        ssize_t len = ::read(fd, chunk, sizeof(chunk));
+        if (len > 0) {
+            consume(chunk, static_cast<int>(len));
+            return true;
+        }
+        return len < 0 && (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno);
+    }
+    void closed() override
+    {
+        done = true;
+    }
+};
+
+class ThreadStream : public QThread, public Stream
+{
+public:
+    explicit ThreadStream(int fd) : m_fd(fd) {}
+    ~ThreadStream()
+    {
+        wait();
+        ::close(m_fd);
+    }
+
+protected:
+    void run() override
+    {
+        char chunk[64 * 1024];
+        for (;;) {
+            ssize_t len = ::read(m_fd, chunk, sizeof(chunk));
+            if (len < 0 && EINTR == errno) {
+                continue;
+            }
+            if (len <= 0) {
+                break;
+            }
+            consume(chunk, static_cast<int>(len));
+        }
+        done = true;
+    }
+
+private:
+    int m_fd;
+};
+
+// the devices: every stream gets one packet in turn, then all are closed
+class Feeder : public QThread
+{
+public:
+    explicit Feeder(const QVector<int> &fds) : m_fds(fds) {}
+
+protected:
+    void run() override
+    {
+        QByteArray packet(DEMUX_HEADER_SIZE + DEMUX_PACKET_SIZE, '\0');
+        qToBigEndian<quint32>(DEMUX_PACKET_SIZE, reinterpret_cast<uchar *>(packet.data() + 8));
+        for (int i = 0; i < DEMUX_PACKETS; ++i) {
+            qToBigEndian<quint64>(i, reinterpret_cast<uchar *>(packet.data()));
+            for (int fd : m_fds) {
+                writeAll(fd, packet);
+            }
+        }
+        for (int fd : m_fds) {
+            ::close(fd);
+        }
+    }
+
+private:
+    static void writeAll(int fd, const QByteArray &data)
+    {
+        const char *p = data.constData();
+        qint64 left = data.size();
+        while (left > 0) {
+            ssize_t len = ::write(fd, p, left);
+            if (len < 0 && EINTR == errno) {
+                continue;
+            }
+            if (len <= 0) {
+                return;
+            }
+            p += len;
+            left -= len;
+        }
+    }
+
+    QVector<int> m_fds;
+};
+
+struct Usage
+{
+    qint64 cpuUs = 0;
+    qint64 switches = 0;
+
+    static Usage now()
+    {
+        struct rusage usage = {};
+        getrusage(RUSAGE_SELF, &usage);
+        Usage result;
+        result.cpuUs = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000LL + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+        result.switches = usage.ru_nvcsw + usage.ru_nivcsw;
+        return result;
+    }
+};
+}
+#endif
+
+void BenchDemuxReactor::receive_data()
+{
+    QTest::addColumn<int>("devices");
+    QTest::addColumn<bool>("reactor");
+    for (int devices : { 16, 64, 200 }) {
+        QTest::newRow(qPrintable(QString("%1 threads").arg(devices))) << devices << false;
+        QTest::newRow(qPrintable(QString("%1 reactor").arg(devices))) << devices << true;
+    }
+}
+
+void BenchDemuxReactor::receive()
+{
+#ifdef Q_OS_LINUX
+    QFETCH(int, devices);
+    QFETCH(bool, reactor);
+    if (reactor && !DemuxReactor::isSupported()) {
+        QSKIP("no demux reactor on this platform");
+    }
+    // the pool threads exist before the clock starts
+    int reactorThreads = DemuxReactor::instance().threadCount();
+
+    QVector<int> writeFds;
+    QVector<int> readFds;
+    for (int i = 0; i < devices; ++i) {
+        int fds[2];
+        QVERIFY(0 == socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds));
+        readFds << fds[0];
+        writeFds << fds[1];
+    }
+
+    QList<ReactorStream *> reactorStreams;
+    QList<ThreadStream *> threadStreams;
+    QList<Stream *> streams;
+    Usage start = Usage::now();
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int fd : readFds) {
+        if (reactor) {
+            ReactorStream *stream = new ReactorStream();
+            QVERIFY(DemuxReactor::instance().add(fd, stream));
+            reactorStreams << stream;
+            streams << stream;
+        } else {
+            ThreadStream *stream = new ThreadStream(fd);
+            stream->start();
+            threadStreams << stream;
+            streams << stream;
+        }
+    }
+    Feeder feeder(writeFds);
+    feeder.start();
+
+    auto allDone = [&streams]() {
+        for (Stream *stream : streams) {
+            if (!stream->done) {
+                return false;
+            }
+        }
+        return true;
+    };
+    QTRY_VERIFY_WITH_TIMEOUT(allDone(), 60000);
+    feeder.wait();
+    qint64 elapsedMs = timer.elapsed();
+    Usage end = Usage::now();
+
+    for (Stream *stream : streams) {
+        QCOMPARE(stream->packets, DEMUX_PACKETS);
+    }
+    for (ReactorStream *stream : reactorStreams) {
+        DemuxReactor::instance().remove(stream);
+    }
+    qDeleteAll(reactorStreams);
+    qDeleteAll(threadStreams);
+
+    qInfo("%3d devices %-7s: %2d receive threads, %5lldms, cpu %6lldms, %7lld context switches", devices, reactor ? "reactor" : "threads",
+          reactor ? reactorThreads : devices, elapsedMs, (end.cpuUs - start.cpuUs) / 1000, end.switches - start.switches);
+#else
+    QSKIP("the receive benchmark needs Linux sockets");
+#endif
+}
+
+QTEST_GUILESS_MAIN(BenchDemuxReactor)
+
+#include "bench_demuxreactor.moc"
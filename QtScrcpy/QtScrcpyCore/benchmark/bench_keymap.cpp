@@ -0,0 +1,92 @@
+#include <QFile>
+#include <QMultiHash>
+#include <QtTest>
+
+#include "keymap.h"
+
+// key and mouse lookups of a game keymap: the flat tables of KeyMap against the two
+// QMultiHash maps it used before, built from the same nodes
+class BenchKeyMap : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void lookupTables();
+    void lookupMultiHash();
+
+private:
+    KeyMap m_keyMap;
+    // a burst of game input: letters, digits, modifiers, function keys and the buttons
+    QVector<int> m_keys;
+    QVector<int> m_buttons;
+};
+
+void BenchKeyMap::initTestCase()
+{
+    QFile file(QString(QSC_BENCHMARK_KEYMAP_DIR) + "/d3l-layoutgila.json");
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QVERIFY(m_keyMap.loadKeyMap(QString::fromUtf8(file.readAll())));
+
+    for (int key = Qt::Key_A; key <= Qt::Key_Z; ++key) {
+        m_keys << key;
+    }
+    for (int key = Qt::Key_0; key <= Qt::Key_9; ++key) {
+        m_keys << key;
+    }
+    for (int key = Qt::Key_F1; key <= Qt::Key_F12; ++key) {
+        m_keys << key;
+    }
+    m_keys << Qt::Key_Space << Qt::Key_Tab << Qt::Key_Escape << Qt::Key_Shift << Qt::Key_Control << Qt::Key_Alt << Qt::Key_QuoteLeft;
+    m_buttons << Qt::LeftButton << Qt::RightButton << Qt::MiddleButton << Qt::XButton1 << Qt::XButton2;
+}
+
+void BenchKeyMap::lookupTables()
+{
+    int mapped = 0;
+    QBENCHMARK {
+        mapped = 0;
+        for (int key : m_keys) {
+            mapped += KeyMap::KMT_INVALID != m_keyMap.getKeyMapNodeKey(key).type;
+        }
+        for (int button : m_buttons) {
+            mapped += KeyMap::KMT_INVALID != m_keyMap.getKeyMapNodeMouse(button).type;
+        }
+    }
+    QVERIFY(mapped > 0);
+}
+
+void BenchKeyMap::lookupMultiHash()
+{
+    QMultiHash<int, const KeyMap::KeyMapNode *> rmapKey;
+    QMultiHash<int, const KeyMap::KeyMapNode *> rmapMouse;
+    for (int key : m_keys) {
+        const KeyMap::KeyMapNode &node = m_keyMap.getKeyMapNodeKey(key);
+        if (KeyMap::KMT_INVALID != node.type) {
+            rmapKey.insert(key, &node);
+        }
+    }
+    for (int button : m_buttons) {
+        const KeyMap::KeyMapNode &node = m_keyMap.getKeyMapNodeMouse(button);
+        if (KeyMap::KMT_INVALID != node.type) {
+            rmapMouse.insert(button, &node);
+        }
+    }
+
+    const KeyMap::KeyMapNode *invalid = Q_NULLPTR;
+    int mapped = 0;
+    QBENCHMARK {
+        mapped = 0;
+        for (int key : m_keys) {
+            mapped += invalid != rmapKey.value(key, invalid);
+        }
+        for (int button : m_buttons) {
+            mapped += invalid != rmapMouse.value(button, invalid);
+        }
+    }
+    QVERIFY(mapped > 0);
+}
+
+QTEST_GUILESS_MAIN(BenchKeyMap)
+
+#include "bench_keymap.moc"
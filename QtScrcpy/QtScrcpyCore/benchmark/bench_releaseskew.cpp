@@ -0,0 +1,102 @@
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QtTest>
+
+#include "controlchannel.h"
+
+#define RELEASE_ROUNDS 50
+// far enough ahead for every channel of the group to queue its data
+#define RELEASE_AHEAD_MS 5
+
+// aligned group input: the same message queued on a group of control channels with one
+// release time, the flush skew of each channel and the first to last flush spread of the
+// group, by group size
+class BenchReleaseSkew : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void skewVsGroupSize_data();
+    void skewVsGroupSize();
+};
+
+void BenchReleaseSkew::skewVsGroupSize_data()
+{
+    QTest::addColumn<int>("devices");
+    QTest::newRow("1") << 1;
+    QTest::newRow("4") << 4;
+    QTest::newRow("16") << 16;
+    QTest::newRow("64") << 64;
+}
+
+void BenchReleaseSkew::skewVsGroupSize()
+{
+    QFETCH(int, devices);
+
+    // the device ends, they only drain what arrives
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost, 0));
+    QList<QTcpSocket *> peers;
+    connect(&server, &QTcpServer::newConnection, this, [&server, &peers]() {
+        while (server.hasPendingConnections()) {
+            QTcpSocket *peer = server.nextPendingConnection();
+            connect(peer, &QTcpSocket::readyRead, peer, [peer]() { peer->readAll(); });
+            peers << peer;
+        }
+    });
+
+    QList<ControlChannel *> channels;
+    for (int i = 0; i < devices; ++i) {
+        QTcpSocket *socket = new QTcpSocket();
+        socket->connectToHost(QHostAddress::LocalHost, server.serverPort());
+        QVERIFY(socket->waitForConnected(1000));
+        channels << new ControlChannel(socket);
+    }
+    QTRY_COMPARE(int(peers.size()), devices);
+
+    // a touch move sized message, shared by the whole group
+    QByteArray data(32, '\x02');
+    quint64 count = 0;
+    qint64 sumNs = 0;
+    qint64 maxNs = 0;
+    ControlChannel::takeReleaseSpread(count, sumNs, maxNs);
+    for (ControlChannel *channel : channels) {
+        channel->takeSendSkew(count, sumNs, maxNs);
+    }
+
+    for (int round = 0; round < RELEASE_ROUNDS; ++round) {
+        qint64 releaseNs = ControlChannel::nowNs() + RELEASE_AHEAD_MS * 1000000LL;
+        for (ControlChannel *channel : channels) {
+            channel->send(data, releaseNs);
+        }
+        QTest::qWait(RELEASE_AHEAD_MS * 2);
+    }
+
+    quint64 skewCount = 0;
+    qint64 skewSumNs = 0;
+    qint64 skewMaxNs = 0;
+    for (ControlChannel *channel : channels) {
+        channel->takeSendSkew(count, sumNs, maxNs);
+        skewCount += count;
+        skewSumNs += sumNs;
+        skewMaxNs = qMax(skewMaxNs, maxNs);
+    }
+    quint64 spreadCount = 0;
+    qint64 spreadSumNs = 0;
+    qint64 spreadMaxNs = 0;
+    ControlChannel::takeReleaseSpread(spreadCount, spreadSumNs, spreadMaxNs);
+
+    for (ControlChannel *channel : channels) {
+        channel->release();
+    }
+    qDeleteAll(peers);
+
+    // a release the clock serves very late may flush two rounds at once
+    QVERIFY(skewCount > 0);
+    qInfo("%3d devices: skew avg %6.1fus max %6.1fus, spread avg %6.1fus max %6.1fus", devices, skewSumNs / 1000.0 / skewCount,
+          skewMaxNs / 1000.0, spreadCount ? spreadSumNs / 1000.0 / spreadCount : 0.0, spreadMaxNs / 1000.0);
+}
+
+QTEST_GUILESS_MAIN(BenchReleaseSkew)
+
+#include "bench_releaseskew.moc"
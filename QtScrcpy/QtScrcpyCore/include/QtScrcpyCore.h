@@ -1,6 +1,7 @@
 #pragma once
 #include <QPointer>
 #include <QMouseEvent>
+#include <QVector>
 
 #include "QtScrcpyCoreDef.h"
 
@@ -83,6 +84,18 @@ public:
 signals:
     void deviceConnected(bool success, const QString& serial, const QString& deviceName, const QSize& size);
     void deviceDisconnected(QString serial);
+    // timing of each server startup step (check/push/reverse/forward/execute/connect)
+    void startupStepFinished(const QString& serial, const QString& step, qint64 elapsedMs);
+    // the first frame after connect was decoded
+    void firstFrameReceived(const QString& serial);
+    // an automatic reconnect finished, successCount/totalCount is the session success rate
+    void reconnectFinished(const QString& serial, bool success, qint64 elapsedMs, quint32 successCount, quint32 totalCount);
+    // the adaptive stream restarted the video with new settings
+    void streamQualityChanged(const QString& serial, quint32 bitRate, quint16 maxSize, quint32 maxFps);
+    // a postTextInput/clipboardPaste finished, long text goes through the device clipboard (viaClipboard)
+    void textInjected(const QString& serial, int chars, qint64 elapsedMs, double charsPerSecond, bool viaClipboard);
+    // the macro played its last loop or was stopped
+    void macroFinished(const QString& serial);
 
 public:
     virtual void setUserData(void* data) = 0;
@@ -96,6 +109,10 @@ public:
     virtual void mouseEvent(const QMouseEvent *from, const QSize &frameSize, const QSize &showSize) = 0;
     virtual void wheelEvent(const QWheelEvent *from, const QSize &frameSize, const QSize &showSize) = 0;
     virtual void keyEvent(const QKeyEvent *from, const QSize &frameSize, const QSize &showSize) = 0;
+    // relative deltas of a raw mouse source (unaccelerated, one per device report) drive the
+    // custom keymap mouse move while enabled, the cursor position is ignored and not warped back
+    virtual void setRawMouseMotion(bool enabled) = 0;
+    virtual void rawMouseMotion(const QPointF &delta) = 0;
 
     virtual void postGoBack() = 0;
     virtual void postGoHome() = 0;
@@ -119,12 +136,43 @@ public:
 
     virtual void screenshot() = 0;
     virtual void showTouch(bool show) = 0;
+    // ask the device for a key frame, repeated requests within a short time are ignored
+    virtual void resetVideo() = 0;
+    // with the shared decode pool, the video of this device is decoded before the others
+    virtual void setDecodePriority(bool high) = 0;
+    // the window of this device is shown and not minimized, the governor does not throttle it
+    virtual void setWindowVisible(bool visible) = 0;
 
     virtual bool isReversePort(quint16 port) = 0;
     virtual const QString &getSerial() = 0;
 
     virtual void updateScript(QString script) = 0;
     virtual bool isCurrentCustomKeymap() = 0;
+    // touch moves and scrolls merged into later ones instead of being sent
+    virtual quint64 mergedInputEventCount() = 0;
+    // send latency of the input events since the last call, from the input event to the control socket
+    virtual void takeInputLatency(quint64 &count, double &avgMs, double &maxMs) = 0;
+    // aligned group input: socket flush time minus the common release time since the last call
+    virtual void takeInputSkew(quint64 &count, double &avgMs, double &maxMs) = 0;
+    // how late the steps of game input animations (steer wheel, drag, multi click) were sent since the last call
+    virtual void takeInputTimingError(quint64 &count, double &avgMs, double &maxMs) = 0;
+
+    // macros: key, touch and scroll input sent to the device, positions relative to the frame
+    virtual void startMacroRecord() = 0;
+    virtual bool stopMacroRecord(const QString &fileName) = 0;
+    // 0 loops: until stopMacro()
+    virtual bool playMacro(const QString &fileName, int loops = 1) = 0;
+    virtual void stopMacro() = 0;
+    virtual bool isMacroPlaying() = 0;
+    // how late the macro messages were sent against their recorded time since the last call
+    virtual void takeMacroTimingError(quint64 &count, double &avgMs, double &maxMs) = 0;
+
+    // bytes held for this device now, and the most held since it was created
+    virtual MemoryUsage memoryUsage() = 0;
+    virtual MemoryUsage memoryPeak() = 0;
+    // memory the application holds for this device, counted in its usage
+    virtual void setTextureMemory(qint64 bytes) = 0;
+    virtual void setAudioMemory(qint64 bytes) = 0;
 };
 
 class IDeviceManage : public QObject {
@@ -132,13 +180,52 @@ class IDeviceManage : public QObject {
 public:
     static IDeviceManage& getInstance();
     virtual bool connectDevice(DeviceParams params) = 0;
+    // connect a batch of devices with bounded parallelism, local ports come from a pool
+    // failed connections are retried with backoff before deviceConnected(false) is emitted
+    virtual void connectDevices(const QList<DeviceParams>& paramsList) = 0;
+    virtual void setMaxConcurrentConnects(int count) = 0;
+    // follow adb's device list through host:track-devices instead of polling "adb devices"
+    // with autoConnect every device reaching the "device" state is connected with autoConnectParams
+    virtual void startDeviceDiscovery(bool autoConnect = false, const DeviceParams& autoConnectParams = DeviceParams()) = 0;
+    virtual void stopDeviceDiscovery() = 0;
+    // serials of the discovered devices in the "device" state
+    virtual QStringList getOnlineDevices() = 0;
     virtual bool disconnectDevice(const QString &serial) = 0;
     virtual void disconnectAllDevice() = 0;
     virtual QPointer<IDevice> getDevice(const QString& serial) = 0;
+    // group control: the event is converted and serialized once per distinct frame size and the
+    // same buffer is queued on every control socket, devices with a custom keymap or UHID input
+    // convert it themselves
+    virtual void broadcastMouseEvent(const QVector<QPointer<IDevice>> &devices, const QMouseEvent *from, const QSize &showSize) = 0;
+    virtual void broadcastWheelEvent(const QVector<QPointer<IDevice>> &devices, const QWheelEvent *from, const QSize &showSize) = 0;
+    virtual void broadcastKeyEvent(const QVector<QPointer<IDevice>> &devices, const QKeyEvent *from, const QSize &showSize) = 0;
+    // broadcasts are held until now + alignMs and then flushed to all sockets together from the
+    // control I/O thread, so no device gets them earlier than the others, 0 sends them right away
+    virtual void setBroadcastAlignment(int alignMs) = 0;
+    // first to last socket flush of each aligned broadcast since the last call
+    virtual void takeBroadcastSpread(quint64 &count, double &avgMs, double &maxMs) = 0;
+    // the same macro on several devices, started together
+    virtual void playMacro(const QString &fileName, const QStringList &serials, int loops = 1) = 0;
+    virtual void stopMacro(const QStringList &serials) = 0;
+    // measures the process CPU usage (percent of all cores) and the video bandwidth every second,
+    // above a limit the devices out of view are throttled one GovernorLevel at a time, below
+    // most of it they are released again; 0 ignores that limit, both 0 turn the governor off
+    virtual void setGovernor(int maxCpuPercent, int maxMbps) = 0;
+    // IDevice::memoryUsage() of all devices together, the peak counts the devices already gone too
+    virtual MemoryUsage totalMemoryUsage() = 0;
+    virtual MemoryUsage totalMemoryPeak() = 0;
 
 signals:
     void deviceConnected(bool success, const QString& serial, const QString& deviceName, const QSize& size);
     void deviceDisconnected(QString serial);
+    // time from the connect request to the first decoded frame
+    void deviceFirstFrame(const QString& serial, qint64 elapsedMs);
+    // device discovery, state is adb's ("device", "offline", "unauthorized"...)
+    void deviceAdded(const QString& serial, const QString& state);
+    void deviceRemoved(const QString& serial);
+    void deviceStateChanged(const QString& serial, const QString& state);
+    // the governor moved the device to level (GovernorLevel), with the measurements that made it
+    void governorDecision(const QString& serial, int level, double cpuPercent, double mbps);
 };
 
 }
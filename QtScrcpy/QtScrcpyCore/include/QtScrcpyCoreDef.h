@@ -3,6 +3,26 @@
 
 namespace qsc {
 
+// 调控器对后台设备的限制，每一级包含前面的限制
+enum GovernorLevel {
+    GL_FULL = 0,                      // 不限制
+    GL_REFERENCE_FRAMES,              // 只解码参考帧
+    GL_KEY_FRAMES,                    // 只解码关键帧
+    GL_REDUCED_STREAM,                // 只解码关键帧，并以更低的分辨率和帧率重启视频流
+};
+
+// 内存占用（字节），按用途分类
+struct MemoryUsage {
+    qint64 demuxer = 0;               // 解复用器中等待拼接的配置包和正在接收的包
+    qint64 decoder = 0;               // 共享解码池中排队的包
+    qint64 videoBuffer = 0;           // VideoBuffer中的解码帧
+    qint64 recorder = 0;              // 录制队列中的包
+    qint64 screenshot = 0;            // 正在保存的截图
+    qint64 texture = 0;               // 显示用的GL纹理（由界面上报）
+    qint64 audio = 0;                 // 音频缓冲（由界面上报）
+    qint64 total = 0;                 // 合计，峰值时是合计的峰值而不是各项峰值之和
+};
+
 struct DeviceParams {
     // necessary
     QString serial = "";              // 设备序列号
@@ -39,6 +59,17 @@ struct DeviceParams {
     bool display = true;              // 是否显示画面（或者仅仅后台录制）
     bool renderExpiredFrames = false; // 是否渲染延迟视频帧
     QString gameScript = "";          // 游戏映射脚本
+    bool clipboardAutoSync = false;   // 电脑剪贴板变化时自动同步到设备（内容不变不重复发送）
+    int inputCoalesceMs = 0;          // 合并触摸移动/滚轮事件的间隔，0表示只合并同一次事件循环内的事件（默认，不额外延迟）
+    bool uhidKeyboard = false;        // 通过UHID虚拟键盘注入按键（保留修饰键和按键重复），游戏脚本优先
+    bool uhidMouse = false;           // 通过UHID虚拟鼠标注入相对移动（点击画面捕获鼠标，Alt释放）
+
+    bool autoReconnect = false;       // 连接断开后自动重连（保留窗口和解码器，只重启server）
+    int maxReconnectCount = 5;        // 每次断开后最多重连次数
+    bool adaptiveStream = false;      // 根据网络和解码状况自动调整码率/分辨率/帧率（不超过上面的设置）
+    int latencyBudgetMs = 100;        // 自适应时允许的排队延迟
+    bool demuxReactor = false;        // 视频流由共享的epoll线程池接收（仅Linux），线程数与设备数无关，同时启用sharedDecode
+    bool sharedDecode = false;        // 所有设备共用一个解码线程池（每个设备按顺序解码，焦点窗口优先）
 };
     
 }
@@ -1,9 +1,12 @@
 #ifndef ADBPROCESS_H
 #define ADBPROCESS_H
 
+#include <functional>
+
 #include <QObject>
 
 class AdbProcessImpl;
+class AdbClient;
 namespace qsc {
 
 class AdbProcess : public QObject
@@ -24,6 +27,9 @@ public:
     virtual ~AdbProcess();
 
     static void setAdbPath(const QString& adbPath);
+    // talk to the adb server directly instead of spawning adb, enabled by default
+    // the adb binary is still used when the adb server can not be reached
+    static void setNativeClientEnabled(bool enabled);
 
     void execute(const QString &serial, const QStringList &args);
     void forward(const QString &serial, quint16 localPort, const QString &deviceSocketName);
@@ -46,8 +52,16 @@ public:
 signals:
     void adbProcessResult(ADB_EXEC_RESULT processResult);
 
+private:
+    void startNative(const QStringList &args, const std::function<void()> &native, const std::function<void()> &fallback);
+    void startProcess(const std::function<void()> &process);
+
 private:
     AdbProcessImpl* m_adbImpl = nullptr;
+    AdbClient* m_adbClient = nullptr;
+    bool m_usingClient = false;
+    QStringList m_clientArgs;
+    std::function<void()> m_fallback;
 };
 
 }
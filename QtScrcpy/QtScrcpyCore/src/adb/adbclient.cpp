@@ -0,0 +1,529 @@
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+#include <QHostAddress>
+#include <QtEndian>
+
+#include "adbclient.h"
+
+#define ADB_SERVER_DEFAULT_PORT 5037
+// the adb server is local, so a slow connect means it is not there
+#define ADB_CONNECT_TIMEOUT 1000
+#define ADB_REQUEST_TIMEOUT 10000
+#define ADB_SYNC_DATA_MAX (64 * 1024)
+#define ADB_SYNC_FILE_MODE 0644
+#define ADB_S_IFMT 0170000
+#define ADB_S_IFDIR 0040000
+
+// shell v2 packet ids
+#define ADB_SHELL_ID_STDOUT 1
+#define ADB_SHELL_ID_STDERR 2
+#define ADB_SHELL_ID_EXIT 3
+#define ADB_SHELL_HEADER_SIZE 5
+
+quint16 AdbClient::s_serverPort = 0;
+
+AdbClient::AdbClient(QObject *parent) : QObject(parent)
+{
+    m_timeoutTimer.setSingleShot(true);
+    connect(&m_timeoutTimer, &QTimer::timeout, this, &AdbClient::onTimeout);
+}
+
+AdbClient::~AdbClient()
+{
+    reset();
+}
+
+quint16 AdbClient::getServerPort()
+{
+    if (0 == s_serverPort) {
+        bool ok = false;
+        quint16 port = qgetenv("ANDROID_ADB_SERVER_PORT").toUShort(&ok);
+        s_serverPort = (ok && port) ? port : ADB_SERVER_DEFAULT_PORT;
+    }
+    return s_serverPort;
+}
+
+void AdbClient::setServerPort(quint16 port)
+{
+    s_serverPort = port;
+}
+
+QByteArray AdbClient::encodeRequest(const QString &request)
+{
+    QByteArray payload = request.toUtf8();
+    return QString("%1").arg(payload.size(), 4, 16, QChar('0')).toUtf8() + payload;
+}
+
+void AdbClient::forward(const QString &serial, quint16 localPort, const QString &deviceSocketName)
+{
+    QString prefix = serial.isEmpty() ? "host" : QString("host-serial:%1").arg(serial);
+    QList<QByteArray> requests;
+    requests << encodeRequest(QString("%1:forward:tcp:%2;localabstract:%3").arg(prefix).arg(localPort).arg(deviceSocketName));
+    // the host replies OKAY for the request and OKAY again once the forward is set up
+    start(ACS_FORWARD, requests, 1);
+}
+
+void AdbClient::forwardRemove(const QString &serial, quint16 localPort)
+{
+    QString prefix = serial.isEmpty() ? "host" : QString("host-serial:%1").arg(serial);
+    QList<QByteArray> requests;
+    requests << encodeRequest(QString("%1:killforward:tcp:%2").arg(prefix).arg(localPort));
+    start(ACS_FORWARD_REMOVE, requests, 1);
+}
+
+void AdbClient::reverse(const QString &serial, const QString &deviceSocketName, quint16 localPort)
+{
+    QList<QByteArray> requests;
+    requests << transportRequest(serial);
+    requests << encodeRequest(QString("reverse:forward:localabstract:%1;tcp:%2").arg(deviceSocketName).arg(localPort));
+    start(ACS_REVERSE, requests, 1);
+}
+
+void AdbClient::reverseRemove(const QString &serial, const QString &deviceSocketName)
+{
+    QList<QByteArray> requests;
+    requests << transportRequest(serial);
+    requests << encodeRequest(QString("reverse:killforward:localabstract:%1").arg(deviceSocketName));
+    start(ACS_REVERSE_REMOVE, requests, 1);
+}
+
+void AdbClient::shell(const QString &serial, const QString &command)
+{
+    m_serial = serial;
+    m_shellCommand = command;
+    m_shellV2 = true;
+    m_exitCode = 0;
+
+    QList<QByteArray> requests;
+    requests << transportRequest(serial);
+    requests << encodeRequest(QString("shell,v2,raw:%1").arg(command));
+    start(ACS_SHELL, requests, 0);
+}
+
+void AdbClient::push(const QString &serial, const QString &local, const QString &remote)
+{
+    if (m_syncFile.isOpen()) {
+        m_syncFile.close();
+    }
+    m_syncFile.setFileName(local);
+    if (!m_syncFile.open(QIODevice::ReadOnly)) {
+        qWarning("adb client: open %s failed", local.toUtf8().data());
+        m_errorOutput = m_syncFile.errorString().toUtf8();
+        // report asynchronously like a failed adb process would
+        QTimer::singleShot(0, this, [this]() {
+            emit adbClientResult(qsc::AdbProcess::AER_SUCCESS_START);
+            emit adbClientResult(qsc::AdbProcess::AER_ERROR_EXEC);
+        });
+        return;
+    }
+    m_syncRemote = remote;
+    // same as adb push, a trailing slash means the target is a directory
+    if (m_syncRemote.endsWith('/')) {
+        m_syncRemote += QFileInfo(local).fileName();
+    }
+    m_syncDataDone = false;
+
+    QList<QByteArray> requests;
+    requests << transportRequest(serial);
+    requests << encodeRequest("sync:");
+    start(ACS_PUSH, requests, 0);
+}
+
+bool AdbClient::isRuning()
+{
+    return ACS_NULL != m_service;
+}
+
+void AdbClient::kill()
+{
+    if (ACS_NULL == m_service) {
+        return;
+    }
+    reset();
+    // like a killed adb process, the request ends with an error reported later
+    quint32 runId = m_runId;
+    QTimer::singleShot(0, this, [this, runId]() {
+        if (runId == m_runId && ACS_NULL == m_service) {
+            emit adbClientResult(qsc::AdbProcess::AER_ERROR_EXEC);
+        }
+    });
+}
+
+QString AdbClient::getStdOut()
+{
+    return QString::fromUtf8(m_standardOutput);
+}
+
+QString AdbClient::getErrorOut()
+{
+    return QString::fromUtf8(m_errorOutput);
+}
+
+void AdbClient::start(ADB_CLIENT_SERVICE service, const QList<QByteArray> &requests, int extraStatus)
+{
+    reset();
+
+    m_runId++;
+    m_service = service;
+    m_requests = requests;
+    m_requestIndex = 0;
+    m_extraStatus = extraStatus;
+    m_buffer.clear();
+    m_standardOutput.clear();
+    m_errorOutput.clear();
+    m_startReported = false;
+    m_state = ACST_CONNECTING;
+
+    m_socket = new QTcpSocket(this);
+    connect(m_socket, &QTcpSocket::connected, this, &AdbClient::onConnected);
+    connect(m_socket, &QTcpSocket::readyRead, this, &AdbClient::onReadyRead);
+    connect(m_socket, &QTcpSocket::bytesWritten, this, &AdbClient::onBytesWritten);
+    connect(m_socket, &QTcpSocket::disconnected, this, &AdbClient::onDisconnected);
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+    connect(m_socket, &QTcpSocket::errorOccurred, this, &AdbClient::onSocketError);
+#else
+    connect(m_socket, static_cast<void (QAbstractSocket::*)(QAbstractSocket::SocketError)>(&QAbstractSocket::error), this, &AdbClient::onSocketError);
+#endif
+
+    m_timeoutTimer.start(ADB_CONNECT_TIMEOUT);
+    m_socket->connectToHost(QHostAddress::LocalHost, getServerPort());
+}
+
+QByteArray AdbClient::transportRequest(const QString &serial)
+{
+    if (serial.isEmpty()) {
+        return encodeRequest("host:transport-any");
+    }
+    return encodeRequest(QString("host:transport:%1").arg(serial));
+}
+
+void AdbClient::sendNextRequest()
+{
+    m_state = ACST_STATUS;
+    m_socket->write(m_requests[m_requestIndex]);
+}
+
+void AdbClient::onConnected()
+{
+    if (ACST_CONNECTING != m_state) {
+        return;
+    }
+    if (!m_startReported) {
+        m_startReported = true;
+        emit adbClientResult(qsc::AdbProcess::AER_SUCCESS_START);
+    }
+    // the connection may have been dropped by a slot connected to the start result
+    if (ACST_CONNECTING != m_state) {
+        return;
+    }
+    m_timeoutTimer.start(ADB_REQUEST_TIMEOUT);
+    sendNextRequest();
+}
+
+void AdbClient::onReadyRead()
+{
+    if (!m_socket) {
+        return;
+    }
+    m_buffer.append(m_socket->readAll());
+
+    bool progress = true;
+    while (progress && ACS_NULL != m_service) {
+        switch (m_state) {
+        case ACST_STATUS:
+            progress = readStatus();
+            break;
+        case ACST_SHELL:
+            progress = readShellStream();
+            break;
+        case ACST_SYNC_STAT:
+        case ACST_SYNC_SEND:
+        case ACST_SYNC_DONE:
+            progress = readSyncReply();
+            break;
+        default:
+            progress = false;
+            break;
+        }
+    }
+}
+
+bool AdbClient::readStatus()
+{
+    if (m_buffer.size() < 4) {
+        return false;
+    }
+
+    if (m_buffer.startsWith("OKAY")) {
+        m_buffer.remove(0, 4);
+        if (m_requestIndex + 1 < m_requests.size()) {
+            m_requestIndex++;
+            sendNextRequest();
+        } else if (m_extraStatus > 0) {
+            m_extraStatus--;
+        } else {
+            onServiceReady();
+        }
+        return true;
+    }
+
+    if (m_buffer.startsWith("FAIL")) {
+        if (m_buffer.size() < 8) {
+            return false;
+        }
+        bool ok = false;
+        int len = m_buffer.mid(4, 4).toInt(&ok, 16);
+        if (!ok) {
+            len = 0;
+        }
+        if (m_buffer.size() < 8 + len) {
+            return false;
+        }
+        m_errorOutput = m_buffer.mid(8, len);
+        m_buffer.remove(0, 8 + len);
+        qWarning() << QString("adb client: %1").arg(getErrorOut()).toStdString().data();
+
+        // old adbd without shell_v2, retry with the legacy shell service
+        if (ACS_SHELL == m_service && m_shellV2 && m_requestIndex == m_requests.size() - 1) {
+            QList<QByteArray> requests;
+            requests << transportRequest(m_serial);
+            requests << encodeRequest(QString("shell:%1").arg(m_shellCommand));
+            start(ACS_SHELL, requests, 0);
+            m_shellV2 = false;
+            m_startReported = true;
+            return false;
+        }
+        finish(qsc::AdbProcess::AER_ERROR_EXEC);
+        return false;
+    }
+
+    qWarning("adb client: invalid status");
+    finish(qsc::AdbProcess::AER_ERROR_EXEC);
+    return false;
+}
+
+void AdbClient::onServiceReady()
+{
+    switch (m_service) {
+    case ACS_SHELL:
+        // shell commands like the server process live as long as they want
+        m_timeoutTimer.stop();
+        m_state = ACST_SHELL;
+        break;
+    case ACS_PUSH: {
+        m_state = ACST_SYNC_STAT;
+        sendSyncRequest("STAT", m_syncRemote.toUtf8());
+        break;
+    }
+    default:
+        finish(qsc::AdbProcess::AER_SUCCESS_EXEC);
+        break;
+    }
+}
+
+bool AdbClient::readShellStream()
+{
+    if (!m_shellV2) {
+        m_standardOutput += m_buffer;
+        m_buffer.clear();
+        return false;
+    }
+
+    if (m_buffer.size() < ADB_SHELL_HEADER_SIZE) {
+        return false;
+    }
+    quint8 id = static_cast<quint8>(m_buffer[0]);
+    quint32 len = qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(m_buffer.constData() + 1));
+    if (static_cast<quint32>(m_buffer.size()) < ADB_SHELL_HEADER_SIZE + len) {
+        return false;
+    }
+    QByteArray data = m_buffer.mid(ADB_SHELL_HEADER_SIZE, len);
+    m_buffer.remove(0, ADB_SHELL_HEADER_SIZE + len);
+
+    switch (id) {
+    case ADB_SHELL_ID_STDOUT:
+        m_standardOutput += data;
+        break;
+    case ADB_SHELL_ID_STDERR:
+        m_errorOutput += data;
+        break;
+    case ADB_SHELL_ID_EXIT:
+        if (!data.isEmpty()) {
+            m_exitCode = static_cast<quint8>(data[0]);
+        }
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+bool AdbClient::readSyncReply()
+{
+    if (m_buffer.size() < 8) {
+        return false;
+    }
+    QByteArray id = m_buffer.left(4);
+    const uchar *p = reinterpret_cast<const uchar *>(m_buffer.constData());
+
+    if (ACST_SYNC_STAT == m_state) {
+        // STAT mode size mtime
+        if (m_buffer.size() < 16) {
+            return false;
+        }
+        quint32 mode = qFromLittleEndian<quint32>(p + 4);
+        m_buffer.remove(0, 16);
+        if (id != "STAT") {
+            qWarning("adb client: invalid sync stat reply");
+            finish(qsc::AdbProcess::AER_ERROR_EXEC);
+            return false;
+        }
+        if ((mode & ADB_S_IFMT) == ADB_S_IFDIR) {
+            m_syncRemote += "/" + QFileInfo(m_syncFile.fileName()).fileName();
+        }
+        m_state = ACST_SYNC_SEND;
+        sendSyncRequest("SEND", QString("%1,%2").arg(m_syncRemote).arg(ADB_SYNC_FILE_MODE).toUtf8());
+        sendSyncData();
+        return true;
+    }
+
+    quint32 len = qFromLittleEndian<quint32>(p + 4);
+    if (id == "OKAY") {
+        m_buffer.remove(0, 8);
+        sendSyncRequest("QUIT", QByteArray());
+        finish(qsc::AdbProcess::AER_SUCCESS_EXEC);
+        return false;
+    }
+    if (id == "FAIL") {
+        if (static_cast<quint32>(m_buffer.size()) < 8 + len) {
+            return false;
+        }
+        m_errorOutput = m_buffer.mid(8, len);
+        m_buffer.remove(0, 8 + len);
+        qWarning() << QString("adb client: push failed: %1").arg(getErrorOut()).toStdString().data();
+        finish(qsc::AdbProcess::AER_ERROR_EXEC);
+        return false;
+    }
+
+    qWarning("adb client: invalid sync reply");
+    finish(qsc::AdbProcess::AER_ERROR_EXEC);
+    return false;
+}
+
+void AdbClient::sendSyncRequest(const char *id, const QByteArray &data)
+{
+    QByteArray packet(id, 4);
+    quint32 len = qToLittleEndian<quint32>(static_cast<quint32>(data.size()));
+    packet.append(reinterpret_cast<const char *>(&len), sizeof(len));
+    packet.append(data);
+    m_socket->write(packet);
+}
+
+void AdbClient::sendSyncData()
+{
+    if (ACST_SYNC_SEND != m_state || m_syncDataDone || !m_socket) {
+        return;
+    }
+
+    // keep a couple of chunks in flight instead of reading the whole file
+    while (m_socket->bytesToWrite() < 2 * ADB_SYNC_DATA_MAX) {
+        QByteArray data = m_syncFile.read(ADB_SYNC_DATA_MAX);
+        if (data.isEmpty()) {
+            quint32 mtime = static_cast<quint32>(QFileInfo(m_syncFile).lastModified().toSecsSinceEpoch());
+            QByteArray done(4, '\0');
+            qToLittleEndian<quint32>(mtime, reinterpret_cast<uchar *>(done.data()));
+            m_socket->write(QByteArray("DONE", 4) + done);
+            m_syncFile.close();
+            m_syncDataDone = true;
+            m_state = ACST_SYNC_DONE;
+            return;
+        }
+        sendSyncRequest("DATA", data);
+        // a push is only slow while data moves, so refresh the timeout per chunk
+        m_timeoutTimer.start(ADB_REQUEST_TIMEOUT);
+    }
+}
+
+void AdbClient::onBytesWritten()
+{
+    sendSyncData();
+}
+
+void AdbClient::onDisconnected()
+{
+    if (ACS_NULL == m_service) {
+        return;
+    }
+    // data may arrive together with the close
+    if (m_socket && m_socket->bytesAvailable()) {
+        onReadyRead();
+    }
+    if (ACS_NULL == m_service) {
+        return;
+    }
+
+    if (ACST_SHELL == m_state) {
+        finish(0 == m_exitCode ? qsc::AdbProcess::AER_SUCCESS_EXEC : qsc::AdbProcess::AER_ERROR_EXEC);
+    } else if (ACST_CONNECTING == m_state) {
+        finish(qsc::AdbProcess::AER_ERROR_START);
+    } else {
+        finish(qsc::AdbProcess::AER_ERROR_EXEC);
+    }
+}
+
+void AdbClient::onSocketError()
+{
+    if (ACS_NULL == m_service || !m_socket) {
+        return;
+    }
+    if (ACST_CONNECTING == m_state) {
+        qInfo("adb client: adb server not reachable on port %d", getServerPort());
+        finish(qsc::AdbProcess::AER_ERROR_START);
+        return;
+    }
+    if (QAbstractSocket::RemoteHostClosedError == m_socket->error()) {
+        // handled in onDisconnected
+        return;
+    }
+    m_errorOutput += m_socket->errorString().toUtf8();
+    finish(qsc::AdbProcess::AER_ERROR_EXEC);
+}
+
+void AdbClient::onTimeout()
+{
+    if (ACS_NULL == m_service) {
+        return;
+    }
+    if (ACST_CONNECTING == m_state) {
+        qInfo("adb client: connect adb server timeout");
+        finish(qsc::AdbProcess::AER_ERROR_START);
+        return;
+    }
+    qWarning("adb client: request timeout");
+    m_errorOutput += "timeout";
+    finish(qsc::AdbProcess::AER_ERROR_EXEC);
+}
+
+void AdbClient::finish(qsc::AdbProcess::ADB_EXEC_RESULT processResult)
+{
+    reset();
+    emit adbClientResult(processResult);
+}
+
+void AdbClient::reset()
+{
+    m_service = ACS_NULL;
+    m_state = ACST_NULL;
+    m_timeoutTimer.stop();
+    if (m_syncFile.isOpen()) {
+        m_syncFile.close();
+    }
+    if (m_socket) {
+        QTcpSocket *socket = m_socket;
+        m_socket = Q_NULLPTR;
+        socket->disconnect(this);
+        socket->abort();
+        socket->deleteLater();
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef ADBCLIENT_H
+#define ADBCLIENT_H
+
+#include <QFile>
+#include <QPointer>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include "adbprocess.h"
+
+// in-process client for the adb server smart-socket protocol (localhost:5037)
+// it reports the same results as AdbProcessImpl, AER_ERROR_START means the adb
+// server is not reachable and the caller should fall back to the adb binary
+class AdbClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum ADB_CLIENT_SERVICE
+    {
+        ACS_NULL,
+        ACS_FORWARD,
+        ACS_FORWARD_REMOVE,
+        ACS_REVERSE,
+        ACS_REVERSE_REMOVE,
+        ACS_SHELL,
+        ACS_PUSH,
+    };
+
+    explicit AdbClient(QObject *parent = nullptr);
+    virtual ~AdbClient();
+
+    // ANDROID_ADB_SERVER_PORT is honored like the adb binary does
+    static quint16 getServerPort();
+    static void setServerPort(quint16 port);
+    // "0004host" style request framing
+    static QByteArray encodeRequest(const QString &request);
+
+    void forward(const QString &serial, quint16 localPort, const QString &deviceSocketName);
+    void forwardRemove(const QString &serial, quint16 localPort);
+    void reverse(const QString &serial, const QString &deviceSocketName, quint16 localPort);
+    void reverseRemove(const QString &serial, const QString &deviceSocketName);
+    void shell(const QString &serial, const QString &command);
+    void push(const QString &serial, const QString &local, const QString &remote);
+
+    bool isRuning();
+    void kill();
+    QString getStdOut();
+    QString getErrorOut();
+
+signals:
+    void adbClientResult(qsc::AdbProcess::ADB_EXEC_RESULT processResult);
+
+private slots:
+    void onConnected();
+    void onReadyRead();
+    void onBytesWritten();
+    void onDisconnected();
+    void onSocketError();
+    void onTimeout();
+
+private:
+    void start(ADB_CLIENT_SERVICE service, const QList<QByteArray> &requests, int extraStatus);
+    QByteArray transportRequest(const QString &serial);
+    void sendNextRequest();
+    bool readStatus();
+    void onServiceReady();
+    bool readShellStream();
+    bool readSyncReply();
+    void sendSyncRequest(const char *id, const QByteArray &data);
+    void sendSyncData();
+    void finish(qsc::AdbProcess::ADB_EXEC_RESULT processResult);
+    void reset();
+
+private:
+    enum ADB_CLIENT_STATE
+    {
+        ACST_NULL,
+        ACST_CONNECTING,
+        ACST_STATUS,
+        ACST_SHELL,
+        ACST_SYNC_STAT,
+        ACST_SYNC_SEND,
+        ACST_SYNC_DONE,
+    };
+
+    QPointer<QTcpSocket> m_socket;
+    QTimer m_timeoutTimer;
+    ADB_CLIENT_SERVICE m_service = ACS_NULL;
+    ADB_CLIENT_STATE m_state = ACST_NULL;
+    QList<QByteArray> m_requests;
+    int m_requestIndex = 0;
+    int m_extraStatus = 0;
+    QByteArray m_buffer;
+    // raw bytes, a utf-8 sequence may be split across reads and shell packets
+    QByteArray m_standardOutput;
+    QByteArray m_errorOutput;
+    bool m_startReported = false;
+    // tells a killed request from the next one
+    quint32 m_runId = 0;
+
+    // shell
+    QString m_serial;
+    QString m_shellCommand;
+    bool m_shellV2 = true;
+    int m_exitCode = 0;
+
+    // sync push
+    QFile m_syncFile;
+    QString m_syncRemote;
+    bool m_syncDataDone = false;
+
+    static quint16 s_serverPort;
+};
+
+#endif // ADBCLIENT_H
@@ -4,18 +4,35 @@
 #include <QFileInfo>
 #include <QProcess>
 
+#include "adbclient.h"
 #include "adbprocess.h"
 #include "adbprocessimpl.h"
 
 QString g_adbPath;
+static bool s_nativeClientEnabled = qgetenv("QTSCRCPY_ADB_NATIVE") != "0";
 
 namespace qsc {
 
 AdbProcess::AdbProcess(QObject *parent)
     : QObject(parent)
     , m_adbImpl(new AdbProcessImpl())
+    , m_adbClient(new AdbClient())
 {
     connect(m_adbImpl, &AdbProcessImpl::adbProcessImplResult, this, &qsc::AdbProcess::adbProcessResult);
+    connect(m_adbClient, &AdbClient::adbClientResult, this, [this](qsc::AdbProcess::ADB_EXEC_RESULT processResult) {
+        if (AER_ERROR_START == processResult && m_fallback) {
+            // adb server not running yet, the adb binary starts it for us
+            std::function<void()> fallback = m_fallback;
+            m_fallback = nullptr;
+            startProcess(fallback);
+            return;
+        }
+        if (AER_SUCCESS_START == processResult) {
+            // the server answered, the request can not be replayed through adb anymore
+            m_fallback = nullptr;
+        }
+        emit adbProcessResult(processResult);
+    });
 }
 
 AdbProcess::~AdbProcess()
@@ -24,6 +41,7 @@ AdbProcess::~AdbProcess()
         m_adbImpl->kill();
     }
     delete m_adbImpl;
+    delete m_adbClient;
 }
 
 void AdbProcess::setAdbPath(const QString &adbPath)
@@ -31,89 +49,179 @@ void AdbProcess::setAdbPath(const QString &adbPath)
     g_adbPath = adbPath;
 }
 
+void AdbProcess::setNativeClientEnabled(bool enabled)
+{
+    s_nativeClientEnabled = enabled;
+}
+
+void AdbProcess::startNative(const QStringList &args, const std::function<void()> &native, const std::function<void()> &fallback)
+{
+    if (!s_nativeClientEnabled) {
+        startProcess(fallback);
+        return;
+    }
+    if (m_adbImpl->isRuning()) {
+        m_adbImpl->kill();
+    }
+    m_usingClient = true;
+    m_clientArgs = args;
+    m_fallback = fallback;
+    native();
+}
+
+void AdbProcess::startProcess(const std::function<void()> &process)
+{
+    if (m_adbClient->isRuning()) {
+        m_adbClient->kill();
+    }
+    m_usingClient = false;
+    m_fallback = nullptr;
+    process();
+}
+
 void AdbProcess::execute(const QString &serial, const QStringList &args)
 {
-    m_adbImpl->execute(serial, args);
+    if (args.size() > 1 && "shell" == args.first()) {
+        QString command = args.mid(1).join(" ");
+        startNative(
+            args, [this, serial, command]() { m_adbClient->shell(serial, command); }, [this, serial, args]() { m_adbImpl->execute(serial, args); });
+        return;
+    }
+    startProcess([this, serial, args]() { m_adbImpl->execute(serial, args); });
 }
 
 bool AdbProcess::isRuning()
 {
+    if (m_usingClient) {
+        return m_adbClient->isRuning();
+    }
     return m_adbImpl->isRuning();
 }
 
 void AdbProcess::setShowTouchesEnabled(const QString &serial, bool enabled)
 {
-    m_adbImpl->setShowTouchesEnabled(serial, enabled);
+    QStringList adbArgs;
+    adbArgs << "shell"
+            << "settings"
+            << "put"
+            << "system"
+            << "show_touches";
+    adbArgs << (enabled ? "1" : "0");
+    execute(serial, adbArgs);
 }
 
 void AdbProcess::kill()
 {
+    m_fallback = nullptr;
+    if (m_usingClient) {
+        m_adbClient->kill();
+        return;
+    }
     m_adbImpl->kill();
 }
 
 QStringList AdbProcess::arguments()
 {
+    if (m_usingClient) {
+        return m_clientArgs;
+    }
     return m_adbImpl->arguments();
 }
 
 QStringList AdbProcess::getDevicesSerialFromStdOut()
 {
-    return m_adbImpl->getDevicesSerialFromStdOut();
+    return AdbProcessImpl::getDevicesSerialFromStdOut(getStdOut());
 }
 
 QString AdbProcess::getDeviceIPFromStdOut()
 {
-    return m_adbImpl->getDeviceIPFromStdOut();
+    return AdbProcessImpl::getDeviceIPFromStdOut(getStdOut());
 }
 
 QString AdbProcess::getDeviceIPByIpFromStdOut()
 {
-    return m_adbImpl->getDeviceIPByIpFromStdOut();
+    return AdbProcessImpl::getDeviceIPByIpFromStdOut(getStdOut());
 }
 
 QString AdbProcess::getStdOut()
 {
+    if (m_usingClient) {
+        return m_adbClient->getStdOut();
+    }
     return m_adbImpl->getStdOut();
 }
 
 QString AdbProcess::getErrorOut()
 {
+    if (m_usingClient) {
+        return m_adbClient->getErrorOut();
+    }
     return m_adbImpl->getErrorOut();
 }
 
 void AdbProcess::forward(const QString &serial, quint16 localPort, const QString &deviceSocketName)
 {
-    m_adbImpl->forward(serial, localPort, deviceSocketName);
+    QStringList args;
+    args << "forward" << QString("tcp:%1").arg(localPort) << QString("localabstract:%1").arg(deviceSocketName);
+    startNative(
+        args,
+        [this, serial, localPort, deviceSocketName]() { m_adbClient->forward(serial, localPort, deviceSocketName); },
+        [this, serial, localPort, deviceSocketName]() { m_adbImpl->forward(serial, localPort, deviceSocketName); });
 }
 
 void AdbProcess::forwardRemove(const QString &serial, quint16 localPort)
 {
-    m_adbImpl->forwardRemove(serial, localPort);
+    QStringList args;
+    args << "forward"
+         << "--remove" << QString("tcp:%1").arg(localPort);
+    startNative(
+        args,
+        [this, serial, localPort]() { m_adbClient->forwardRemove(serial, localPort); },
+        [this, serial, localPort]() { m_adbImpl->forwardRemove(serial, localPort); });
 }
 
 void AdbProcess::reverse(const QString &serial, const QString &deviceSocketName, quint16 localPort)
 {
-    m_adbImpl->reverse(serial, deviceSocketName, localPort);
+    QStringList args;
+    args << "reverse" << QString("localabstract:%1").arg(deviceSocketName) << QString("tcp:%1").arg(localPort);
+    startNative(
+        args,
+        [this, serial, deviceSocketName, localPort]() { m_adbClient->reverse(serial, deviceSocketName, localPort); },
+        [this, serial, deviceSocketName, localPort]() { m_adbImpl->reverse(serial, deviceSocketName, localPort); });
 }
 
 void AdbProcess::reverseRemove(const QString &serial, const QString &deviceSocketName)
 {
-    m_adbImpl->reverseRemove(serial, deviceSocketName);
+    QStringList args;
+    args << "reverse"
+         << "--remove" << QString("localabstract:%1").arg(deviceSocketName);
+    startNative(
+        args,
+        [this, serial, deviceSocketName]() { m_adbClient->reverseRemove(serial, deviceSocketName); },
+        [this, serial, deviceSocketName]() { m_adbImpl->reverseRemove(serial, deviceSocketName); });
 }
 
 void AdbProcess::push(const QString &serial, const QString &local, const QString &remote)
 {
-    m_adbImpl->push(serial, local, remote);
+    QStringList args;
+    args << "push" << local << remote;
+    startNative(
+        args, [this, serial, local, remote]() { m_adbClient->push(serial, local, remote); }, [this, serial, local, remote]() { m_adbImpl->push(serial, local, remote); });
 }
 
 void AdbProcess::install(const QString &serial, const QString &local)
 {
-    m_adbImpl->install(serial, local);
+    // install needs the package manager session logic of the adb binary
+    startProcess([this, serial, local]() { m_adbImpl->install(serial, local); });
 }
 
 void AdbProcess::removePath(const QString &serial, const QString &path)
 {
-    m_adbImpl->removePath(serial, path);
+    QStringList adbArgs;
+    adbArgs << "shell";
+    adbArgs << "rm";
+    adbArgs << path;
+    execute(serial, adbArgs);
 }
 
 }
@@ -129,7 +129,7 @@ void AdbProcessImpl::setShowTouchesEnabled(const QString &serial, bool enabled)
     execute(serial, adbArgs);
 }
 
-QStringList AdbProcessImpl::getDevicesSerialFromStdOut()
+QStringList AdbProcessImpl::getDevicesSerialFromStdOut(const QString &stdOut)
 {
     // get devices serial by adb devices
     QStringList serials;
@@ -140,7 +140,7 @@ QStringList AdbProcessImpl::getDevicesSerialFromStdOut()
     QRegularExpression lineExp("\r\n|\n");
     QRegularExpression tExp("\t");
 #endif
-    QStringList devicesInfoList = m_standardOutput.split(lineExp);
+    QStringList devicesInfoList = stdOut.split(lineExp);
     for (QString deviceInfo : devicesInfoList) {
         QStringList deviceInfos = deviceInfo.split(tExp);
         if (2 == deviceInfos.count() && 0 == deviceInfos[1].compare("device")) {
@@ -150,19 +150,19 @@ QStringList AdbProcessImpl::getDevicesSerialFromStdOut()
     return serials;
 }
 
-QString AdbProcessImpl::getDeviceIPFromStdOut()
+QString AdbProcessImpl::getDeviceIPFromStdOut(const QString &stdOut)
 {
     QString ip = "";
     QString strIPExp = "inet addr:[\\d.]*";
 #if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
     QRegExp ipRegExp(strIPExp, Qt::CaseInsensitive);
-    if (ipRegExp.indexIn(m_standardOutput) != -1) {
+    if (ipRegExp.indexIn(stdOut) != -1) {
         ip = ipRegExp.cap(0);
         ip = ip.right(ip.size() - 10);
     }
 #else
     QRegularExpression ipRegExp(strIPExp, QRegularExpression::CaseInsensitiveOption);
-    QRegularExpressionMatch match = ipRegExp.match(m_standardOutput);
+    QRegularExpressionMatch match = ipRegExp.match(stdOut);
     if (match.hasMatch()) {
         ip = match.captured(0);
         ip = ip.right(ip.size() - 10);
@@ -172,20 +172,20 @@ QString AdbProcessImpl::getDeviceIPFromStdOut()
     return ip;
 }
 
-QString AdbProcessImpl::getDeviceIPByIpFromStdOut()
+QString AdbProcessImpl::getDeviceIPByIpFromStdOut(const QString &stdOut)
 {
     QString ip = "";
 
     QString strIPExp = "wlan0    inet [\\d.]*";
 #if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
     QRegExp ipRegExp(strIPExp, Qt::CaseInsensitive);
-    if (ipRegExp.indexIn(m_standardOutput) != -1) {
+    if (ipRegExp.indexIn(stdOut) != -1) {
         ip = ipRegExp.cap(0);
         ip = ip.right(ip.size() - 14);
     }
 #else
     QRegularExpression ipRegExp(strIPExp, QRegularExpression::CaseInsensitiveOption);
-    QRegularExpressionMatch match = ipRegExp.match(m_standardOutput);
+    QRegularExpressionMatch match = ipRegExp.match(stdOut);
     if (match.hasMatch()) {
         ip = match.captured(0);
         ip = ip.right(ip.size() - 14);
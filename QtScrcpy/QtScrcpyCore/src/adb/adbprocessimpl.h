@@ -21,9 +21,9 @@ public:
     void removePath(const QString &serial, const QString &path);
     bool isRuning();
     void setShowTouchesEnabled(const QString &serial, bool enabled);
-    QStringList getDevicesSerialFromStdOut();
-    QString getDeviceIPFromStdOut();
-    QString getDeviceIPByIpFromStdOut();
+    static QStringList getDevicesSerialFromStdOut(const QString &stdOut);
+    static QString getDeviceIPFromStdOut(const QString &stdOut);
+    static QString getDeviceIPByIpFromStdOut(const QString &stdOut);
     QString getStdOut();
     QString getErrorOut();
 
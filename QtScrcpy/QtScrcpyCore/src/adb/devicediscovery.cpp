@@ -0,0 +1,184 @@
+#include <QDebug>
+#include <QHostAddress>
+
+#include "adbclient.h"
+#include "devicediscovery.h"
+
+#define DISCOVERY_RECONNECT_INTERVAL 500
+#define DISCOVERY_RECONNECT_INTERVAL_MAX 5000
+
+DeviceDiscovery::DeviceDiscovery(QObject *parent) : QObject(parent)
+{
+    m_reconnectTimer.setSingleShot(true);
+    connect(&m_reconnectTimer, &QTimer::timeout, this, &DeviceDiscovery::connectToServer);
+    connect(&m_startServerProcess, &qsc::AdbProcess::adbProcessResult, this, [this](qsc::AdbProcess::ADB_EXEC_RESULT processResult) {
+        if (qsc::AdbProcess::AER_SUCCESS_EXEC == processResult && m_active) {
+            m_reconnectTimer.start(0);
+        }
+    });
+}
+
+DeviceDiscovery::~DeviceDiscovery()
+{
+    stop();
+}
+
+void DeviceDiscovery::start()
+{
+    if (m_active) {
+        return;
+    }
+    m_active = true;
+    m_failCount = 0;
+    connectToServer();
+}
+
+void DeviceDiscovery::stop()
+{
+    m_active = false;
+    m_reconnectTimer.stop();
+    if (m_socket) {
+        QTcpSocket *socket = m_socket;
+        m_socket = Q_NULLPTR;
+        socket->disconnect(this);
+        socket->abort();
+        socket->deleteLater();
+    }
+    // nothing is known anymore, but the devices did not go away: no removal is reported,
+    // a listener keeps the list it has
+    m_devices.clear();
+}
+
+bool DeviceDiscovery::isActive()
+{
+    return m_active;
+}
+
+QMap<QString, QString> DeviceDiscovery::getDevices()
+{
+    return m_devices;
+}
+
+void DeviceDiscovery::connectToServer()
+{
+    if (!m_active) {
+        return;
+    }
+    if (m_socket) {
+        m_socket->disconnect(this);
+        m_socket->abort();
+        m_socket->deleteLater();
+    }
+    m_buffer.clear();
+    m_okay = false;
+
+    m_socket = new QTcpSocket(this);
+    connect(m_socket, &QTcpSocket::connected, this, &DeviceDiscovery::onConnected);
+    connect(m_socket, &QTcpSocket::readyRead, this, &DeviceDiscovery::onReadyRead);
+    connect(m_socket, &QTcpSocket::disconnected, this, &DeviceDiscovery::onDisconnected);
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+    connect(m_socket, &QTcpSocket::errorOccurred, this, &DeviceDiscovery::onDisconnected);
+#else
+    connect(m_socket, static_cast<void (QAbstractSocket::*)(QAbstractSocket::SocketError)>(&QAbstractSocket::error), this, &DeviceDiscovery::onDisconnected);
+#endif
+    m_socket->connectToHost(QHostAddress::LocalHost, AdbClient::getServerPort());
+}
+
+void DeviceDiscovery::onConnected()
+{
+    m_socket->write(AdbClient::encodeRequest("host:track-devices"));
+}
+
+void DeviceDiscovery::onReadyRead()
+{
+    if (!m_socket) {
+        return;
+    }
+    m_buffer.append(m_socket->readAll());
+
+    if (!m_okay) {
+        if (m_buffer.size() < 4) {
+            return;
+        }
+        if (!m_buffer.startsWith("OKAY")) {
+            qWarning("device discovery: track-devices refused");
+            onDisconnected();
+            return;
+        }
+        m_buffer.remove(0, 4);
+        m_okay = true;
+        m_failCount = 0;
+        qInfo("device discovery: tracking devices");
+    }
+
+    // each message is the whole device list: 4 hex length + "serial\tstate\n"...
+    while (m_buffer.size() >= 4) {
+        bool ok = false;
+        int len = m_buffer.left(4).toInt(&ok, 16);
+        if (!ok) {
+            qWarning("device discovery: invalid message");
+            onDisconnected();
+            return;
+        }
+        if (m_buffer.size() < 4 + len) {
+            return;
+        }
+        QByteArray list = m_buffer.mid(4, len);
+        m_buffer.remove(0, 4 + len);
+        updateDevices(list);
+    }
+}
+
+void DeviceDiscovery::onDisconnected()
+{
+    if (m_socket) {
+        QTcpSocket *socket = m_socket;
+        m_socket = Q_NULLPTR;
+        socket->disconnect(this);
+        socket->abort();
+        socket->deleteLater();
+    }
+    // the adb server may only be restarting, the next full list after the reconnect
+    // reports what changed meanwhile
+    if (m_active) {
+        scheduleReconnect();
+    }
+}
+
+void DeviceDiscovery::scheduleReconnect()
+{
+    // the adb server is not running, let adb start it once, then keep polling the port
+    if (0 == m_failCount && !m_startServerProcess.isRuning()) {
+        m_startServerProcess.execute("", QStringList() << "start-server");
+    }
+    int interval = qMin(DISCOVERY_RECONNECT_INTERVAL << qMin(m_failCount, 4), DISCOVERY_RECONNECT_INTERVAL_MAX);
+    m_failCount++;
+    m_reconnectTimer.start(interval);
+}
+
+void DeviceDiscovery::updateDevices(const QByteArray &list)
+{
+    QMap<QString, QString> devices;
+    for (const QByteArray &line : list.split('\n')) {
+        QList<QByteArray> fields = line.trimmed().split('\t');
+        if (2 == fields.size() && !fields[0].isEmpty()) {
+            devices.insert(QString::fromUtf8(fields[0]), QString::fromUtf8(fields[1]));
+        }
+    }
+
+    QMap<QString, QString> old = m_devices;
+    m_devices = devices;
+
+    for (auto it = old.constBegin(); it != old.constEnd(); ++it) {
+        if (!devices.contains(it.key())) {
+            emit deviceRemoved(it.key());
+        }
+    }
+    for (auto it = devices.constBegin(); it != devices.constEnd(); ++it) {
+        if (!old.contains(it.key())) {
+            emit deviceAdded(it.key(), it.value());
+        } else if (old.value(it.key()) != it.value()) {
+            emit deviceStateChanged(it.key(), it.value());
+        }
+    }
+}
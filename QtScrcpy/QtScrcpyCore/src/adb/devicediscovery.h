@@ -0,0 +1,53 @@
+#ifndef DEVICEDISCOVERY_H
+#define DEVICEDISCOVERY_H
+
+#include <QMap>
+#include <QPointer>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include "adbprocess.h"
+
+// keeps a host:track-devices stream open on the adb server, which pushes the
+// whole device list every time a device appears, goes away or changes state
+class DeviceDiscovery : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DeviceDiscovery(QObject *parent = nullptr);
+    virtual ~DeviceDiscovery();
+
+    void start();
+    void stop();
+    bool isActive();
+    // serial -> state ("device", "offline", "unauthorized"...)
+    QMap<QString, QString> getDevices();
+
+signals:
+    void deviceAdded(const QString &serial, const QString &state);
+    void deviceRemoved(const QString &serial);
+    void deviceStateChanged(const QString &serial, const QString &state);
+
+private slots:
+    void onConnected();
+    void onReadyRead();
+    void onDisconnected();
+
+private:
+    void connectToServer();
+    void scheduleReconnect();
+    void updateDevices(const QByteArray &list);
+
+private:
+    QPointer<QTcpSocket> m_socket;
+    QTimer m_reconnectTimer;
+    qsc::AdbProcess m_startServerProcess;
+    QByteArray m_buffer;
+    QMap<QString, QString> m_devices;
+    bool m_active = false;
+    bool m_okay = false;
+    int m_failCount = 0;
+};
+
+#endif // DEVICEDISCOVERY_H
@@ -0,0 +1,75 @@
+#include "memoryaccount.h"
+
+namespace {
+std::atomic<qint64> s_current[MemoryAccount::MC_COUNT + 1];
+std::atomic<qint64> s_peak[MemoryAccount::MC_COUNT + 1];
+
+void updatePeak(std::atomic<qint64> &peak, qint64 value)
+{
+    qint64 oldPeak = peak.load();
+    while (value > oldPeak && !peak.compare_exchange_weak(oldPeak, value)) {
+    }
+}
+
+void account(std::atomic<qint64> *current, std::atomic<qint64> *peak, int category, qint64 bytes)
+{
+    updatePeak(peak[category], current[category] += bytes);
+    updatePeak(peak[MemoryAccount::MC_COUNT], current[MemoryAccount::MC_COUNT] += bytes);
+}
+}
+
+MemoryAccount::MemoryAccount()
+{
+    for (int i = 0; i <= MC_COUNT; ++i) {
+        m_current[i].store(0);
+        m_peak[i].store(0);
+    }
+}
+
+MemoryAccount::~MemoryAccount()
+{
+    for (int i = 0; i < MC_COUNT; ++i) {
+        qint64 bytes = m_current[i].load();
+        if (bytes) {
+            account(s_current, s_peak, i, -bytes);
+        }
+    }
+}
+
+void MemoryAccount::add(Category category, qint64 bytes)
+{
+    if (!bytes) {
+        return;
+    }
+    account(m_current, m_peak, category, bytes);
+    account(s_current, s_peak, category, bytes);
+}
+
+void MemoryAccount::set(Category category, qint64 bytes)
+{
+    qint64 old = m_current[category].exchange(bytes);
+    // the exchange already moved the category, only its peak and the sums follow
+    updatePeak(m_peak[category], bytes);
+    updatePeak(m_peak[MC_COUNT], m_current[MC_COUNT] += bytes - old);
+    account(s_current, s_peak, category, bytes - old);
+}
+
+qint64 MemoryAccount::current(int category)
+{
+    return m_current[qBound(0, category, static_cast<int>(MC_COUNT))].load();
+}
+
+qint64 MemoryAccount::peak(int category)
+{
+    return m_peak[qBound(0, category, static_cast<int>(MC_COUNT))].load();
+}
+
+qint64 MemoryAccount::processCurrent(int category)
+{
+    return s_current[qBound(0, category, static_cast<int>(MC_COUNT))].load();
+}
+
+qint64 MemoryAccount::processPeak(int category)
+{
+    return s_peak[qBound(0, category, static_cast<int>(MC_COUNT))].load();
+}
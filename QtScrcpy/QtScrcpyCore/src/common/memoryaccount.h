@@ -0,0 +1,45 @@
+#ifndef MEMORYACCOUNT_H
+#define MEMORYACCOUNT_H
+
+#include <atomic>
+
+#include <QtGlobal>
+
+// bytes held for one device by category, with their high-water marks, and the same for all devices
+// of the process together; shared by the parts of a device, they may outlive the device object
+class MemoryAccount
+{
+public:
+    enum Category
+    {
+        MC_DEMUXER = 0,
+        MC_DECODER,
+        MC_VIDEO_BUFFER,
+        MC_RECORDER,
+        MC_SCREENSHOT,
+        MC_TEXTURE,
+        MC_AUDIO,
+        MC_COUNT
+    };
+
+    MemoryAccount();
+    // whatever is still held leaves the process totals
+    ~MemoryAccount();
+
+    // any thread, bytes < 0 releases them
+    void add(Category category, qint64 bytes);
+    // any thread, for buffers whose size is known as a whole
+    void set(Category category, qint64 bytes);
+
+    // MC_COUNT is the sum of all categories
+    qint64 current(int category);
+    qint64 peak(int category);
+    static qint64 processCurrent(int category);
+    static qint64 processPeak(int category);
+
+private:
+    std::atomic<qint64> m_current[MC_COUNT + 1];
+    std::atomic<qint64> m_peak[MC_COUNT + 1];
+};
+
+#endif // MEMORYACCOUNT_H
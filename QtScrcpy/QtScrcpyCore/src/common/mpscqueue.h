@@ -0,0 +1,80 @@
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <atomic>
+#include <utility>
+
+// unbounded multi producer / single consumer queue (Vyukov)
+// push() is wait-free and may be called from any thread,
+// pop(), peek() and isEmpty() only from the consumer thread
+template <typename T>
+class MpscQueue
+{
+public:
+    MpscQueue()
+    {
+        Node *stub = new Node();
+        m_head.store(stub, std::memory_order_relaxed);
+        m_tail = stub;
+    }
+
+    ~MpscQueue()
+    {
+        T value;
+        while (pop(value)) {
+        }
+        delete m_tail;
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    void push(T value)
+    {
+        Node *node = new Node();
+        node->value = std::move(value);
+        Node *prev = m_head.exchange(node, std::memory_order_acq_rel);
+        // between the exchange and this store the node is not reachable yet,
+        // the consumer sees an empty queue with isEmpty() == false
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    bool pop(T &value)
+    {
+        Node *tail = m_tail;
+        Node *next = tail->next.load(std::memory_order_acquire);
+        if (!next) {
+            return false;
+        }
+        value = std::move(next->value);
+        next->value = T();
+        m_tail = next;
+        delete tail;
+        return true;
+    }
+
+    // the next value pop() would return, nullptr if there is none
+    T *peek()
+    {
+        Node *next = m_tail->next.load(std::memory_order_acquire);
+        return next ? &next->value : nullptr;
+    }
+
+    // false while a push is still being linked in
+    bool isEmpty() const
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail;
+    }
+
+private:
+    struct Node
+    {
+        std::atomic<Node *> next { nullptr };
+        T value;
+    };
+
+    std::atomic<Node *> m_head;
+    Node *m_tail;
+};
+
+#endif // MPSCQUEUE_H
@@ -0,0 +1,112 @@
+#include "adaptivestream.h"
+
+// consecutive samples needed before moving down/up the ladder
+#define AS_DOWN_SAMPLES 2
+#define AS_UP_SAMPLES 15
+// samples to wait after a change, a restarted stream starts with a key frame burst
+#define AS_DOWN_COOLDOWN 3
+#define AS_UP_COOLDOWN 20
+#define AS_SKIP_RATIO_BAD 0.3
+#define AS_SKIP_RATIO_GOOD 0.05
+#define AS_MIN_BIT_RATE 500000
+#define AS_MIN_MAX_SIZE 480
+
+static quint16 scaleSize(quint16 maxSize, quint16 fallback, double scale)
+{
+    int size = maxSize ? static_cast<int>(maxSize * scale) : fallback;
+    size = qMax(size, AS_MIN_MAX_SIZE) & ~7;
+    return static_cast<quint16>(maxSize ? qMin<int>(size, maxSize) : size);
+}
+
+AdaptiveStream::AdaptiveStream(const Level &top, int latencyBudgetMs)
+    : m_latencyBudgetMs(qMax(latencyBudgetMs, 1))
+{
+    // bit rate scale, size scale (or fixed size when the top is unlimited), fps cap
+    struct Step
+    {
+        double bitRate;
+        double size;
+        quint16 fallbackSize;
+        quint32 fpsCap;
+    };
+    const Step steps[] = {
+        { 1.0, 1.0, 0, 0 },
+        { 0.7, 1.0, 0, 0 },
+        { 0.5, 0.75, 1280, 0 },
+        { 0.35, 0.6, 960, 30 },
+        { 0.25, 0.5, 720, 30 },
+    };
+
+    for (const Step &step : steps) {
+        Level level;
+        level.bitRate = qMax<quint32>(static_cast<quint32>(top.bitRate * step.bitRate), AS_MIN_BIT_RATE);
+        level.maxSize = 1.0 == step.size ? top.maxSize : scaleSize(top.maxSize, step.fallbackSize, step.size);
+        level.maxFps = top.maxFps;
+        if (step.fpsCap && (0 == level.maxFps || level.maxFps > step.fpsCap)) {
+            level.maxFps = step.fpsCap;
+        }
+        if (m_levels.isEmpty() || level.bitRate < m_levels.last().bitRate) {
+            m_levels << level;
+        }
+    }
+}
+
+bool AdaptiveStream::update(const Sample &sample, Level &next)
+{
+    m_samplesSinceChange++;
+
+    quint32 frames = sample.rendered + sample.skipped;
+    double skipRatio = frames ? static_cast<double>(sample.skipped) / frames : 0;
+    double delay = queueDelayMs(sample);
+
+    if (delay > m_latencyBudgetMs || skipRatio > AS_SKIP_RATIO_BAD) {
+        m_badCount++;
+        m_goodCount = 0;
+    } else if (delay < m_latencyBudgetMs / 2.0 && skipRatio < AS_SKIP_RATIO_GOOD) {
+        m_goodCount++;
+        m_badCount = 0;
+    } else {
+        // inside the hysteresis band, hold the level
+        m_badCount = 0;
+        m_goodCount = 0;
+    }
+
+    int target = m_current;
+    if (m_badCount >= AS_DOWN_SAMPLES && m_samplesSinceChange >= AS_DOWN_COOLDOWN && m_current + 1 < m_levels.size()) {
+        target = m_current + 1;
+    } else if (m_goodCount >= AS_UP_SAMPLES && m_samplesSinceChange >= AS_UP_COOLDOWN && m_current > 0) {
+        target = m_current - 1;
+    }
+    if (target == m_current) {
+        return false;
+    }
+
+    m_current = target;
+    m_badCount = 0;
+    m_goodCount = 0;
+    m_samplesSinceChange = 0;
+    next = m_levels[m_current];
+    return true;
+}
+
+int AdaptiveStream::currentLevel()
+{
+    return m_current;
+}
+
+const QList<AdaptiveStream::Level> &AdaptiveStream::levels()
+{
+    return m_levels;
+}
+
+double AdaptiveStream::queueDelayMs(const Sample &sample)
+{
+    double delay = sample.jitterMs * 2;
+    if (sample.throughputBps > 0) {
+        delay += sample.backlogBytes * 8 * 1000.0 / sample.throughputBps;
+    } else if (sample.backlogBytes > 0) {
+        // data is waiting but nothing was drained, the link or the decoder stalls
+        delay += 1000;
+    }
+    return delay;
+}
@@ -0,0 +1,47 @@
+#ifndef ADAPTIVESTREAM_H
+#define ADAPTIVESTREAM_H
+
+#include <QList>
+#include <QtGlobal>
+
+// picks the stream quality from link and decode health, one sample per second
+// pure logic without timers or sockets, the owner feeds samples and applies levels
+class AdaptiveStream
+{
+public:
+    struct Level
+    {
+        quint32 bitRate = 0;
+        quint16 maxSize = 0; // 0 is the device resolution
+        quint32 maxFps = 0;  // 0 is unlimited
+    };
+
+    struct Sample
+    {
+        double throughputBps = 0; // received bits per second
+        double jitterMs = 0;      // packet arrival jitter
+        qint64 backlogBytes = 0;  // bytes waiting in the socket
+        quint32 rendered = 0;     // frames rendered during the sample
+        quint32 skipped = 0;      // frames decoded but never rendered
+    };
+
+    // top is the quality asked for by the user, the ladder only goes below it
+    AdaptiveStream(const Level &top, int latencyBudgetMs);
+
+    // returns true when the stream should be restarted with next
+    bool update(const Sample &sample, Level &next);
+    int currentLevel();
+    const QList<Level> &levels();
+    // estimated time a new packet waits before it is decoded
+    static double queueDelayMs(const Sample &sample);
+
+private:
+    QList<Level> m_levels;
+    int m_current = 0;
+    int m_latencyBudgetMs = 100;
+    int m_badCount = 0;
+    int m_goodCount = 0;
+    int m_samplesSinceChange = 0;
+};
+
+#endif // ADAPTIVESTREAM_H
@@ -20,6 +20,41 @@ void BufferUtil::write16(QBuffer &buffer, quint16 value)
     buffer.putChar(value);
 }
 
+void BufferUtil::write16(uchar *buf, quint16 value)
+{
+    buf[0] = value >> 8;
+    buf[1] = value;
+}
+
+void BufferUtil::write32(uchar *buf, quint32 value)
+{
+    buf[0] = value >> 24;
+    buf[1] = value >> 16;
+    buf[2] = value >> 8;
+    buf[3] = value;
+}
+
+void BufferUtil::write64(uchar *buf, quint64 value)
+{
+    write32(buf, value >> 32);
+    write32(buf + 4, (quint32)value);
+}
+
+quint16 BufferUtil::read16(const uchar *buf)
+{
+    return (buf[0] << 8) | buf[1];
+}
+
+quint32 BufferUtil::read32(const uchar *buf)
+{
+    return ((quint32)buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3];
+}
+
+quint64 BufferUtil::read64(const uchar *buf)
+{
+    return ((quint64)read32(buf) << 32) | read32(buf + 4);
+}
+
 quint16 BufferUtil::read16(QBuffer &buffer)
 {
     uchar c;
@@ -8,6 +8,13 @@ public:
     static void write16(QBuffer &buffer, quint16 value);
     static void write32(QBuffer &buffer, quint32 value);
     static void write64(QBuffer &buffer, quint64 value);
+    // big endian into a caller sized buffer, no bounds check
+    static void write16(uchar *buf, quint16 value);
+    static void write32(uchar *buf, quint32 value);
+    static void write64(uchar *buf, quint64 value);
+    static quint16 read16(const uchar *buf);
+    static quint32 read32(const uchar *buf);
+    static quint64 read64(const uchar *buf);
     static quint16 read16(QBuffer &buffer);
     static quint32 read32(QBuffer &buffer);
     static quint64 read64(QBuffer &buffer);
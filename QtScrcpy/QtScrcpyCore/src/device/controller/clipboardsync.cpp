@@ -0,0 +1,201 @@
+#include <QApplication>
+#include <QClipboard>
+#include <QCryptographicHash>
+
+#include "clipboardsync.h"
+#include "controller.h"
+#include "controlmsg.h"
+
+#define CLIPBOARD_ACK_TIMEOUT 3000
+// longer clipboards are not sent again as a marker
+#define CLIPBOARD_MARKER_MAX_LENGTH 1024
+
+ClipboardSync::ClipboardSync(Controller *controller) : QObject(controller), m_controller(controller)
+{
+    m_ackTimer.setSingleShot(true);
+    connect(&m_ackTimer, &QTimer::timeout, this, &ClipboardSync::onAckTimeout);
+}
+
+ClipboardSync::~ClipboardSync() {}
+
+void ClipboardSync::setAutoSync(bool enable)
+{
+    if (m_autoSync == enable) {
+        return;
+    }
+    m_autoSync = enable;
+    QClipboard *board = QApplication::clipboard();
+    if (m_autoSync) {
+        connect(board, &QClipboard::dataChanged, this, &ClipboardSync::onClipboardChanged);
+    } else {
+        disconnect(board, &QClipboard::dataChanged, this, &ClipboardSync::onClipboardChanged);
+    }
+}
+
+void ClipboardSync::onDeviceClipboard(const QString &text)
+{
+    QByteArray hash = hashText(text);
+    if (hash == m_syncedHash || hash == m_pendingHash) {
+        qDebug("Computer clipboard unchanged");
+        return;
+    }
+    qInfo("Device clipboard copied");
+    // set before the clipboard so onClipboardChanged sees no change
+    m_syncedHash = hash;
+    m_syncedText = text;
+    QApplication::clipboard()->setText(text);
+}
+
+void ClipboardSync::onAckClipboard(quint64 sequence)
+{
+    if (0 == m_pendingSequence || sequence != m_pendingSequence) {
+        return;
+    }
+    m_ackTimer.stop();
+    m_syncedHash = m_pendingHash;
+    m_syncedText = m_pendingText;
+    m_pendingSequence = 0;
+    m_pendingHash.clear();
+    m_pendingText.clear();
+    emit sendFinished(sequence, true);
+    sendDeferred();
+}
+
+void ClipboardSync::onAckTimeout()
+{
+    if (0 == m_pendingSequence) {
+        return;
+    }
+    // not known to be synced, a change waiting for the ack goes out now
+    qWarning("clipboard ack %llu timed out", m_pendingSequence);
+    quint64 sequence = m_pendingSequence;
+    m_pendingSequence = 0;
+    m_pendingHash.clear();
+    m_pendingText.clear();
+    emit sendFinished(sequence, false);
+    sendDeferred();
+}
+
+void ClipboardSync::sendDeferred()
+{
+    if (!m_deferred) {
+        return;
+    }
+    m_deferred = false;
+    bool paste = m_deferredPaste;
+    m_deferredPaste = false;
+    QString text = QApplication::clipboard()->text();
+    QByteArray hash = hashText(text);
+    if (!text.isEmpty() && hash != m_syncedHash) {
+        sendClipboard(text, hash, paste);
+    } else if (paste) {
+        postPaste();
+    }
+}
+
+void ClipboardSync::syncToDevice(bool paste)
+{
+    QString text = QApplication::clipboard()->text();
+    if (text.isEmpty()) {
+        return;
+    }
+    QByteArray hash = hashText(text);
+    if (hash == m_syncedHash && !isPending()) {
+        // the device has it already, only paste
+        if (paste) {
+            postPaste();
+        }
+        return;
+    }
+    sendClipboard(text, hash, paste);
+}
+
+quint64 ClipboardSync::sendText(const QString &text, bool paste)
+{
+    if (!m_controller || text.isEmpty()) {
+        return 0;
+    }
+    // what the device holds is unknown until the ack, the sync in flight is superseded
+    m_syncedHash.clear();
+    m_syncedText.clear();
+    return writeClipboard(text, hashText(text), paste);
+}
+
+quint64 ClipboardSync::sendMarker()
+{
+    if (!m_controller || isPending() || m_syncedText.isEmpty() || m_syncedText.length() > CLIPBOARD_MARKER_MAX_LENGTH) {
+        return 0;
+    }
+    // the device echoes the unchanged text, dropped as synced
+    return writeClipboard(m_syncedText, m_syncedHash, false);
+}
+
+void ClipboardSync::onClipboardChanged()
+{
+    QString text = QApplication::clipboard()->text();
+    if (text.isEmpty()) {
+        return;
+    }
+    QByteArray hash = hashText(text);
+    if (hash == m_syncedHash || hash == m_pendingHash) {
+        return;
+    }
+    sendClipboard(text, hash, false);
+}
+
+QByteArray ClipboardSync::hashText(const QString &text)
+{
+    return QCryptographicHash::hash(text.toUtf8(), QCryptographicHash::Sha1);
+}
+
+void ClipboardSync::sendClipboard(const QString &text, const QByteArray &hash, bool paste)
+{
+    if (!m_controller) {
+        return;
+    }
+    if (isPending()) {
+        // only the latest text is sent once the device acked the previous one
+        m_deferred = true;
+        m_deferredPaste = m_deferredPaste || paste;
+        return;
+    }
+
+    // sending the current text covers a deferred change as well
+    paste = paste || m_deferredPaste;
+    m_deferred = false;
+    m_deferredPaste = false;
+    writeClipboard(text, hash, paste);
+}
+
+quint64 ClipboardSync::writeClipboard(const QString &text, const QByteArray &hash, bool paste)
+{
+    m_pendingSequence = ++m_sequence;
+    m_pendingHash = hash;
+    m_pendingText = text;
+    m_ackTimer.start(CLIPBOARD_ACK_TIMEOUT);
+
+    QString clipboardText = text;
+    ControlMsg controlMsg(ControlMsg::CMT_SET_CLIPBOARD);
+    controlMsg.setSetClipboardMsgData(clipboardText, paste, m_pendingSequence);
+    m_controller->sendControlMsg(controlMsg);
+    return m_pendingSequence;
+}
+
+void ClipboardSync::postPaste()
+{
+    if (!m_controller) {
+        return;
+    }
+    ControlMsg controlEventDown(ControlMsg::CMT_INJECT_KEYCODE);
+    controlEventDown.setInjectKeycodeMsgData(AKEY_EVENT_ACTION_DOWN, AKEYCODE_PASTE, 0, AMETA_NONE);
+    m_controller->sendControlMsg(controlEventDown);
+
+    ControlMsg controlEventUp(ControlMsg::CMT_INJECT_KEYCODE);
+    controlEventUp.setInjectKeycodeMsgData(AKEY_EVENT_ACTION_UP, AKEYCODE_PASTE, 0, AMETA_NONE);
+    m_controller->sendControlMsg(controlEventUp);
+}
+
+bool ClipboardSync::isPending()
+{
+    return 0 != m_pendingSequence;
+}
@@ -0,0 +1,69 @@
+#ifndef CLIPBOARDSYNC_H
+#define CLIPBOARDSYNC_H
+
+#include <QByteArray>
+#include <QObject>
+#include <QTimer>
+
+class Controller;
+
+// keeps the computer and device clipboards in sync without resending unchanged content:
+// the hash of the text known to be on both sides is kept, device echoes and unchanged
+// text are dropped, a text sent to the device counts as synced once its ack arrives,
+// changes made while waiting for an ack are merged into one
+class ClipboardSync : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ClipboardSync(Controller *controller);
+    virtual ~ClipboardSync();
+
+    // also send computer clipboard changes to the device as they happen
+    void setAutoSync(bool enable);
+
+    // device -> computer
+    void onDeviceClipboard(const QString &text);
+    void onAckClipboard(quint64 sequence);
+    // computer -> device, paste: paste it on the device too
+    void syncToDevice(bool paste);
+    // a text that is not the computer clipboard, sent right away even if a sync waits for its ack,
+    // returns the sequence reported by sendFinished()
+    quint64 sendText(const QString &text, bool paste);
+    // sets the device clipboard to the text it already holds, the ack tells that the device
+    // has processed everything sent before, 0 if that text is unknown or a sync is in flight
+    quint64 sendMarker();
+
+signals:
+    // a set clipboard was acked by the device, or its ack timed out
+    void sendFinished(quint64 sequence, bool acked);
+
+private slots:
+    void onClipboardChanged();
+    void onAckTimeout();
+
+private:
+    static QByteArray hashText(const QString &text);
+    void sendClipboard(const QString &text, const QByteArray &hash, bool paste);
+    quint64 writeClipboard(const QString &text, const QByteArray &hash, bool paste);
+    void sendDeferred();
+    void postPaste();
+    bool isPending();
+
+private:
+    Controller *m_controller = Q_NULLPTR;
+    bool m_autoSync = false;
+    QByteArray m_syncedHash;
+    QString m_syncedText;
+    quint64 m_sequence = 0;
+    // set clipboard waiting for its ack
+    quint64 m_pendingSequence = 0;
+    QByteArray m_pendingHash;
+    QString m_pendingText;
+    // a lost ack must not block the sync forever
+    QTimer m_ackTimer;
+    // a change that arrived while another one was in flight
+    bool m_deferred = false;
+    bool m_deferredPaste = false;
+};
+
+#endif // CLIPBOARDSYNC_H
@@ -0,0 +1,432 @@
+#include <chrono>
+#include <limits>
+
+#include <QDeadlineTimer>
+#include <QDebug>
+#include <QMutex>
+#include <QTcpSocket>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "controlchannel.h"
+#include "devicemsg.h"
+
+// the end of the wait is spun on the release thread, a wait may overshoot by about this much
+#ifdef Q_OS_WIN
+// the waits round up to the system tick
+#define CONTROL_RELEASE_SPIN_NS 16000000
+#else
+#define CONTROL_RELEASE_SPIN_NS 100000
+#endif
+
+namespace {
+qint64 steadyNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class ControlIoThread : public QThread
+{
+public:
+    ControlIoThread()
+    {
+        setObjectName("control io");
+        start();
+    }
+    ~ControlIoThread()
+    {
+        quit();
+        wait();
+    }
+};
+
+std::atomic<quint64> s_spreadCount { 0 };
+std::atomic<qint64> s_spreadSumNs { 0 };
+std::atomic<qint64> s_spreadMaxNs { 0 };
+
+void updateMax(std::atomic<qint64> &maxNs, qint64 value)
+{
+    qint64 oldMaxNs = maxNs.load();
+    while (value > oldMaxNs && !maxNs.compare_exchange_weak(oldMaxNs, value)) {
+    }
+}
+}
+
+// waits for the release times of the held data on a thread of its own, so the wait never blocks
+// the shared I/O thread, then hands the release to the I/O thread: the channels due together are
+// written and flushed there one right after the other
+class ControlReleaseClock : public QThread
+{
+public:
+    static ControlReleaseClock *instance()
+    {
+        // constructed after the I/O thread, destroyed before it
+        static ControlReleaseClock clock;
+        return &clock;
+    }
+
+    // any thread
+    void schedule(ControlChannel *channel, qint64 releaseNs)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_held.append({ channel, releaseNs });
+        m_cond.wakeOne();
+    }
+
+    // I/O thread, from the channel destructor
+    void remove(ControlChannel *channel)
+    {
+        QMutexLocker locker(&m_mutex);
+        for (int i = m_held.size() - 1; i >= 0; --i) {
+            if (m_held[i].channel == channel) {
+                m_held.remove(i);
+            }
+        }
+    }
+
+private:
+    ControlReleaseClock()
+    {
+        setObjectName("control release");
+        m_ioContext = new QObject();
+        m_ioContext->moveToThread(ControlChannel::ioThread());
+        start(QThread::TimeCriticalPriority);
+    }
+
+    ~ControlReleaseClock()
+    {
+        {
+            QMutexLocker locker(&m_mutex);
+            m_quit = true;
+            m_cond.wakeOne();
+        }
+        wait();
+        m_ioContext->deleteLater();
+    }
+
+    qint64 nextRelease()
+    {
+        qint64 next = 0;
+        for (const auto &item : m_held) {
+            if (0 == next || item.releaseNs < next) {
+                next = item.releaseNs;
+            }
+        }
+        return next;
+    }
+
+    void run() override
+    {
+        QMutexLocker locker(&m_mutex);
+        while (!m_quit) {
+            // one release pass at a time, the pass wakes us when done
+            qint64 next = m_releasePending ? 0 : nextRelease();
+            if (0 == next) {
+                m_cond.wait(&m_mutex);
+                continue;
+            }
+            qint64 leftNs = next - steadyNowNs();
+            if (leftNs > CONTROL_RELEASE_SPIN_NS) {
+                // an earlier release time wakes us before the deadline
+                QDeadlineTimer deadline(Qt::PreciseTimer);
+                deadline.setPreciseRemainingTime(0, leftNs - CONTROL_RELEASE_SPIN_NS, Qt::PreciseTimer);
+                m_cond.wait(&m_mutex, deadline);
+                continue;
+            }
+            // the wake up may be late by about the spin, the rest is spun on this thread
+            locker.unlock();
+            while (steadyNowNs() < next) {
+#ifdef Q_OS_WIN
+                QThread::yieldCurrentThread();
+#endif
+            }
+            locker.relock();
+            m_releasePending = true;
+            QMetaObject::invokeMethod(m_ioContext, [this]() { release(); }, Qt::QueuedConnection);
+        }
+    }
+
+    // I/O thread
+    void release()
+    {
+        QVector<ControlChannel *> due;
+        {
+            QMutexLocker locker(&m_mutex);
+            qint64 now = steadyNowNs();
+            for (int i = m_held.size() - 1; i >= 0; --i) {
+                if (m_held[i].releaseNs > now) {
+                    continue;
+                }
+                if (!due.contains(m_held[i].channel)) {
+                    due.append(m_held[i].channel);
+                }
+                m_held.remove(i);
+            }
+        }
+
+        // channels are only deleted on this thread, none goes away during the pass
+        qint64 firstNs = 0;
+        qint64 lastNs = 0;
+        for (ControlChannel *channel : due) {
+            channel->drain();
+            lastNs = steadyNowNs();
+            if (0 == firstNs) {
+                firstNs = lastNs;
+            }
+        }
+        if (due.size() > 1) {
+            s_spreadCount++;
+            s_spreadSumNs += lastNs - firstNs;
+            updateMax(s_spreadMaxNs, lastNs - firstNs);
+        }
+
+        QMutexLocker locker(&m_mutex);
+        m_releasePending = false;
+        m_cond.wakeOne();
+    }
+
+private:
+    struct Held
+    {
+        ControlChannel *channel;
+        qint64 releaseNs;
+    };
+    QMutex m_mutex;
+    QWaitCondition m_cond;
+    QVector<Held> m_held;
+    bool m_releasePending = false;
+    bool m_quit = false;
+    // lives on the I/O thread, the release passes are queued to it
+    QObject *m_ioContext = Q_NULLPTR;
+};
+
+ControlChannel::ControlChannel(QTcpSocket *socket) : QObject(Q_NULLPTR), m_socket(socket)
+{
+    static bool registered = false;
+    if (!registered) {
+        qRegisterMetaType<QSharedPointer<DeviceMsg>>("QSharedPointer<DeviceMsg>");
+        registered = true;
+    }
+
+    Q_ASSERT(m_socket && !m_socket->parent());
+    connect(m_socket, &QTcpSocket::readyRead, this, &ControlChannel::onReadyRead);
+    connect(m_socket, &QTcpSocket::disconnected, this, &ControlChannel::channelClosed);
+    connect(m_socket, &QTcpSocket::bytesWritten, this, [this]() {
+        m_socketBytes.store(m_socket->bytesToWrite());
+    });
+
+    // the socket follows the channel, its notifiers are registered again on the I/O thread
+    moveToThread(ioThread());
+    m_socket->moveToThread(ioThread());
+}
+
+ControlChannel::~ControlChannel()
+{
+    ControlReleaseClock::instance()->remove(this);
+    if (m_socket) {
+        m_socket->disconnect(this);
+        m_socket->close();
+        delete m_socket;
+        m_socket = Q_NULLPTR;
+    }
+}
+
+QThread *ControlChannel::ioThread()
+{
+    static ControlIoThread thread;
+    return &thread;
+}
+
+void ControlChannel::send(const char *data, int len, const QVector<qint64> &stampsNs)
+{
+    if (!data || len <= 0) {
+        return;
+    }
+    m_queuedBytes += len;
+    Chunk chunk;
+    chunk.data = QByteArray(data, len);
+    chunk.stampsNs = stampsNs;
+    if (chunk.stampsNs.isEmpty()) {
+        chunk.stampsNs.append(steadyNowNs());
+    }
+    m_sendQueue.push(std::move(chunk));
+    scheduleDrain();
+}
+
+void ControlChannel::send(const QByteArray &data, qint64 releaseNs, qint64 stampNs)
+{
+    if (data.isEmpty()) {
+        return;
+    }
+    m_queuedBytes += data.size();
+    qint64 now = steadyNowNs();
+    Chunk chunk;
+    chunk.data = data;
+    chunk.stampsNs.append(stampNs ? stampNs : now);
+    chunk.releaseNs = releaseNs > now ? releaseNs : 0;
+    releaseNs = chunk.releaseNs;
+    m_sendQueue.push(std::move(chunk));
+    if (releaseNs) {
+        // after the push, the clock must find the chunk when it drains the channel
+        ControlReleaseClock::instance()->schedule(this, releaseNs);
+    } else {
+        scheduleDrain();
+    }
+}
+
+qint64 ControlChannel::nowNs()
+{
+    return steadyNowNs();
+}
+
+qint64 ControlChannel::backlog()
+{
+    return m_queuedBytes.load() + m_socketBytes.load();
+}
+
+void ControlChannel::takeSendLatency(quint64 &count, qint64 &sumNs, qint64 &maxNs)
+{
+    count = m_latencyCount.exchange(0);
+    sumNs = m_latencySumNs.exchange(0);
+    maxNs = m_latencyMaxNs.exchange(0);
+}
+
+void ControlChannel::takeSendSkew(quint64 &count, qint64 &sumNs, qint64 &maxNs)
+{
+    count = m_skewCount.exchange(0);
+    sumNs = m_skewSumNs.exchange(0);
+    maxNs = m_skewMaxNs.exchange(0);
+}
+
+void ControlChannel::takeReleaseSpread(quint64 &count, qint64 &sumNs, qint64 &maxNs)
+{
+    count = s_spreadCount.exchange(0);
+    sumNs = s_spreadSumNs.exchange(0);
+    maxNs = s_spreadMaxNs.exchange(0);
+}
+
+void ControlChannel::release()
+{
+    // queued after the pending drain, whatever was sent before goes out first,
+    // data held for a release time is not waited for
+    QMetaObject::invokeMethod(this, [this]() {
+        write(std::numeric_limits<qint64>::max());
+        deleteLater();
+    }, Qt::QueuedConnection);
+}
+
+void ControlChannel::scheduleDrain()
+{
+    if (!m_drainPending.exchange(true)) {
+        QMetaObject::invokeMethod(this, "drain", Qt::QueuedConnection);
+    }
+}
+
+void ControlChannel::drain()
+{
+    m_drainPending.store(false);
+    write(steadyNowNs());
+}
+
+void ControlChannel::write(qint64 releaseUntilNs)
+{
+    // everything popped here is written right below
+    qint64 now = steadyNowNs();
+    QByteArray data;
+    Chunk chunk;
+    quint64 count = 0;
+    qint64 sumNs = 0;
+    qint64 maxNs = 0;
+    // the earliest release written in this pass, 0 if none
+    qint64 releaseNs = 0;
+    bool held = false;
+    for (Chunk *next = m_sendQueue.peek(); next; next = m_sendQueue.peek()) {
+        if (next->releaseNs > releaseUntilNs) {
+            // the release clock comes back for it, what follows must not overtake it
+            held = true;
+            break;
+        }
+        m_sendQueue.pop(chunk);
+        if (chunk.releaseNs && (0 == releaseNs || chunk.releaseNs < releaseNs)) {
+            releaseNs = chunk.releaseNs;
+        }
+        data.append(chunk.data);
+        // one sample per message, however they were batched
+        for (qint64 stampNs : chunk.stampsNs) {
+            count++;
+            sumNs += now - stampNs;
+            maxNs = qMax(maxNs, now - stampNs);
+        }
+    }
+    m_queuedBytes -= data.size();
+    if (!data.isEmpty() && m_socket) {
+        m_socket->write(data);
+        if (releaseNs) {
+            // released data goes to the kernel now, not when the loop polls the socket
+            m_socket->flush();
+            qint64 skewNs = steadyNowNs() - releaseNs;
+            // flushed early on release, no skew of the alignment
+            if (skewNs >= 0) {
+                m_skewCount++;
+                m_skewSumNs += skewNs;
+                updateMax(m_skewMaxNs, skewNs);
+            }
+        }
+        m_socketBytes.store(m_socket->bytesToWrite());
+
+        m_latencyCount += count;
+        m_latencySumNs += sumNs;
+        updateMax(m_latencyMaxNs, maxNs);
+    }
+
+    if (!held && !m_sendQueue.isEmpty()) {
+        // a producer is still linking its message, come back for it
+        scheduleDrain();
+    }
+}
+
+void ControlChannel::onReadyRead()
+{
+    if (!m_socket) {
+        return;
+    }
+
+    // read straight into the parser buffer
+    qint64 available = m_socket->bytesAvailable();
+    while (available > 0) {
+        int size = static_cast<int>(qMin<qint64>(available, DEVICE_MSG_MAX_SIZE));
+        qint64 len = m_socket->read(m_parser.reserve(size), size);
+        if (len <= 0) {
+            break;
+        }
+        m_parser.commit(static_cast<int>(len));
+        available = m_socket->bytesAvailable();
+    }
+
+    DeviceMsgParser::MsgView view;
+    int ret = 0;
+    while ((ret = m_parser.next(view)) > 0) {
+        // the only copy, the message crosses to the GUI thread
+        QSharedPointer<DeviceMsg> deviceMsg(new DeviceMsg());
+        switch (view.type) {
+        case DeviceMsg::DMT_GET_CLIPBOARD:
+            deviceMsg->setClipboardMsgData(view.data, view.size);
+            break;
+        case DeviceMsg::DMT_ACK_CLIPBOARD:
+            deviceMsg->setAckClipboardMsgData(view.sequence);
+            break;
+        case DeviceMsg::DMT_UHID_OUTPUT:
+            deviceMsg->setUhidOutputMsgData(view.uhidId, view.data, view.size);
+            break;
+        default:
+            continue;
+        }
+        emit deviceMsgReceived(deviceMsg);
+    }
+    if (0 > ret) {
+        // unknown message, the stream cannot be resynchronized
+        qWarning("Unsupported device msg, %d bytes dropped", m_parser.buffered());
+        m_parser.reset();
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef CONTROLCHANNEL_H
+#define CONTROLCHANNEL_H
+
+#include <atomic>
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QVector>
+
+#include "devicemsgparser.h"
+#include "mpscqueue.h"
+
+class QTcpSocket;
+class QThread;
+class DeviceMsg;
+
+// owns the control socket and runs it on the control I/O thread shared by all devices,
+// so a busy GUI thread delays neither the input going out nor the device messages coming in
+class ControlChannel : public QObject
+{
+    Q_OBJECT
+public:
+    // takes the socket over, the socket must not have a parent
+    explicit ControlChannel(QTcpSocket *socket);
+    // use release() instead of deleting the channel from another thread
+    virtual ~ControlChannel();
+
+    // any thread, the data is copied
+    // stampsNs: when each message of the data was produced (nowNs() base), none: one message produced now
+    void send(const char *data, int len, const QVector<qint64> &stampsNs = QVector<qint64>());
+    // any thread, the data is shared, one buffer can be queued on many channels
+    // with a release time the data and what follows are held until then, the channels
+    // holding data for the same release are written and flushed in one pass
+    // stampNs: when the message was produced, 0: now
+    void send(const QByteArray &data, qint64 releaseNs = 0, qint64 stampNs = 0);
+    // any thread, writes what is queued, held data included, then closes the socket
+    // and deletes the channel on the I/O thread
+    void release();
+    // any thread, bytes queued or waiting in the socket
+    qint64 backlog();
+    // any thread, time from each message being produced to the socket write, reset by each call
+    void takeSendLatency(quint64 &count, qint64 &sumNs, qint64 &maxNs);
+    // any thread, flush time minus release time of the held data, reset by each call
+    void takeSendSkew(quint64 &count, qint64 &sumNs, qint64 &maxNs);
+    // any thread, first to last flush of each release pass over all channels, reset by each call
+    static void takeReleaseSpread(quint64 &count, qint64 &sumNs, qint64 &maxNs);
+
+    // steady clock, the time base of the release times
+    static qint64 nowNs();
+
+signals:
+    // emitted on the I/O thread
+    void deviceMsgReceived(QSharedPointer<DeviceMsg> deviceMsg);
+    void channelClosed();
+
+private slots:
+    void drain();
+    void onReadyRead();
+
+private:
+    friend class ControlReleaseClock;
+    static QThread *ioThread();
+    void scheduleDrain();
+    // writes the queued data up to the first chunk held past releaseUntilNs
+    void write(qint64 releaseUntilNs);
+
+private:
+    QTcpSocket *m_socket = Q_NULLPTR;
+    struct Chunk
+    {
+        QByteArray data;
+        QVector<qint64> stampsNs;
+        qint64 releaseNs = 0;
+    };
+    MpscQueue<Chunk> m_sendQueue;
+    std::atomic<bool> m_drainPending { false };
+    std::atomic<qint64> m_queuedBytes { 0 };
+    std::atomic<qint64> m_socketBytes { 0 };
+    std::atomic<quint64> m_latencyCount { 0 };
+    std::atomic<qint64> m_latencySumNs { 0 };
+    std::atomic<qint64> m_latencyMaxNs { 0 };
+    std::atomic<quint64> m_skewCount { 0 };
+    std::atomic<qint64> m_skewSumNs { 0 };
+    std::atomic<qint64> m_skewMaxNs { 0 };
+    DeviceMsgParser m_parser;
+};
+
+#endif // CONTROLCHANNEL_H
@@ -1,31 +1,410 @@
+#include <chrono>
+
 #include <QApplication>
 #include <QClipboard>
+#include <QThread>
 
+#include "bufferutil.h"
+#include "clipboardsync.h"
 #include "controller.h"
 #include "controlmsg.h"
 #include "inputconvertgame.h"
+#include "inputconverthid.h"
 #include "receiver.h"
+#include "textinjector.h"
 #include "videosocket.h"
 
+// initial send buffer capacity, a busy frame of touch moves fits in it
+#define CONTROL_SEND_BUFFER_SIZE 4096
+// from the last step of a macro loop to the first of the next
+#define MACRO_LOOP_GAP_NS 16000000
+
+static qint64 steadyNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 Controller::Controller(std::function<qint64(const QByteArray&)> sendData, QString gameScript, QObject *parent)
     : QObject(parent)
     , m_sendData(sendData)
 {
     m_receiver = new Receiver(this);
     Q_ASSERT(m_receiver);
+    m_clipboardSync = new ClipboardSync(this);
+    m_receiver->setClipboardSync(m_clipboardSync);
+    m_textInjector = new TextInjector(this, m_clipboardSync);
+    connect(m_textInjector, &TextInjector::injectFinished, this, &Controller::textInjectFinished);
+    m_sendBuffer.reserve(CONTROL_SEND_BUFFER_SIZE);
+    m_sendStamps.reserve(CONTROL_SEND_BUFFER_SIZE / CONTROL_MSG_INJECT_TOUCH_SIZE);
+    m_coalesceTimer.setSingleShot(true);
+    connect(&m_coalesceTimer, &QTimer::timeout, this, [this]() {
+        commitCoalesced();
+        flushControl();
+    });
 
     updateScript(gameScript);
 }
 
-Controller::~Controller() {}
+Controller::~Controller()
+{
+    InputScheduler::instance().cancelAll(this);
+    InputScheduler::instance().cancelAll(&m_playMacro);
+}
 
 void Controller::postControlMsg(ControlMsg *controlMsg)
 {
-    if (controlMsg) {
-        QCoreApplication::postEvent(this, controlMsg);
+    if (!controlMsg) {
+        return;
+    }
+    if (QThread::currentThread() == thread()) {
+        // keep the order with sendControlMsg(), no event round trip needed
+        sendControlMsg(*controlMsg);
+        delete controlMsg;
+        return;
+    }
+    QCoreApplication::postEvent(this, controlMsg);
+}
+
+void Controller::sendControlMsg(const ControlMsg &controlMsg)
+{
+    if (m_macroRecording) {
+        recordControlMsg(controlMsg);
+    }
+
+    if (ControlMsg::CMT_INJECT_TOUCH == controlMsg.type() && AMOTION_EVENT_ACTION_MOVE == controlMsg.touchAction()) {
+        coalesceTouchMove(controlMsg);
+        return;
+    }
+    if (ControlMsg::CMT_INJECT_SCROLL == controlMsg.type()) {
+        coalesceScroll(controlMsg);
+        return;
+    }
+
+    // down/up and everything else must not overtake the held back moves
+    if (commitCoalesced()) {
+        scheduleFlush();
+    }
+    appendControlMsg(controlMsg);
+}
+
+void Controller::setCoalesceInterval(int ms)
+{
+    m_coalesceInterval = qMax(0, ms);
+}
+
+quint64 Controller::mergedEventCount()
+{
+    return m_mergedEvents;
+}
+
+quint64 Controller::submitInputPlan(const QVector<InputScheduler::Step> &steps, InputScheduler::Finished finished, const void *owner, int loops,
+                                    qint64 loopPeriodNs, qint64 startNs)
+{
+    if (!owner) {
+        owner = this;
+    }
+    if (m_macroRecording && owner == this) {
+        // recorded at the time the steps are planned for
+        qint64 now = steadyNowNs();
+        for (const auto &step : steps) {
+            m_recordMacro.append(step.data, step.size, now + step.offsetNs);
+        }
+    }
+
+    // the scheduler writes to the channel directly, hand over what is buffered first
+    commitCoalesced();
+    flushControl();
+    return InputScheduler::instance().submit(owner, steps, m_sendData, finished, loops, loopPeriodNs, startNs);
+}
+
+int Controller::cancelInputPlan(quint64 planId)
+{
+    return InputScheduler::instance().cancel(planId);
+}
+
+void Controller::takeInputPlanTimingError(quint64 &count, qint64 &sumNs, qint64 &maxNs)
+{
+    InputScheduler::instance().takeTimingError(this, count, sumNs, maxNs);
+}
+
+void Controller::setFrameSize(const QSize &frameSize)
+{
+    m_frameSize = frameSize;
+}
+
+void Controller::startMacroRecord()
+{
+    m_recordMacro.clear();
+    m_macroRecording = true;
+}
+
+bool Controller::stopMacroRecord(const QString &fileName)
+{
+    if (!m_macroRecording) {
+        return false;
+    }
+    m_macroRecording = false;
+    bool ret = m_recordMacro.save(fileName);
+    qInfo("macro: %d messages recorded", m_recordMacro.size());
+    m_recordMacro.clear();
+    return ret;
+}
+
+void Controller::recordControlMsg(const ControlMsg &controlMsg)
+{
+    uchar buf[CONTROL_MSG_FIXED_MAX_SIZE];
+    if (controlMsg.serializedSize() > CONTROL_MSG_FIXED_MAX_SIZE) {
+        return;
+    }
+    int len = controlMsg.serializeTo(buf, CONTROL_MSG_FIXED_MAX_SIZE);
+    if (len > 0) {
+        m_recordMacro.append(buf, len, steadyNowNs());
+    }
+}
+
+bool Controller::playMacro(const QString &fileName, int loops)
+{
+    stopMacro();
+    Macro macro;
+    if (!macro.load(fileName)) {
+        return false;
+    }
+    if (macro.isEmpty() || m_frameSize.isEmpty()) {
+        return false;
+    }
+    return playMacroSteps(macro.plan(m_frameSize), loops);
+}
+
+bool Controller::playMacroSteps(const QVector<InputScheduler::Step> &steps, int loops, qint64 startNs)
+{
+    stopMacro();
+    if (steps.isEmpty()) {
+        return false;
+    }
+    m_macroSteps = steps;
+    m_macroPlanId = submitInputPlan(m_macroSteps, [this](quint64 planId) {
+        QMetaObject::invokeMethod(this, [this, planId]() { onMacroFinished(planId); }, Qt::QueuedConnection);
+    }, &m_playMacro, loops, steps.last().offsetNs + MACRO_LOOP_GAP_NS, startNs);
+    return 0 != m_macroPlanId;
+}
+
+void Controller::onMacroFinished(quint64 planId)
+{
+    if (0 == planId || planId != m_macroPlanId) {
+        // stopped meanwhile
+        return;
+    }
+    m_macroPlanId = 0;
+    m_macroSteps.clear();
+    emit macroFinished();
+}
+
+void Controller::stopMacro()
+{
+    if (0 == m_macroPlanId) {
+        return;
+    }
+    int sent = cancelInputPlan(m_macroPlanId);
+    m_macroPlanId = 0;
+    if (0 > sent) {
+        // the loop just ended, everything was sent
+        sent = m_macroSteps.size();
+    }
+
+    // what went down and not up yet, by pointer id and by keycode
+    QHash<quint64, int> touches;
+    QHash<quint32, int> keys;
+    for (int i = 0; i < sent && i < m_macroSteps.size(); i++) {
+        const InputScheduler::Step &step = m_macroSteps[i];
+        if (ControlMsg::CMT_INJECT_TOUCH == step.data[0]) {
+            quint64 pointerId = BufferUtil::read64(step.data + 2);
+            if (AMOTION_EVENT_ACTION_UP == step.data[1]) {
+                touches.remove(pointerId);
+            } else {
+                touches.insert(pointerId, i);
+            }
+        } else if (ControlMsg::CMT_INJECT_KEYCODE == step.data[0]) {
+            quint32 keycode = BufferUtil::read32(step.data + 2);
+            if (AKEY_EVENT_ACTION_UP == step.data[1]) {
+                keys.remove(keycode);
+            } else {
+                keys.insert(keycode, i);
+            }
+        }
+    }
+
+    // the last message of each, turned into its up
+    for (int index : touches) {
+        uchar data[CONTROL_MSG_INJECT_TOUCH_SIZE];
+        memcpy(data, m_macroSteps[index].data, CONTROL_MSG_INJECT_TOUCH_SIZE);
+        data[1] = AMOTION_EVENT_ACTION_UP;
+        // pressure
+        BufferUtil::write16(data + 22, 0);
+        m_sendBuffer.append(reinterpret_cast<const char *>(data), CONTROL_MSG_INJECT_TOUCH_SIZE);
+        m_sendStamps.append(steadyNowNs());
+    }
+    for (int index : keys) {
+        uchar data[CONTROL_MSG_INJECT_KEYCODE_SIZE];
+        memcpy(data, m_macroSteps[index].data, CONTROL_MSG_INJECT_KEYCODE_SIZE);
+        data[1] = AKEY_EVENT_ACTION_UP;
+        // repeat
+        BufferUtil::write32(data + 6, 0);
+        m_sendBuffer.append(reinterpret_cast<const char *>(data), CONTROL_MSG_INJECT_KEYCODE_SIZE);
+        m_sendStamps.append(steadyNowNs());
+    }
+    if (!touches.isEmpty() || !keys.isEmpty()) {
+        scheduleFlush();
+    }
+    m_macroSteps.clear();
+    emit macroFinished();
+}
+
+bool Controller::isMacroPlaying()
+{
+    return 0 != m_macroPlanId;
+}
+
+void Controller::takeMacroTimingError(quint64 &count, qint64 &sumNs, qint64 &maxNs)
+{
+    InputScheduler::instance().takeTimingError(&m_playMacro, count, sumNs, maxNs);
+}
+
+void Controller::appendControlMsg(const ControlMsg &controlMsg)
+{
+    if (writeControlMsg(controlMsg)) {
+        scheduleFlush();
+    }
+}
+
+bool Controller::writeControlMsg(const ControlMsg &controlMsg)
+{
+    int size = controlMsg.serializedSize();
+    int offset = m_sendBuffer.size();
+    m_sendBuffer.resize(offset + size);
+    int len = controlMsg.serializeTo(reinterpret_cast<uchar *>(m_sendBuffer.data()) + offset, size);
+    if (len < 0) {
+        m_sendBuffer.resize(offset);
+        return false;
+    }
+    m_sendStamps.append(steadyNowNs());
+    return true;
+}
+
+void Controller::coalesceTouchMove(const ControlMsg &controlMsg)
+{
+    if (m_pendingScroll.pending && commitCoalesced()) {
+        scheduleFlush();
+    }
+
+    // latest position wins, one slot per pointer
+    PendingMove *move = Q_NULLPTR;
+    for (auto &item : m_pendingMoves) {
+        if (item.id == controlMsg.touchId()) {
+            move = &item;
+            m_mergedEvents++;
+            break;
+        }
+    }
+    if (!move) {
+        m_pendingMoves.append(PendingMove());
+        move = &m_pendingMoves.last();
+        move->id = controlMsg.touchId();
+        move->stampNs = steadyNowNs();
+    }
+    controlMsg.serializeTo(move->data, CONTROL_MSG_INJECT_TOUCH_SIZE);
+
+    if (0 == m_coalesceInterval) {
+        scheduleFlush();
+    } else if (!m_coalesceTimer.isActive()) {
+        m_coalesceTimer.start(m_coalesceInterval);
+    }
+}
+
+void Controller::coalesceScroll(const ControlMsg &controlMsg)
+{
+    if (!m_pendingMoves.isEmpty() && commitCoalesced()) {
+        scheduleFlush();
+    }
+
+    QRect position;
+    float hScroll = 0.0f;
+    float vScroll = 0.0f;
+    AndroidMotioneventButtons buttons;
+    controlMsg.getInjectScrollMsgData(position, hScroll, vScroll, buttons);
+
+    if (m_pendingScroll.pending) {
+        // the wire format holds [-16, 16], a larger sum is sent as two messages
+        bool overflow = qAbs(m_pendingScroll.hScroll + hScroll) > 16 || qAbs(m_pendingScroll.vScroll + vScroll) > 16;
+        if ((overflow || m_pendingScroll.buttons != buttons) && commitCoalesced()) {
+            scheduleFlush();
+        }
+    }
+
+    if (m_pendingScroll.pending) {
+        m_pendingScroll.hScroll += hScroll;
+        m_pendingScroll.vScroll += vScroll;
+        m_mergedEvents++;
+    } else {
+        m_pendingScroll.pending = true;
+        m_pendingScroll.stampNs = steadyNowNs();
+        m_pendingScroll.hScroll = hScroll;
+        m_pendingScroll.vScroll = vScroll;
+        m_pendingScroll.buttons = buttons;
+    }
+    m_pendingScroll.position = position;
+
+    if (0 == m_coalesceInterval) {
+        scheduleFlush();
+    } else if (!m_coalesceTimer.isActive()) {
+        m_coalesceTimer.start(m_coalesceInterval);
     }
 }
 
+bool Controller::commitCoalesced()
+{
+    m_coalesceTimer.stop();
+    bool committed = !m_pendingMoves.isEmpty() || m_pendingScroll.pending;
+    for (const auto &item : m_pendingMoves) {
+        m_sendBuffer.append(reinterpret_cast<const char *>(item.data), CONTROL_MSG_INJECT_TOUCH_SIZE);
+        m_sendStamps.append(item.stampNs);
+    }
+    m_pendingMoves.clear();
+
+    if (m_pendingScroll.pending) {
+        m_pendingScroll.pending = false;
+        ControlMsg controlMsg(ControlMsg::CMT_INJECT_SCROLL);
+        controlMsg.setInjectScrollMsgData(m_pendingScroll.position, m_pendingScroll.hScroll, m_pendingScroll.vScroll, m_pendingScroll.buttons);
+        if (writeControlMsg(controlMsg)) {
+            m_sendStamps.last() = m_pendingScroll.stampNs;
+        }
+    }
+    return committed;
+}
+
+void Controller::scheduleFlush()
+{
+    // everything produced until control returns to the event loop goes out in one write
+    if (!m_flushPending) {
+        m_flushPending = true;
+        QMetaObject::invokeMethod(this, "flushControl", Qt::QueuedConnection);
+    }
+}
+
+void Controller::flushControl()
+{
+    m_flushPending = false;
+    if (0 == m_coalesceInterval) {
+        commitCoalesced();
+    }
+    if (m_sendBuffer.isEmpty()) {
+        return;
+    }
+    sendControl(m_sendBuffer, m_sendStamps);
+    // resize keeps the reserved capacity
+    m_sendBuffer.resize(0);
+    m_sendStamps.resize(0);
+}
+
 void Controller::recvDeviceMsg(DeviceMsg *deviceMsg)
 {
     if (!m_receiver) {
@@ -45,6 +424,13 @@ void Controller::test(QRect rc)
 
 void Controller::updateScript(QString gameScript)
 {
+    m_gameScript = gameScript;
+    InputConvertGame *currentGame = qobject_cast<InputConvertGame *>(m_inputConvert.data());
+    if (currentGame && !gameScript.isEmpty()) {
+        // only the keymap is swapped, the converter is kept
+        currentGame->loadKeyMap(gameScript);
+        return;
+    }
     if (m_inputConvert) {
         delete m_inputConvert;
     }
@@ -52,13 +438,36 @@ void Controller::updateScript(QString gameScript)
         InputConvertGame *convertgame = new InputConvertGame(this);
         convertgame->loadKeyMap(gameScript);
         m_inputConvert = convertgame;
+    } else if (m_uhidKeyboard || m_uhidMouse) {
+        m_inputConvert = new InputConvertHid(this, m_uhidKeyboard, m_uhidMouse);
     } else {
         m_inputConvert = new InputConvertNormal(this);
     }
     Q_ASSERT(m_inputConvert);
+    m_inputConvert->setRawMouseMotion(m_rawMouseMotion);
     connect(m_inputConvert, &InputConvertBase::grabCursor, this, &Controller::grabCursor);
 }
 
+void Controller::setUhidMode(bool keyboard, bool mouse)
+{
+    if (m_uhidKeyboard == keyboard && m_uhidMouse == mouse) {
+        return;
+    }
+    m_uhidKeyboard = keyboard;
+    m_uhidMouse = mouse;
+    // a game script takes precedence
+    if (m_gameScript.isEmpty()) {
+        updateScript();
+    }
+}
+
+void Controller::resetInput()
+{
+    if (m_inputConvert) {
+        m_inputConvert->reset();
+    }
+}
+
 bool Controller::isCurrentCustomKeymap()
 {
     if (!m_inputConvert) {
@@ -163,14 +572,13 @@ void Controller::getDeviceClipboard(bool cut)
 
 void Controller::setDeviceClipboard(bool pause)
 {
-    QClipboard *board = QApplication::clipboard();
-    QString text = board->text();
-    ControlMsg *controlMsg = new ControlMsg(ControlMsg::CMT_SET_CLIPBOARD);
-    if (!controlMsg) {
-        return;
-    }
-    controlMsg->setSetClipboardMsgData(text, pause);
-    postControlMsg(controlMsg);
+    // unchanged text is not sent again, only pasted
+    m_clipboardSync->syncToDevice(pause);
+}
+
+void Controller::setClipboardAutoSync(bool enable)
+{
+    m_clipboardSync->setAutoSync(enable);
 }
 
 void Controller::clipboardPaste()
@@ -182,12 +590,59 @@ void Controller::clipboardPaste()
 
 void Controller::postTextInput(QString &text)
 {
-    ControlMsg *controlMsg = new ControlMsg(ControlMsg::CMT_INJECT_TEXT);
-    if (!controlMsg) {
+    if (text.isEmpty()) {
         return;
     }
-    controlMsg->setInjectTextMsgData(text);
-    postControlMsg(controlMsg);
+    QByteArray utf8 = text.toUtf8();
+    if (utf8.size() > CONTROL_MSG_INJECT_TEXT_MAX_LENGTH || m_textInjector->isRunning()) {
+        // one message would be truncated, or must not overtake the text being streamed
+        m_textInjector->inject(text);
+        return;
+    }
+    ControlMsg controlMsg(ControlMsg::CMT_INJECT_TEXT);
+    controlMsg.setInjectTextMsgData(utf8.constData(), utf8.size());
+    sendControlMsg(controlMsg);
+}
+
+void Controller::setSendBacklogQuery(std::function<qint64()> backlog)
+{
+    m_textInjector->setBacklogQuery(backlog);
+}
+
+void Controller::setSendStampedData(std::function<qint64(const QByteArray&, const QVector<qint64>& stampsNs)> sendStamped)
+{
+    m_sendStamped = sendStamped;
+}
+
+void Controller::setSendSharedData(std::function<qint64(const QByteArray&, qint64 releaseNs, qint64 stampNs)> sendShared)
+{
+    m_sendShared = sendShared;
+}
+
+void Controller::sendSerialized(const QByteArray &serialized, qint64 releaseNs)
+{
+    if (serialized.isEmpty()) {
+        return;
+    }
+    qint64 stampNs = steadyNowNs();
+    // nothing may be overtaken, held back moves included
+    commitCoalesced();
+    if (!m_sendShared) {
+        m_sendBuffer.append(serialized);
+        m_sendStamps.append(stampNs);
+        scheduleFlush();
+        return;
+    }
+    if (!m_sendBuffer.isEmpty()) {
+        flushControl();
+    }
+    m_sendShared(serialized, releaseNs, stampNs);
+}
+
+bool Controller::isNormalInput()
+{
+    // the game and UHID converters derive from the normal one
+    return m_inputConvert && m_inputConvert->metaObject() == &InputConvertNormal::staticMetaObject;
 }
 
 void Controller::setDisplayPower(bool on)
@@ -200,6 +655,15 @@ void Controller::setDisplayPower(bool on)
     postControlMsg(controlMsg);
 }
 
+void Controller::resetVideo()
+{
+    ControlMsg *controlMsg = new ControlMsg(ControlMsg::CMT_RESET_VIDEO);
+    if (!controlMsg) {
+        return;
+    }
+    postControlMsg(controlMsg);
+}
+
 void Controller::mouseEvent(const QMouseEvent *from, const QSize &frameSize, const QSize &showSize)
 {
     if (m_inputConvert) {
@@ -214,6 +678,21 @@ void Controller::wheelEvent(const QWheelEvent *from, const QSize &frameSize, con
     }
 }
 
+void Controller::setRawMouseMotion(bool enabled)
+{
+    m_rawMouseMotion = enabled;
+    if (m_inputConvert) {
+        m_inputConvert->setRawMouseMotion(enabled);
+    }
+}
+
+void Controller::rawMouseMotion(const QPointF &delta)
+{
+    if (m_inputConvert) {
+        m_inputConvert->rawMouseMotion(delta);
+    }
+}
+
 void Controller::keyEvent(const QKeyEvent *from, const QSize &frameSize, const QSize &showSize)
 {
     if (m_inputConvert) {
@@ -226,20 +705,22 @@ bool Controller::event(QEvent *event)
     if (event && static_cast<ControlMsg::Type>(event->type()) == ControlMsg::Control) {
         ControlMsg *controlMsg = dynamic_cast<ControlMsg *>(event);
         if (controlMsg) {
-            sendControl(controlMsg->serializeData());
+            sendControlMsg(*controlMsg);
         }
         return true;
     }
     return QObject::event(event);
 }
 
-bool Controller::sendControl(const QByteArray &buffer)
+bool Controller::sendControl(const QByteArray &buffer, const QVector<qint64> &stampsNs)
 {
     if (buffer.isEmpty()) {
         return false;
     }
     qint32 len = 0;
-    if (m_sendData) {
+    if (m_sendStamped) {
+        len = static_cast<qint32>(m_sendStamped(buffer, stampsNs));
+    } else if (m_sendData) {
         len = static_cast<qint32>(m_sendData(buffer));
     }
     return len == buffer.length() ? true : false;
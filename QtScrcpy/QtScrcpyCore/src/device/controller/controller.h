@@ -4,11 +4,17 @@
 
 #include <QObject>
 #include <QPointer>
+#include <QTimer>
+#include <QVector>
 
 #include "inputconvertbase.h"
+#include "inputscheduler.h"
+#include "macro.h"
 
 class QTcpSocket;
 class Receiver;
+class TextInjector;
+class ClipboardSync;
 class InputConvertBase;
 class DeviceMsg;
 class Controller : public QObject
@@ -18,12 +24,46 @@ public:
     Controller(std::function<qint64(const QByteArray&)> sendData, QString gameScript = "", QObject *parent = Q_NULLPTR);
     virtual ~Controller();
 
+    // takes ownership, may be called from any thread
     void postControlMsg(ControlMsg *controlMsg);
+    // controller thread only, serialized into the send buffer right away
+    // touch moves (latest per pointer) and scrolls (summed) are held back for the coalesce interval
+    void sendControlMsg(const ControlMsg &controlMsg);
+    // 0: coalesce within one event loop iteration only
+    void setCoalesceInterval(int ms);
+    // input events dropped or merged by coalescing
+    quint64 mergedEventCount();
+    // input animations run on the input scheduler thread, after what was sent so far
+    // the timing error is accounted to owner, the controller by default
+    quint64 submitInputPlan(const QVector<InputScheduler::Step> &steps, InputScheduler::Finished finished = Q_NULLPTR, const void *owner = Q_NULLPTR,
+                            int loops = 1, qint64 loopPeriodNs = 0, qint64 startNs = 0);
+    // returns the number of steps sent, -1 if the plan is finished
+    int cancelInputPlan(quint64 planId);
+    void takeInputPlanTimingError(quint64 &count, qint64 &sumNs, qint64 &maxNs);
     void recvDeviceMsg(DeviceMsg *deviceMsg);
     void test(QRect rc);
 
     void updateScript(QString gameScript = "");
     bool isCurrentCustomKeymap();
+    // inject keyboard and/or mouse through UHID devices, a game script takes precedence
+    void setUhidMode(bool keyboard, bool mouse);
+    // the server was restarted
+    void resetInput();
+    // the current video frame size, macros are replayed at it
+    void setFrameSize(const QSize &frameSize);
+
+    // record what is sent to the device until stopMacroRecord()
+    void startMacroRecord();
+    bool stopMacroRecord(const QString &fileName);
+    // replays on the input scheduler thread, 0 loops: until stopMacro()
+    // the loops follow each other on the scheduler timeline, planned once at the current frame size
+    bool playMacro(const QString &fileName, int loops = 1);
+    // steps planned by Macro::plan() for this frame size, startNs: see InputScheduler::submit()
+    bool playMacroSteps(const QVector<InputScheduler::Step> &steps, int loops = 1, qint64 startNs = 0);
+    // lifts the touches and keys the macro left down
+    void stopMacro();
+    bool isMacroPlaying();
+    void takeMacroTimingError(quint64 &count, qint64 &sumNs, qint64 &maxNs);
 
     void postGoBack();
     void postGoHome();
@@ -37,11 +77,15 @@ public:
     void expandNotificationPanel();
     void collapsePanel();
     void setDisplayPower(bool on);
+    void resetVideo();
 
     // for input convert
     void mouseEvent(const QMouseEvent *from, const QSize &frameSize, const QSize &showSize);
     void wheelEvent(const QWheelEvent *from, const QSize &frameSize, const QSize &showSize);
     void keyEvent(const QKeyEvent *from, const QSize &frameSize, const QSize &showSize);
+    // unaccelerated relative deltas from a raw mouse source, replace the cursor moves while enabled
+    void setRawMouseMotion(bool enabled);
+    void rawMouseMotion(const QPointF &delta);
 
     // turn the screen on if it was off, press BACK otherwise
     // If the screen is off, it is turned on only on down
@@ -50,22 +94,97 @@ public:
     void getDeviceClipboard(bool cut = false);
     void setDeviceClipboard(bool pause = true);
     void clipboardPaste();
+    // long text is streamed in chunks, see TextInjector
     void postTextInput(QString &text);
+    // bytes written to the control socket but not read by the device yet
+    void setSendBacklogQuery(std::function<qint64()> backlog);
+    // hands the send buffer to the control socket with the time each of its messages was produced,
+    // the latency is measured from there to the socket write
+    void setSendStampedData(std::function<qint64(const QByteArray&, const QVector<qint64>& stampsNs)> sendStamped);
+    // hands a shared buffer to the control socket without copying it, held until the release time if any
+    void setSendSharedData(std::function<qint64(const QByteArray&, qint64 releaseNs, qint64 stampNs)> sendShared);
+    // messages serialized once for a group of devices, sent after what is buffered
+    // with a release time (ControlChannel::nowNs() base) they leave together with the group
+    void sendSerialized(const QByteArray &serialized, qint64 releaseNs = 0);
+    // the plain input conversion, no custom keymap or UHID devices
+    bool isNormalInput();
+    // send computer clipboard changes to the device automatically
+    void setClipboardAutoSync(bool enable);
 
 signals:
     void grabCursor(bool grab);
+    void textInjectFinished(int chars, qint64 elapsedMs, double charsPerSecond, bool viaClipboard);
+    // the last loop ended or the macro was stopped
+    void macroFinished();
 
 protected:
     bool event(QEvent *event);
 
+private slots:
+    void flushControl();
+
 private:
-    bool sendControl(const QByteArray &buffer);
+    void appendControlMsg(const ControlMsg &controlMsg);
+    bool writeControlMsg(const ControlMsg &controlMsg);
+    void coalesceTouchMove(const ControlMsg &controlMsg);
+    void coalesceScroll(const ControlMsg &controlMsg);
+    // moves the held back messages into the send buffer, returns false if there were none
+    bool commitCoalesced();
+    void scheduleFlush();
+    bool sendControl(const QByteArray &buffer, const QVector<qint64> &stampsNs = QVector<qint64>());
+    void recordControlMsg(const ControlMsg &controlMsg);
+    void onMacroFinished(quint64 planId);
     void postKeyCodeClick(AndroidKeycode keycode);
 
 private:
     QPointer<Receiver> m_receiver;
     QPointer<InputConvertBase> m_inputConvert;
+    QPointer<TextInjector> m_textInjector;
+    QPointer<ClipboardSync> m_clipboardSync;
     std::function<qint64(const QByteArray&)> m_sendData = Q_NULLPTR;
+    std::function<qint64(const QByteArray&, const QVector<qint64>&)> m_sendStamped = Q_NULLPTR;
+    std::function<qint64(const QByteArray&, qint64, qint64)> m_sendShared = Q_NULLPTR;
+    // messages of one event loop iteration, written to the socket at once
+    QByteArray m_sendBuffer;
+    bool m_flushPending = false;
+    QString m_gameScript;
+    QSize m_frameSize;
+
+    // macros
+    bool m_macroRecording = false;
+    Macro m_recordMacro;
+    // the owner of the replay plans on the input scheduler, replays are planned from a loaded copy
+    Macro m_playMacro;
+    QVector<InputScheduler::Step> m_macroSteps;
+    quint64 m_macroPlanId = 0;
+    bool m_uhidKeyboard = false;
+    bool m_uhidMouse = false;
+    bool m_rawMouseMotion = false;
+
+    // when each message in the send buffer was produced
+    QVector<qint64> m_sendStamps;
+
+    // coalescing
+    struct PendingMove
+    {
+        quint64 id;
+        // the oldest move merged into this one
+        qint64 stampNs;
+        uchar data[CONTROL_MSG_INJECT_TOUCH_SIZE];
+    };
+    QVector<PendingMove> m_pendingMoves;
+    struct
+    {
+        bool pending = false;
+        qint64 stampNs = 0;
+        QRect position;
+        float hScroll = 0.0f;
+        float vScroll = 0.0f;
+        AndroidMotioneventButtons buttons = static_cast<AndroidMotioneventButtons>(0);
+    } m_pendingScroll;
+    int m_coalesceInterval = 0;
+    QTimer m_coalesceTimer;
+    quint64 m_mergedEvents = 0;
 };
 
 #endif // CONTROLLER_H
@@ -10,16 +10,32 @@
 ControlMsg::ControlMsg(ControlMsgType controlMsgType) : QScrcpyEvent(Control)
 {
     m_data.type = controlMsgType;
+    // a text message may be sent without its text, it owns no buffer until one is set
+    if (CMT_INJECT_TEXT == controlMsgType) {
+        m_data.injectText.text = Q_NULLPTR;
+    } else if (CMT_SET_CLIPBOARD == controlMsgType) {
+        m_data.setClipboard.text = Q_NULLPTR;
+    } else if (CMT_UHID_CREATE == controlMsgType) {
+        m_data.uhidCreate.name = Q_NULLPTR;
+        m_data.uhidCreate.reportDesc = Q_NULLPTR;
+        m_data.uhidCreate.nameSize = 0;
+        m_data.uhidCreate.reportDescSize = 0;
+    }
 }
 
 ControlMsg::~ControlMsg()
 {
     if (CMT_SET_CLIPBOARD == m_data.type && Q_NULLPTR != m_data.setClipboard.text) {
-        delete m_data.setClipboard.text;
+        delete[] m_data.setClipboard.text;
         m_data.setClipboard.text = Q_NULLPTR;
     } else if (CMT_INJECT_TEXT == m_data.type && Q_NULLPTR != m_data.injectText.text) {
-        delete m_data.injectText.text;
+        delete[] m_data.injectText.text;
         m_data.injectText.text = Q_NULLPTR;
+    } else if (CMT_UHID_CREATE == m_data.type) {
+        delete[] m_data.uhidCreate.name;
+        delete[] m_data.uhidCreate.reportDesc;
+        m_data.uhidCreate.name = Q_NULLPTR;
+        m_data.uhidCreate.reportDesc = Q_NULLPTR;
     }
 }
 
@@ -44,6 +60,14 @@ void ControlMsg::setInjectTextMsgData(QString &text)
     m_data.injectText.text[tmp.length()] = '\0';
 }
 
+void ControlMsg::setInjectTextMsgData(const char *text, int len)
+{
+    len = qMin(len, CONTROL_MSG_INJECT_TEXT_MAX_LENGTH);
+    m_data.injectText.text = new char[len + 1];
+    memcpy(m_data.injectText.text, text, len);
+    m_data.injectText.text[len] = '\0';
+}
+
 void ControlMsg::setInjectTouchMsgData(
     quint64 id,
     AndroidMotioneventAction action,
@@ -68,13 +92,23 @@ void ControlMsg::setInjectScrollMsgData(QRect position, float hScroll, float vSc
     m_data.injectScroll.buttons = buttons;
 }
 
+void ControlMsg::getInjectScrollMsgData(QRect &position, float &hScroll, float &vScroll, AndroidMotioneventButtons &buttons) const
+{
+    position = m_data.injectScroll.position;
+    hScroll = m_data.injectScroll.hScroll;
+    vScroll = m_data.injectScroll.vScroll;
+    buttons = m_data.injectScroll.buttons;
+}
+
 void ControlMsg::setGetClipboardMsgData(ControlMsg::GetClipboardCopyKey copyKey) 
 {
     m_data.getClipboard.copyKey = copyKey;
 }
 
-void ControlMsg::setSetClipboardMsgData(QString &text, bool paste)
+void ControlMsg::setSetClipboardMsgData(QString &text, bool paste, quint64 sequence)
 {
+    m_data.setClipboard.paste = paste;
+    m_data.setClipboard.sequence = sequence;
     if (text.isEmpty()) {
         m_data.setClipboard.text = Q_NULLPTR;
         return;
@@ -87,8 +121,6 @@ void ControlMsg::setSetClipboardMsgData(QString &text, bool paste)
     m_data.setClipboard.text = new char[tmp.length() + 1];
     memcpy(m_data.setClipboard.text, tmp.data(), tmp.length());
     m_data.setClipboard.text[tmp.length()] = '\0';
-    m_data.setClipboard.paste = paste;
-    m_data.setClipboard.sequence = 0;
 }
 
 void ControlMsg::setDisplayPowerData(bool on)
@@ -101,12 +133,43 @@ void ControlMsg::setBackOrScreenOnData(bool down)
     m_data.backOrScreenOn.action = down ? AKEY_EVENT_ACTION_DOWN : AKEY_EVENT_ACTION_UP;
 }
 
-void ControlMsg::writePosition(QBuffer &buffer, const QRect &value)
+void ControlMsg::setUhidCreateMsgData(quint16 id, quint16 vendorId, quint16 productId, const QByteArray &name, const QByteArray &reportDesc)
+{
+    m_data.uhidCreate.id = id;
+    m_data.uhidCreate.vendorId = vendorId;
+    m_data.uhidCreate.productId = productId;
+
+    // the name length is a single byte
+    int nameSize = qMin(static_cast<int>(name.size()), 127);
+    m_data.uhidCreate.name = new char[nameSize + 1];
+    memcpy(m_data.uhidCreate.name, name.constData(), nameSize);
+    m_data.uhidCreate.name[nameSize] = '\0';
+    m_data.uhidCreate.nameSize = nameSize;
+
+    m_data.uhidCreate.reportDescSize = reportDesc.size();
+    m_data.uhidCreate.reportDesc = new uchar[reportDesc.size()];
+    memcpy(m_data.uhidCreate.reportDesc, reportDesc.constData(), reportDesc.size());
+}
+
+void ControlMsg::setUhidInputMsgData(quint16 id, const uchar *data, quint16 size)
+{
+    Q_ASSERT(size <= CONTROL_MSG_UHID_REPORT_MAX_SIZE);
+    m_data.uhidInput.id = id;
+    m_data.uhidInput.size = qMin<quint16>(size, CONTROL_MSG_UHID_REPORT_MAX_SIZE);
+    memcpy(m_data.uhidInput.data, data, m_data.uhidInput.size);
+}
+
+void ControlMsg::setUhidDestroyMsgData(quint16 id)
+{
+    m_data.uhidDestroy.id = id;
+}
+
+void ControlMsg::writePosition(uchar *buf, const QRect &value)
 {
-    BufferUtil::write32(buffer, value.left());
-    BufferUtil::write32(buffer, value.top());
-    BufferUtil::write16(buffer, value.width());
-    BufferUtil::write16(buffer, value.height());
+    BufferUtil::write32(buf, value.left());
+    BufferUtil::write32(buf + 4, value.top());
+    BufferUtil::write16(buf + 8, value.width());
+    BufferUtil::write16(buf + 10, value.height());
 }
 
 quint16 ControlMsg::flostToU16fp(float f)
@@ -133,74 +196,130 @@ qint16 ControlMsg::flostToI16fp(float f)
 
 QByteArray ControlMsg::serializeData()
 {
-    QByteArray byteArray;
-    QBuffer buffer(&byteArray);
-    buffer.open(QBuffer::WriteOnly);
-    buffer.putChar(m_data.type);
+    QByteArray byteArray(serializedSize(), Qt::Uninitialized);
+    int len = serializeTo(reinterpret_cast<uchar *>(byteArray.data()), byteArray.size());
+    if (len < 0) {
+        return QByteArray();
+    }
+    byteArray.resize(len);
+    return byteArray;
+}
+
+int ControlMsg::serializedSize() const
+{
+    switch (m_data.type) {
+    case CMT_INJECT_KEYCODE:
+        return CONTROL_MSG_INJECT_KEYCODE_SIZE;
+    case CMT_INJECT_TEXT:
+        return 5 + (m_data.injectText.text ? static_cast<int>(strlen(m_data.injectText.text)) : 0);
+    case CMT_INJECT_TOUCH:
+        return CONTROL_MSG_INJECT_TOUCH_SIZE;
+    case CMT_INJECT_SCROLL:
+        return CONTROL_MSG_INJECT_SCROLL_SIZE;
+    case CMT_SET_CLIPBOARD:
+        return 14 + (m_data.setClipboard.text ? static_cast<int>(strlen(m_data.setClipboard.text)) : 0);
+    case CMT_BACK_OR_SCREEN_ON:
+    case CMT_GET_CLIPBOARD:
+    case CMT_SET_DISPLAY_POWER:
+        return 2;
+    case CMT_UHID_CREATE:
+        // type, id, vendor id, product id, name length, name, report desc size, report desc
+        return 10 + m_data.uhidCreate.nameSize + m_data.uhidCreate.reportDescSize;
+    case CMT_UHID_INPUT:
+        return CONTROL_MSG_UHID_INPUT_HEADER_SIZE + m_data.uhidInput.size;
+    case CMT_UHID_DESTROY:
+        return 3;
+    default:
+        return 1;
+    }
+}
+
+int ControlMsg::serializeTo(uchar *buf, int size) const
+{
+    int len = serializedSize();
+    if (!buf || size < len) {
+        return -1;
+    }
+    buf[0] = m_data.type;
 
     switch (m_data.type) {
     case CMT_INJECT_KEYCODE:
-        buffer.putChar(m_data.injectKeycode.action);
-        BufferUtil::write32(buffer, m_data.injectKeycode.keycode);
-        BufferUtil::write32(buffer, m_data.injectKeycode.repeat);
-        BufferUtil::write32(buffer, m_data.injectKeycode.metastate);
+        buf[1] = m_data.injectKeycode.action;
+        BufferUtil::write32(buf + 2, m_data.injectKeycode.keycode);
+        BufferUtil::write32(buf + 6, m_data.injectKeycode.repeat);
+        BufferUtil::write32(buf + 10, m_data.injectKeycode.metastate);
         break;
     case CMT_INJECT_TEXT:
-        BufferUtil::write32(buffer, static_cast<quint32>(strlen(m_data.injectText.text)));
-        buffer.write(m_data.injectText.text, strlen(m_data.injectText.text));
+        BufferUtil::write32(buf + 1, static_cast<quint32>(len - 5));
+        if (len > 5) {
+            memcpy(buf + 5, m_data.injectText.text, len - 5);
+        }
+        break;
+    case CMT_INJECT_TOUCH:
+        buf[1] = m_data.injectTouch.action;
+        BufferUtil::write64(buf + 2, m_data.injectTouch.id);
+        writePosition(buf + 10, m_data.injectTouch.position);
+        BufferUtil::write16(buf + 22, flostToU16fp(m_data.injectTouch.pressure));
+        BufferUtil::write32(buf + 24, m_data.injectTouch.actionButtons);
+        BufferUtil::write32(buf + 28, m_data.injectTouch.buttons);
         break;
-    case CMT_INJECT_TOUCH: {
-        buffer.putChar(m_data.injectTouch.action);
-        BufferUtil::write64(buffer, m_data.injectTouch.id);
-        writePosition(buffer, m_data.injectTouch.position);
-        quint16 pressure = flostToU16fp(m_data.injectTouch.pressure);
-        BufferUtil::write16(buffer, pressure);
-        BufferUtil::write32(buffer, m_data.injectTouch.actionButtons);
-        BufferUtil::write32(buffer, m_data.injectTouch.buttons);
-    } break;
     case CMT_INJECT_SCROLL: {
-        writePosition(buffer, m_data.injectScroll.position);
+        writePosition(buf + 1, m_data.injectScroll.position);
         // Accept values in the range [-16, 16].
         // Normalize to [-1, 1] in order to use sc_float_to_i16fp().
         float hscrollNorm = m_data.injectScroll.hScroll / 16;
         hscrollNorm = CLAMP(hscrollNorm, -1, 1);
         float vscrollNorm = m_data.injectScroll.vScroll / 16;
         vscrollNorm = CLAMP(vscrollNorm, -1, 1);
-        qint16 hScroll = flostToI16fp(hscrollNorm);
-        qint16 vScroll = flostToI16fp(vscrollNorm);
-        BufferUtil::write16(buffer, (quint16)hScroll);
-        BufferUtil::write16(buffer, (quint16)vScroll);
-        BufferUtil::write32(buffer, m_data.injectScroll.buttons);
+        BufferUtil::write16(buf + 13, (quint16)flostToI16fp(hscrollNorm));
+        BufferUtil::write16(buf + 15, (quint16)flostToI16fp(vscrollNorm));
+        BufferUtil::write32(buf + 17, m_data.injectScroll.buttons);
     } break;
     case CMT_BACK_OR_SCREEN_ON:
-        buffer.putChar(m_data.backOrScreenOn.action);
+        buf[1] = m_data.backOrScreenOn.action;
         break;
     case CMT_GET_CLIPBOARD:
-        buffer.putChar(m_data.getClipboard.copyKey);
+        buf[1] = m_data.getClipboard.copyKey;
         break;
     case CMT_SET_CLIPBOARD:
-        BufferUtil::write64(buffer, m_data.setClipboard.sequence);
-        buffer.putChar(!!m_data.setClipboard.paste);
-        if (m_data.setClipboard.text != Q_NULLPTR) {
-            BufferUtil::write32(buffer, static_cast<quint32>(strlen(m_data.setClipboard.text)));
-            buffer.write(m_data.setClipboard.text, strlen(m_data.setClipboard.text));
-        } else {
-            BufferUtil::write32(buffer, 0);
-            buffer.write(m_data.setClipboard.text, 0);
+        BufferUtil::write64(buf + 1, m_data.setClipboard.sequence);
+        buf[9] = !!m_data.setClipboard.paste;
+        BufferUtil::write32(buf + 10, static_cast<quint32>(len - 14));
+        if (len > 14) {
+            memcpy(buf + 14, m_data.setClipboard.text, len - 14);
         }
         break;
     case CMT_SET_DISPLAY_POWER:
-        buffer.putChar(m_data.setDisplayPower.on);
+        buf[1] = m_data.setDisplayPower.on;
+        break;
+    case CMT_UHID_CREATE: {
+        BufferUtil::write16(buf + 1, m_data.uhidCreate.id);
+        BufferUtil::write16(buf + 3, m_data.uhidCreate.vendorId);
+        BufferUtil::write16(buf + 5, m_data.uhidCreate.productId);
+        buf[7] = m_data.uhidCreate.nameSize;
+        memcpy(buf + 8, m_data.uhidCreate.name, m_data.uhidCreate.nameSize);
+        int index = 8 + m_data.uhidCreate.nameSize;
+        BufferUtil::write16(buf + index, m_data.uhidCreate.reportDescSize);
+        memcpy(buf + index + 2, m_data.uhidCreate.reportDesc, m_data.uhidCreate.reportDescSize);
+    } break;
+    case CMT_UHID_INPUT:
+        BufferUtil::write16(buf + 1, m_data.uhidInput.id);
+        BufferUtil::write16(buf + 3, m_data.uhidInput.size);
+        memcpy(buf + 5, m_data.uhidInput.data, m_data.uhidInput.size);
+        break;
+    case CMT_UHID_DESTROY:
+        BufferUtil::write16(buf + 1, m_data.uhidDestroy.id);
         break;
     case CMT_EXPAND_NOTIFICATION_PANEL:
     case CMT_EXPAND_SETTINGS_PANEL:
     case CMT_COLLAPSE_PANELS:
     case CMT_ROTATE_DEVICE:
+    case CMT_OPEN_HARD_KEYBOARD_SETTINGS:
+    case CMT_RESET_VIDEO:
         break;
     default:
         qDebug() << "Unknown event type:" << m_data.type;
-        break;
+        return -1;
     }
-    buffer.close();
-    return byteArray;
+    return len;
 }
@@ -16,6 +16,16 @@
 #define CONTROL_MSG_CLIPBOARD_TEXT_MAX_LENGTH \
     (CONTROL_MSG_MAX_SIZE - 14)
 
+// serialized sizes of the fixed layout messages, type byte included
+#define CONTROL_MSG_INJECT_KEYCODE_SIZE 14
+#define CONTROL_MSG_INJECT_TOUCH_SIZE 32
+#define CONTROL_MSG_INJECT_SCROLL_SIZE 21
+// type: 1 byte; id: 2 bytes; size: 2 bytes; report
+#define CONTROL_MSG_UHID_INPUT_HEADER_SIZE 5
+#define CONTROL_MSG_UHID_REPORT_MAX_SIZE 15
+// the largest fixed layout message, enough for a stack buffer
+#define CONTROL_MSG_FIXED_MAX_SIZE CONTROL_MSG_INJECT_TOUCH_SIZE
+
 #define POINTER_ID_MOUSE static_cast<quint64>(-1)
 #define POINTER_ID_GENERIC_FINGER static_cast<quint64>(-2)
 
@@ -41,7 +51,14 @@ public:
         CMT_GET_CLIPBOARD,
         CMT_SET_CLIPBOARD,
         CMT_SET_DISPLAY_POWER,
-        CMT_ROTATE_DEVICE
+        CMT_ROTATE_DEVICE,
+        CMT_UHID_CREATE,
+        CMT_UHID_INPUT,
+        CMT_UHID_DESTROY,
+        CMT_OPEN_HARD_KEYBOARD_SETTINGS,
+        CMT_START_APP,
+        // ask the encoder for a new IDR frame (and resend the config packet)
+        CMT_RESET_VIDEO
     };
 
     enum GetClipboardCopyKey {
@@ -55,6 +72,8 @@ public:
 
     void setInjectKeycodeMsgData(AndroidKeyeventAction action, AndroidKeycode keycode, quint32 repeat, AndroidMetastate metastate);
     void setInjectTextMsgData(QString &text);
+    // utf-8, at most CONTROL_MSG_INJECT_TEXT_MAX_LENGTH bytes are kept
+    void setInjectTextMsgData(const char *text, int len);
     // id 代表一个触摸点，最多支持10个触摸点[0,9]
     // action 只能是AMOTION_EVENT_ACTION_DOWN，AMOTION_EVENT_ACTION_UP，AMOTION_EVENT_ACTION_MOVE
     // position action动作对应的位置
@@ -67,16 +86,42 @@ public:
         float pressure);
     void setInjectScrollMsgData(QRect position, float hScroll, float vScroll, AndroidMotioneventButtons buttons);
     void setGetClipboardMsgData(ControlMsg::GetClipboardCopyKey copyKey); 
-    void setSetClipboardMsgData(QString &text, bool paste);
+    // sequence: acked by the device with DMT_ACK_CLIPBOARD, 0 for no ack
+    void setSetClipboardMsgData(QString &text, bool paste, quint64 sequence = 0);
     void setDisplayPowerData(bool on);
     void setBackOrScreenOnData(bool down);
+    // the device creates a virtual hid device described by reportDesc
+    void setUhidCreateMsgData(quint16 id, quint16 vendorId, quint16 productId, const QByteArray &name, const QByteArray &reportDesc);
+    // at most CONTROL_MSG_UHID_REPORT_MAX_SIZE bytes
+    void setUhidInputMsgData(quint16 id, const uchar *data, quint16 size);
+    void setUhidDestroyMsgData(quint16 id);
+
+    ControlMsgType type() const
+    {
+        return m_data.type;
+    }
+    // valid for CMT_INJECT_TOUCH
+    quint64 touchId() const
+    {
+        return m_data.injectTouch.id;
+    }
+    AndroidMotioneventAction touchAction() const
+    {
+        return m_data.injectTouch.action;
+    }
+    // valid for CMT_INJECT_SCROLL
+    void getInjectScrollMsgData(QRect &position, float &hScroll, float &vScroll, AndroidMotioneventButtons &buttons) const;
 
     QByteArray serializeData();
+    // bytes needed by serializeTo()
+    int serializedSize() const;
+    // writes the message into buf, returns the written size or -1 if size is too small
+    int serializeTo(uchar *buf, int size) const;
 
 private:
-    void writePosition(QBuffer &buffer, const QRect &value);
-    quint16 flostToU16fp(float f);
-    qint16 flostToI16fp(float f);
+    static void writePosition(uchar *buf, const QRect &value);
+    static quint16 flostToU16fp(float f);
+    static qint16 flostToI16fp(float f);
 
 private:
     struct ControlMsgData
@@ -130,6 +175,26 @@ private:
             {
                 bool on;
             } setDisplayPower;
+            struct
+            {
+                quint16 id;
+                quint16 vendorId;
+                quint16 productId;
+                char *name;
+                quint8 nameSize;
+                uchar *reportDesc;
+                quint16 reportDescSize;
+            } uhidCreate;
+            struct
+            {
+                quint16 id;
+                quint16 size;
+                uchar data[CONTROL_MSG_UHID_REPORT_MAX_SIZE];
+            } uhidInput;
+            struct
+            {
+                quint16 id;
+            } uhidDestroy;
         };
 
         ControlMsgData() {}
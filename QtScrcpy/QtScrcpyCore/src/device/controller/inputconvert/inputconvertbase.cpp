@@ -14,3 +14,10 @@ void InputConvertBase::sendControlMsg(ControlMsg *msg)
         m_controller->postControlMsg(msg);
     }
 }
+
+void InputConvertBase::sendControlMsg(const ControlMsg &msg)
+{
+    if (m_controller) {
+        m_controller->sendControlMsg(msg);
+    }
+}
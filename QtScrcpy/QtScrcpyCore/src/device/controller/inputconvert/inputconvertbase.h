@@ -25,12 +25,19 @@ public:
     {
         return false;
     }
+    // the server was restarted, forget the state held on the device
+    virtual void reset() {}
+    // relative mouse deltas come from a raw input source instead of the cursor position
+    virtual void setRawMouseMotion(bool enabled) { Q_UNUSED(enabled) }
+    virtual void rawMouseMotion(const QPointF &delta) { Q_UNUSED(delta) }
 
 signals:
     void grabCursor(bool grab);
 
 protected:
     void sendControlMsg(ControlMsg *msg);
+    // for stack messages on the input path, nothing is allocated
+    void sendControlMsg(const ControlMsg &msg);
 
     QPointer<Controller> m_controller;
     // Qt reports repeated events as a boolean, but Android expects the actual
@@ -5,17 +5,23 @@
 #include <QTime>
 #include <QRandomGenerator>
 
+#include "controller.h"
 #include "inputconvertgame.h"
 
 #define CURSOR_POS_CHECK 50
+#define NS_PER_MS 1000000
 
-InputConvertGame::InputConvertGame(Controller *controller) : InputConvertNormal(controller) {
-    m_ctrlSteerWheel.delayData.timer = new QTimer(this);
-    m_ctrlSteerWheel.delayData.timer->setSingleShot(true);
-    connect(m_ctrlSteerWheel.delayData.timer, &QTimer::timeout, this, &InputConvertGame::onSteerWheelTimer);
-}
+InputConvertGame::InputConvertGame(Controller *controller) : InputConvertNormal(controller) {}
 
-InputConvertGame::~InputConvertGame() {}
+InputConvertGame::~InputConvertGame()
+{
+    // nothing may call back into a deleted converter
+    cancelPlan(m_ctrlSteerWheel.delayData.planId);
+    cancelPlan(m_dragDelayData.planId);
+    for (auto it = m_clickPlans.constBegin(); it != m_clickPlans.constEnd(); ++it) {
+        cancelPlan(it.key());
+    }
+}
 
 void InputConvertGame::mouseEvent(const QMouseEvent *from, const QSize &frameSize, const QSize &showSize)
 {
@@ -142,7 +148,58 @@ bool InputConvertGame::isCurrentCustomKeymap()
 
 void InputConvertGame::loadKeyMap(const QString &json)
 {
-    m_keyMap.loadKeyMap(json);
+    // the cursor state depends on the keymap it was set up with
+    bool mouseMoveMap = m_keyMap.isValidMouseMoveMap();
+    bool gameMap = m_gameMap;
+    if (!m_keyMap.loadKeyMap(json)) {
+        return;
+    }
+
+    // touches held under the old keymap would never see their release
+    resetGameState();
+    if (gameMap && mouseMoveMap) {
+#ifdef QT_NO_DEBUG
+        emit grabCursor(false);
+#endif
+        hideMouseCursor(false);
+    }
+}
+
+void InputConvertGame::resetGameState()
+{
+    cancelPlan(m_ctrlSteerWheel.delayData.planId);
+    cancelPlan(m_dragDelayData.planId);
+    for (auto it = m_clickPlans.constBegin(); it != m_clickPlans.constEnd(); ++it) {
+        cancelPlan(it.key());
+    }
+    m_clickPlans.clear();
+    stopMouseMoveTimer();
+
+    for (int i = 0; i < MULTI_TOUCH_MAX_NUM; i++) {
+        if (0 != m_multiTouchID[i]) {
+            sendTouchUpEvent(i, m_multiTouchPos[i]);
+            m_multiTouchID[i] = 0;
+        }
+    }
+
+    m_ctrlSteerWheel.touchKey = Qt::Key_unknown;
+    m_ctrlSteerWheel.pressedUp = false;
+    m_ctrlSteerWheel.pressedDown = false;
+    m_ctrlSteerWheel.pressedLeft = false;
+    m_ctrlSteerWheel.pressedRight = false;
+    m_ctrlSteerWheel.delayData.planId = 0;
+    m_ctrlSteerWheel.delayData.planPos.clear();
+    m_ctrlSteerWheel.delayData.pressedNum = 0;
+    m_dragDelayData.planId = 0;
+    m_dragDelayData.planPos.clear();
+    m_dragDelayData.currentPos = QPointF();
+    m_dragDelayData.pressKey = 0;
+    m_ctrlMouseMove.touching = false;
+    m_ctrlMouseMove.smallEyes = false;
+    m_processMouseMove = true;
+
+    m_gameMap = false;
+    m_needBackMouseMove = false;
 }
 
 void InputConvertGame::updateSize(const QSize &frameSize, const QSize &showSize)
@@ -181,20 +238,16 @@ void InputConvertGame::sendTouchEvent(int id, QPointF pos, AndroidMotioneventAct
         return;
     }
     //qDebug() << "id:" << id << " pos:" << pos << " action" << action;
-    ControlMsg *controlMsg = new ControlMsg(ControlMsg::CMT_INJECT_TOUCH);
-    if (!controlMsg) {
-        return;
-    }
-
+    m_multiTouchPos[id] = pos;
     QPoint absolutePos = calcFrameAbsolutePos(pos).toPoint();
     static QPoint lastAbsolutePos = absolutePos;
     if (AMOTION_EVENT_ACTION_MOVE == action && lastAbsolutePos == absolutePos) {
-        delete controlMsg;
         return;
     }
     lastAbsolutePos = absolutePos;
 
-    controlMsg->setInjectTouchMsgData(
+    ControlMsg controlMsg(ControlMsg::CMT_INJECT_TOUCH);
+    controlMsg.setInjectTouchMsgData(
         static_cast<quint64>(id),
         action,
         static_cast<AndroidMotioneventButtons>(0),
@@ -205,12 +258,8 @@ void InputConvertGame::sendTouchEvent(int id, QPointF pos, AndroidMotioneventAct
 }
 
 void InputConvertGame::sendKeyEvent(AndroidKeyeventAction action, AndroidKeycode keyCode) {
-    ControlMsg *controlMsg = new ControlMsg(ControlMsg::CMT_INJECT_KEYCODE);
-    if (!controlMsg) {
-        return;
-    }
-
-    controlMsg->setInjectKeycodeMsgData(action, keyCode, 0, AMETA_NONE);
+    ControlMsg controlMsg(ControlMsg::CMT_INJECT_KEYCODE);
+    controlMsg.setInjectKeycodeMsgData(action, keyCode, 0, AMETA_NONE);
     sendControlMsg(controlMsg);
 }
 
@@ -263,10 +312,33 @@ int InputConvertGame::getTouchID(int key)
 
 // -------- steer wheel event --------
 
-void InputConvertGame::getDelayQueue(const QPointF& start, const QPointF& end,
+void InputConvertGame::planTouchEvent(QVector<InputScheduler::Step> &steps, qint64 offsetNs, int id, QPointF pos, AndroidMotioneventAction action)
+{
+    if (0 > id || MULTI_TOUCH_MAX_NUM - 1 < id) {
+        Q_ASSERT(0);
+        return;
+    }
+    ControlMsg controlMsg(ControlMsg::CMT_INJECT_TOUCH);
+    controlMsg.setInjectTouchMsgData(
+        static_cast<quint64>(id),
+        action,
+        static_cast<AndroidMotioneventButtons>(0),
+        static_cast<AndroidMotioneventButtons>(0),
+        QRect(calcFrameAbsolutePos(pos).toPoint(), m_frameSize),
+        AMOTION_EVENT_ACTION_DOWN == action ? 1.0f : 0.0f);
+
+    InputScheduler::Step step;
+    step.offsetNs = offsetNs;
+    step.size = controlMsg.serializeTo(step.data, CONTROL_MSG_FIXED_MAX_SIZE);
+    if (0 < step.size) {
+        steps.append(step);
+    }
+}
+
+void InputConvertGame::planDelayPath(const QPointF& start, const QPointF& end,
                                      const double& distanceStep, const double& posStepconst,
-                                     quint32 lowestTimer, quint32 highestTimer,
-                                     QQueue<QPointF>& queuePos, QQueue<quint32>& queueTimer) {
+                                     quint32 lowestTimer, quint32 highestTimer, int id, qint64 &offsetNs,
+                                     QVector<InputScheduler::Step> &steps, QVector<QPointF> &positions) {
     double x1 = start.x();
     double y1 = start.y();
     double x2 = end.x();
@@ -279,37 +351,80 @@ void InputConvertGame::getDelayQueue(const QPointF& start, const QPointF& end,
     dx/=e;
     dy/=e;
 
-    QQueue<QPointF> queue;
-    QQueue<quint32> queue2;
+    steps.reserve(steps.size() + static_cast<int>(e) + 1);
+    positions.reserve(positions.size() + static_cast<int>(e));
     for(int i=1;i<=e;i++) {
+        if (i > 1) {
+            offsetNs += static_cast<qint64>(QRandomGenerator::global()->bounded(lowestTimer, highestTimer)) * NS_PER_MS;
+        }
         QPointF pos(x1+(QRandomGenerator::global()->bounded(posStepconst*2)-posStepconst), y1+(QRandomGenerator::global()->bounded(posStepconst*2)-posStepconst));
-        queue.enqueue(pos);
-        queue2.enqueue(QRandomGenerator::global()->bounded(lowestTimer, highestTimer));
+        planTouchEvent(steps, offsetNs, id, pos, AMOTION_EVENT_ACTION_MOVE);
+        positions.append(pos);
         x1+=dx;
         y1+=dy;
     }
+}
 
-    queuePos = queue;
-    queueTimer = queue2;
+quint64 InputConvertGame::submitPlan(const QVector<InputScheduler::Step> &steps)
+{
+    if (!m_controller || steps.isEmpty()) {
+        return 0;
+    }
+    return m_controller->submitInputPlan(steps, [this](quint64 planId) {
+        // called on the scheduler thread, the converter is only touched from its own
+        QMetaObject::invokeMethod(this, [this, planId]() { onPlanFinished(planId); }, Qt::QueuedConnection);
+    });
 }
 
-void InputConvertGame::onSteerWheelTimer() {
-    if(m_ctrlSteerWheel.delayData.queuePos.empty()) {
-        return;
+int InputConvertGame::cancelPlan(quint64 planId)
+{
+    if (!m_controller || 0 == planId) {
+        return -1;
     }
-    int id = getTouchID(m_ctrlSteerWheel.touchKey);
-    m_ctrlSteerWheel.delayData.currentPos = m_ctrlSteerWheel.delayData.queuePos.dequeue();
-    sendTouchMoveEvent(id, m_ctrlSteerWheel.delayData.currentPos);
+    return m_controller->cancelInputPlan(planId);
+}
 
-    if(m_ctrlSteerWheel.delayData.queuePos.empty() && m_ctrlSteerWheel.delayData.pressedNum == 0) {
-        sendTouchUpEvent(id, m_ctrlSteerWheel.delayData.currentPos);
-        detachTouchID(m_ctrlSteerWheel.touchKey);
+void InputConvertGame::onPlanFinished(quint64 planId)
+{
+    if (0 == planId) {
         return;
     }
 
-    if(!m_ctrlSteerWheel.delayData.queuePos.empty()) {
-        m_ctrlSteerWheel.delayData.timer->start(m_ctrlSteerWheel.delayData.queueTimer.dequeue());
+    if (planId == m_ctrlSteerWheel.delayData.planId) {
+        if (!m_ctrlSteerWheel.delayData.planPos.isEmpty()) {
+            m_ctrlSteerWheel.delayData.currentPos = m_ctrlSteerWheel.delayData.planPos.last();
+        }
+        m_ctrlSteerWheel.delayData.planId = 0;
+        m_ctrlSteerWheel.delayData.planPos.clear();
+    } else if (planId == m_dragDelayData.planId) {
+        // the plan ended with the touch up
+        detachTouchID(m_dragDelayData.pressKey);
+        m_dragDelayData.planId = 0;
+        m_dragDelayData.planPos.clear();
+        m_dragDelayData.currentPos = QPointF();
+        m_dragDelayData.pressKey = 0;
+    } else if (m_clickPlans.contains(planId)) {
+        int id = m_clickPlans.take(planId);
+        m_multiTouchID[id] = 0;
+    }
+}
+
+void InputConvertGame::stopSteerWheelPlan()
+{
+    if (0 == m_ctrlSteerWheel.delayData.planId) {
+        return;
+    }
+    int sent = cancelPlan(m_ctrlSteerWheel.delayData.planId);
+    const QVector<QPointF> &planPos = m_ctrlSteerWheel.delayData.planPos;
+    if (0 > sent) {
+        sent = planPos.size();
     }
+    sent = qMin(sent, static_cast<int>(planPos.size()));
+    if (0 < sent) {
+        m_ctrlSteerWheel.delayData.currentPos = planPos[sent - 1];
+    }
+    m_ctrlSteerWheel.delayData.planId = 0;
+    m_ctrlSteerWheel.delayData.planPos.clear();
 }
 
 void InputConvertGame::processSteerWheel(const KeyMap::KeyMapNode &node, const QKeyEvent *from)
@@ -348,41 +463,37 @@ void InputConvertGame::processSteerWheel(const KeyMap::KeyMapNode &node, const Q
     }
     m_ctrlSteerWheel.delayData.pressedNum = pressedNum;
 
-    // last key release and timer no active, active timer to detouch
+    // last key release, stop the path where it is and detouch
     if (pressedNum == 0) {
-        if (m_ctrlSteerWheel.delayData.timer->isActive()) {
-            m_ctrlSteerWheel.delayData.timer->stop();
-            m_ctrlSteerWheel.delayData.queueTimer.clear();
-            m_ctrlSteerWheel.delayData.queuePos.clear();
-        }
-
+        stopSteerWheelPlan();
         sendTouchUpEvent(getTouchID(m_ctrlSteerWheel.touchKey), m_ctrlSteerWheel.delayData.currentPos);
         detachTouchID(m_ctrlSteerWheel.touchKey);
         return;
     }
 
-    // process steer wheel key event
-    m_ctrlSteerWheel.delayData.timer->stop();
-    m_ctrlSteerWheel.delayData.queueTimer.clear();
-    m_ctrlSteerWheel.delayData.queuePos.clear();
+    // process steer wheel key event, the new path starts where the last one stopped
+    stopSteerWheelPlan();
 
+    int id = -1;
     // first press, get key and touch down
     if (pressedNum == 1 && flag) {
         m_ctrlSteerWheel.touchKey = from->key();
-        int id = attachTouchID(m_ctrlSteerWheel.touchKey);
+        id = attachTouchID(m_ctrlSteerWheel.touchKey);
         sendTouchDownEvent(id, node.data.steerWheel.centerPos);
-
-        getDelayQueue(node.data.steerWheel.centerPos, node.data.steerWheel.centerPos+offset,
-                      0.01f, 0.002f, 2, 8,
-                      m_ctrlSteerWheel.delayData.queuePos,
-                      m_ctrlSteerWheel.delayData.queueTimer);
+        m_ctrlSteerWheel.delayData.currentPos = node.data.steerWheel.centerPos;
     } else {
-        getDelayQueue(m_ctrlSteerWheel.delayData.currentPos, node.data.steerWheel.centerPos+offset,
-                      0.01f, 0.002f, 2, 8,
-                      m_ctrlSteerWheel.delayData.queuePos,
-                      m_ctrlSteerWheel.delayData.queueTimer);
+        id = getTouchID(m_ctrlSteerWheel.touchKey);
     }
-    m_ctrlSteerWheel.delayData.timer->start();
+    if (0 > id) {
+        return;
+    }
+
+    QVector<InputScheduler::Step> steps;
+    qint64 offsetNs = 0;
+    planDelayPath(m_ctrlSteerWheel.delayData.currentPos, node.data.steerWheel.centerPos+offset,
+                  0.01f, 0.002f, 2, 8, id, offsetNs,
+                  steps, m_ctrlSteerWheel.delayData.planPos);
+    m_ctrlSteerWheel.delayData.planId = submitPlan(steps);
     return;
 }
 
@@ -418,82 +529,64 @@ void InputConvertGame::processKeyClickMulti(const KeyMap::DelayClickNode *nodes,
         return;
     }
 
-    int key = from->key();
-    int delay = 0;
-    QPointF clickPos;
+    // one touch id for the whole sequence, released when the plan finishes
+    int id = attachTouchID(from->key());
+    if (0 > id) {
+        return;
+    }
 
+    QVector<InputScheduler::Step> steps;
+    steps.reserve(count * 2);
+    qint64 delay = 0;
     for (int i = 0; i < count; i++) {
         delay += nodes[i].delay;
-        clickPos = nodes[i].pos;
-        QTimer::singleShot(delay, this, [this, key, clickPos]() {
-            int id = attachTouchID(key);
-            sendTouchDownEvent(id, clickPos);
-        });
+        planTouchEvent(steps, delay * NS_PER_MS, id, nodes[i].pos, AMOTION_EVENT_ACTION_DOWN);
 
         // Don't up it too fast
         delay += 20;
-        QTimer::singleShot(delay, this, [this, key, clickPos]() {
-            int id = getTouchID(key);
-            sendTouchUpEvent(id, clickPos);
-            detachTouchID(key);
-        });
-    }
-}
-
-void InputConvertGame::onDragTimer() {
-    if(m_dragDelayData.queuePos.empty()) {
-        return;
+        planTouchEvent(steps, delay * NS_PER_MS, id, nodes[i].pos, AMOTION_EVENT_ACTION_UP);
     }
-    int id = getTouchID(m_dragDelayData.pressKey);
-    m_dragDelayData.currentPos = m_dragDelayData.queuePos.dequeue();
-    sendTouchMoveEvent(id, m_dragDelayData.currentPos);
-
-    if(m_dragDelayData.queuePos.empty()) {
-        delete m_dragDelayData.timer;
-        m_dragDelayData.timer = nullptr;
 
-        sendTouchUpEvent(id, m_dragDelayData.currentPos);
-        detachTouchID(m_dragDelayData.pressKey);
-
-        m_dragDelayData.currentPos = QPointF();
-        m_dragDelayData.pressKey = 0;
+    quint64 planId = submitPlan(steps);
+    if (0 == planId) {
+        m_multiTouchID[id] = 0;
         return;
     }
-
-    if(!m_dragDelayData.queuePos.empty()) {
-        m_dragDelayData.timer->start(m_dragDelayData.queueTimer.dequeue());
-    }
+    m_clickPlans.insert(planId, id);
 }
 
 void InputConvertGame::processKeyDrag(const QPointF &startPos, QPointF endPos, quint32 startDelay, float dragSpeed, const QKeyEvent *from)
 {
     if (QEvent::KeyPress == from->type()) {
         // stop last
-        if (m_dragDelayData.timer && m_dragDelayData.timer->isActive()) {
-            m_dragDelayData.timer->stop();
-            delete m_dragDelayData.timer;
-            m_dragDelayData.timer = nullptr;
-            m_dragDelayData.queuePos.clear();
-            m_dragDelayData.queueTimer.clear();
-
-            sendTouchUpEvent(getTouchID(m_dragDelayData.pressKey), m_dragDelayData.currentPos);
+        if (0 != m_dragDelayData.planId) {
+            int sent = cancelPlan(m_dragDelayData.planId);
+            if (0 <= sent) {
+                // still running, the planned touch up was not sent
+                sent = qMin(sent, static_cast<int>(m_dragDelayData.planPos.size()));
+                if (0 < sent) {
+                    m_dragDelayData.currentPos = m_dragDelayData.planPos[sent - 1];
+                }
+                sendTouchUpEvent(getTouchID(m_dragDelayData.pressKey), m_dragDelayData.currentPos);
+            }
             detachTouchID(m_dragDelayData.pressKey);
 
+            m_dragDelayData.planId = 0;
+            m_dragDelayData.planPos.clear();
             m_dragDelayData.currentPos = QPointF();
             m_dragDelayData.pressKey = 0;
         }
 
         // start this
         int id = attachTouchID(from->key());
+        if (0 > id) {
+            return;
+        }
         sendTouchDownEvent(id, startPos);
 
-        m_dragDelayData.timer = new QTimer(this);
-        m_dragDelayData.timer->setSingleShot(true);
-        connect(m_dragDelayData.timer, &QTimer::timeout, this, &InputConvertGame::onDragTimer);
         m_dragDelayData.pressKey = from->key();
         m_dragDelayData.currentPos = startPos;
-        m_dragDelayData.queuePos.clear();
-        m_dragDelayData.queueTimer.clear();
+        m_dragDelayData.planPos.clear();
 
         // Clamp dragSpeed to 0-1 range
         const float speed = qBound(0.0f, static_cast<float>(dragSpeed), 1.0f);
@@ -504,14 +597,24 @@ void InputConvertGame::processKeyDrag(const QPointF &startPos, QPointF endPos, q
         const quint32 minDelay = static_cast<quint32>(1 + (1.0f - speed) * 29);  // 1 to 30
         const quint32 maxDelay = minDelay + static_cast<quint32>((1.0f - speed) * 9) + 1;  // // min + (0 to 9) + 1
 
-        getDelayQueue(startPos, endPos,
+        QVector<InputScheduler::Step> steps;
+        qint64 offsetNs = static_cast<qint64>(startDelay) * NS_PER_MS;
+        planDelayPath(startPos, endPos,
                       0.01f, 0.0005f,
                       minDelay,
                       maxDelay,
-                      m_dragDelayData.queuePos,
-                      m_dragDelayData.queueTimer);
-
-        m_dragDelayData.timer->start(startDelay);
+                      id, offsetNs,
+                      steps, m_dragDelayData.planPos);
+        // up right after the last move
+        QPointF upPos = m_dragDelayData.planPos.isEmpty() ? startPos : m_dragDelayData.planPos.last();
+        planTouchEvent(steps, offsetNs, id, upPos, AMOTION_EVENT_ACTION_UP);
+
+        m_dragDelayData.planId = submitPlan(steps);
+        if (0 == m_dragDelayData.planId) {
+            sendTouchUpEvent(id, startPos);
+            detachTouchID(m_dragDelayData.pressKey);
+            m_dragDelayData.pressKey = 0;
+        }
     }
 }
 
@@ -565,6 +668,10 @@ bool InputConvertGame::processMouseMove(const QMouseEvent *from)
         return false;
     }
 
+    if (m_ctrlMouseMove.rawMotion) {
+        return true;
+    }
+
     if (checkCursorPos(from)) {
         m_ctrlMouseMove.lastPos = QPointF(0.0, 0.0);
         return true;
@@ -588,36 +695,63 @@ bool InputConvertGame::processMouseMove(const QMouseEvent *from)
 #else
         QPointF distance_raw{from->position() - lastPos};
 #endif
-        QPointF speedRatio  {m_keyMap.getMouseMoveMap().data.mouseMove.speedRatio};
-        QPointF distance    {distance_raw.x() / speedRatio.x(), distance_raw.y() / speedRatio.y()};
-
-        mouseMoveStartTouch(from);
-        startMouseMoveTimer();
+        moveMouseTouch(distance_raw);
+    }
 
-        m_ctrlMouseMove.lastConverPos.setX(m_ctrlMouseMove.lastConverPos.x() + distance.x() / m_showSize.width());
-        m_ctrlMouseMove.lastConverPos.setY(m_ctrlMouseMove.lastConverPos.y() + distance.y() / m_showSize.height());
+    return true;
+}
 
-        if (m_ctrlMouseMove.lastConverPos.x() < 0.05 || m_ctrlMouseMove.lastConverPos.x() > 0.95 || m_ctrlMouseMove.lastConverPos.y() < 0.05
-            || m_ctrlMouseMove.lastConverPos.y() > 0.95) {
-            if (m_ctrlMouseMove.smallEyes) {
-                m_processMouseMove = false;
-                int delay = 30;
-                QTimer::singleShot(delay, this, [this]() { mouseMoveStopTouch(); });
-                QTimer::singleShot(delay * 2, this, [this]() {
-                    mouseMoveStartTouch(nullptr);
-                    m_processMouseMove = true;
-                });
-            } else {
-                mouseMoveStopTouch();
-                m_ctrlMouseMove.ignoreCount = 5;
-                return true;
-            }
+void InputConvertGame::moveMouseTouch(const QPointF &distanceRaw)
+{
+    QPointF speedRatio  {m_keyMap.getMouseMoveMap().data.mouseMove.speedRatio};
+    QPointF distance    {distanceRaw.x() / speedRatio.x(), distanceRaw.y() / speedRatio.y()};
+
+    mouseMoveStartTouch(nullptr);
+    startMouseMoveTimer();
+
+    m_ctrlMouseMove.lastConverPos.setX(m_ctrlMouseMove.lastConverPos.x() + distance.x() / m_showSize.width());
+    m_ctrlMouseMove.lastConverPos.setY(m_ctrlMouseMove.lastConverPos.y() + distance.y() / m_showSize.height());
+
+    if (m_ctrlMouseMove.lastConverPos.x() < 0.05 || m_ctrlMouseMove.lastConverPos.x() > 0.95 || m_ctrlMouseMove.lastConverPos.y() < 0.05
+        || m_ctrlMouseMove.lastConverPos.y() > 0.95) {
+        if (m_ctrlMouseMove.smallEyes) {
+            m_processMouseMove = false;
+            int delay = 30;
+            QTimer::singleShot(delay, this, [this]() { mouseMoveStopTouch(); });
+            QTimer::singleShot(delay * 2, this, [this]() {
+                mouseMoveStartTouch(nullptr);
+                m_processMouseMove = true;
+            });
+        } else {
+            mouseMoveStopTouch();
+            m_ctrlMouseMove.ignoreCount = 5;
+            return;
         }
-
-        sendTouchMoveEvent(getTouchID(Qt::ExtraButton24), m_ctrlMouseMove.lastConverPos);
     }
 
-    return true;
+    sendTouchMoveEvent(getTouchID(Qt::ExtraButton24), m_ctrlMouseMove.lastConverPos);
+}
+
+void InputConvertGame::setRawMouseMotion(bool enabled)
+{
+    m_ctrlMouseMove.rawMotion = enabled;
+    // the next cursor position is not relative to the last one seen
+    m_ctrlMouseMove.lastPos = QPointF(0.0, 0.0);
+}
+
+void InputConvertGame::rawMouseMotion(const QPointF &delta)
+{
+    if (!m_ctrlMouseMove.rawMotion || !m_gameMap || m_needBackMouseMove || !m_keyMap.isValidMouseMoveMap()) {
+        return;
+    }
+    if (m_ctrlMouseMove.ignoreCount > 0) {
+        --m_ctrlMouseMove.ignoreCount;
+        return;
+    }
+    if (!m_processMouseMove || m_showSize.isEmpty()) {
+        return;
+    }
+    moveMouseTouch(delta);
 }
 
 bool InputConvertGame::checkCursorPos(const QMouseEvent *from)
@@ -662,6 +796,10 @@ void InputConvertGame::moveCursorTo(const QMouseEvent *from, const QPoint &local
 void InputConvertGame::mouseMoveStartTouch(const QMouseEvent *from)
 {
     Q_UNUSED(from)
+    // a delayed restart may come after a reload without mouse move map
+    if (!m_keyMap.isValidMouseMoveMap()) {
+        return;
+    }
     if (!m_ctrlMouseMove.touching) {
         QPointF mouseMoveStartPos
             = m_ctrlMouseMove.smallEyes ? m_keyMap.getMouseMoveMap().data.mouseMove.smallEyes.pos : m_keyMap.getMouseMoveMap().data.mouseMove.startPos;
@@ -1,10 +1,12 @@
 #ifndef INPUTCONVERTGAME_H
 #define INPUTCONVERTGAME_H
 
+#include <QHash>
 #include <QPointF>
-#include <QQueue>
+#include <QVector>
 
 #include "inputconvertnormal.h"
+#include "inputscheduler.h"
 #include "keymap.h"
 
 #define MULTI_TOUCH_MAX_NUM 10
@@ -19,7 +21,10 @@ public:
     virtual void wheelEvent(const QWheelEvent *from, const QSize &frameSize, const QSize &showSize);
     virtual void keyEvent(const QKeyEvent *from, const QSize &frameSize, const QSize &showSize);
     virtual bool isCurrentCustomKeymap();
+    virtual void setRawMouseMotion(bool enabled);
+    virtual void rawMouseMotion(const QPointF &delta);
 
+    // swaps the keymap in place, the current one is kept if the json is invalid
     void loadKeyMap(const QString &json);
 
 protected:
@@ -55,6 +60,8 @@ protected:
     // mouse
     bool processMouseClick(const QMouseEvent *from);
     bool processMouseMove(const QMouseEvent *from);
+    // distance in show size pixels, before the speed ratio
+    void moveMouseTouch(const QPointF &distanceRaw);
     void moveCursorTo(const QMouseEvent *from, const QPoint &localPosPixel);
     void mouseMoveStartTouch(const QMouseEvent *from);
     void mouseMoveStopTouch();
@@ -65,24 +72,32 @@ protected:
     bool checkCursorPos(const QMouseEvent *from);
     void hideMouseCursor(bool hide);
 
-    void getDelayQueue(const QPointF& start, const QPointF& end,
+    // input animations are planned up front and sent by the input scheduler
+    void planTouchEvent(QVector<InputScheduler::Step> &steps, qint64 offsetNs, int id, QPointF pos, AndroidMotioneventAction action);
+    // jittered moves from start towards end, one every lowestTimer to highestTimer ms
+    void planDelayPath(const QPointF& start, const QPointF& end,
                        const double& distanceStep, const double& posStepconst,
-                       quint32 lowestTimer, quint32 highestTimer,
-                       QQueue<QPointF>& queuePos, QQueue<quint32>& queueTimer);
+                       quint32 lowestTimer, quint32 highestTimer, int id, qint64 &offsetNs,
+                       QVector<InputScheduler::Step> &steps, QVector<QPointF> &positions);
+    quint64 submitPlan(const QVector<InputScheduler::Step> &steps);
+    // returns the number of steps sent, -1 if the plan is finished
+    int cancelPlan(quint64 planId);
+    void onPlanFinished(quint64 planId);
+    void stopSteerWheelPlan();
+    // lift every touch and leave the custom keymap mode
+    void resetGameState();
 
 protected:
     void timerEvent(QTimerEvent *event);
 
-private slots:
-    void onSteerWheelTimer();
-    void onDragTimer();
-
 private:
     QSize m_frameSize;
     QSize m_showSize;
     bool m_gameMap = false;
     bool m_needBackMouseMove = false;
     int m_multiTouchID[MULTI_TOUCH_MAX_NUM] = { 0 };
+    // last position sent per touch id
+    QPointF m_multiTouchPos[MULTI_TOUCH_MAX_NUM];
     KeyMap m_keyMap;
 
     bool m_processMouseMove = true;
@@ -100,9 +115,9 @@ private:
         // for delay
         struct {
             QPointF currentPos;
-            QTimer* timer = nullptr;
-            QQueue<QPointF> queuePos;
-            QQueue<quint32> queueTimer;
+            quint64 planId = 0;
+            // of the planned moves
+            QVector<QPointF> planPos;
             int pressedNum = 0;
         } delayData;
     } m_ctrlSteerWheel;
@@ -116,16 +131,21 @@ private:
         int timer = 0;
         bool smallEyes = false;
         int ignoreCount = 0;
+        // deltas come from rawMouseMotion(), the cursor is not warped back
+        bool rawMotion = false;
     } m_ctrlMouseMove;
 
     // for drag delay
     struct {
         QPointF currentPos;
-        QTimer* timer = nullptr;
-        QQueue<QPointF> queuePos;
-        QQueue<quint32> queueTimer;
+        quint64 planId = 0;
+        // of the planned moves, the touch up follows the last one
+        QVector<QPointF> planPos;
         int pressKey = 0;
     } m_dragDelayData;
+
+    // multi click plan -> touch id
+    QHash<quint64, int> m_clickPlans;
 };
 
 #endif // INPUTCONVERTGAME_H
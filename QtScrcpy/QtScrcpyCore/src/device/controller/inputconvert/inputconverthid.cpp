@@ -0,0 +1,503 @@
+#include <QCursor>
+#include <QDebug>
+#include <QGuiApplication>
+
+#include "controller.h"
+#include "inputconverthid.h"
+
+#define HID_ID_KEYBOARD 1
+#define HID_ID_MOUSE 2
+// modifiers: 1 byte; reserved: 1 byte; keys: 6 bytes
+#define HID_KEYBOARD_REPORT_SIZE 8
+#define HID_KEYBOARD_MAX_KEYS 6
+// buttons: 1 byte; x, y, wheel, hwheel: 1 byte each
+#define HID_MOUSE_REPORT_SIZE 5
+// keep the captured cursor away from the window edges
+#define HID_CURSOR_MARGIN 50
+
+// boot protocol keyboard with the led output report
+static const uchar s_keyboardReportDesc[] = {
+    0x05, 0x01, // Usage Page (Generic Desktop)
+    0x09, 0x06, // Usage (Keyboard)
+    0xA1, 0x01, // Collection (Application)
+    0x05, 0x07, //   Usage Page (Key Codes)
+    0x19, 0xE0, //   Usage Minimum (224)
+    0x29, 0xE7, //   Usage Maximum (231)
+    0x15, 0x00, //   Logical Minimum (0)
+    0x25, 0x01, //   Logical Maximum (1)
+    0x75, 0x01, //   Report Size (1)
+    0x95, 0x08, //   Report Count (8)
+    0x81, 0x02, //   Input (Data, Variable, Absolute): modifiers
+    0x75, 0x08, //   Report Size (8)
+    0x95, 0x01, //   Report Count (1)
+    0x81, 0x01, //   Input (Constant): reserved
+    0x05, 0x08, //   Usage Page (LEDs)
+    0x19, 0x01, //   Usage Minimum (1)
+    0x29, 0x05, //   Usage Maximum (5)
+    0x75, 0x01, //   Report Size (1)
+    0x95, 0x05, //   Report Count (5)
+    0x91, 0x02, //   Output (Data, Variable, Absolute): leds
+    0x75, 0x03, //   Report Size (3)
+    0x95, 0x01, //   Report Count (1)
+    0x91, 0x01, //   Output (Constant): padding
+    0x05, 0x07, //   Usage Page (Key Codes)
+    0x19, 0x00, //   Usage Minimum (0)
+    0x29, 0x65, //   Usage Maximum (101)
+    0x15, 0x00, //   Logical Minimum (0)
+    0x25, 0x65, //   Logical Maximum (101)
+    0x75, 0x08, //   Report Size (8)
+    0x95, 0x06, //   Report Count (6)
+    0x81, 0x00, //   Input (Data, Array): keys
+    0xC0,       // End Collection
+};
+
+// relative mouse, 5 buttons, vertical and horizontal wheel
+static const uchar s_mouseReportDesc[] = {
+    0x05, 0x01, // Usage Page (Generic Desktop)
+    0x09, 0x02, // Usage (Mouse)
+    0xA1, 0x01, // Collection (Application)
+    0x09, 0x01, //   Usage (Pointer)
+    0xA1, 0x00, //   Collection (Physical)
+    0x05, 0x09, //     Usage Page (Buttons)
+    0x19, 0x01, //     Usage Minimum (1)
+    0x29, 0x05, //     Usage Maximum (5)
+    0x15, 0x00, //     Logical Minimum (0)
+    0x25, 0x01, //     Logical Maximum (1)
+    0x95, 0x05, //     Report Count (5)
+    0x75, 0x01, //     Report Size (1)
+    0x81, 0x02, //     Input (Data, Variable, Absolute): buttons
+    0x95, 0x01, //     Report Count (1)
+    0x75, 0x03, //     Report Size (3)
+    0x81, 0x01, //     Input (Constant): padding
+    0x05, 0x01, //     Usage Page (Generic Desktop)
+    0x09, 0x30, //     Usage (X)
+    0x09, 0x31, //     Usage (Y)
+    0x09, 0x38, //     Usage (Wheel)
+    0x15, 0x81, //     Logical Minimum (-127)
+    0x25, 0x7F, //     Logical Maximum (127)
+    0x75, 0x08, //     Report Size (8)
+    0x95, 0x03, //     Report Count (3)
+    0x81, 0x06, //     Input (Data, Variable, Relative)
+    0x05, 0x0C, //     Usage Page (Consumer)
+    0x0A, 0x38, 0x02, // Usage (AC Pan)
+    0x15, 0x81, //     Logical Minimum (-127)
+    0x25, 0x7F, //     Logical Maximum (127)
+    0x75, 0x08, //     Report Size (8)
+    0x95, 0x01, //     Report Count (1)
+    0x81, 0x06, //     Input (Data, Variable, Relative)
+    0xC0,       //   End Collection
+    0xC0,       // End Collection
+};
+
+InputConvertHid::InputConvertHid(Controller *controller, bool keyboard, bool mouse)
+    : InputConvertNormal(controller)
+    , m_keyboard(keyboard)
+    , m_mouse(mouse)
+{
+}
+
+InputConvertHid::~InputConvertHid()
+{
+    setCaptured(false);
+    if (m_keyboardCreated) {
+        ControlMsg controlMsg(ControlMsg::CMT_UHID_DESTROY);
+        controlMsg.setUhidDestroyMsgData(HID_ID_KEYBOARD);
+        sendControlMsg(controlMsg);
+    }
+    if (m_mouseCreated) {
+        ControlMsg controlMsg(ControlMsg::CMT_UHID_DESTROY);
+        controlMsg.setUhidDestroyMsgData(HID_ID_MOUSE);
+        sendControlMsg(controlMsg);
+    }
+}
+
+void InputConvertHid::reset()
+{
+    m_keyboardCreated = false;
+    m_mouseCreated = false;
+    m_modifiers = 0;
+    m_pressedKeys.clear();
+    m_buttons = 0;
+}
+
+void InputConvertHid::mouseEvent(const QMouseEvent *from, const QSize &frameSize, const QSize &showSize)
+{
+    if (!m_mouse) {
+        InputConvertNormal::mouseEvent(from, frameSize, showSize);
+        return;
+    }
+    if (!from) {
+        return;
+    }
+
+    if (!m_captured) {
+        // the click that captures the cursor is not sent
+        if (QEvent::MouseButtonPress == from->type()) {
+            setCaptured(true);
+#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
+            m_lastPos = from->localPos();
+#else
+            m_lastPos = from->position();
+#endif
+        }
+        return;
+    }
+
+    createMouse();
+
+    switch (from->type()) {
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseButtonRelease:
+        m_buttons = convertHidButtons(from->buttons());
+        sendMouseReport(0, 0, 0, 0);
+        break;
+    case QEvent::MouseMove: {
+#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
+        QPointF pos = from->localPos();
+#else
+        QPointF pos = from->position();
+#endif
+        if (m_ignoreNextMove) {
+            // the move caused by recenterCursor()
+            m_ignoreNextMove = false;
+            m_lastPos = pos;
+            return;
+        }
+        QPointF delta = pos - m_lastPos;
+        m_lastPos = pos;
+        m_buttons = convertHidButtons(from->buttons());
+        sendMouseReport(qRound(delta.x()), qRound(delta.y()), 0, 0);
+        recenterCursor(from, showSize);
+    } break;
+    default:
+        break;
+    }
+}
+
+void InputConvertHid::wheelEvent(const QWheelEvent *from, const QSize &frameSize, const QSize &showSize)
+{
+    if (!m_mouse) {
+        InputConvertNormal::wheelEvent(from, frameSize, showSize);
+        return;
+    }
+    if (!from || !m_captured) {
+        return;
+    }
+    createMouse();
+    // one notch is 120, the rest is kept for the next event
+    m_wheelRemainder += from->angleDelta().y();
+    m_hWheelRemainder += from->angleDelta().x();
+    int wheel = m_wheelRemainder / 120;
+    int hWheel = m_hWheelRemainder / 120;
+    m_wheelRemainder %= 120;
+    m_hWheelRemainder %= 120;
+    if (wheel || hWheel) {
+        sendMouseReport(0, 0, wheel, hWheel);
+    }
+}
+
+void InputConvertHid::keyEvent(const QKeyEvent *from, const QSize &frameSize, const QSize &showSize)
+{
+    if (!from) {
+        return;
+    }
+
+    if (m_mouse && m_captured && Qt::Key_Alt == from->key()) {
+        if (QEvent::KeyPress == from->type()) {
+            setCaptured(false);
+        }
+        return;
+    }
+
+    if (!m_keyboard) {
+        InputConvertNormal::keyEvent(from, frameSize, showSize);
+        return;
+    }
+    // Android repeats held hid keys itself
+    if (from->isAutoRepeat()) {
+        return;
+    }
+
+    bool down = QEvent::KeyPress == from->type();
+    uchar modifier = convertHidModifier(from->key());
+    uchar usage = modifier ? 0 : convertHidUsage(from->key());
+    if (!modifier && !usage) {
+        return;
+    }
+
+    createKeyboard();
+    if (modifier) {
+        if (down) {
+            m_modifiers |= modifier;
+        } else {
+            m_modifiers &= ~modifier;
+        }
+    } else if (down) {
+        if (!m_pressedKeys.contains(usage) && m_pressedKeys.size() < HID_KEYBOARD_MAX_KEYS) {
+            m_pressedKeys.append(usage);
+        }
+    } else {
+        m_pressedKeys.removeAll(usage);
+    }
+    sendKeyboardReport();
+}
+
+void InputConvertHid::createKeyboard()
+{
+    if (m_keyboardCreated) {
+        return;
+    }
+    m_keyboardCreated = true;
+    ControlMsg controlMsg(ControlMsg::CMT_UHID_CREATE);
+    controlMsg.setUhidCreateMsgData(HID_ID_KEYBOARD, 0, 0, "QtScrcpy keyboard",
+                                    QByteArray(reinterpret_cast<const char *>(s_keyboardReportDesc), sizeof(s_keyboardReportDesc)));
+    sendControlMsg(controlMsg);
+}
+
+void InputConvertHid::createMouse()
+{
+    if (m_mouseCreated) {
+        return;
+    }
+    m_mouseCreated = true;
+    ControlMsg controlMsg(ControlMsg::CMT_UHID_CREATE);
+    controlMsg.setUhidCreateMsgData(HID_ID_MOUSE, 0, 0, "QtScrcpy mouse",
+                                    QByteArray(reinterpret_cast<const char *>(s_mouseReportDesc), sizeof(s_mouseReportDesc)));
+    sendControlMsg(controlMsg);
+}
+
+void InputConvertHid::sendKeyboardReport()
+{
+    uchar report[HID_KEYBOARD_REPORT_SIZE] = { 0 };
+    report[0] = m_modifiers;
+    for (int i = 0; i < m_pressedKeys.size(); i++) {
+        report[2 + i] = m_pressedKeys[i];
+    }
+    ControlMsg controlMsg(ControlMsg::CMT_UHID_INPUT);
+    controlMsg.setUhidInputMsgData(HID_ID_KEYBOARD, report, HID_KEYBOARD_REPORT_SIZE);
+    sendControlMsg(controlMsg);
+}
+
+void InputConvertHid::sendMouseReport(int dx, int dy, int wheel, int hWheel)
+{
+    // a report holds [-127, 127] per axis, split larger moves
+    do {
+        int x = qBound(-127, dx, 127);
+        int y = qBound(-127, dy, 127);
+        uchar report[HID_MOUSE_REPORT_SIZE];
+        report[0] = m_buttons;
+        report[1] = static_cast<uchar>(static_cast<qint8>(x));
+        report[2] = static_cast<uchar>(static_cast<qint8>(y));
+        report[3] = static_cast<uchar>(static_cast<qint8>(qBound(-127, wheel, 127)));
+        report[4] = static_cast<uchar>(static_cast<qint8>(qBound(-127, hWheel, 127)));
+        ControlMsg controlMsg(ControlMsg::CMT_UHID_INPUT);
+        controlMsg.setUhidInputMsgData(HID_ID_MOUSE, report, HID_MOUSE_REPORT_SIZE);
+        sendControlMsg(controlMsg);
+        dx -= x;
+        dy -= y;
+        wheel = 0;
+        hWheel = 0;
+    } while (dx || dy);
+}
+
+void InputConvertHid::setCaptured(bool captured)
+{
+    if (m_captured == captured) {
+        return;
+    }
+    m_captured = captured;
+    m_ignoreNextMove = false;
+    m_wheelRemainder = 0;
+    m_hWheelRemainder = 0;
+    if (captured) {
+#ifdef QT_NO_DEBUG
+        QGuiApplication::setOverrideCursor(QCursor(Qt::BlankCursor));
+#else
+        QGuiApplication::setOverrideCursor(QCursor(Qt::CrossCursor));
+#endif
+    } else {
+        QGuiApplication::restoreOverrideCursor();
+        if (m_buttons) {
+            // do not leave buttons pressed on the device
+            m_buttons = 0;
+            sendMouseReport(0, 0, 0, 0);
+        }
+    }
+    emit grabCursor(captured);
+}
+
+bool InputConvertHid::recenterCursor(const QMouseEvent *from, const QSize &showSize)
+{
+    QPoint pos = from->pos();
+    if (pos.x() > HID_CURSOR_MARGIN && pos.x() < showSize.width() - HID_CURSOR_MARGIN && pos.y() > HID_CURSOR_MARGIN
+        && pos.y() < showSize.height() - HID_CURSOR_MARGIN) {
+        return false;
+    }
+#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
+    QPoint globalPos = from->globalPos();
+#else
+    QPoint globalPos = from->globalPosition().toPoint();
+#endif
+    QPoint center(showSize.width() / 2, showSize.height() / 2);
+    QCursor::setPos(globalPos - pos + center);
+    m_ignoreNextMove = true;
+    return true;
+}
+
+uchar InputConvertHid::convertHidModifier(int key)
+{
+    switch (key) {
+    case Qt::Key_Control:
+        return 0x01;
+    case Qt::Key_Shift:
+        return 0x02;
+    case Qt::Key_Alt:
+        return 0x04;
+    case Qt::Key_Meta:
+        return 0x08;
+    default:
+        return 0;
+    }
+}
+
+uchar InputConvertHid::convertHidUsage(int key)
+{
+    if (key >= Qt::Key_A && key <= Qt::Key_Z) {
+        return 0x04 + (key - Qt::Key_A);
+    }
+    if (key >= Qt::Key_1 && key <= Qt::Key_9) {
+        return 0x1E + (key - Qt::Key_1);
+    }
+    if (key >= Qt::Key_F1 && key <= Qt::Key_F12) {
+        return 0x3A + (key - Qt::Key_F1);
+    }
+
+    // Qt reports the shifted symbol, the usage is the key under it on a US layout
+    switch (key) {
+    case Qt::Key_0:
+    case Qt::Key_ParenRight:
+        return 0x27;
+    case Qt::Key_Exclam:
+        return 0x1E;
+    case Qt::Key_At:
+        return 0x1F;
+    case Qt::Key_NumberSign:
+        return 0x20;
+    case Qt::Key_Dollar:
+        return 0x21;
+    case Qt::Key_Percent:
+        return 0x22;
+    case Qt::Key_AsciiCircum:
+        return 0x23;
+    case Qt::Key_Ampersand:
+        return 0x24;
+    case Qt::Key_Asterisk:
+        return 0x25;
+    case Qt::Key_ParenLeft:
+        return 0x26;
+    case Qt::Key_Return:
+    case Qt::Key_Enter:
+        return 0x28;
+    case Qt::Key_Escape:
+        return 0x29;
+    case Qt::Key_Backspace:
+        return 0x2A;
+    case Qt::Key_Tab:
+    case Qt::Key_Backtab:
+        return 0x2B;
+    case Qt::Key_Space:
+        return 0x2C;
+    case Qt::Key_Minus:
+    case Qt::Key_Underscore:
+        return 0x2D;
+    case Qt::Key_Equal:
+    case Qt::Key_Plus:
+        return 0x2E;
+    case Qt::Key_BracketLeft:
+    case Qt::Key_BraceLeft:
+        return 0x2F;
+    case Qt::Key_BracketRight:
+    case Qt::Key_BraceRight:
+        return 0x30;
+    case Qt::Key_Backslash:
+    case Qt::Key_Bar:
+        return 0x31;
+    case Qt::Key_Semicolon:
+    case Qt::Key_Colon:
+        return 0x33;
+    case Qt::Key_Apostrophe:
+    case Qt::Key_QuoteDbl:
+        return 0x34;
+    case Qt::Key_QuoteLeft:
+    case Qt::Key_AsciiTilde:
+        return 0x35;
+    case Qt::Key_Comma:
+    case Qt::Key_Less:
+        return 0x36;
+    case Qt::Key_Period:
+    case Qt::Key_Greater:
+        return 0x37;
+    case Qt::Key_Slash:
+    case Qt::Key_Question:
+        return 0x38;
+    case Qt::Key_CapsLock:
+        return 0x39;
+    case Qt::Key_Print:
+        return 0x46;
+    case Qt::Key_ScrollLock:
+        return 0x47;
+    case Qt::Key_Pause:
+        return 0x48;
+    case Qt::Key_Insert:
+        return 0x49;
+    case Qt::Key_Home:
+        return 0x4A;
+    case Qt::Key_PageUp:
+        return 0x4B;
+    case Qt::Key_Delete:
+        return 0x4C;
+    case Qt::Key_End:
+        return 0x4D;
+    case Qt::Key_PageDown:
+        return 0x4E;
+    case Qt::Key_Right:
+        return 0x4F;
+    case Qt::Key_Left:
+        return 0x50;
+    case Qt::Key_Down:
+        return 0x51;
+    case Qt::Key_Up:
+        return 0x52;
+    case Qt::Key_NumLock:
+        return 0x53;
+    case Qt::Key_Menu:
+        return 0x65;
+    default:
+        return 0;
+    }
+}
+
+uchar InputConvertHid::convertHidButtons(Qt::MouseButtons buttons)
+{
+    uchar ret = 0;
+    if (buttons & Qt::LeftButton) {
+        ret |= 0x01;
+    }
+    if (buttons & Qt::RightButton) {
+        ret |= 0x02;
+    }
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+    if (buttons & Qt::MiddleButton) {
+#else
+    if (buttons & Qt::MidButton) {
+#endif
+        ret |= 0x04;
+    }
+    if (buttons & Qt::XButton1) {
+        ret |= 0x08;
+    }
+    if (buttons & Qt::XButton2) {
+        ret |= 0x10;
+    }
+    return ret;
+}
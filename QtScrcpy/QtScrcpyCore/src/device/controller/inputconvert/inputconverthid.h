@@ -0,0 +1,55 @@
+#ifndef INPUTCONVERTHID_H
+#define INPUTCONVERTHID_H
+
+#include <QPointF>
+#include <QVector>
+
+#include "inputconvertnormal.h"
+
+// injects through virtual hid devices on the device (UHID) instead of the InputManager:
+// the keyboard sends boot protocol reports, so modifiers and key repeat are handled by
+// Android like for a real keyboard, the mouse is relative and needs the cursor captured
+// (click to capture, Alt to release)
+class InputConvertHid : public InputConvertNormal
+{
+    Q_OBJECT
+public:
+    InputConvertHid(Controller *controller, bool keyboard, bool mouse);
+    virtual ~InputConvertHid();
+
+    virtual void mouseEvent(const QMouseEvent *from, const QSize &frameSize, const QSize &showSize);
+    virtual void wheelEvent(const QWheelEvent *from, const QSize &frameSize, const QSize &showSize);
+    virtual void keyEvent(const QKeyEvent *from, const QSize &frameSize, const QSize &showSize);
+    // the device side hid devices are gone after a reconnect
+    virtual void reset();
+
+private:
+    void createKeyboard();
+    void createMouse();
+    void sendKeyboardReport();
+    void sendMouseReport(int dx, int dy, int wheel, int hWheel);
+    void setCaptured(bool captured);
+    bool recenterCursor(const QMouseEvent *from, const QSize &showSize);
+    static uchar convertHidUsage(int key);
+    static uchar convertHidModifier(int key);
+    static uchar convertHidButtons(Qt::MouseButtons buttons);
+
+private:
+    bool m_keyboard = false;
+    bool m_mouse = false;
+    bool m_keyboardCreated = false;
+    bool m_mouseCreated = false;
+
+    uchar m_modifiers = 0;
+    QVector<uchar> m_pressedKeys;
+
+    bool m_captured = false;
+    bool m_ignoreNextMove = false;
+    QPointF m_lastPos;
+    uchar m_buttons = 0;
+    // angle delta short of a whole notch, hi-res wheels send fractions of one
+    int m_wheelRemainder = 0;
+    int m_hWheelRemainder = 0;
+};
+
+#endif // INPUTCONVERTHID_H
@@ -9,9 +9,35 @@ InputConvertNormal::InputConvertNormal(Controller *controller) : InputConvertBas
 InputConvertNormal::~InputConvertNormal() {}
 
 void InputConvertNormal::mouseEvent(const QMouseEvent *from, const QSize &frameSize, const QSize &showSize)
+{
+    ControlMsg controlMsg(ControlMsg::CMT_INJECT_TOUCH);
+    if (convertMouseEvent(from, frameSize, showSize, controlMsg)) {
+        sendControlMsg(controlMsg);
+    }
+}
+
+void InputConvertNormal::wheelEvent(const QWheelEvent *from, const QSize &frameSize, const QSize &showSize)
+{
+    ControlMsg controlMsg(ControlMsg::CMT_INJECT_SCROLL);
+    if (convertWheelEvent(from, frameSize, showSize, controlMsg)) {
+        sendControlMsg(controlMsg);
+    }
+}
+
+void InputConvertNormal::keyEvent(const QKeyEvent *from, const QSize &frameSize, const QSize &showSize)
+{
+    Q_UNUSED(frameSize)
+    Q_UNUSED(showSize)
+    ControlMsg controlMsg(ControlMsg::CMT_INJECT_KEYCODE);
+    if (convertKeyEvent(from, m_repeat, controlMsg)) {
+        sendControlMsg(controlMsg);
+    }
+}
+
+bool InputConvertNormal::convertMouseEvent(const QMouseEvent *from, const QSize &frameSize, const QSize &showSize, ControlMsg &controlMsg)
 {
     if (!from) {
-        return;
+        return false;
     }
 
     // action
@@ -26,12 +52,12 @@ void InputConvertNormal::mouseEvent(const QMouseEvent *from, const QSize &frameS
     case QEvent::MouseMove:
         // only support left button drag
         if (!(from->buttons() & Qt::LeftButton)) {
-            return;
+            return false;
         }
         action = AMOTION_EVENT_ACTION_MOVE;
         break;
     default:
-        return;
+        return false;
     }
 
     // pos
@@ -45,24 +71,20 @@ void InputConvertNormal::mouseEvent(const QMouseEvent *from, const QSize &frameS
     pos.setY(pos.y() * frameSize.height() / showSize.height());
 
     // set data
-    ControlMsg *controlMsg = new ControlMsg(ControlMsg::CMT_INJECT_TOUCH);
-    if (!controlMsg) {
-        return;
-    }
-    controlMsg->setInjectTouchMsgData(
+    controlMsg.setInjectTouchMsgData(
         static_cast<quint64>(POINTER_ID_GENERIC_FINGER),
         action,
         convertMouseButton(from->button()),
         convertMouseButtons(from->buttons()),
         QRect(pos.toPoint(), frameSize),
         AMOTION_EVENT_ACTION_DOWN == action ? 1.0f : 0.0f);
-    sendControlMsg(controlMsg);
+    return true;
 }
 
-void InputConvertNormal::wheelEvent(const QWheelEvent *from, const QSize &frameSize, const QSize &showSize)
+bool InputConvertNormal::convertWheelEvent(const QWheelEvent *from, const QSize &frameSize, const QSize &showSize, ControlMsg &controlMsg)
 {
     if (!from || from->angleDelta().isNull()) {
-        return;
+        return false;
     }
 
     // delta
@@ -80,23 +102,17 @@ void InputConvertNormal::wheelEvent(const QWheelEvent *from, const QSize &frameS
     pos.setY(pos.y() * frameSize.height() / showSize.height());
 
     // set data
-    ControlMsg *controlMsg = new ControlMsg(ControlMsg::CMT_INJECT_SCROLL);
-    if (!controlMsg) {
-        return;
-    }
-    controlMsg->setInjectScrollMsgData(QRect(pos.toPoint(), frameSize), hScroll, vScroll, convertMouseButtons(from->buttons()));
-    sendControlMsg(controlMsg);
+    controlMsg.setInjectScrollMsgData(QRect(pos.toPoint(), frameSize), hScroll, vScroll, convertMouseButtons(from->buttons()));
+    return true;
 }
 
-void InputConvertNormal::keyEvent(const QKeyEvent *from, const QSize &frameSize, const QSize &showSize)
+bool InputConvertNormal::convertKeyEvent(const QKeyEvent *from, unsigned &repeat, ControlMsg &controlMsg)
 {
-    Q_UNUSED(frameSize)
-    Q_UNUSED(showSize)
     if (!from) {
-        return;
+        return false;
     }
 
-    bool repeat = from->isAutoRepeat();
+    bool autoRepeat = from->isAutoRepeat();
 
     // action
     AndroidKeyeventAction action;
@@ -108,29 +124,24 @@ void InputConvertNormal::keyEvent(const QKeyEvent *from, const QSize &frameSize,
         action = AKEY_EVENT_ACTION_UP;
         break;
     default:
-        return;
+        return false;
     }
 
     // key code
     AndroidKeycode keyCode = convertKeyCode(from->key(), from->modifiers());
     if (AKEYCODE_UNKNOWN == keyCode) {
-        return;
+        return false;
     }
 
     // set data
-    ControlMsg *controlMsg = new ControlMsg(ControlMsg::CMT_INJECT_KEYCODE);
-    if (!controlMsg) {
-        return;
-    }
-
-    if (repeat) {
-        m_repeat++;
+    if (autoRepeat) {
+        repeat++;
     } else {
-        m_repeat = 0;
+        repeat = 0;
     }
 
-    controlMsg->setInjectKeycodeMsgData(action, keyCode, m_repeat, convertMetastate(from->modifiers()));
-    sendControlMsg(controlMsg);
+    controlMsg.setInjectKeycodeMsgData(action, keyCode, repeat, convertMetastate(from->modifiers()));
+    return true;
 }
 
 AndroidMotioneventButtons InputConvertNormal::convertMouseButtons(Qt::MouseButtons buttonState)
@@ -14,11 +14,18 @@ public:
     virtual void wheelEvent(const QWheelEvent *from, const QSize &frameSize, const QSize &showSize);
     virtual void keyEvent(const QKeyEvent *from, const QSize &frameSize, const QSize &showSize);
 
+    // the conversions without a controller, false if the event sends nothing
+    // a group broadcast converts once per frame size and serializes the result for every device
+    static bool convertMouseEvent(const QMouseEvent *from, const QSize &frameSize, const QSize &showSize, ControlMsg &controlMsg);
+    static bool convertWheelEvent(const QWheelEvent *from, const QSize &frameSize, const QSize &showSize, ControlMsg &controlMsg);
+    // repeat counts the auto repeated presses across calls
+    static bool convertKeyEvent(const QKeyEvent *from, unsigned &repeat, ControlMsg &controlMsg);
+
 private:
-    AndroidMotioneventButtons convertMouseButtons(Qt::MouseButtons buttonState);
-    AndroidMotioneventButtons convertMouseButton(Qt::MouseButton button);
-    AndroidKeycode convertKeyCode(int key, Qt::KeyboardModifiers modifiers);
-    AndroidMetastate convertMetastate(Qt::KeyboardModifiers modifiers);
+    static AndroidMotioneventButtons convertMouseButtons(Qt::MouseButtons buttonState);
+    static AndroidMotioneventButtons convertMouseButton(Qt::MouseButton button);
+    static AndroidKeycode convertKeyCode(int key, Qt::KeyboardModifiers modifiers);
+    static AndroidMetastate convertMetastate(Qt::KeyboardModifiers modifiers);
 };
 
 #endif // INPUTCONVERT_H
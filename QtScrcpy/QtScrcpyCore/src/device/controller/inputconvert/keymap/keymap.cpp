@@ -5,16 +5,19 @@
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QMetaEnum>
+#include <QtAlgorithms>
 
 #include "keymap.h"
 
-KeyMap::KeyMap(QObject *parent) : QObject(parent) {}
+KeyMap::KeyMap(QObject *parent) : QObject(parent), m_compiled(new Compiled()) {}
 
 KeyMap::~KeyMap() {}
 
-void KeyMap::loadKeyMap(const QString &json)
+bool KeyMap::loadKeyMap(const QString &json)
 {
     QString errorString;
+    // parsed aside, a broken script leaves the current keymap alone
+    QScopedPointer<Compiled> compiled(new Compiled());
     QJsonParseError jsonError;
     QJsonDocument jsonDoc;
     QJsonObject rootObj;
@@ -41,8 +44,8 @@ void KeyMap::loadKeyMap(const QString &json)
         goto parseError;
     }
 
-    m_switchKey.type = switchKey.first;
-    m_switchKey.key = switchKey.second;
+    compiled->switchKey.type = switchKey.first;
+    compiled->switchKey.key = switchKey.second;
 
     // mouseMoveMap
     if (checkItemObject(rootObj, "mouseMoveMap")) {
@@ -127,8 +130,8 @@ void KeyMap::loadKeyMap(const QString &json)
             keyMapNode.data.mouseMove.smallEyes.pos = getItemPos(smallEyes, "pos");
         }
 
-        m_idxMouseMove = m_keyMapNodes.size();
-        m_keyMapNodes.push_back(keyMapNode);
+        compiled->idxMouseMove = compiled->keyMapNodes.size();
+        compiled->keyMapNodes.push_back(keyMapNode);
     }
 
     // keyMapNodes
@@ -167,7 +170,7 @@ void KeyMap::loadKeyMap(const QString &json)
                 keyMapNode.data.click.keyNode.pos = getItemPos(node, "pos");
                 keyMapNode.data.click.switchMap = getItemBool(node, "switchMap");
                 keyMapNode.data.click.keyNode.androidKey = static_cast<AndroidKeycode>(getItemDouble(node, "androidKey"));
-                m_keyMapNodes.push_back(keyMapNode);
+                compiled->keyMapNodes.push_back(keyMapNode);
             } break;
             case KeyMap::KMT_CLICK_TWICE: {
                 // safe check
@@ -188,7 +191,7 @@ void KeyMap::loadKeyMap(const QString &json)
                 keyMapNode.data.click.keyNode.pos = getItemPos(node, "pos");
                 keyMapNode.data.click.switchMap = getItemBool(node, "switchMap");
                 keyMapNode.data.click.keyNode.androidKey = static_cast<AndroidKeycode>(getItemDouble(node, "androidKey"));
-                m_keyMapNodes.push_back(keyMapNode);
+                compiled->keyMapNodes.push_back(keyMapNode);
             } break;
             case KeyMap::KMT_CLICK_MULTI: {
                 // safe check
@@ -210,20 +213,17 @@ void KeyMap::loadKeyMap(const QString &json)
                 QJsonObject clickNode;
                 keyMapNode.data.clickMulti.keyNode.delayClickNodesCount = 0;
 
+                // out of line, makeReverseMap() points the node at them
                 for (int i = 0; i < clickNodes.size(); i++) {
-                    if (i >= MAX_DELAY_CLICK_NODES) {
-                        qInfo() << "clickNodes too much, up to " << MAX_DELAY_CLICK_NODES;
-                        break;
-                    }
                     clickNode = clickNodes.at(i).toObject();
                     DelayClickNode delayClickNode;
                     delayClickNode.delay = getItemDouble(clickNode, "delay");
                     delayClickNode.pos = getItemPos(clickNode, "pos");
-                    keyMapNode.data.clickMulti.keyNode.delayClickNodes[i] = delayClickNode;
+                    compiled->delayClickNodes.push_back(delayClickNode);
                     keyMapNode.data.clickMulti.keyNode.delayClickNodesCount++;
                 }
 
-                m_keyMapNodes.push_back(keyMapNode);
+                compiled->keyMapNodes.push_back(keyMapNode);
             } break;
             case KeyMap::KMT_STEER_WHEEL: {
                 // safe check
@@ -260,8 +260,8 @@ void KeyMap::loadKeyMap(const QString &json)
                 keyMapNode.data.steerWheel.down = { downKey.first, downKey.second, QPointF(0, 0), QPointF(0, 0), getItemDouble(node, "downOffset") };
 
                 keyMapNode.data.steerWheel.centerPos = getItemPos(node, "centerPos");
-                m_idxSteerWheel = m_keyMapNodes.size();
-                m_keyMapNodes.push_back(keyMapNode);
+                compiled->idxSteerWheel = compiled->keyMapNodes.size();
+                compiled->keyMapNodes.push_back(keyMapNode);
             } break;
             case KeyMap::KMT_DRAG: {
                 // safe check
@@ -286,7 +286,7 @@ void KeyMap::loadKeyMap(const QString &json)
                     static_cast<quint32>(getItemDouble(node, "startDelay")) : 0;
                 keyMapNode.data.drag.dragSpeed = node.contains("dragSpeed") ? 
                     static_cast<float>(getItemDouble(node, "dragSpeed")) : 1.0f;
-                m_keyMapNodes.push_back(keyMapNode);
+                compiled->keyMapNodes.push_back(keyMapNode);
                 break;
             }
             case KeyMap::KMT_ANDROID_KEY: {
@@ -306,7 +306,7 @@ void KeyMap::loadKeyMap(const QString &json)
                 keyMapNode.data.androidKey.keyNode.type = key.first;
                 keyMapNode.data.androidKey.keyNode.key = key.second;
                 keyMapNode.data.androidKey.keyNode.androidKey = static_cast<AndroidKeycode>(getItemDouble(node, "androidKey"));
-                m_keyMapNodes.push_back(keyMapNode);
+                compiled->keyMapNodes.push_back(keyMapNode);
             } break;
             default:
                 qWarning() << "json error: keyMapNodes invalid node type:" << node.value("type").toString();
@@ -314,104 +314,132 @@ void KeyMap::loadKeyMap(const QString &json)
             }
         }
     }
-    // this must be called after m_keyMapNodes is stable
-    makeReverseMap();
+    // this must be called after compiled->keyMapNodes is stable
+    makeReverseMap(*compiled);
+    m_compiled.swap(compiled);
     qInfo() << "Script updated, current keymap mode:normal, Press ~ key to switch keymap mode";
+    return true;
 
 parseError:
-    if (!errorString.isEmpty()) {
-        qWarning() << errorString;
-    }
-    return;
+    qWarning() << errorString;
+    return false;
 }
 
 const KeyMap::KeyMapNode &KeyMap::getKeyMapNode(int key)
 {
-    auto p = m_rmapKey.value(key, &m_invalidNode);
-    if (p == &m_invalidNode) {
-        return *m_rmapMouse.value(key, &m_invalidNode);
+    const KeyMapNode &node = getKeyMapNodeKey(key);
+    if (&node == &m_invalidNode) {
+        return getKeyMapNodeMouse(key);
     }
-    return *p;
+    return node;
 }
 
 const KeyMap::KeyMapNode &KeyMap::getKeyMapNodeKey(int key)
 {
-    return *m_rmapKey.value(key, &m_invalidNode);
+    if (key >= 0 && key < KEYMAP_KEY_TABLE_LOW) {
+        return nodeAt(m_compiled->keyLow[key]);
+    }
+    if (key >= Qt::Key_Escape && key < Qt::Key_Escape + KEYMAP_KEY_TABLE_HIGH) {
+        return nodeAt(m_compiled->keyHigh[key - Qt::Key_Escape]);
+    }
+    return nodeAt(m_compiled->keyOther.value(key, 0));
 }
 
 const KeyMap::KeyMapNode &KeyMap::getKeyMapNodeMouse(int key)
 {
-    return *m_rmapMouse.value(key, &m_invalidNode);
+    // a single button
+    if (key <= 0 || (key & (key - 1))) {
+        return m_invalidNode;
+    }
+    return nodeAt(m_compiled->mouse[qCountTrailingZeroBits(static_cast<quint32>(key))]);
+}
+
+const KeyMap::KeyMapNode &KeyMap::nodeAt(quint16 slot)
+{
+    if (0 == slot) {
+        return m_invalidNode;
+    }
+    return m_compiled->keyMapNodes[slot - 1];
 }
 
 bool KeyMap::isSwitchOnKeyboard()
 {
-    return m_switchKey.type == AT_KEY;
+    return m_compiled->switchKey.type == AT_KEY;
 }
 
 int KeyMap::getSwitchKey()
 {
-    return m_switchKey.key;
+    return m_compiled->switchKey.key;
 }
 
 const KeyMap::KeyMapNode &KeyMap::getMouseMoveMap()
 {
-    return m_keyMapNodes[m_idxMouseMove];
+    return m_compiled->keyMapNodes[m_compiled->idxMouseMove];
 }
 
 bool KeyMap::isValidMouseMoveMap()
 {
-    return m_idxMouseMove != -1;
+    return m_compiled->idxMouseMove != -1;
 }
 
 bool KeyMap::isValidSteerWheelMap()
 {
-    return m_idxSteerWheel != -1;
+    return m_compiled->idxSteerWheel != -1;
 }
 
-void KeyMap::makeReverseMap()
+void KeyMap::makeReverseMap(Compiled &compiled)
 {
-    m_rmapKey.clear();
-    m_rmapMouse.clear();
-    for (int i = 0; i < m_keyMapNodes.size(); ++i) {
-        auto &node = m_keyMapNodes[i];
+    int delayClickOffset = 0;
+    for (int i = 0; i < compiled.keyMapNodes.size(); ++i) {
+        auto &node = compiled.keyMapNodes[i];
         switch (node.type) {
-        case KMT_CLICK: {
-            QMultiHash<int, KeyMapNode *> &m = node.data.click.keyNode.type == AT_KEY ? m_rmapKey : m_rmapMouse;
-            m.insert(node.data.click.keyNode.key, &node);
-        } break;
-        case KMT_CLICK_TWICE: {
-            QMultiHash<int, KeyMapNode *> &m = node.data.clickTwice.keyNode.type == AT_KEY ? m_rmapKey : m_rmapMouse;
-            m.insert(node.data.clickTwice.keyNode.key, &node);
-        } break;
-        case KMT_CLICK_MULTI: {
-            QMultiHash<int, KeyMapNode *> &m = node.data.clickMulti.keyNode.type == AT_KEY ? m_rmapKey : m_rmapMouse;
-            m.insert(node.data.clickMulti.keyNode.key, &node);
-        } break;
-        case KMT_STEER_WHEEL: {
-            QMultiHash<int, KeyMapNode *> &ml = node.data.steerWheel.left.type == AT_KEY ? m_rmapKey : m_rmapMouse;
-            ml.insert(node.data.steerWheel.left.key, &node);
-            QMultiHash<int, KeyMapNode *> &mr = node.data.steerWheel.right.type == AT_KEY ? m_rmapKey : m_rmapMouse;
-            mr.insert(node.data.steerWheel.right.key, &node);
-            QMultiHash<int, KeyMapNode *> &mu = node.data.steerWheel.up.type == AT_KEY ? m_rmapKey : m_rmapMouse;
-            mu.insert(node.data.steerWheel.up.key, &node);
-            QMultiHash<int, KeyMapNode *> &md = node.data.steerWheel.down.type == AT_KEY ? m_rmapKey : m_rmapMouse;
-            md.insert(node.data.steerWheel.down.key, &node);
-        } break;
-        case KMT_DRAG: {
-            QMultiHash<int, KeyMapNode *> &m = node.data.drag.keyNode.type == AT_KEY ? m_rmapKey : m_rmapMouse;
-            m.insert(node.data.drag.keyNode.key, &node);
-        } break;
-        case KMT_ANDROID_KEY: {
-            QMultiHash<int, KeyMapNode *> &m = node.data.androidKey.keyNode.type == AT_KEY ? m_rmapKey : m_rmapMouse;
-            m.insert(node.data.androidKey.keyNode.key, &node);
-        } break;
+        case KMT_CLICK:
+            mapKeyNode(compiled, node.data.click.keyNode, i);
+            break;
+        case KMT_CLICK_TWICE:
+            mapKeyNode(compiled, node.data.clickTwice.keyNode, i);
+            break;
+        case KMT_CLICK_MULTI:
+            node.data.clickMulti.keyNode.delayClickNodes = compiled.delayClickNodes.constData() + delayClickOffset;
+            delayClickOffset += node.data.clickMulti.keyNode.delayClickNodesCount;
+            mapKeyNode(compiled, node.data.clickMulti.keyNode, i);
+            break;
+        case KMT_STEER_WHEEL:
+            mapKeyNode(compiled, node.data.steerWheel.left, i);
+            mapKeyNode(compiled, node.data.steerWheel.right, i);
+            mapKeyNode(compiled, node.data.steerWheel.up, i);
+            mapKeyNode(compiled, node.data.steerWheel.down, i);
+            break;
+        case KMT_DRAG:
+            mapKeyNode(compiled, node.data.drag.keyNode, i);
+            break;
+        case KMT_ANDROID_KEY:
+            mapKeyNode(compiled, node.data.androidKey.keyNode, i);
+            break;
         default:
             break;
         }
     }
 }
 
+void KeyMap::mapKeyNode(Compiled &compiled, const KeyNode &keyNode, int index)
+{
+    // a later node wins for the same key
+    quint16 slot = static_cast<quint16>(index + 1);
+    int key = keyNode.key;
+    if (AT_KEY == keyNode.type) {
+        if (key >= 0 && key < KEYMAP_KEY_TABLE_LOW) {
+            compiled.keyLow[key] = slot;
+        } else if (key >= Qt::Key_Escape && key < Qt::Key_Escape + KEYMAP_KEY_TABLE_HIGH) {
+            compiled.keyHigh[key - Qt::Key_Escape] = slot;
+        } else {
+            compiled.keyOther.insert(key, slot);
+        }
+    } else if (AT_MOUSE == keyNode.type && key > 0 && !(key & (key - 1))) {
+        compiled.mouse[qCountTrailingZeroBits(static_cast<quint32>(key))] = slot;
+    }
+}
+
 QString KeyMap::getItemString(const QJsonObject &node, const QString &name)
 {
     return node.value(name).toString();
@@ -1,17 +1,21 @@
 #ifndef KEYMAP_H
 #define KEYMAP_H
+#include <QHash>
 #include <QJsonObject>
 #include <QMetaEnum>
-#include <QMultiHash>
 #include <QObject>
 #include <QPair>
 #include <QPointF>
 #include <QRectF>
+#include <QScopedPointer>
 #include <QVector>
 
 #include "keycodes.h"
 
-#define MAX_DELAY_CLICK_NODES 50
+// direct indexed lookup: latin1 keys, keys from Qt::Key_Escape on, one slot per mouse button bit
+#define KEYMAP_KEY_TABLE_LOW 0x100
+#define KEYMAP_KEY_TABLE_HIGH 0x200
+#define KEYMAP_MOUSE_TABLE_SIZE 32
 
 class KeyMap : public QObject
 {
@@ -51,7 +55,7 @@ public:
         QPointF pos = QPointF(0, 0);                           // normal key
         QPointF extendPos = QPointF(0, 0);                     // for drag
         double extendOffset = 0.0;                             // for steerWheel
-        DelayClickNode delayClickNodes[MAX_DELAY_CLICK_NODES]; // for multi clicks
+        const DelayClickNode *delayClickNodes = nullptr;       // for multi clicks, owned by the keymap
         int delayClickNodesCount = 0;
         AndroidKeycode androidKey = AKEYCODE_UNKNOWN;          // for key press
 
@@ -117,7 +121,8 @@ public:
     KeyMap(QObject *parent = Q_NULLPTR);
     virtual ~KeyMap();
 
-    void loadKeyMap(const QString &json);
+    // the current keymap is kept if the json is invalid
+    bool loadKeyMap(const QString &json);
     const KeyMap::KeyMapNode &getKeyMapNode(int key);
     const KeyMap::KeyMapNode &getKeyMapNodeKey(int key);
     const KeyMap::KeyMapNode &getKeyMapNodeMouse(int key);
@@ -129,8 +134,27 @@ public:
     const KeyMap::KeyMapNode &getMouseMoveMap();
 
 private:
-    // set up the reverse map from key/event event to keyMapNode
-    void makeReverseMap();
+    // everything loadKeyMap() builds, swapped in as a whole
+    struct Compiled
+    {
+        QVector<KeyMapNode> keyMapNodes;
+        // the click nodes of all multi click nodes, in node order
+        QVector<DelayClickNode> delayClickNodes;
+        KeyNode switchKey = { AT_KEY, Qt::Key_QuoteLeft };
+        int idxSteerWheel = -1;
+        int idxMouseMove = -1;
+        // node index + 1, 0 if nothing is mapped
+        quint16 keyLow[KEYMAP_KEY_TABLE_LOW] = {};
+        quint16 keyHigh[KEYMAP_KEY_TABLE_HIGH] = {};
+        quint16 mouse[KEYMAP_MOUSE_TABLE_SIZE] = {};
+        // keys outside both key tables
+        QHash<int, quint16> keyOther;
+    };
+
+    // set up the lookup tables from key/mouse event to keyMapNode
+    void makeReverseMap(Compiled &compiled);
+    void mapKeyNode(Compiled &compiled, const KeyNode &keyNode, int index);
+    const KeyMap::KeyMapNode &nodeAt(quint16 slot);
 
     // safe check for base
     bool checkItemString(const QJsonObject &node, const QString &name);
@@ -160,25 +184,15 @@ private:
 private:
     static QString s_keyMapPath;
 
-    QVector<KeyMapNode> m_keyMapNodes;
-    KeyNode m_switchKey = { AT_KEY, Qt::Key_QuoteLeft };
+    QScopedPointer<Compiled> m_compiled;
 
     // just for return
     KeyMapNode m_invalidNode;
 
-    // steer wheel index
-    int m_idxSteerWheel = -1;
-
-    // mouse move index
-    int m_idxMouseMove = -1;
-
     // mapping of key/mouse event name to index
     QMetaEnum m_metaEnumKey = QMetaEnum::fromType<Qt::Key>();
     QMetaEnum m_metaEnumMouseButtons = QMetaEnum::fromType<Qt::MouseButtons>();
     QMetaEnum m_metaEnumKeyMapType = QMetaEnum::fromType<KeyMap::KeyMapType>();
-    // reverse map of key/mouse event
-    QMultiHash<int, KeyMapNode *> m_rmapKey;
-    QMultiHash<int, KeyMapNode *> m_rmapMouse;
 };
 
 #endif // KEYMAP_H
@@ -0,0 +1,217 @@
+#include <chrono>
+
+#include "inputscheduler.h"
+
+#define INPUT_WHEEL_TICK_NS 1000000
+// sleeping is only as precise as the OS timer, the rest is spun
+#define INPUT_SCHEDULER_SPIN_NS 1000000
+
+static qint64 steadyNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+InputScheduler &InputScheduler::instance()
+{
+    static InputScheduler scheduler;
+    return scheduler;
+}
+
+InputScheduler::InputScheduler()
+{
+    setObjectName("input scheduler");
+    m_wheelTick = steadyNowNs() / INPUT_WHEEL_TICK_NS;
+    start(QThread::TimeCriticalPriority);
+}
+
+InputScheduler::~InputScheduler()
+{
+    m_mutex.lock();
+    m_quit = true;
+    m_cond.wakeAll();
+    m_mutex.unlock();
+    wait();
+}
+
+quint64 InputScheduler::submit(const void *owner, const QVector<Step> &steps, Sink sink, Finished finished, int loops, qint64 loopPeriodNs,
+                              qint64 startNs)
+{
+    if (steps.isEmpty()) {
+        return 0;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    quint64 planId = m_nextPlanId++;
+    Plan &plan = m_plans[planId];
+    plan.owner = owner;
+    plan.steps = steps;
+    plan.startNs = startNs ? startNs : steadyNowNs();
+    plan.loops = qMax(0, loops);
+    plan.loopPeriodNs = qMax(loopPeriodNs, steps.last().offsetNs);
+    plan.sink = sink;
+    plan.finished = finished;
+    insert(plan.startNs + steps.first().offsetNs, planId);
+    m_cond.wakeOne();
+    return planId;
+}
+
+int InputScheduler::cancel(quint64 planId)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_plans.find(planId);
+    if (it == m_plans.end()) {
+        return -1;
+    }
+    // the wheel entry is dropped when its slot comes up
+    int sent = it->next;
+    m_plans.erase(it);
+    return sent;
+}
+
+void InputScheduler::cancelAll(const void *owner)
+{
+    QMutexLocker locker(&m_mutex);
+    for (auto it = m_plans.begin(); it != m_plans.end();) {
+        if (it->owner == owner) {
+            it = m_plans.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    m_timingErrors.remove(owner);
+}
+
+void InputScheduler::takeTimingError(const void *owner, quint64 &count, qint64 &sumNs, qint64 &maxNs)
+{
+    QMutexLocker locker(&m_mutex);
+    TimingError error = m_timingErrors.take(owner);
+    count = error.count;
+    sumNs = error.sumNs;
+    maxNs = error.maxNs;
+}
+
+void InputScheduler::insert(qint64 deadlineNs, quint64 planId)
+{
+    // a late deadline goes to the current slot, it is fired right away
+    qint64 tick = qMax(deadlineNs / INPUT_WHEEL_TICK_NS, m_wheelTick);
+    m_wheel[tick % INPUT_WHEEL_SLOTS].push_back({ deadlineNs, planId });
+}
+
+void InputScheduler::fire(quint64 planId, qint64 now)
+{
+    auto it = m_plans.find(planId);
+    if (it == m_plans.end()) {
+        // cancelled
+        return;
+    }
+    Plan &plan = *it;
+    TimingError &error = m_timingErrors[plan.owner];
+
+    // steps due at the same time go out in one write
+    QByteArray batch;
+    while (plan.next < plan.steps.size()) {
+        const Step &step = plan.steps[plan.next];
+        qint64 deadline = plan.startNs + step.offsetNs;
+        if (deadline > now) {
+            break;
+        }
+        batch.append(reinterpret_cast<const char *>(step.data), step.size);
+        error.count++;
+        error.sumNs += now - deadline;
+        error.maxNs = qMax(error.maxNs, now - deadline);
+        plan.next++;
+    }
+    if (!batch.isEmpty() && plan.sink) {
+        plan.sink(batch);
+    }
+
+    if (plan.next == plan.steps.size() && (0 == plan.loops || ++plan.loop < plan.loops)) {
+        // the next loop one period after the start of this one, however late it is served
+        plan.next = 0;
+        plan.startNs += plan.loopPeriodNs;
+    }
+    if (plan.next < plan.steps.size()) {
+        // planned from the start, a late step does not delay the following ones
+        insert(plan.startNs + plan.steps[plan.next].offsetNs, planId);
+        return;
+    }
+    Finished finished = plan.finished;
+    m_plans.erase(it);
+    if (finished) {
+        finished(planId);
+    }
+}
+
+qint64 InputScheduler::nextDeadline(qint64 now)
+{
+    // the first slot holding an entry of the current round has the earliest deadline
+    qint64 nowTick = now / INPUT_WHEEL_TICK_NS;
+    for (qint64 tick = nowTick; tick < nowTick + INPUT_WHEEL_SLOTS; tick++) {
+        qint64 earliest = -1;
+        for (const Entry &entry : m_wheel[tick % INPUT_WHEEL_SLOTS]) {
+            if (entry.deadlineNs / INPUT_WHEEL_TICK_NS <= tick && (earliest < 0 || entry.deadlineNs < earliest)) {
+                earliest = entry.deadlineNs;
+            }
+        }
+        if (earliest >= 0) {
+            return earliest;
+        }
+    }
+
+    // nothing within one revolution
+    qint64 earliest = -1;
+    for (const auto &slot : m_wheel) {
+        for (const Entry &entry : slot) {
+            if (earliest < 0 || entry.deadlineNs < earliest) {
+                earliest = entry.deadlineNs;
+            }
+        }
+    }
+    return earliest;
+}
+
+void InputScheduler::run()
+{
+    std::vector<Entry> due;
+    QMutexLocker locker(&m_mutex);
+    while (!m_quit) {
+        qint64 now = steadyNowNs();
+        qint64 nowTick = now / INPUT_WHEEL_TICK_NS;
+        qint64 firstTick = qMax(m_wheelTick, nowTick - INPUT_WHEEL_SLOTS + 1);
+        for (qint64 tick = firstTick; tick <= nowTick; tick++) {
+            std::vector<Entry> &slot = m_wheel[tick % INPUT_WHEEL_SLOTS];
+            for (size_t i = 0; i < slot.size();) {
+                if (slot[i].deadlineNs <= now) {
+                    due.push_back(slot[i]);
+                    slot[i] = slot.back();
+                    slot.pop_back();
+                } else {
+                    i++;
+                }
+            }
+        }
+        // the current slot stays open for the deadlines later in this tick
+        m_wheelTick = nowTick;
+        for (const Entry &entry : due) {
+            fire(entry.planId, now);
+        }
+        due.clear();
+
+        qint64 deadline = nextDeadline(now);
+        if (deadline < 0) {
+            m_cond.wait(&m_mutex);
+            continue;
+        }
+        qint64 remaining = deadline - steadyNowNs();
+        if (remaining > INPUT_SCHEDULER_SPIN_NS) {
+            m_cond.wait(&m_mutex, static_cast<unsigned long>((remaining - INPUT_SCHEDULER_SPIN_NS) / 1000000));
+            continue;
+        }
+        // a cancel or submit may come in while spinning, the loop checks again
+        locker.unlock();
+        while (steadyNowNs() < deadline) {
+            QThread::yieldCurrentThread();
+        }
+        locker.relock();
+    }
+}
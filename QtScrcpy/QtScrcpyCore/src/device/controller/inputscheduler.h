@@ -0,0 +1,96 @@
+#ifndef INPUTSCHEDULER_H
+#define INPUTSCHEDULER_H
+
+#include <functional>
+#include <vector>
+
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "controlmsg.h"
+
+// 1ms per slot, 256ms per revolution, later deadlines wait for their round
+#define INPUT_WHEEL_SLOTS 256
+
+// sends preplanned input animations (steer wheel, drag, multi click) at their deadline
+// from a thread of its own, so a busy GUI event loop does not make them stutter:
+// the thread sleeps on a timer wheel until shortly before the next deadline, then spins
+class InputScheduler : public QThread
+{
+public:
+    struct Step
+    {
+        // from the start of the plan
+        qint64 offsetNs = 0;
+        int size = 0;
+        uchar data[CONTROL_MSG_FIXED_MAX_SIZE];
+    };
+    typedef std::function<qint64(const QByteArray &)> Sink;
+    // called on the scheduler thread once the last step is sent
+    typedef std::function<void(quint64 planId)> Finished;
+
+    static InputScheduler &instance();
+
+    // the plan starts at startNs (steady clock), 0: now, the sink must be thread safe
+    // loops: the steps are repeated every loopPeriodNs on the scheduler timeline, 0: until cancelled
+    quint64 submit(const void *owner, const QVector<Step> &steps, Sink sink, Finished finished = Q_NULLPTR, int loops = 1,
+                   qint64 loopPeriodNs = 0, qint64 startNs = 0);
+    // no step is sent after it returns, returns the number of steps of the current loop sent,
+    // -1 if the plan is finished
+    int cancel(quint64 planId);
+    void cancelAll(const void *owner);
+    // actual minus planned send time of the steps of owner since the last call
+    void takeTimingError(const void *owner, quint64 &count, qint64 &sumNs, qint64 &maxNs);
+
+protected:
+    void run() override;
+
+private:
+    InputScheduler();
+    ~InputScheduler();
+
+    struct Entry
+    {
+        qint64 deadlineNs;
+        quint64 planId;
+    };
+    struct Plan
+    {
+        const void *owner = Q_NULLPTR;
+        QVector<Step> steps;
+        int next = 0;
+        // of the current loop
+        qint64 startNs = 0;
+        int loops = 1;
+        int loop = 0;
+        qint64 loopPeriodNs = 0;
+        Sink sink;
+        Finished finished;
+    };
+    struct TimingError
+    {
+        quint64 count = 0;
+        qint64 sumNs = 0;
+        qint64 maxNs = 0;
+    };
+
+    void insert(qint64 deadlineNs, quint64 planId);
+    void fire(quint64 planId, qint64 now);
+    qint64 nextDeadline(qint64 now);
+
+private:
+    QMutex m_mutex;
+    QWaitCondition m_cond;
+    bool m_quit = false;
+    quint64 m_nextPlanId = 1;
+    QHash<quint64, Plan> m_plans;
+    QHash<const void *, TimingError> m_timingErrors;
+    std::vector<Entry> m_wheel[INPUT_WHEEL_SLOTS];
+    // every slot before this tick is processed
+    qint64 m_wheelTick = 0;
+};
+
+#endif // INPUTSCHEDULER_H
@@ -0,0 +1,209 @@
+#include <algorithm>
+
+#include <QDebug>
+#include <QFile>
+
+#include "bufferutil.h"
+#include "macro.h"
+
+// "QSMA" + version
+#define MACRO_MAGIC 0x51534d41
+#define MACRO_VERSION 1
+#define MACRO_HEADER_SIZE 8
+// delta us (4) + message size (1)
+#define MACRO_RECORD_HEADER_SIZE 5
+// positions are stored as a 16.16 fraction of the frame
+#define MACRO_POS_SHIFT 16
+
+// offset of the position (x, y, width, height) in the serialized message, -1 if it has none
+static int positionOffset(quint8 type)
+{
+    switch (type) {
+    case ControlMsg::CMT_INJECT_TOUCH:
+        return 10;
+    case ControlMsg::CMT_INJECT_SCROLL:
+        return 1;
+    default:
+        return -1;
+    }
+}
+
+static bool isReplayable(quint8 type, int size)
+{
+    switch (type) {
+    case ControlMsg::CMT_INJECT_KEYCODE:
+        return CONTROL_MSG_INJECT_KEYCODE_SIZE == size;
+    case ControlMsg::CMT_INJECT_TOUCH:
+        return CONTROL_MSG_INJECT_TOUCH_SIZE == size;
+    case ControlMsg::CMT_INJECT_SCROLL:
+        return CONTROL_MSG_INJECT_SCROLL_SIZE == size;
+    case ControlMsg::CMT_BACK_OR_SCREEN_ON:
+        return 2 == size;
+    default:
+        return false;
+    }
+}
+
+Macro::Macro() {}
+
+void Macro::clear()
+{
+    m_events.clear();
+    m_sorted = true;
+}
+
+bool Macro::isEmpty() const
+{
+    return m_events.isEmpty();
+}
+
+int Macro::size() const
+{
+    return m_events.size();
+}
+
+bool Macro::append(const uchar *data, int size, qint64 stampNs)
+{
+    if (!data || size <= 0 || size > CONTROL_MSG_FIXED_MAX_SIZE || !isReplayable(data[0], size)) {
+        return false;
+    }
+
+    Event event;
+    event.stampNs = stampNs;
+    event.size = size;
+    memcpy(event.data, data, size);
+
+    int offset = positionOffset(data[0]);
+    if (0 <= offset) {
+        // x, y to fractions of width, height
+        qint64 x = static_cast<qint32>(BufferUtil::read32(data + offset));
+        qint64 y = static_cast<qint32>(BufferUtil::read32(data + offset + 4));
+        quint16 width = BufferUtil::read16(data + offset + 8);
+        quint16 height = BufferUtil::read16(data + offset + 10);
+        if (0 == width || 0 == height) {
+            return false;
+        }
+        BufferUtil::write32(event.data + offset, static_cast<quint32>(x * (1 << MACRO_POS_SHIFT) / width));
+        BufferUtil::write32(event.data + offset + 4, static_cast<quint32>(y * (1 << MACRO_POS_SHIFT) / height));
+        BufferUtil::write16(event.data + offset + 8, 0);
+        BufferUtil::write16(event.data + offset + 10, 0);
+    }
+
+    if (!m_events.isEmpty() && stampNs < m_events.last().stampNs) {
+        m_sorted = false;
+    }
+    m_events.append(event);
+    return true;
+}
+
+void Macro::sortEvents()
+{
+    if (m_sorted) {
+        return;
+    }
+    std::stable_sort(m_events.begin(), m_events.end(), [](const Event &a, const Event &b) { return a.stampNs < b.stampNs; });
+    m_sorted = true;
+}
+
+bool Macro::save(const QString &fileName)
+{
+    sortEvents();
+
+    QByteArray buffer;
+    buffer.resize(MACRO_HEADER_SIZE + m_events.size() * (MACRO_RECORD_HEADER_SIZE + CONTROL_MSG_FIXED_MAX_SIZE));
+    uchar *buf = reinterpret_cast<uchar *>(buffer.data());
+    BufferUtil::write32(buf, MACRO_MAGIC);
+    BufferUtil::write32(buf + 4, MACRO_VERSION);
+    int index = MACRO_HEADER_SIZE;
+
+    qint64 lastStampNs = m_events.isEmpty() ? 0 : m_events.first().stampNs;
+    for (const Event &event : m_events) {
+        qint64 deltaUs = (event.stampNs - lastStampNs) / 1000;
+        // keep the rounding error from adding up
+        lastStampNs += deltaUs * 1000;
+        BufferUtil::write32(buf + index, static_cast<quint32>(qBound<qint64>(0, deltaUs, 0xffffffff)));
+        buf[index + 4] = static_cast<uchar>(event.size);
+        memcpy(buf + index + MACRO_RECORD_HEADER_SIZE, event.data, event.size);
+        index += MACRO_RECORD_HEADER_SIZE + event.size;
+    }
+    buffer.resize(index);
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "macro: open file failed:" << fileName;
+        return false;
+    }
+    return file.write(buffer) == buffer.size();
+}
+
+bool Macro::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "macro: open file failed:" << fileName;
+        return false;
+    }
+    QByteArray buffer = file.readAll();
+    const uchar *buf = reinterpret_cast<const uchar *>(buffer.constData());
+    int size = buffer.size();
+    if (size < MACRO_HEADER_SIZE || MACRO_MAGIC != BufferUtil::read32(buf) || MACRO_VERSION != BufferUtil::read32(buf + 4)) {
+        qWarning() << "macro: invalid file:" << fileName;
+        return false;
+    }
+
+    QVector<Event> events;
+    qint64 stampNs = 0;
+    int index = MACRO_HEADER_SIZE;
+    while (index < size) {
+        if (size - index < MACRO_RECORD_HEADER_SIZE) {
+            qWarning() << "macro: truncated file:" << fileName;
+            return false;
+        }
+        Event event;
+        stampNs += static_cast<qint64>(BufferUtil::read32(buf + index)) * 1000;
+        event.stampNs = stampNs;
+        event.size = buf[index + 4];
+        index += MACRO_RECORD_HEADER_SIZE;
+        if (size - index < event.size || !isReplayable(buf[index], event.size)) {
+            qWarning() << "macro: invalid record in" << fileName;
+            return false;
+        }
+        memcpy(event.data, buf + index, event.size);
+        index += event.size;
+        events.append(event);
+    }
+
+    m_events.swap(events);
+    m_sorted = true;
+    return true;
+}
+
+QVector<InputScheduler::Step> Macro::plan(const QSize &frameSize)
+{
+    sortEvents();
+
+    QVector<InputScheduler::Step> steps;
+    if (m_events.isEmpty() || frameSize.isEmpty()) {
+        return steps;
+    }
+    steps.reserve(m_events.size());
+    qint64 firstStampNs = m_events.first().stampNs;
+    for (const Event &event : m_events) {
+        InputScheduler::Step step;
+        step.offsetNs = event.stampNs - firstStampNs;
+        step.size = event.size;
+        memcpy(step.data, event.data, event.size);
+
+        int offset = positionOffset(event.data[0]);
+        if (0 <= offset) {
+            qint64 x = static_cast<qint32>(BufferUtil::read32(event.data + offset));
+            qint64 y = static_cast<qint32>(BufferUtil::read32(event.data + offset + 4));
+            BufferUtil::write32(step.data + offset, static_cast<quint32>((x * frameSize.width()) / (1 << MACRO_POS_SHIFT)));
+            BufferUtil::write32(step.data + offset + 4, static_cast<quint32>((y * frameSize.height()) / (1 << MACRO_POS_SHIFT)));
+            BufferUtil::write16(step.data + offset + 8, static_cast<quint16>(frameSize.width()));
+            BufferUtil::write16(step.data + offset + 10, static_cast<quint16>(frameSize.height()));
+        }
+        steps.append(step);
+    }
+    return steps;
+}
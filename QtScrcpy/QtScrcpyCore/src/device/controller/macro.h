@@ -0,0 +1,45 @@
+#ifndef MACRO_H
+#define MACRO_H
+
+#include <QSize>
+#include <QString>
+#include <QVector>
+
+#include "inputscheduler.h"
+
+// recorded control messages with their time, touch and scroll positions are kept
+// relative to the frame so a macro replays on any resolution
+// only the fixed size input messages are kept (key, touch, scroll, back or screen on)
+class Macro
+{
+public:
+    Macro();
+
+    void clear();
+    bool isEmpty() const;
+    int size() const;
+    // a serialized control message, returns false if it does not replay
+    bool append(const uchar *data, int size, qint64 stampNs);
+
+    bool save(const QString &fileName);
+    bool load(const QString &fileName);
+
+    // the steps for a device showing frameSize, offsets from the first message
+    QVector<InputScheduler::Step> plan(const QSize &frameSize);
+
+private:
+    void sortEvents();
+
+private:
+    struct Event
+    {
+        qint64 stampNs = 0;
+        int size = 0;
+        uchar data[CONTROL_MSG_FIXED_MAX_SIZE];
+    };
+    QVector<Event> m_events;
+    // plan steps may be recorded ahead of messages sent later
+    bool m_sorted = true;
+};
+
+#endif // MACRO_H
@@ -1,66 +1,45 @@
-#include <QDebug>
-
-#include "bufferutil.h"
 #include "devicemsg.h"
 
 DeviceMsg::DeviceMsg(QObject *parent) : QObject(parent) {}
 
-DeviceMsg::~DeviceMsg()
-{
-    if (DMT_GET_CLIPBOARD == m_data.type && Q_NULLPTR != m_data.clipboardMsg.text) {
-        delete m_data.clipboardMsg.text;
-        m_data.clipboardMsg.text = Q_NULLPTR;
-    }
-}
+DeviceMsg::~DeviceMsg() {}
 
 DeviceMsg::DeviceMsgType DeviceMsg::type()
 {
-    return m_data.type;
+    return m_type;
 }
 
 void DeviceMsg::getClipboardMsgData(QString &text)
 {
-    text = QString::fromUtf8(m_data.clipboardMsg.text);
+    text = QString::fromUtf8(m_payload);
 }
 
-qint32 DeviceMsg::deserialize(QByteArray &byteArray)
+quint64 DeviceMsg::getAckClipboardSequence()
 {
-    QBuffer buf(&byteArray);
-    buf.open(QBuffer::ReadOnly);
-
-    qint64 len = buf.size();
-    char c = 0;
-    qint32 ret = 0;
-
-    if (len < 5) {
-        // at least type + empty string length
-        return 0; // not available
-    }
+    return m_sequence;
+}
 
-    buf.getChar(&c);
-    m_data.type = (DeviceMsgType)c;
-    switch (m_data.type) {
-    case DMT_GET_CLIPBOARD: {
-        m_data.clipboardMsg.text = Q_NULLPTR;
-        quint16 clipboardLen = BufferUtil::read32(buf);
-        if (clipboardLen > len - 5) {
-            ret = 0; // not available
-            break;
-        }
+void DeviceMsg::getUhidOutputMsgData(quint16 &id, QByteArray &data)
+{
+    id = m_uhidId;
+    data = m_payload;
+}
 
-        QByteArray text = buf.readAll();
-        m_data.clipboardMsg.text = new char[text.length() + 1];
-        memcpy(m_data.clipboardMsg.text, text.data(), text.length());
-        m_data.clipboardMsg.text[text.length()] = '\0';
+void DeviceMsg::setClipboardMsgData(const char *text, int len)
+{
+    m_type = DMT_GET_CLIPBOARD;
+    m_payload = QByteArray(text, len);
+}
 
-        ret = 5 + clipboardLen;
-        break;
-    }
-    default:
-        qWarning("Unsupported device msg type: %d", (int)m_data.type);
-        ret = -1; // error, we cannot recover
-    }
+void DeviceMsg::setAckClipboardMsgData(quint64 sequence)
+{
+    m_type = DMT_ACK_CLIPBOARD;
+    m_sequence = sequence;
+}
 
-    buf.close();
-    return ret;
+void DeviceMsg::setUhidOutputMsgData(quint16 id, const char *data, int len)
+{
+    m_type = DMT_UHID_OUTPUT;
+    m_uhidId = id;
+    m_payload = QByteArray(data, len);
 }
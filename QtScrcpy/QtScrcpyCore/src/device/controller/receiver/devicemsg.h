@@ -1,7 +1,8 @@
 #ifndef DEVICEMSG_H
 #define DEVICEMSG_H
 
-#include <QBuffer>
+#include <QByteArray>
+#include <QObject>
 
 #define DEVICE_MSG_MAX_SIZE (1 << 18) // 256k
 // type: 1 byte; length: 4 bytes
@@ -16,31 +17,28 @@ public:
         DMT_NULL = -1,
         // 和服务端对应
         DMT_GET_CLIPBOARD = 0,
+        DMT_ACK_CLIPBOARD,
+        DMT_UHID_OUTPUT,
     };
     explicit DeviceMsg(QObject *parent = nullptr);
     virtual ~DeviceMsg();
 
     DeviceMsg::DeviceMsgType type();
     void getClipboardMsgData(QString &text);
+    quint64 getAckClipboardSequence();
+    void getUhidOutputMsgData(quint16 &id, QByteArray &data);
 
-    qint32 deserialize(QByteArray &byteArray);
+    // filled by DeviceMsgParser
+    void setClipboardMsgData(const char *text, int len);
+    void setAckClipboardMsgData(quint64 sequence);
+    void setUhidOutputMsgData(quint16 id, const char *data, int len);
 
 private:
-    struct DeviceMsgData
-    {
-        DeviceMsgType type = DMT_NULL;
-        union
-        {
-            struct
-            {
-                char *text = Q_NULLPTR;
-            } clipboardMsg;
-        };
-        DeviceMsgData() {}
-        ~DeviceMsgData() {}
-    };
-
-    DeviceMsgData m_data;
+    DeviceMsgType m_type = DMT_NULL;
+    // clipboard text or uhid output report
+    QByteArray m_payload;
+    quint64 m_sequence = 0;
+    quint16 m_uhidId = 0;
 };
 
 #endif // DEVICEMSG_H
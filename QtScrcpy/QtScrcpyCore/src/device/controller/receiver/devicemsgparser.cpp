@@ -0,0 +1,130 @@
+#include <cstring>
+
+#include "bufferutil.h"
+#include "devicemsgparser.h"
+
+#define PARSER_INITIAL_SIZE 4096
+
+DeviceMsgParser::DeviceMsgParser()
+{
+    m_buffer.resize(PARSER_INITIAL_SIZE);
+}
+
+char *DeviceMsgParser::reserve(int size)
+{
+    if (m_buffer.size() - m_writePos < size) {
+        // move the unread bytes to the front before growing
+        int unread = m_writePos - m_readPos;
+        if (m_readPos > 0) {
+            memmove(m_buffer.data(), m_buffer.constData() + m_readPos, unread);
+            m_readPos = 0;
+            m_writePos = unread;
+        }
+        if (m_buffer.size() - m_writePos < size) {
+            int capacity = m_buffer.size();
+            while (capacity - m_writePos < size) {
+                capacity *= 2;
+            }
+            m_buffer.resize(capacity);
+        }
+    }
+    return m_buffer.data() + m_writePos;
+}
+
+void DeviceMsgParser::commit(int size)
+{
+    Q_ASSERT(m_writePos + size <= m_buffer.size());
+    m_writePos += size;
+}
+
+void DeviceMsgParser::append(const char *data, int size)
+{
+    if (!data || size <= 0) {
+        return;
+    }
+    memcpy(reserve(size), data, size);
+    commit(size);
+}
+
+int DeviceMsgParser::next(MsgView &view)
+{
+    int available = m_writePos - m_readPos;
+    const uchar *buf = reinterpret_cast<const uchar *>(m_buffer.constData()) + m_readPos;
+
+    if (0 == m_needed) {
+        if (available < 1) {
+            return 0;
+        }
+        switch (buf[0]) {
+        case DeviceMsg::DMT_GET_CLIPBOARD: {
+            // type: 1 byte; length: 4 bytes; text
+            if (available < 5) {
+                return 0;
+            }
+            quint32 len = BufferUtil::read32(buf + 1);
+            if (len > DEVICE_MSG_TEXT_MAX_LENGTH) {
+                return -1;
+            }
+            m_needed = 5 + static_cast<int>(len);
+            break;
+        }
+        case DeviceMsg::DMT_ACK_CLIPBOARD:
+            // type: 1 byte; sequence: 8 bytes
+            m_needed = 9;
+            break;
+        case DeviceMsg::DMT_UHID_OUTPUT:
+            // type: 1 byte; id: 2 bytes; size: 2 bytes; data
+            if (available < 5) {
+                return 0;
+            }
+            m_needed = 5 + BufferUtil::read16(buf + 3);
+            break;
+        default:
+            return -1;
+        }
+    }
+
+    if (available < m_needed) {
+        return 0;
+    }
+
+    view = MsgView();
+    view.type = static_cast<DeviceMsg::DeviceMsgType>(buf[0]);
+    switch (view.type) {
+    case DeviceMsg::DMT_GET_CLIPBOARD:
+        view.data = reinterpret_cast<const char *>(buf + 5);
+        view.size = m_needed - 5;
+        break;
+    case DeviceMsg::DMT_ACK_CLIPBOARD:
+        view.sequence = BufferUtil::read64(buf + 1);
+        break;
+    case DeviceMsg::DMT_UHID_OUTPUT:
+        view.uhidId = BufferUtil::read16(buf + 1);
+        view.data = reinterpret_cast<const char *>(buf + 5);
+        view.size = m_needed - 5;
+        break;
+    default:
+        break;
+    }
+
+    m_readPos += m_needed;
+    m_needed = 0;
+    if (m_readPos == m_writePos) {
+        // the view stays valid, the bytes are only overwritten by the next reserve()
+        m_readPos = 0;
+        m_writePos = 0;
+    }
+    return 1;
+}
+
+void DeviceMsgParser::reset()
+{
+    m_readPos = 0;
+    m_writePos = 0;
+    m_needed = 0;
+}
+
+int DeviceMsgParser::buffered()
+{
+    return m_writePos - m_readPos;
+}
@@ -0,0 +1,44 @@
+#ifndef DEVICEMSGPARSER_H
+#define DEVICEMSGPARSER_H
+
+#include <QByteArray>
+
+#include "devicemsg.h"
+
+// resumable parser for the device message stream
+// bytes are read straight into its buffer, once a header is complete the size of the
+// message is known and later reads only compare the buffered size against it
+class DeviceMsgParser
+{
+public:
+    // points into the parser buffer, valid until the next reserve()/append()
+    struct MsgView
+    {
+        DeviceMsg::DeviceMsgType type = DeviceMsg::DMT_NULL;
+        quint64 sequence = 0; // ack clipboard
+        quint16 uhidId = 0;   // uhid output
+        const char *data = nullptr; // clipboard text or uhid report
+        int size = 0;
+    };
+
+    DeviceMsgParser();
+
+    // room for size bytes at the write end, commit() what was actually written
+    char *reserve(int size);
+    void commit(int size);
+    void append(const char *data, int size);
+
+    // 1: view holds the next message, 0: more bytes needed, -1: corrupted stream
+    int next(MsgView &view);
+    void reset();
+    int buffered();
+
+private:
+    QByteArray m_buffer;
+    int m_readPos = 0;
+    int m_writePos = 0;
+    // size of the message at m_readPos, 0 while its header is incomplete
+    int m_needed = 0;
+};
+
+#endif // DEVICEMSGPARSER_H
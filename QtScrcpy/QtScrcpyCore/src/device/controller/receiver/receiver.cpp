@@ -1,6 +1,6 @@
-#include <QApplication>
-#include <QClipboard>
+#include <QDebug>
 
+#include "clipboardsync.h"
 #include "devicemsg.h"
 #include "receiver.h"
 
@@ -8,20 +8,34 @@ Receiver::Receiver(QObject *parent) : QObject(parent) {}
 
 Receiver::~Receiver() {}
 
+void Receiver::setClipboardSync(ClipboardSync *clipboardSync)
+{
+    m_clipboardSync = clipboardSync;
+}
+
 void Receiver::recvDeviceMsg(DeviceMsg *deviceMsg)
 {
     switch (deviceMsg->type()) {
     case DeviceMsg::DMT_GET_CLIPBOARD: {
-        qInfo("Device clipboard copied");
-        QClipboard *board = QApplication::clipboard();
         QString text;
         deviceMsg->getClipboardMsgData(text);
-
-        if (board->text() == text) {
-            qDebug("Computer clipboard unchanged");
-            break;
+        if (m_clipboardSync) {
+            m_clipboardSync->onDeviceClipboard(text);
         }
-        board->setText(text);
+        break;
+    }
+    case DeviceMsg::DMT_ACK_CLIPBOARD:
+        qDebug("Device clipboard set, sequence %llu", deviceMsg->getAckClipboardSequence());
+        if (m_clipboardSync) {
+            m_clipboardSync->onAckClipboard(deviceMsg->getAckClipboardSequence());
+        }
+        break;
+    case DeviceMsg::DMT_UHID_OUTPUT: {
+        quint16 id = 0;
+        QByteArray data;
+        deviceMsg->getUhidOutputMsgData(id, data);
+        // keyboard leds and the like, nothing to do with them yet
+        qDebug("UHID output for device %u, %d bytes", id, static_cast<int>(data.size()));
         break;
     }
     default:
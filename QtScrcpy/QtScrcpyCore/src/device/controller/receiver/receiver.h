@@ -4,6 +4,7 @@
 #include <QPointer>
 
 class DeviceMsg;
+class ClipboardSync;
 class Receiver : public QObject
 {
     Q_OBJECT
@@ -11,7 +12,11 @@ public:
     explicit Receiver(QObject *parent = Q_NULLPTR);
     virtual ~Receiver();
 
+    void setClipboardSync(ClipboardSync *clipboardSync);
     void recvDeviceMsg(DeviceMsg *deviceMsg);
+
+private:
+    QPointer<ClipboardSync> m_clipboardSync;
 };
 
 #endif // RECEIVER_H
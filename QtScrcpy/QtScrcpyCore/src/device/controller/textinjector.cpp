@@ -0,0 +1,199 @@
+#include <QDebug>
+
+#include "clipboardsync.h"
+#include "controller.h"
+#include "controlmsg.h"
+#include "textinjector.h"
+
+// chars per second
+#define INJECT_RATE_START 200.0
+#define INJECT_RATE_MIN 50.0
+#define INJECT_RATE_MAX 2000.0
+#define INJECT_RATE_STEP 50.0
+// longer text is pasted from the device clipboard instead of typed
+#define INJECT_CLIPBOARD_THRESHOLD 2000
+// chunks sent ahead of a marker ack
+#define INJECT_MARKER_CHUNKS 2
+
+TextInjector::TextInjector(Controller *controller, ClipboardSync *clipboardSync)
+    : QObject(controller)
+    , m_controller(controller)
+    , m_clipboardSync(clipboardSync)
+{
+    m_sendTimer.setSingleShot(true);
+    connect(&m_sendTimer, &QTimer::timeout, this, &TextInjector::onSendTimer);
+    connect(m_clipboardSync, &ClipboardSync::sendFinished, this, &TextInjector::onClipboardSent);
+}
+
+TextInjector::~TextInjector() {}
+
+void TextInjector::inject(const QString &text)
+{
+    if (text.isEmpty() || !m_controller) {
+        return;
+    }
+
+    if (text.length() > INJECT_CLIPBOARD_THRESHOLD && !isRunning()) {
+        qInfo("inject %d chars through the device clipboard", static_cast<int>(text.length()));
+        m_clock.start();
+        m_clipboardChars = text.length();
+        m_clipboardSequence = m_clipboardSync->sendText(text, true);
+        return;
+    }
+
+    QByteArray utf8 = text.toUtf8();
+    int pos = 0;
+    while (pos < utf8.size()) {
+        int len = qMin(CONTROL_MSG_INJECT_TEXT_MAX_LENGTH, static_cast<int>(utf8.size()) - pos);
+        // never cut inside a sequence, continuation bytes are 10xxxxxx
+        while (pos + len < utf8.size() && len > 0 && 0x80 == (static_cast<uchar>(utf8[pos + len]) & 0xC0)) {
+            len--;
+        }
+        if (0 == len) {
+            // not valid utf-8, let the device sort it out
+            len = qMin(CONTROL_MSG_INJECT_TEXT_MAX_LENGTH, static_cast<int>(utf8.size()) - pos);
+        }
+        m_chunks.enqueue(utf8.mid(pos, len));
+        pos += len;
+    }
+
+    if (!m_sendTimer.isActive() && 0 == m_clipboardSequence && 0 == m_markerSequence) {
+        startStream();
+    }
+}
+
+void TextInjector::cancel()
+{
+    m_chunks.clear();
+    m_sendTimer.stop();
+    m_clipboardSequence = 0;
+    m_markerSequence = 0;
+}
+
+bool TextInjector::isRunning()
+{
+    return m_sendTimer.isActive() || !m_chunks.isEmpty() || 0 != m_clipboardSequence || 0 != m_markerSequence;
+}
+
+void TextInjector::setBacklogQuery(std::function<qint64()> backlog)
+{
+    m_backlog = backlog;
+}
+
+void TextInjector::onSendTimer()
+{
+    if (m_chunks.isEmpty() || !m_controller) {
+        return;
+    }
+
+    if (!m_ackPaced && 0 < m_totalChars) {
+        // the previous chunk had its time, is the device still reading?
+        if (m_backlog && 0 < m_backlog()) {
+            m_rate = qMax(INJECT_RATE_MIN, m_rate / 2);
+        } else {
+            m_rate = qMin(INJECT_RATE_MAX, m_rate + INJECT_RATE_STEP);
+        }
+    }
+
+    QByteArray chunk = m_chunks.dequeue();
+    ControlMsg controlMsg(ControlMsg::CMT_INJECT_TEXT);
+    controlMsg.setInjectTextMsgData(chunk.constData(), chunk.size());
+    m_controller->sendControlMsg(controlMsg);
+
+    int chars = countChars(chunk);
+    m_totalChars += chars;
+    m_unmarkedChunks++;
+
+    if (m_ackPaced && (INJECT_MARKER_CHUNKS <= m_unmarkedChunks || m_chunks.isEmpty())) {
+        m_markerSequence = m_clipboardSync->sendMarker();
+        if (m_markerSequence) {
+            // the ack sends the next chunks
+            m_markerChars = m_totalChars;
+            m_unmarkedChunks = 0;
+            return;
+        }
+        qInfo("no clipboard marker, text injection paced by time");
+        m_ackPaced = false;
+    }
+
+    if (!m_chunks.isEmpty()) {
+        m_sendTimer.start(m_ackPaced ? 0 : static_cast<int>(chars * 1000 / m_rate));
+        return;
+    }
+    finishStream();
+}
+
+void TextInjector::finishStream()
+{
+    qint64 elapsed = m_ackedElapsed;
+    int chars = m_ackedChars;
+    if (m_ackedChars < m_totalChars) {
+        // not all acked, the time until the last chunk was handed over
+        elapsed = m_clock.elapsed();
+        chars = m_totalChars;
+    }
+    double charsPerSecond = elapsed > 0 ? chars * 1000.0 / elapsed : 0.0;
+    qInfo("injected %d chars in %lldms, %.1f chars/s%s", m_totalChars, elapsed, charsPerSecond, m_ackedChars < m_totalChars ? " (not acked)" : "");
+    emit injectFinished(m_totalChars, elapsed, charsPerSecond, false);
+}
+
+void TextInjector::onClipboardSent(quint64 sequence, bool acked)
+{
+    if (0 != m_markerSequence && sequence == m_markerSequence) {
+        m_markerSequence = 0;
+        if (acked) {
+            m_ackedChars = m_markerChars;
+            m_ackedElapsed = m_clock.elapsed();
+        } else {
+            m_ackPaced = false;
+        }
+        if (!m_chunks.isEmpty()) {
+            m_sendTimer.start(0);
+        } else {
+            finishStream();
+        }
+        return;
+    }
+    if (0 == m_clipboardSequence || sequence != m_clipboardSequence) {
+        return;
+    }
+    m_clipboardSequence = 0;
+    qint64 elapsed = m_clock.elapsed();
+    // the device acks once the text is on its clipboard
+    double charsPerSecond = acked && elapsed > 0 ? m_clipboardChars * 1000.0 / elapsed : 0.0;
+    if (acked) {
+        qInfo("injected %d chars through the clipboard in %lldms, %.1f chars/s", m_clipboardChars, elapsed, charsPerSecond);
+    } else {
+        qWarning("clipboard injection of %d chars not acked", m_clipboardChars);
+    }
+    emit injectFinished(m_clipboardChars, elapsed, charsPerSecond, true);
+
+    // text queued behind the paste
+    if (!m_chunks.isEmpty()) {
+        startStream();
+    }
+}
+
+void TextInjector::startStream()
+{
+    m_totalChars = 0;
+    m_rate = INJECT_RATE_START;
+    m_ackPaced = true;
+    m_unmarkedChunks = 0;
+    m_markerSequence = 0;
+    m_ackedChars = 0;
+    m_ackedElapsed = 0;
+    m_clock.start();
+    m_sendTimer.start(0);
+}
+
+int TextInjector::countChars(const QByteArray &utf8)
+{
+    int chars = 0;
+    for (char c : utf8) {
+        if (0x80 != (static_cast<uchar>(c) & 0xC0)) {
+            chars++;
+        }
+    }
+    return chars;
+}
@@ -0,0 +1,67 @@
+#ifndef TEXTINJECTOR_H
+#define TEXTINJECTOR_H
+
+#include <functional>
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QQueue>
+#include <QTimer>
+
+class ClipboardSync;
+class Controller;
+
+// streams long text as inject text messages of at most CONTROL_MSG_INJECT_TEXT_MAX_LENGTH
+// bytes, cut on utf-8 boundaries, paced by the device: every few chunks a clipboard marker is
+// sent and the next chunks wait for its ack, timed by the send backlog if no marker can be sent
+// text too long to be typed in reasonable time goes through the device clipboard and a paste,
+// sent by the clipboard sync so it knows what the device holds, timed until the device acks it
+class TextInjector : public QObject
+{
+    Q_OBJECT
+public:
+    TextInjector(Controller *controller, ClipboardSync *clipboardSync);
+    virtual ~TextInjector();
+
+    void inject(const QString &text);
+    void cancel();
+    bool isRunning();
+    // bytes not yet taken by the device, the pacing feedback without markers
+    void setBacklogQuery(std::function<qint64()> backlog);
+
+signals:
+    void injectFinished(int chars, qint64 elapsedMs, double charsPerSecond, bool viaClipboard);
+
+private slots:
+    void onSendTimer();
+    void onClipboardSent(quint64 sequence, bool acked);
+
+private:
+    void startStream();
+    void finishStream();
+    static int countChars(const QByteArray &utf8);
+
+private:
+    Controller *m_controller = Q_NULLPTR;
+    ClipboardSync *m_clipboardSync = Q_NULLPTR;
+    std::function<qint64()> m_backlog = Q_NULLPTR;
+    QQueue<QByteArray> m_chunks;
+    QTimer m_sendTimer;
+    QElapsedTimer m_clock;
+    // chars per second, additive increase while the device keeps up, halved when it does not
+    double m_rate = 0.0;
+    int m_totalChars = 0;
+    // paced by marker acks, until a marker cannot be sent or is lost
+    bool m_ackPaced = true;
+    int m_unmarkedChunks = 0;
+    quint64 m_markerSequence = 0;
+    int m_markerChars = 0;
+    // chars the device acked and when
+    int m_ackedChars = 0;
+    qint64 m_ackedElapsed = 0;
+    // the clipboard fallback waiting for its ack
+    quint64 m_clipboardSequence = 0;
+    int m_clipboardChars = 0;
+};
+
+#endif // TEXTINJECTOR_H
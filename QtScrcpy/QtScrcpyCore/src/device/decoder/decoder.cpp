@@ -12,13 +12,40 @@ Decoder::Decoder(std::function<void(int, int, uint8_t*, uint8_t*, uint8_t*, int,
     m_vb->init();
     connect(this, &Decoder::newFrame, this, &Decoder::onNewFrame, Qt::QueuedConnection);
     connect(m_vb, &VideoBuffer::updateFPS, this, &Decoder::updateFPS);
+    connect(m_vb, &VideoBuffer::updateFrameStats, this, &Decoder::updateFrameStats);
 }
 
 Decoder::~Decoder() {
+    if (m_shared) {
+        DecodeScheduler::instance().remove(this);
+    }
     m_vb->deInit();
     delete m_vb;
 }
 
+void Decoder::setShared(bool shared)
+{
+    m_shared = shared;
+}
+
+void Decoder::setPriority(bool high)
+{
+    if (m_shared) {
+        DecodeScheduler::instance().setPriority(this, high);
+    }
+}
+
+void Decoder::setSkipFrames(AVDiscard discard)
+{
+    m_skipFrames.store(discard);
+}
+
+void Decoder::setMemoryAccount(QSharedPointer<MemoryAccount> memory)
+{
+    m_memory = memory;
+    m_vb->setMemoryAccount(memory);
+}
+
 bool Decoder::open()
 {
     // codec
@@ -38,11 +65,18 @@ bool Decoder::open()
         m_codecCtx->skip_loop_filter = AVDISCARD_NONREF;
         m_codecCtx->thread_type = FF_THREAD_SLICE;
     }
+    if (m_shared) {
+        // the pool decodes the devices in parallel, a thread pool per context would multiply it
+        m_codecCtx->thread_count = 1;
+    }
     if (avcodec_open2(m_codecCtx, codec, NULL) < 0) {
         qCritical("Could not open H.264 codec");
         return false;
     }
     m_isCodecCtxOpen = true;
+    if (m_shared) {
+        DecodeScheduler::instance().add(this);
+    }
     return true;
 }
 
@@ -55,6 +89,10 @@ void Decoder::close()
     if (!m_codecCtx) {
         return;
     }
+    if (m_shared) {
+        // no pool thread uses the context after this
+        DecodeScheduler::instance().remove(this);
+    }
     if (m_isCodecCtxOpen) {
         avcodec_free_context(&m_codecCtx);
     }
@@ -66,7 +104,62 @@ bool Decoder::push(const AVPacket *packet)
     if (!m_codecCtx || !m_vb) {
         return false;
     }
+
+    if (m_shared) {
+        if (!DecodeScheduler::instance().push(this, packet)) {
+            qWarning("decode queue full, waiting for a key frame");
+            return false;
+        }
+        return true;
+    }
+    return decodeInOrder(packet);
+}
+
+void Decoder::decodePacket(const AVPacket *packet)
+{
+    if (!packet) {
+        // the scheduler dropped the queue
+        resync();
+        return;
+    }
+    if (!decodeInOrder(packet)) {
+        qCritical("Could not decode packet, request a key frame");
+        emit decodeFailed();
+    }
+}
+
+void Decoder::queuedBytesChanged(qint64 bytes)
+{
+    if (m_memory) {
+        m_memory->set(MemoryAccount::MC_DECODER, bytes);
+    }
+}
+
+bool Decoder::decodeInOrder(const AVPacket *packet)
+{
+    if (m_waitKeyFrame) {
+        if (!(packet->flags & AV_PKT_FLAG_KEY)) {
+            // predicted from broken references, it would only show garbage
+            m_droppedPackets++;
+            return true;
+        }
+        qInfo("decoder resynced on key frame, %u packets dropped", m_droppedPackets);
+        m_waitKeyFrame = false;
+        m_droppedPackets = 0;
+    }
+
+    if (!decode(packet)) {
+        resync();
+        return false;
+    }
+    return true;
+}
+
+bool Decoder::decode(const AVPacket *packet)
+{
     AVFrame *decodingFrame = m_vb->decodingFrame();
+    // applied on the decoding thread, the decoder checks it for each frame
+    m_codecCtx->skip_frame = static_cast<AVDiscard>(m_skipFrames.load());
 #ifdef QTSCRCPY_LAVF_HAS_NEW_ENCODING_DECODING_API
     int ret = -1;
     if ((ret = avcodec_send_packet(m_codecCtx, packet)) < 0) {
@@ -124,6 +217,13 @@ bool Decoder::push(const AVPacket *packet)
     return true;
 }
 
+void Decoder::resync()
+{
+    avcodec_flush_buffers(m_codecCtx);
+    m_waitKeyFrame = true;
+    m_droppedPackets = 0;
+}
+
 void Decoder::peekFrame(std::function<void (int, int, uint8_t *)> onFrame)
 {
     if (!m_vb) {
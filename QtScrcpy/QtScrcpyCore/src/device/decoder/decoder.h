@@ -1,29 +1,47 @@
 #ifndef DECODER_H
 #define DECODER_H
 #include <QObject>
+#include <QSharedPointer>
 
 extern "C"
 {
 #include "libavcodec/avcodec.h"
 }
 
+#include <atomic>
 #include <functional>
 
+#include "decodescheduler.h"
+#include "memoryaccount.h"
+
 class VideoBuffer;
-class Decoder : public QObject
+class Decoder : public QObject, public DecodeScheduler::Queue
 {
     Q_OBJECT
 public:
     Decoder(std::function<void(int width, int height, uint8_t* dataY, uint8_t* dataU, uint8_t* dataV, int linesizeY, int linesizeU, int linesizeV)> onFrame, QObject *parent = Q_NULLPTR);
     virtual ~Decoder();
 
+    // decode on the shared pool instead of the pushing thread, set before open()
+    void setShared(bool shared);
+    // the shared pool decodes this one before the others
+    void setPriority(bool high);
+    // any thread, frames the decoder discards (AVDISCARD_NONREF, AVDISCARD_NONKEY...)
+    void setSkipFrames(AVDiscard discard);
+    // the packets queued on the shared pool are counted as MC_DECODER
+    void setMemoryAccount(QSharedPointer<MemoryAccount> memory);
     bool open();
     void close();
+    // a failed push drops the decoder references, following packets are
+    // skipped until the next key frame
     bool push(const AVPacket *packet);
     void peekFrame(std::function<void(int width, int height, uint8_t* dataRGB32)> onFrame);
 
 signals:
     void updateFPS(quint32 fps);
+    void updateFrameStats(quint32 rendered, quint32 skipped);
+    // shared pool thread, a packet could not be decoded, request a key frame
+    void decodeFailed();
 
 private slots:
     void onNewFrame();
@@ -33,11 +51,21 @@ signals:
 
 private:
     void pushFrame();
+    bool decodeInOrder(const AVPacket *packet);
+    void decodePacket(const AVPacket *packet) override;
+    void queuedBytesChanged(qint64 bytes) override;
+    bool decode(const AVPacket *packet);
+    void resync();
 
 private:
     VideoBuffer *m_vb = Q_NULLPTR;
     AVCodecContext *m_codecCtx = Q_NULLPTR;
     bool m_isCodecCtxOpen = false;
+    bool m_shared = false;
+    std::atomic<int> m_skipFrames { AVDISCARD_DEFAULT };
+    QSharedPointer<MemoryAccount> m_memory;
+    bool m_waitKeyFrame = false;
+    quint32 m_droppedPackets = 0;
     std::function<void(int, int, uint8_t*, uint8_t*, uint8_t*, int, int, int)> m_onFrame = Q_NULLPTR;
 };
 
@@ -0,0 +1,250 @@
+#include <QDebug>
+
+#include "decodescheduler.h"
+
+// at most this many pool threads
+#define DECODE_MAX_THREADS 8
+// packets decoded per turn, then the lane goes back to the run queue
+#define DECODE_BATCH 4
+// about half a second of video, more means the pool cannot keep up with this device
+#define DECODE_QUEUE_MAX 30
+
+DecodeScheduler &DecodeScheduler::instance()
+{
+    static DecodeScheduler scheduler;
+    return scheduler;
+}
+
+DecodeScheduler::DecodeScheduler()
+{
+    int count = qBound(1, QThread::idealThreadCount(), DECODE_MAX_THREADS);
+    m_runQueues.resize(count);
+    for (int i = 0; i < count; ++i) {
+        Worker *worker = new Worker(this, i);
+        worker->start();
+        m_workers.append(worker);
+    }
+    qInfo("decode scheduler: %d threads", count);
+}
+
+DecodeScheduler::~DecodeScheduler()
+{
+    m_mutex.lock();
+    m_quit = true;
+    m_cond.wakeAll();
+    m_mutex.unlock();
+    for (Worker *worker : m_workers) {
+        worker->wait();
+    }
+    qDeleteAll(m_workers);
+    for (Lane *lane : m_lanes) {
+        dropPackets(lane);
+        delete lane;
+    }
+}
+
+void DecodeScheduler::add(Queue *queue)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!queue || m_lanes.contains(queue)) {
+        return;
+    }
+    Lane *lane = new Lane();
+    lane->queue = queue;
+    lane->home = m_nextHome;
+    m_nextHome = (m_nextHome + 1) % m_runQueues.size();
+    m_lanes.insert(queue, lane);
+}
+
+void DecodeScheduler::remove(Queue *queue)
+{
+    QMutexLocker locker(&m_mutex);
+    Lane *lane = m_lanes.take(queue);
+    if (!lane) {
+        return;
+    }
+    if (lane->ready) {
+        auto &runQueue = m_runQueues[lane->home];
+        for (auto it = runQueue.begin(); it != runQueue.end(); ++it) {
+            if (*it == lane) {
+                runQueue.erase(it);
+                break;
+            }
+        }
+    }
+    dropPackets(lane);
+    // the pool thread decoding it is told by the missing lane, the lane is deleted here
+    while (lane->running) {
+        m_idle.wait(&m_mutex);
+    }
+    delete lane;
+}
+
+bool DecodeScheduler::push(Queue *queue, const AVPacket *packet)
+{
+    QMutexLocker locker(&m_mutex);
+    Lane *lane = m_lanes.value(queue);
+    if (!lane) {
+        return false;
+    }
+
+    bool ok = true;
+    if (lane->packets.size() >= DECODE_QUEUE_MAX) {
+        // the references are lost anyway, decode again from the next key frame
+        dropPackets(lane);
+        lane->packets.push_back(Q_NULLPTR);
+        ok = false;
+    } else {
+        AVPacket *ref = av_packet_clone(packet);
+        if (!ref) {
+            qCritical("Could not reference packet");
+            return false;
+        }
+        lane->packets.push_back(ref);
+        account(lane, ref->size);
+    }
+    schedule(lane);
+    return ok;
+}
+
+void DecodeScheduler::setPriority(Queue *queue, bool high)
+{
+    QMutexLocker locker(&m_mutex);
+    Lane *lane = m_lanes.value(queue);
+    if (lane) {
+        // takes effect the next time it is scheduled
+        lane->priority = high;
+    }
+}
+
+int DecodeScheduler::threadCount()
+{
+    return m_workers.size();
+}
+
+void DecodeScheduler::schedule(Lane *lane)
+{
+    // a running lane is scheduled again by its thread, so one thread decodes it at a time
+    if (lane->ready || lane->running || lane->packets.empty()) {
+        return;
+    }
+    auto &runQueue = m_runQueues[lane->home];
+    if (lane->priority) {
+        runQueue.push_front(lane);
+    } else {
+        runQueue.push_back(lane);
+    }
+    lane->ready = true;
+    m_cond.wakeOne();
+}
+
+DecodeScheduler::Lane *DecodeScheduler::take(int index)
+{
+    // a priority lane anywhere, its own thread may be busy with a long batch
+    for (int i = 0; i < m_runQueues.size(); ++i) {
+        auto &runQueue = m_runQueues[(index + i) % m_runQueues.size()];
+        if (!runQueue.empty() && runQueue.front()->priority) {
+            Lane *lane = runQueue.front();
+            runQueue.pop_front();
+            lane->home = index;
+            return lane;
+        }
+    }
+
+    if (!m_runQueues[index].empty()) {
+        Lane *lane = m_runQueues[index].front();
+        m_runQueues[index].pop_front();
+        return lane;
+    }
+
+    // steal from the back of the longest run queue, the lane stays with the thief
+    int victim = -1;
+    size_t longest = 0;
+    for (int i = 0; i < m_runQueues.size(); ++i) {
+        if (m_runQueues[i].size() > longest) {
+            longest = m_runQueues[i].size();
+            victim = i;
+        }
+    }
+    if (victim < 0) {
+        return Q_NULLPTR;
+    }
+    Lane *lane = m_runQueues[victim].back();
+    m_runQueues[victim].pop_back();
+    lane->home = index;
+    return lane;
+}
+
+void DecodeScheduler::dropPackets(Lane *lane)
+{
+    qint64 bytes = 0;
+    for (AVPacket *packet : lane->packets) {
+        if (packet) {
+            bytes += packet->size;
+        }
+        av_packet_free(&packet);
+    }
+    lane->packets.clear();
+    account(lane, -bytes);
+}
+
+void DecodeScheduler::account(Lane *lane, qint64 bytes)
+{
+    if (!bytes) {
+        return;
+    }
+    lane->bytes += bytes;
+    lane->queue->queuedBytesChanged(lane->bytes);
+}
+
+void DecodeScheduler::work(int index)
+{
+    QVector<AVPacket *> batch;
+    QMutexLocker locker(&m_mutex);
+    while (!m_quit) {
+        Lane *lane = take(index);
+        if (!lane) {
+            m_cond.wait(&m_mutex);
+            continue;
+        }
+        lane->ready = false;
+        lane->running = true;
+        while (!lane->packets.empty() && batch.size() < DECODE_BATCH) {
+            batch.append(lane->packets.front());
+            lane->packets.pop_front();
+        }
+        Queue *queue = lane->queue;
+
+        locker.unlock();
+        qint64 bytes = 0;
+        for (AVPacket *packet : batch) {
+            queue->decodePacket(packet);
+            if (packet) {
+                bytes += packet->size;
+            }
+            av_packet_free(&packet);
+        }
+        batch.clear();
+        locker.relock();
+
+        // still alive while running, remove() waits for it
+        account(lane, -bytes);
+        lane->running = false;
+        if (!m_lanes.contains(queue)) {
+            // remove() waits for it
+            m_idle.wakeAll();
+            continue;
+        }
+        schedule(lane);
+    }
+}
+
+DecodeScheduler::Worker::Worker(DecodeScheduler *scheduler, int index) : m_scheduler(scheduler), m_index(index)
+{
+    setObjectName(QString("decode %1").arg(index));
+}
+
+void DecodeScheduler::Worker::run()
+{
+    m_scheduler->work(m_index);
+}
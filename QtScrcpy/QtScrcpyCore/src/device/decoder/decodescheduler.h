@@ -0,0 +1,92 @@
+#ifndef DECODESCHEDULER_H
+#define DECODESCHEDULER_H
+
+#include <deque>
+
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+extern "C"
+{
+#include "libavcodec/avcodec.h"
+}
+
+// decodes the video of all devices on a fixed pool of threads instead of one thread (or one
+// ffmpeg thread pool) per device: each device has a queue of packets, decoded in order by one
+// pool thread at a time; an idle thread steals ready devices from the others, devices with
+// priority (the focused window) go first
+class DecodeScheduler
+{
+public:
+    class Queue
+    {
+    public:
+        virtual ~Queue() {}
+        // pool thread, one packet after the other, null means the queue was dropped: flush
+        virtual void decodePacket(const AVPacket *packet) = 0;
+        // pool or pushing thread, bytes of the queued packets and of those being decoded
+        virtual void queuedBytesChanged(qint64 bytes) { Q_UNUSED(bytes) }
+    };
+
+    static DecodeScheduler &instance();
+
+    void add(Queue *queue);
+    // no packet of the queue is decoded once it returns, the pending ones are dropped
+    void remove(Queue *queue);
+    // any thread, takes a reference to the packet; false if the queue is full, then the
+    // pending packets are dropped and the queue gets a flush instead
+    bool push(Queue *queue, const AVPacket *packet);
+    void setPriority(Queue *queue, bool high);
+    int threadCount();
+
+private:
+    DecodeScheduler();
+    ~DecodeScheduler();
+
+    struct Lane
+    {
+        Queue *queue = Q_NULLPTR;
+        std::deque<AVPacket *> packets;
+        qint64 bytes = 0;
+        // the pool thread whose run queue takes it
+        int home = 0;
+        bool ready = false;
+        bool running = false;
+        bool priority = false;
+    };
+
+    class Worker : public QThread
+    {
+    public:
+        Worker(DecodeScheduler *scheduler, int index);
+
+    protected:
+        void run() override;
+
+    private:
+        DecodeScheduler *m_scheduler;
+        int m_index;
+    };
+
+    void work(int index);
+    void schedule(Lane *lane);
+    Lane *take(int index);
+    void dropPackets(Lane *lane);
+    void account(Lane *lane, qint64 bytes);
+
+private:
+    QMutex m_mutex;
+    QWaitCondition m_cond;
+    QWaitCondition m_idle;
+    bool m_quit = false;
+    QHash<Queue *, Lane *> m_lanes;
+    // ready lanes of each pool thread, priority lanes at the front
+    QVector<std::deque<Lane *>> m_runQueues;
+    QVector<Worker *> m_workers;
+    int m_nextHome = 0;
+};
+
+#endif // DECODESCHEDULER_H
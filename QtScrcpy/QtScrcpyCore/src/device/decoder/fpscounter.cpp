@@ -41,6 +41,7 @@ void FpsCounter::timerEvent(QTimerEvent *event)
         m_curSkipped = m_skipped;
         resetCounter();
         emit updateFPS(m_curRendered);
+        emit updateFrameStats(m_curRendered, m_curSkipped);
         //qInfo("FPS:%d Discard:%d", m_curRendered, m_skipped);
     }
 }
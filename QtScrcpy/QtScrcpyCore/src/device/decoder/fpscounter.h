@@ -17,6 +17,8 @@ public:
 
 signals:
     void updateFPS(quint32 fps);
+    // rendered and skipped frames of the last second
+    void updateFrameStats(quint32 rendered, quint32 skipped);
 
 protected:
     virtual void timerEvent(QTimerEvent *event);
@@ -9,10 +9,25 @@ extern "C"
 
 VideoBuffer::VideoBuffer(QObject *parent) : QObject(parent) {
     connect(&m_fpsCounter, &FpsCounter::updateFPS, this, &VideoBuffer::updateFPS);
+    connect(&m_fpsCounter, &FpsCounter::updateFrameStats, this, &VideoBuffer::updateFrameStats);
 }
 
 VideoBuffer::~VideoBuffer() {}
 
+static qint64 frameBytes(const AVFrame *frame)
+{
+    qint64 bytes = 0;
+    for (int i = 0; frame && i < AV_NUM_DATA_POINTERS && frame->buf[i]; ++i) {
+        bytes += frame->buf[i]->size;
+    }
+    return bytes;
+}
+
+void VideoBuffer::setMemoryAccount(QSharedPointer<MemoryAccount> memory)
+{
+    m_memory = memory;
+}
+
 bool VideoBuffer::init()
 {
     m_decodingFrame = av_frame_alloc();
@@ -89,6 +104,9 @@ void VideoBuffer::offerDecodedFrame(bool &previousFrameSkipped)
     swap();
     previousFrameSkipped = !m_renderingFrameConsumed;
     m_renderingFrameConsumed = false;
+    if (m_memory) {
+        m_memory->set(MemoryAccount::MC_VIDEO_BUFFER, frameBytes(m_decodingFrame) + frameBytes(m_renderingframe));
+    }
     m_mutex.unlock();
 }
 
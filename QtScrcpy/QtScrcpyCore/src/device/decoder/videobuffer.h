@@ -2,11 +2,13 @@
 #define VIDEO_BUFFER_H
 
 #include <QMutex>
+#include <QSharedPointer>
 #include <QWaitCondition>
 #include <QObject>
 
 #include <functional>
 #include "fpscounter.h"
+#include "memoryaccount.h"
 
 // forward declarations
 typedef struct AVFrame AVFrame;
@@ -23,6 +25,8 @@ public:
     void lock();
     void unLock();
     void setRenderExpiredFrames(bool renderExpiredFrames);
+    // the decoded and the rendering frame are counted as MC_VIDEO_BUFFER
+    void setMemoryAccount(QSharedPointer<MemoryAccount> memory);
 
     AVFrame *decodingFrame();
     // set the decoder frame as ready for rendering
@@ -43,6 +47,7 @@ public:
 
 signals:
     void updateFPS(quint32 fps);
+    void updateFrameStats(quint32 rendered, quint32 skipped);
 
 private:
     void swap();
@@ -53,6 +58,7 @@ private:
     QMutex m_mutex;
     bool m_renderingFrameConsumed = true;
     FpsCounter m_fpsCounter;
+    QSharedPointer<MemoryAccount> m_memory;
 
     bool m_renderExpiredFrames = false;
     QWaitCondition m_renderingFrameConsumedCond;
@@ -1,6 +1,12 @@
 #include <QDebug>
 #include <QTime>
 
+#ifdef Q_OS_LINUX
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
 #include "compat.h"
 #include "demuxer.h"
 #include "videosocket.h"
@@ -12,13 +18,21 @@
 
 #define SC_PACKET_PTS_MASK (SC_PACKET_FLAG_KEY_FRAME - 1)
 
+// packets handled per wake up in reactor mode, the other devices of the thread get their turn
+#define REACTOR_PACKETS_PER_WAKE 4
+
 typedef qint32 (*ReadPacketFunc)(void *, quint8 *, qint32);
 
 Demuxer::Demuxer(QObject *parent)
     : QThread(parent)
 {}
 
-Demuxer::~Demuxer() {}
+Demuxer::~Demuxer()
+{
+    if (m_reactor) {
+        stopDecode();
+    }
+}
 
 static void avLogCallback(void *avcl, int level, const char *fmt, va_list vl)
 {
@@ -67,9 +81,21 @@ void Demuxer::deInit()
     avformat_network_deinit(); // ignore failure
 }
 
+void Demuxer::setReactorMode(bool reactor)
+{
+    m_reactor = reactor && DemuxReactor::isSupported();
+}
+
+void Demuxer::setMemoryAccount(QSharedPointer<MemoryAccount> memory)
+{
+    m_memory = memory;
+}
+
 void Demuxer::installVideoSocket(VideoSocket *videoSocket)
 {
-    videoSocket->moveToThread(this);
+    if (!m_reactor) {
+        videoSocket->moveToThread(this);
+    }
     m_videoSocket = videoSocket;
 }
 
@@ -90,6 +116,21 @@ static quint64 bufferRead64be(quint8 *buf)
     return (static_cast<quint64>(msb) << 32) | lsb;
 }
 
+static void setPacketHeader(AVPacket *packet, quint64 ptsFlags)
+{
+    if (ptsFlags & SC_PACKET_FLAG_CONFIG) {
+        packet->pts = AV_NOPTS_VALUE;
+    } else {
+        packet->pts = ptsFlags & SC_PACKET_PTS_MASK;
+    }
+
+    if (ptsFlags & SC_PACKET_FLAG_KEY_FRAME) {
+        packet->flags |= AV_PKT_FLAG_KEY;
+    }
+
+    packet->dts = packet->pts;
+}
+
 qint32 Demuxer::recvData(quint8 *buf, qint32 bufSize)
 {
     if (!buf || !m_videoSocket) {
@@ -105,33 +146,140 @@ bool Demuxer::startDecode()
     if (!m_videoSocket) {
         return false;
     }
-    start();
+    if (!m_reactor) {
+        start();
+        return true;
+    }
+
+#ifdef Q_OS_LINUX
+    // the reactor reads the socket itself, keep the descriptor and what Qt has buffered already
+    m_reactorFd = ::dup(static_cast<int>(m_videoSocket->socketDescriptor()));
+    m_leftover = m_videoSocket->readAll();
+    m_videoSocket->abort();
+    delete m_videoSocket;
+    m_videoSocket = Q_NULLPTR;
+
+    m_reactorPacket = av_packet_alloc();
+    m_headerLen = 0;
+    m_bodyLen = 0;
+    m_bodyPending = false;
+    int fd = m_reactorFd;
+    if (fd < 0 || !m_reactorPacket || !openParser()) {
+        qCritical("Could not start the stream");
+        closed();
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return false;
+    }
+    if (!DemuxReactor::instance().add(fd, this)) {
+        qCritical("Could not add the stream to the reactor");
+        closed();
+        ::close(fd);
+        return false;
+    }
     return true;
+#else
+    return false;
+#endif
 }
 
 void Demuxer::stopDecode()
 {
-    wait();
+    if (!m_reactor) {
+        wait();
+        return;
+    }
+    // if the stream has ended already, closed() has cleaned up
+    if (DemuxReactor::instance().remove(this)) {
+        closeParser();
+        av_packet_free(&m_reactorPacket);
+        m_reactorFd = -1;
+        m_leftover.clear();
+        m_bodyPending = false;
+        updateMemory();
+    }
 }
 
-void Demuxer::run()
+Demuxer::StreamStats Demuxer::takeStats()
+{
+    QMutexLocker locker(&m_statsMutex);
+    StreamStats stats = m_stats;
+    m_stats = StreamStats();
+    m_stats.jitterMs = stats.jitterMs;
+    return stats;
+}
+
+void Demuxer::updateMemory()
+{
+    if (!m_memory) {
+        return;
+    }
+    qint64 bytes = m_leftover.size();
+    if (m_pending) {
+        bytes += m_pending->size;
+    }
+    if (m_bodyPending && m_reactorPacket) {
+        bytes += m_reactorPacket->size;
+    }
+    m_memory->set(MemoryAccount::MC_DEMUXER, bytes);
+}
+
+quint64 Demuxer::totalBytes()
+{
+    return m_totalBytes.load();
+}
+
+void Demuxer::updateStats(const AVPacket *packet)
+{
+    m_totalBytes += HEADER_SIZE + packet->size;
+    qint64 backlog = m_videoSocket ? m_videoSocket->bytesAvailable() : 0;
+#ifdef Q_OS_LINUX
+    int pending = 0;
+    if (m_reactorFd >= 0 && 0 == ioctl(m_reactorFd, FIONREAD, &pending)) {
+        backlog = pending + m_leftover.size();
+    }
+#endif
+    qint64 arrivalUs = m_arrivalTimer.nsecsElapsed() / 1000;
+
+    // config packets carry no pts
+    if (packet->pts != AV_NOPTS_VALUE) {
+        if (m_lastArrivalUs >= 0 && m_lastPts != AV_NOPTS_VALUE) {
+            qint64 d = (arrivalUs - m_lastArrivalUs) - (packet->pts - m_lastPts);
+            m_jitterUs += (qAbs(d) - m_jitterUs) / 16.0;
+        }
+        m_lastArrivalUs = arrivalUs;
+        m_lastPts = packet->pts;
+    }
+
+    QMutexLocker locker(&m_statsMutex);
+    m_stats.bytes += HEADER_SIZE + packet->size;
+    m_stats.packets++;
+    m_stats.jitterMs = m_jitterUs / 1000.0;
+    m_stats.backlogBytes = qMax(m_stats.backlogBytes, backlog);
+}
+
+bool Demuxer::openParser()
 {
     m_codecCtx = Q_NULLPTR;
     m_parser = Q_NULLPTR;
-    AVPacket *packet = Q_NULLPTR;
+    m_arrivalTimer.start();
+    m_lastArrivalUs = -1;
+    m_lastPts = AV_NOPTS_VALUE;
+    m_jitterUs = 0;
 
     // codec
     const AVCodec* codec = avcodec_find_decoder(AV_CODEC_ID_H264);
     if (!codec) {
         qCritical("H.264 decoder not found");
-        goto runQuit;
+        return false;
     }
 
     // codeCtx
     m_codecCtx = avcodec_alloc_context3(codec);
     if (!m_codecCtx) {
         qCritical("Could not allocate codec context");
-        goto runQuit;
+        return false;
     }
     m_codecCtx->flags |= AV_CODEC_FLAG_LOW_DELAY;
     m_codecCtx->width = m_frameSize.width();
@@ -141,12 +289,38 @@ void Demuxer::run()
     m_parser = av_parser_init(AV_CODEC_ID_H264);
     if (!m_parser) {
         qCritical("Could not initialize parser");
-        goto runQuit;
+        return false;
     }
 
     // We must only pass complete frames to av_parser_parse2()!
     // It's more complicated, but this allows to reduce the latency by 1 frame!
     m_parser->flags |= PARSER_FLAG_COMPLETE_FRAMES;
+    return true;
+}
+
+void Demuxer::closeParser()
+{
+    if (m_pending) {
+        av_packet_free(&m_pending);
+    }
+
+    if (m_parser) {
+        av_parser_close(m_parser);
+        m_parser = Q_NULLPTR;
+    }
+
+    if (m_codecCtx) {
+        avcodec_free_context(&m_codecCtx);
+    }
+}
+
+void Demuxer::run()
+{
+    AVPacket *packet = Q_NULLPTR;
+
+    if (!openParser()) {
+        goto runQuit;
+    }
 
     packet = av_packet_alloc();
     if (!packet) {
@@ -160,9 +334,11 @@ void Demuxer::run()
             // end of stream
             break;
         }
+        updateStats(packet);
 
         ok = pushPacket(packet);
         av_packet_unref(packet);
+        updateMemory();
         if (!ok) {
             // cannot process packet (error already logged)
             break;
@@ -171,18 +347,11 @@ void Demuxer::run()
 
     qDebug("End of frames");
 
-    if (m_pending) {
-        av_packet_free(&m_pending);
-    }
-
     av_packet_free(&packet);
 
-    av_parser_close(m_parser);
-
 runQuit:
-    if (m_codecCtx) {
-        avcodec_free_context(&m_codecCtx);
-    }
+    closeParser();
+    updateMemory();
 
     if (m_videoSocket) {
         m_videoSocket->close();
@@ -237,18 +406,113 @@ bool Demuxer::recvPacket(AVPacket *packet)
         return false;
     }
 
-    if (ptsFlags & SC_PACKET_FLAG_CONFIG) {
-        packet->pts = AV_NOPTS_VALUE;
-    } else {
-        packet->pts = ptsFlags & SC_PACKET_PTS_MASK;
+    setPacketHeader(packet, ptsFlags);
+    return true;
+}
+
+bool Demuxer::readReady(int fd)
+{
+    for (int i = 0; i < REACTOR_PACKETS_PER_WAKE; ++i) {
+        int ret = recvPacketNonBlock(fd);
+        if (0 == ret) {
+            // wait for more data, a partial packet is held meanwhile
+            updateMemory();
+            return true;
+        }
+        if (ret < 0) {
+            qDebug("End of frames");
+            return false;
+        }
+        updateStats(m_reactorPacket);
+
+        bool ok = pushPacket(m_reactorPacket);
+        av_packet_unref(m_reactorPacket);
+        updateMemory();
+        if (!ok) {
+            // cannot process packet (error already logged)
+            return false;
+        }
     }
+    // level triggered, called again right away if more is buffered
+    return true;
+}
 
-    if (ptsFlags & SC_PACKET_FLAG_KEY_FRAME) {
-        packet->flags |= AV_PKT_FLAG_KEY;
+void Demuxer::closed()
+{
+    closeParser();
+    av_packet_free(&m_reactorPacket);
+    m_reactorFd = -1;
+    m_leftover.clear();
+    m_bodyPending = false;
+    updateMemory();
+
+    emit onStreamStop();
+}
+
+int Demuxer::recvPacketNonBlock(int fd)
+{
+    // same layout as recvPacket(), but the header and the packet may arrive in any number of
+    // pieces: returns 1 once a packet is complete, 0 if more data is needed, -1 at the end
+    while (m_headerLen < HEADER_SIZE) {
+        qint32 r = readNonBlock(fd, m_header + m_headerLen, HEADER_SIZE - m_headerLen);
+        if (r <= 0) {
+            return r;
+        }
+        m_headerLen += r;
     }
 
-    packet->dts = packet->pts;
-    return true;
+    if (!m_bodyPending) {
+        quint32 len = bufferRead32be(&m_header[8]);
+        Q_ASSERT(len);
+        if (av_new_packet(m_reactorPacket, static_cast<int>(len))) {
+            qCritical("Could not allocate packet");
+            return -1;
+        }
+        m_bodyLen = 0;
+        m_bodyPending = true;
+    }
+
+    while (m_bodyLen < m_reactorPacket->size) {
+        qint32 r = readNonBlock(fd, m_reactorPacket->data + m_bodyLen, m_reactorPacket->size - m_bodyLen);
+        if (r <= 0) {
+            return r;
+        }
+        m_bodyLen += r;
+    }
+
+    setPacketHeader(m_reactorPacket, bufferRead64be(m_header));
+    m_headerLen = 0;
+    m_bodyPending = false;
+    return 1;
+}
+
+qint32 Demuxer::readNonBlock(int fd, quint8 *buf, qint32 bufSize)
+{
+    // returns the bytes read, 0 if nothing is available, -1 at the end of the stream
+    if (!m_leftover.isEmpty()) {
+        qint32 len = qMin(bufSize, static_cast<qint32>(m_leftover.size()));
+        memcpy(buf, m_leftover.constData(), static_cast<size_t>(len));
+        m_leftover.remove(0, len);
+        return len;
+    }
+#ifdef Q_OS_LINUX
+    for (;;) {
+        ssize_t r = ::read(fd, buf, static_cast<size_t>(bufSize));
+        if (r > 0) {
+            return static_cast<qint32>(r);
+        }
+        if (0 == r) {
+            return -1;
+        }
+        if (EINTR == errno) {
+            continue;
+        }
+        return (EAGAIN == errno || EWOULDBLOCK == errno) ? 0 : -1;
+    }
+#else
+    Q_UNUSED(fd)
+    return -1;
+#endif
 }
 
 bool Demuxer::pushPacket(AVPacket *packet)
@@ -1,7 +1,13 @@
 #ifndef STREAM_H
 #define STREAM_H
 
+#include <atomic>
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMutex>
 #include <QPointer>
+#include <QSharedPointer>
 #include <QSize>
 #include <QThread>
 
@@ -11,22 +17,43 @@ extern "C"
 #include "libavformat/avformat.h"
 }
 
+#include "demuxreactor.h"
+#include "memoryaccount.h"
+
 class VideoSocket;
-class Demuxer : public QThread
+class Demuxer : public QThread, public DemuxReactor::Source
 {
     Q_OBJECT
 public:
     Demuxer(QObject *parent = Q_NULLPTR);
     virtual ~Demuxer();
 
+public:
+    struct StreamStats
+    {
+        quint64 bytes = 0;        // bytes received, headers included
+        quint32 packets = 0;
+        double jitterMs = 0;      // smoothed arrival jitter against the packet pts (RFC 3550 style)
+        qint64 backlogBytes = 0;  // most bytes left in the socket after reading a packet
+    };
+
 public:
     static bool init();
     static void deInit();
 
+    // the socket is read by the shared reactor threads instead of a thread of its own,
+    // falls back to the thread where the reactor is not supported, set before installVideoSocket()
+    void setReactorMode(bool reactor);
+    // the config packets waiting for their frame and the packet being received are counted as MC_DEMUXER
+    void setMemoryAccount(QSharedPointer<MemoryAccount> memory);
     void installVideoSocket(VideoSocket* videoSocket);
     void setFrameSize(const QSize &frameSize);
     bool startDecode();
     void stopDecode();
+    // counters since the previous call, may be called from any thread
+    StreamStats takeStats();
+    // any thread, bytes received since the demuxer was created, never reset
+    quint64 totalBytes();
 
 signals:
     void onStreamStop();
@@ -35,12 +62,22 @@ signals:
 
 protected:
     void run();
+    bool openParser();
+    void closeParser();
     bool recvPacket(AVPacket *packet);
     bool pushPacket(AVPacket *packet);
     bool processConfigPacket(AVPacket *packet);
     bool parse(AVPacket *packet);
     bool processFrame(AVPacket *packet);
     qint32 recvData(quint8 *buf, qint32 bufSize);
+    void updateStats(const AVPacket *packet);
+    void updateMemory();
+
+    // reactor mode, called on a reactor thread
+    bool readReady(int fd) override;
+    void closed() override;
+    int recvPacketNonBlock(int fd);
+    qint32 readNonBlock(int fd, quint8 *buf, qint32 bufSize);
 
 private:
     QPointer<VideoSocket> m_videoSocket;
@@ -51,6 +88,25 @@ private:
     // successive packets may need to be concatenated, until a non-config
     // packet is available
     AVPacket* m_pending = Q_NULLPTR;
+
+    QMutex m_statsMutex;
+    StreamStats m_stats;
+    std::atomic<quint64> m_totalBytes { 0 };
+    QSharedPointer<MemoryAccount> m_memory;
+    QElapsedTimer m_arrivalTimer;
+    qint64 m_lastArrivalUs = -1;
+    qint64 m_lastPts = AV_NOPTS_VALUE;
+    double m_jitterUs = 0;
+
+    bool m_reactor = false;
+    // reactor mode: the socket, what the VideoSocket had buffered and the packet being received
+    int m_reactorFd = -1;
+    QByteArray m_leftover;
+    AVPacket *m_reactorPacket = Q_NULLPTR;
+    quint8 m_header[12];
+    int m_headerLen = 0;
+    int m_bodyLen = 0;
+    bool m_bodyPending = false;
 };
 
 #endif // STREAM_H
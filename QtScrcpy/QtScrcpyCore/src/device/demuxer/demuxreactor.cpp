@@ -0,0 +1,263 @@
+#include <QDebug>
+
+#ifdef Q_OS_LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#include "demuxreactor.h"
+
+// events taken per epoll_wait()
+#define REACTOR_MAX_EVENTS 64
+// at most this many pool threads, they only receive, the devices decode on the shared decode pool
+#define REACTOR_MAX_THREADS 8
+
+DemuxReactor &DemuxReactor::instance()
+{
+    static DemuxReactor reactor;
+    return reactor;
+}
+
+bool DemuxReactor::isSupported()
+{
+#ifdef Q_OS_LINUX
+    return true;
+#else
+    return false;
+#endif
+}
+
+DemuxReactor::DemuxReactor()
+{
+    if (!isSupported()) {
+        return;
+    }
+    int count = qBound(1, QThread::idealThreadCount(), REACTOR_MAX_THREADS);
+    for (int i = 0; i < count; ++i) {
+        DemuxReactorWorker *worker = new DemuxReactorWorker(i);
+        if (!worker->isValid()) {
+            delete worker;
+            break;
+        }
+        worker->start();
+        m_workers.append(worker);
+    }
+    qInfo("demux reactor: %d threads", m_workers.size());
+}
+
+DemuxReactor::~DemuxReactor()
+{
+    qDeleteAll(m_workers);
+    m_workers.clear();
+}
+
+bool DemuxReactor::add(int fd, Source *source)
+{
+    if (fd < 0 || !source || m_workers.isEmpty()) {
+        return false;
+    }
+    // the least busy thread, a device stays on it until its stream ends
+    DemuxReactorWorker *worker = m_workers.first();
+    for (DemuxReactorWorker *item : m_workers) {
+        if (item->sourceCount() < worker->sourceCount()) {
+            worker = item;
+        }
+    }
+    return worker->add(fd, source);
+}
+
+bool DemuxReactor::remove(Source *source)
+{
+    for (DemuxReactorWorker *worker : m_workers) {
+        if (worker->remove(source)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int DemuxReactor::threadCount()
+{
+    return m_workers.size();
+}
+
+DemuxReactorWorker::DemuxReactorWorker(int index)
+{
+    setObjectName(QString("demux reactor %1").arg(index));
+#ifdef Q_OS_LINUX
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    m_wake = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m_epoll >= 0 && m_wake >= 0) {
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.ptr = Q_NULLPTR;
+        epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wake, &event);
+    }
+#else
+    Q_UNUSED(index)
+#endif
+}
+
+DemuxReactorWorker::~DemuxReactorWorker()
+{
+#ifdef Q_OS_LINUX
+    if (isRunning()) {
+        m_mutex.lock();
+        m_quit = true;
+        m_mutex.unlock();
+        quint64 one = 1;
+        if (::write(m_wake, &one, sizeof(one)) < 0) {
+            qWarning("demux reactor: wake failed");
+        }
+        wait();
+    }
+    for (auto it = m_sources.constBegin(); it != m_sources.constEnd(); ++it) {
+        ::close(it.value());
+    }
+    if (m_wake >= 0) {
+        ::close(m_wake);
+    }
+    if (m_epoll >= 0) {
+        ::close(m_epoll);
+    }
+#endif
+}
+
+bool DemuxReactorWorker::isValid()
+{
+    return m_epoll >= 0 && m_wake >= 0;
+}
+
+int DemuxReactorWorker::sourceCount()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_sources.size();
+}
+
+bool DemuxReactorWorker::add(int fd, DemuxReactor::Source *source)
+{
+#ifdef Q_OS_LINUX
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        return false;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_sources.insert(source, fd);
+    // level triggered: a source may stop reading early to let the others run
+    struct epoll_event event = {};
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.ptr = source;
+    if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event) < 0) {
+        m_sources.remove(source);
+        return false;
+    }
+    return true;
+#else
+    Q_UNUSED(fd)
+    Q_UNUSED(source)
+    return false;
+#endif
+}
+
+bool DemuxReactorWorker::remove(DemuxReactor::Source *source)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_sources.contains(source)) {
+        // it may be in closed() right now
+        while (m_current == source) {
+            m_idle.wait(&m_mutex);
+        }
+        return false;
+    }
+    int fd = m_sources.take(source);
+#ifdef Q_OS_LINUX
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, Q_NULLPTR);
+#endif
+    // it may be in readReady() right now, the socket is closed once it is done with it
+    while (m_current == source) {
+        m_idle.wait(&m_mutex);
+    }
+#ifdef Q_OS_LINUX
+    ::close(fd);
+#else
+    Q_UNUSED(fd)
+#endif
+    return true;
+}
+
+void DemuxReactorWorker::run()
+{
+#ifdef Q_OS_LINUX
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    for (;;) {
+        int count = epoll_wait(m_epoll, events, REACTOR_MAX_EVENTS, -1);
+        if (count < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            qCritical("demux reactor: epoll_wait failed: %d", errno);
+            return;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            DemuxReactor::Source *source = static_cast<DemuxReactor::Source *>(events[i].data.ptr);
+            if (!source) {
+                // only the destructor wakes it, the quit flag tells
+                quint64 value = 0;
+                ssize_t r = ::read(m_wake, &value, sizeof(value));
+                Q_UNUSED(r)
+                QMutexLocker locker(&m_mutex);
+                if (m_quit) {
+                    return;
+                }
+                continue;
+            }
+            service(source);
+        }
+    }
+#endif
+}
+
+void DemuxReactorWorker::service(DemuxReactor::Source *source)
+{
+#ifdef Q_OS_LINUX
+    int fd = -1;
+    {
+        QMutexLocker locker(&m_mutex);
+        // removed since epoll_wait() returned
+        if (!m_sources.contains(source)) {
+            return;
+        }
+        fd = m_sources.value(source);
+        m_current = source;
+    }
+
+    bool open = source->readReady(fd);
+
+    bool ended = false;
+    if (!open) {
+        QMutexLocker locker(&m_mutex);
+        // unless remove() took it meanwhile, then it closes the socket and nothing is reported
+        if (m_sources.contains(source)) {
+            m_sources.remove(source);
+            epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, Q_NULLPTR);
+            ::close(fd);
+            ended = true;
+        }
+    }
+    if (ended) {
+        // remove() waits for it, m_current is still the source
+        source->closed();
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_current = Q_NULLPTR;
+    m_idle.wakeAll();
+#else
+    Q_UNUSED(source)
+#endif
+}
@@ -0,0 +1,74 @@
+#ifndef DEMUXREACTOR_H
+#define DEMUXREACTOR_H
+
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+class DemuxReactorWorker;
+
+// services the video sockets of all devices from a fixed pool of threads (epoll, Linux only),
+// instead of one thread per device blocked in a read: each socket is bound to one pool thread,
+// which reads it non blocking whenever it is readable
+class DemuxReactor
+{
+public:
+    class Source
+    {
+    public:
+        virtual ~Source() {}
+        // pool thread, reads what is available, false at the end of the stream or on error
+        virtual bool readReady(int fd) = 0;
+        // pool thread, after a false readReady(), the socket is already closed
+        virtual void closed() = 0;
+    };
+
+    static DemuxReactor &instance();
+    static bool isSupported();
+
+    // takes the socket over, it is closed when the stream ends or the source is removed
+    bool add(int fd, Source *source);
+    // the source is not touched anymore once it returns, false if it was gone already
+    bool remove(Source *source);
+    int threadCount();
+
+private:
+    DemuxReactor();
+    ~DemuxReactor();
+
+private:
+    QVector<DemuxReactorWorker *> m_workers;
+};
+
+class DemuxReactorWorker : public QThread
+{
+public:
+    DemuxReactorWorker(int index);
+    ~DemuxReactorWorker();
+
+    bool isValid();
+    int sourceCount();
+    bool add(int fd, DemuxReactor::Source *source);
+    bool remove(DemuxReactor::Source *source);
+
+protected:
+    void run() override;
+
+private:
+    void service(DemuxReactor::Source *source);
+
+private:
+    int m_epoll = -1;
+    // wakes epoll_wait() up to quit
+    int m_wake = -1;
+    QMutex m_mutex;
+    QWaitCondition m_idle;
+    QHash<DemuxReactor::Source *, int> m_sources;
+    // in readReady() or closed() on the pool thread
+    DemuxReactor::Source *m_current = Q_NULLPTR;
+    bool m_quit = false;
+};
+
+#endif // DEMUXREACTOR_H
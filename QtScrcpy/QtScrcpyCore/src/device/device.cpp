@@ -2,41 +2,97 @@
 #include <QMessageBox>
 #include <QTimer>
 
+#include "adaptivestream.h"
+#include "controlchannel.h"
 #include "controller.h"
 #include "devicemsg.h"
 #include "decoder.h"
 #include "device.h"
 #include "filehandler.h"
+#include "memoryaccount.h"
 #include "recorder.h"
 #include "server.h"
 #include "demuxer.h"
+#include "demuxreactor.h"
+
+// one key frame request per interval, the encoder needs time to answer
+#define RESET_VIDEO_INTERVAL 500
+// stream limits of a device at GL_REDUCED_STREAM
+#define GOVERNOR_REDUCED_MAX_SIZE 480
+#define GOVERNOR_REDUCED_MAX_FPS 10
 
 namespace qsc {
 
 Device::Device(DeviceParams params, QObject *parent) : IDevice(parent), m_params(params)
 {
+    m_memory.reset(new MemoryAccount());
     if (!params.display && !m_params.recordFile) {
         qCritical("not display must be recorded");
         return;
     }
+    if (m_params.demuxReactor && DemuxReactor::isSupported()) {
+        // a decoder of its own would decode on the reactor thread and hold up the other sockets
+        m_params.sharedDecode = true;
+    }
 
     if (params.display) {
         m_decoder = new Decoder([this](int width, int height, uint8_t* dataY, uint8_t* dataU, uint8_t* dataV, int linesizeY, int linesizeU, int linesizeV) {
+            if (!m_firstFrameReceived) {
+                m_firstFrameReceived = true;
+                emit firstFrameReceived(m_params.serial);
+            }
+            if (width != m_frameSize.width() || height != m_frameSize.height()) {
+                m_frameSize = QSize(width, height);
+                if (m_controller) {
+                    m_controller->setFrameSize(m_frameSize);
+                }
+            }
             for (const auto& item : m_deviceObservers) {
                 item->onFrame(width, height, dataY, dataU, dataV, linesizeY, linesizeU, linesizeV);
             }
         }, this);
+        m_decoder->setShared(m_params.sharedDecode);
+        m_decoder->setMemoryAccount(m_memory);
         m_fileHandler = new FileHandler(this);
         m_controller = new Controller([this](const QByteArray& buffer) -> qint64 {
-            if (!m_server || !m_server->getControlSocket()) {
+            // also called from the input scheduler thread
+            QMutexLocker locker(&m_controlChannelMutex);
+            if (!m_controlChannel) {
                 return 0;
             }
 
-            return m_server->getControlSocket()->write(buffer.data(), buffer.length());
+            // written by the control I/O thread
+            m_controlChannel->send(buffer.constData(), buffer.length());
+            return buffer.length();
         }, params.gameScript, this);
+        m_controller->setCoalesceInterval(params.inputCoalesceMs);
+        m_controller->setClipboardAutoSync(params.clipboardAutoSync);
+        m_controller->setUhidMode(params.uhidKeyboard, params.uhidMouse);
+        m_controller->setSendBacklogQuery([this]() -> qint64 {
+            QMutexLocker locker(&m_controlChannelMutex);
+            return m_controlChannel ? m_controlChannel->backlog() : 0;
+        });
+        m_controller->setSendStampedData([this](const QByteArray& buffer, const QVector<qint64>& stampsNs) -> qint64 {
+            QMutexLocker locker(&m_controlChannelMutex);
+            if (!m_controlChannel) {
+                return 0;
+            }
+            m_controlChannel->send(buffer.constData(), buffer.length(), stampsNs);
+            return buffer.length();
+        });
+        m_controller->setSendSharedData([this](const QByteArray& buffer, qint64 releaseNs, qint64 stampNs) -> qint64 {
+            QMutexLocker locker(&m_controlChannelMutex);
+            if (!m_controlChannel) {
+                return 0;
+            }
+            m_controlChannel->send(buffer, releaseNs, stampNs);
+            return buffer.length();
+        });
     }
 
     m_stream = new Demuxer(this);
+    m_stream->setReactorMode(m_params.demuxReactor);
+    m_stream->setMemoryAccount(m_memory);
 
     m_server = new Server(this);
     if (m_params.recordFile && !m_params.recordPath.trimmed().isEmpty()) {
@@ -58,6 +114,7 @@ Device::Device(DeviceParams params, QObject *parent) : IDevice(parent), m_params
             absFilePath = dir.absoluteFilePath(fileName);
         }
         m_recorder = new Recorder(absFilePath, this);
+        m_recorder->setMemoryAccount(m_memory);
     }
     initSignals();
 }
@@ -65,6 +122,7 @@ Device::Device(DeviceParams params, QObject *parent) : IDevice(parent), m_params
 Device::~Device()
 {
     Device::disconnectDevice();
+    delete m_adaptiveStream;
 }
 
 void Device::setUserData(void *data)
@@ -80,6 +138,8 @@ void *Device::getUserData()
 void Device::registerDeviceObserver(DeviceObserver *observer)
 {
     m_deviceObservers.insert(observer);
+    // a new consumer should not wait for the next periodic key frame
+    resetVideo();
 }
 
 void Device::deRegisterDeviceObserver(DeviceObserver *observer)
@@ -107,7 +167,11 @@ void Device::screenshot()
 
     // screenshot
     m_decoder->peekFrame([this](int width, int height, uint8_t* dataRGB32) {
-       saveFrame(width, height, dataRGB32);
+        // the RGB copy lives until the file is written
+        qint64 bytes = static_cast<qint64>(width) * height * 4;
+        m_memory->add(MemoryAccount::MC_SCREENSHOT, bytes);
+        saveFrame(width, height, dataRGB32);
+        m_memory->add(MemoryAccount::MC_SCREENSHOT, -bytes);
     });
 }
 
@@ -127,6 +191,26 @@ void Device::showTouch(bool show)
     qInfo() << getSerial() << " show touch " << (show ? "enable" : "disable");
 }
 
+void Device::setDecodePriority(bool high)
+{
+    m_focused = high;
+    if (m_decoder) {
+        m_decoder->setPriority(high);
+    }
+}
+
+void Device::resetVideo()
+{
+    if (!m_controller || !m_serverStartSuccess || m_reconnecting) {
+        return;
+    }
+    if (m_resetVideoTimeCount.isValid() && m_resetVideoTimeCount.elapsed() < RESET_VIDEO_INTERVAL) {
+        return;
+    }
+    m_resetVideoTimeCount.start();
+    m_controller->resetVideo();
+}
+
 bool Device::isReversePort(quint16 port)
 {
     if (m_server && m_server->isReverse() && port == m_server->getParams().localPort) {
@@ -144,6 +228,12 @@ void Device::initSignals()
                 item->grabCursor(grab);
             }
         });
+        connect(m_controller, &Controller::textInjectFinished, this, [this](int chars, qint64 elapsedMs, double charsPerSecond, bool viaClipboard) {
+            emit textInjected(m_params.serial, chars, elapsedMs, charsPerSecond, viaClipboard);
+        });
+        connect(m_controller, &Controller::macroFinished, this, [this]() {
+            emit macroFinished(m_params.serial);
+        });
     }
     if (m_fileHandler) {
         connect(m_fileHandler, &FileHandler::fileHandlerResult, this, [this](FileHandler::FILE_HANDLER_RESULT processResult, bool isApk) {
@@ -169,6 +259,11 @@ void Device::initSignals()
 
     if (m_server) {
         connect(m_server, &Server::serverStarted, this, [this](bool success, const QString &deviceName, const QSize &size) {
+            if (m_reconnecting) {
+                onReconnectResult(success, size);
+                return;
+            }
+
             m_serverStartSuccess = success;
             emit deviceConnected(success, m_params.serial, deviceName, size);
             if (success) {
@@ -192,29 +287,16 @@ void Device::initSignals()
                     m_decoder->open();
                 }
 
-                // init stream
-                m_stream->installVideoSocket(m_server->removeVideoSocket());
-                m_stream->setFrameSize(size);
-                m_stream->startDecode();
+                startStream(size);
 
-                // recv device msg
-                connect(m_server->getControlSocket(), &QTcpSocket::readyRead, this, [this](){
-                    if (!m_controller) {
-                        return;
-                    }
-
-                    auto controlSocket = m_server->getControlSocket();
-                    while (controlSocket->bytesAvailable()) {
-                        QByteArray byteArray = controlSocket->peek(controlSocket->bytesAvailable());
-                        DeviceMsg deviceMsg;
-                        qint32 consume = deviceMsg.deserialize(byteArray);
-                        if (0 >= consume) {
-                            break;
-                        }
-                        controlSocket->read(consume);
-                        m_controller->recvDeviceMsg(&deviceMsg);
-                    }
-                });
+                if (m_params.adaptiveStream && !m_adaptiveStream) {
+                    AdaptiveStream::Level top;
+                    top.bitRate = m_params.bitRate;
+                    top.maxSize = m_params.maxSize;
+                    top.maxFps = m_params.maxFps;
+                    m_adaptiveStream = new AdaptiveStream(top, m_params.latencyBudgetMs);
+                    m_adaptiveTimer.start(1000);
+                }
 
                 // 显示界面时才自动息屏（m_params.display）
                 if (m_params.closeScreen && m_params.display && m_controller) {
@@ -224,20 +306,27 @@ void Device::initSignals()
                 m_server->stop();
             }
         });
+        connect(m_server, &Server::serverStepFinished, this, [this](const QString &step, qint64 elapsedMs) {
+            emit startupStepFinished(m_params.serial, step, elapsedMs);
+        });
         connect(m_server, &Server::serverStoped, this, [this]() {
-            disconnectDevice();
             qDebug() << "server process stop";
+            onConnectionLost();
         });
     }
 
     if (m_stream) {
         connect(m_stream, &Demuxer::onStreamStop, this, [this]() {
-            disconnectDevice();
             qDebug() << "stream thread stop";
+            onConnectionLost();
         });
         connect(m_stream, &Demuxer::getFrame, this, [this](AVPacket *packet) {
             if (m_decoder && !m_decoder->push(packet)) {
-                qCritical("Could not send packet to decoder");
+                qCritical("Could not send packet to decoder, request a key frame");
+                // demuxer thread, the request is sent from the device thread
+                QMetaObject::invokeMethod(this, [this]() {
+                    resetVideo();
+                }, Qt::QueuedConnection);
             }
 
             if (m_recorder && !m_recorder->push(packet)) {
@@ -251,7 +340,25 @@ void Device::initSignals()
         }, Qt::DirectConnection);
     }
 
+    connect(&m_adaptiveTimer, &QTimer::timeout, this, &Device::onAdaptiveTimer);
+    m_restartTimer.setSingleShot(true);
+    connect(&m_restartTimer, &QTimer::timeout, this, [this]() {
+        if (m_restarting) {
+            qWarning("%s stream did not stop for the restart", m_params.serial.toUtf8().data());
+            m_restarting = false;
+            m_reconnecting = false;
+            disconnectDevice();
+        }
+    });
+
     if (m_decoder) {
+        connect(m_decoder, &Decoder::decodeFailed, this, [this]() {
+            resetVideo();
+        }, Qt::QueuedConnection);
+        connect(m_decoder, &Decoder::updateFrameStats, this, [this](quint32 rendered, quint32 skipped) {
+            m_renderedFrames = rendered;
+            m_skippedFrames = skipped;
+        });
         connect(m_decoder, &Decoder::updateFPS, this, [this](quint32 fps) {
             for (const auto& item : m_deviceObservers) {
                 item->updateFPS(fps);
@@ -266,47 +373,288 @@ bool Device::connectDevice()
         return false;
     }
 
+    m_firstFrameReceived = false;
     // fix: macos cant recv finished signel, timer is ok
     QTimer::singleShot(0, this, [this]() {
         m_startTimeCount.start();
-        // max size support 480p 720p 1080p 设备原生分辨率
-        // support wireless connect, example:
-        //m_server->start("192.168.0.174:5555", 27183, m_maxSize, m_bitRate, "");
-        // only one devices, serial can be null
-        // mark: crop input format: "width:height:x:y" or "" for no crop, for example: "100:200:0:0"
-        Server::ServerParams params;
-        params.serverLocalPath = m_params.serverLocalPath;
-        params.serverRemotePath = m_params.serverRemotePath;
-        params.serial = m_params.serial;
-        params.localPort = m_params.localPort;
-        params.maxSize = m_params.maxSize;
-        params.bitRate = m_params.bitRate;
-        params.maxFps = m_params.maxFps;
-        params.useReverse = m_params.useReverse;
-        params.captureOrientationLock = m_params.captureOrientationLock;
-        params.captureOrientation = m_params.captureOrientation;
-        params.stayAwake = m_params.stayAwake;
-        params.serverVersion = m_params.serverVersion;
-        params.logLevel = m_params.logLevel;
-        params.codecOptions = m_params.codecOptions;
-        params.codecName = m_params.codecName;
-        params.scid = m_params.scid;
-
-        params.crop = "";
-        params.control = true;
-        m_server->start(params);
+        startServer();
     });
 
     return true;
 }
 
+void Device::startServer()
+{
+    if (!m_server) {
+        return;
+    }
+    // max size support 480p 720p 1080p 设备原生分辨率
+    // support wireless connect, example:
+    //m_server->start("192.168.0.174:5555", 27183, m_maxSize, m_bitRate, "");
+    // only one devices, serial can be null
+    // mark: crop input format: "width:height:x:y" or "" for no crop, for example: "100:200:0:0"
+    Server::ServerParams params;
+    params.serverLocalPath = m_params.serverLocalPath;
+    params.serverRemotePath = m_params.serverRemotePath;
+    params.serial = m_params.serial;
+    params.localPort = m_params.localPort;
+    params.maxSize = m_params.maxSize;
+    params.bitRate = m_params.bitRate;
+    params.maxFps = m_params.maxFps;
+    if (m_throttleLevel >= GL_REDUCED_STREAM) {
+        // 0 means no limit for both
+        if (!params.maxSize || params.maxSize > GOVERNOR_REDUCED_MAX_SIZE) {
+            params.maxSize = GOVERNOR_REDUCED_MAX_SIZE;
+        }
+        if (!params.maxFps || params.maxFps > GOVERNOR_REDUCED_MAX_FPS) {
+            params.maxFps = GOVERNOR_REDUCED_MAX_FPS;
+        }
+    }
+    params.useReverse = m_params.useReverse;
+    params.captureOrientationLock = m_params.captureOrientationLock;
+    params.captureOrientation = m_params.captureOrientation;
+    params.stayAwake = m_params.stayAwake;
+    params.serverVersion = m_params.serverVersion;
+    params.logLevel = m_params.logLevel;
+    params.codecOptions = m_params.codecOptions;
+    params.codecName = m_params.codecName;
+    params.scid = m_params.scid;
+
+    params.crop = "";
+    params.control = true;
+    m_server->start(params);
+}
+
+void Device::startStream(const QSize &size)
+{
+    // init stream
+    m_stream->installVideoSocket(m_server->removeVideoSocket());
+    m_stream->setFrameSize(size);
+    m_stream->startDecode();
+
+    // device messages are parsed on the control I/O thread
+    releaseControlChannel();
+    QTcpSocket *controlSocket = m_server->removeControlSocket();
+    if (!controlSocket) {
+        return;
+    }
+    m_controlChannelMutex.lock();
+    m_controlChannel = new ControlChannel(controlSocket);
+    m_controlChannelMutex.unlock();
+    connect(m_controlChannel, &ControlChannel::deviceMsgReceived, this, [this](QSharedPointer<DeviceMsg> deviceMsg) {
+        if (m_controller) {
+            m_controller->recvDeviceMsg(deviceMsg.data());
+        }
+    }, Qt::QueuedConnection);
+    if (m_controller) {
+        // the UHID devices died with the old server
+        m_controller->resetInput();
+    }
+}
+
+void Device::releaseControlChannel()
+{
+    if (!m_controlChannel) {
+        return;
+    }
+    QMutexLocker locker(&m_controlChannelMutex);
+    m_controlChannel->disconnect(this);
+    m_controlChannel->release();
+    m_controlChannel = Q_NULLPTR;
+}
+
+void Device::onConnectionLost()
+{
+    if (m_server && m_restarting) {
+        // the old stream is gone, bring the server back with the new settings
+        m_restarting = false;
+        m_restartTimer.stop();
+        if (m_stream) {
+            m_stream->stopDecode();
+        }
+        scheduleReconnect();
+        return;
+    }
+    if (!m_server || m_reconnecting) {
+        // disconnected on purpose, or a reconnect is already running
+        return;
+    }
+    if (!m_params.autoReconnect || !m_serverStartSuccess) {
+        disconnectDevice();
+        return;
+    }
+
+    qInfo("%s connection lost, reconnecting", m_params.serial.toUtf8().data());
+    m_reconnecting = true;
+    m_reconnectAttempt = 0;
+    m_reconnectTotal++;
+    m_reconnectTimeCount.start();
+
+    // the decoder, recorder, controller and observers stay as they are
+    m_server->stop();
+    releaseControlChannel();
+    if (m_stream) {
+        m_stream->stopDecode();
+    }
+    scheduleReconnect();
+}
+
+void Device::scheduleReconnect()
+{
+    if (m_reconnectAttempt >= m_params.maxReconnectCount) {
+        qWarning("%s reconnect failed after %d attempts", m_params.serial.toUtf8().data(), m_reconnectAttempt);
+        m_reconnecting = false;
+        emit reconnectFinished(m_params.serial, false, m_reconnectTimeCount.elapsed(), m_reconnectSuccess, m_reconnectTotal);
+        disconnectDevice();
+        return;
+    }
+
+    // 200ms, 400ms, 800ms ... up to 5s, a planned restart starts right away
+    int delay = qMin(200 << m_reconnectAttempt, 5000);
+    if (m_plannedRestart && 0 == m_reconnectAttempt) {
+        delay = 0;
+    }
+    m_reconnectAttempt++;
+    QTimer::singleShot(delay, this, [this]() {
+        if (!m_server || !m_reconnecting) {
+            return;
+        }
+        startServer();
+    });
+}
+
+void Device::onReconnectResult(bool success, const QSize &size)
+{
+    if (!success) {
+        m_server->stop();
+        scheduleReconnect();
+        return;
+    }
+
+    m_reconnecting = false;
+    if (m_plannedRestart) {
+        m_plannedRestart = false;
+        qInfo("%s stream restarted in %lldms", m_params.serial.toUtf8().data(), m_reconnectTimeCount.elapsed());
+        startStream(size);
+        return;
+    }
+    m_reconnectSuccess++;
+    qint64 elapsed = m_reconnectTimeCount.elapsed();
+    qInfo("%s reconnected in %lldms (%u/%u)", m_params.serial.toUtf8().data(), elapsed, m_reconnectSuccess, m_reconnectTotal);
+    startStream(size);
+    emit reconnectFinished(m_params.serial, true, elapsed, m_reconnectSuccess, m_reconnectTotal);
+}
+
+void Device::setWindowVisible(bool visible)
+{
+    m_windowVisible = visible;
+}
+
+bool Device::isInView()
+{
+    return m_windowVisible || m_focused;
+}
+
+quint64 Device::videoBytes()
+{
+    return m_stream ? m_stream->totalBytes() : 0;
+}
+
+int Device::throttleLevel()
+{
+    return m_throttleLevel;
+}
+
+bool Device::setThrottleLevel(int level)
+{
+    if (level == m_throttleLevel) {
+        return false;
+    }
+    int previous = m_throttleLevel;
+    m_throttleLevel = level;
+
+    if (m_decoder) {
+        AVDiscard discard = AVDISCARD_DEFAULT;
+        if (level >= GL_KEY_FRAMES) {
+            discard = AVDISCARD_NONKEY;
+        } else if (level >= GL_REFERENCE_FRAMES) {
+            discard = AVDISCARD_NONREF;
+        }
+        m_decoder->setSkipFrames(discard);
+    }
+
+    if ((previous >= GL_REDUCED_STREAM) != (level >= GL_REDUCED_STREAM)) {
+        // startServer() applies the limits
+        restartStream();
+        return true;
+    }
+    if (previous >= GL_KEY_FRAMES && level < GL_KEY_FRAMES) {
+        // the skipped frames are missing as references, start over from a key frame
+        resetVideo();
+    }
+    return false;
+}
+
+void Device::restartStream()
+{
+    if (!m_server || m_reconnecting) {
+        return;
+    }
+    // same path as a reconnect, the decoder and observers are kept
+    m_reconnecting = true;
+    m_restarting = true;
+    m_plannedRestart = true;
+    m_reconnectAttempt = 0;
+    m_reconnectTimeCount.start();
+    m_server->stop();
+    releaseControlChannel();
+
+    // the stream ends when the device server is gone, see onConnectionLost
+    m_restartTimer.start(3000);
+}
+
+void Device::onAdaptiveTimer()
+{
+    if (!m_adaptiveStream || !m_stream || m_reconnecting) {
+        return;
+    }
+
+    Demuxer::StreamStats stats = m_stream->takeStats();
+    AdaptiveStream::Sample sample;
+    sample.throughputBps = stats.bytes * 8.0;
+    sample.jitterMs = stats.jitterMs;
+    sample.backlogBytes = stats.backlogBytes;
+    sample.rendered = m_renderedFrames;
+    sample.skipped = m_skippedFrames;
+
+    AdaptiveStream::Level next;
+    if (!m_adaptiveStream->update(sample, next)) {
+        return;
+    }
+
+    qInfo("%s adapt stream to level %d: bit rate %u, max size %d, max fps %u (delay %.1fms, skipped %u/%u)",
+          m_params.serial.toUtf8().data(), m_adaptiveStream->currentLevel(), next.bitRate, next.maxSize, next.maxFps,
+          AdaptiveStream::queueDelayMs(sample), sample.skipped, sample.rendered + sample.skipped);
+    m_params.bitRate = next.bitRate;
+    m_params.maxSize = next.maxSize;
+    m_params.maxFps = next.maxFps;
+    emit streamQualityChanged(m_params.serial, next.bitRate, next.maxSize, next.maxFps);
+    restartStream();
+}
+
 void Device::disconnectDevice()
 {
     if (!m_server) {
         return;
     }
     m_server->stop();
+    releaseControlChannel();
     m_server = Q_NULLPTR;
+    m_reconnecting = false;
+    m_restarting = false;
+    m_plannedRestart = false;
+    m_restartTimer.stop();
+    m_adaptiveTimer.stop();
 
     if (m_stream) {
         m_stream->stopDecode();
@@ -595,6 +943,40 @@ void Device::keyEvent(const QKeyEvent *from, const QSize &frameSize, const QSize
     }
 }
 
+void Device::setRawMouseMotion(bool enabled)
+{
+    if (!m_controller) {
+        return;
+    }
+    m_controller->setRawMouseMotion(enabled);
+}
+
+void Device::rawMouseMotion(const QPointF &delta)
+{
+    if (!m_controller) {
+        return;
+    }
+    m_controller->rawMouseMotion(delta);
+}
+
+QSize Device::frameSize()
+{
+    return m_frameSize;
+}
+
+bool Device::isNormalInput()
+{
+    return m_controller && m_controller->isNormalInput();
+}
+
+void Device::sendSerializedControl(const QByteArray &serialized, qint64 releaseNs)
+{
+    if (!m_controller) {
+        return;
+    }
+    m_controller->sendSerialized(serialized, releaseNs);
+}
+
 bool Device::isCurrentCustomKeymap()
 {
     if (!m_controller) {
@@ -603,6 +985,170 @@ bool Device::isCurrentCustomKeymap()
     return m_controller->isCurrentCustomKeymap();
 }
 
+quint64 Device::mergedInputEventCount()
+{
+    if (!m_controller) {
+        return 0;
+    }
+    return m_controller->mergedEventCount();
+}
+
+void Device::takeInputLatency(quint64 &count, double &avgMs, double &maxMs)
+{
+    count = 0;
+    avgMs = 0.0;
+    maxMs = 0.0;
+    QMutexLocker locker(&m_controlChannelMutex);
+    if (!m_controlChannel) {
+        return;
+    }
+
+    // each event is stamped by the controller, batching and the wait for the I/O thread included
+    qint64 sumNs = 0;
+    qint64 maxNs = 0;
+    m_controlChannel->takeSendLatency(count, sumNs, maxNs);
+    if (count) {
+        avgMs = sumNs / 1000000.0 / count;
+        maxMs = maxNs / 1000000.0;
+    }
+}
+
+MemoryUsage Device::toMemoryUsage(std::function<qint64(int category)> read)
+{
+    MemoryUsage usage;
+    usage.demuxer = read(MemoryAccount::MC_DEMUXER);
+    usage.decoder = read(MemoryAccount::MC_DECODER);
+    usage.videoBuffer = read(MemoryAccount::MC_VIDEO_BUFFER);
+    usage.recorder = read(MemoryAccount::MC_RECORDER);
+    usage.screenshot = read(MemoryAccount::MC_SCREENSHOT);
+    usage.texture = read(MemoryAccount::MC_TEXTURE);
+    usage.audio = read(MemoryAccount::MC_AUDIO);
+    usage.total = read(MemoryAccount::MC_COUNT);
+    return usage;
+}
+
+MemoryUsage Device::memoryUsage()
+{
+    return toMemoryUsage([this](int category) { return m_memory->current(category); });
+}
+
+MemoryUsage Device::memoryPeak()
+{
+    return toMemoryUsage([this](int category) { return m_memory->peak(category); });
+}
+
+void Device::setTextureMemory(qint64 bytes)
+{
+    m_memory->set(MemoryAccount::MC_TEXTURE, bytes);
+}
+
+void Device::setAudioMemory(qint64 bytes)
+{
+    m_memory->set(MemoryAccount::MC_AUDIO, bytes);
+}
+
+void Device::takeInputSkew(quint64 &count, double &avgMs, double &maxMs)
+{
+    count = 0;
+    avgMs = 0.0;
+    maxMs = 0.0;
+    QMutexLocker locker(&m_controlChannelMutex);
+    if (!m_controlChannel) {
+        return;
+    }
+    qint64 sumNs = 0;
+    qint64 maxNs = 0;
+    m_controlChannel->takeSendSkew(count, sumNs, maxNs);
+    if (count) {
+        avgMs = sumNs / 1000000.0 / count;
+        maxMs = maxNs / 1000000.0;
+    }
+}
+
+void Device::takeInputTimingError(quint64 &count, double &avgMs, double &maxMs)
+{
+    count = 0;
+    avgMs = 0.0;
+    maxMs = 0.0;
+    if (!m_controller) {
+        return;
+    }
+
+    qint64 sumNs = 0;
+    qint64 maxNs = 0;
+    m_controller->takeInputPlanTimingError(count, sumNs, maxNs);
+    if (count) {
+        avgMs = sumNs / 1000000.0 / count;
+        maxMs = maxNs / 1000000.0;
+    }
+}
+
+void Device::startMacroRecord()
+{
+    if (!m_controller) {
+        return;
+    }
+    m_controller->startMacroRecord();
+}
+
+bool Device::stopMacroRecord(const QString &fileName)
+{
+    if (!m_controller) {
+        return false;
+    }
+    return m_controller->stopMacroRecord(fileName);
+}
+
+bool Device::playMacro(const QString &fileName, int loops)
+{
+    if (!m_controller) {
+        return false;
+    }
+    return m_controller->playMacro(fileName, loops);
+}
+
+bool Device::playMacroSteps(const QVector<InputScheduler::Step> &steps, int loops, qint64 startNs)
+{
+    if (!m_controller) {
+        return false;
+    }
+    return m_controller->playMacroSteps(steps, loops, startNs);
+}
+
+void Device::stopMacro()
+{
+    if (!m_controller) {
+        return;
+    }
+    m_controller->stopMacro();
+}
+
+bool Device::isMacroPlaying()
+{
+    if (!m_controller) {
+        return false;
+    }
+    return m_controller->isMacroPlaying();
+}
+
+void Device::takeMacroTimingError(quint64 &count, double &avgMs, double &maxMs)
+{
+    count = 0;
+    avgMs = 0.0;
+    maxMs = 0.0;
+    if (!m_controller) {
+        return;
+    }
+
+    qint64 sumNs = 0;
+    qint64 maxNs = 0;
+    m_controller->takeMacroTimingError(count, sumNs, maxNs);
+    if (count) {
+        avgMs = sumNs / 1000000.0 / count;
+        maxMs = maxNs / 1000000.0;
+    }
+}
+
 bool Device::saveFrame(int width, int height, uint8_t* dataRGB32)
 {
     if (!dataRGB32) {
@@ -1,12 +1,17 @@
 ﻿#ifndef DEVICE_H
 #define DEVICE_H
 
+#include <functional>
 #include <set>
 #include <QElapsedTimer>
+#include <QMutex>
 #include <QPointer>
+#include <QSharedPointer>
 #include <QTime>
+#include <QTimer>
 
 #include "../../include/QtScrcpyCore.h"
+#include "inputscheduler.h"
 
 class QMouseEvent;
 class QWheelEvent;
@@ -19,6 +24,9 @@ class FileHandler;
 class Demuxer;
 class VideoForm;
 class Controller;
+class ControlChannel;
+class AdaptiveStream;
+class MemoryAccount;
 struct AVFrame;
 
 namespace qsc {
@@ -43,6 +51,8 @@ public:
     void mouseEvent(const QMouseEvent *from, const QSize &frameSize, const QSize &showSize) override;
     void wheelEvent(const QWheelEvent *from, const QSize &frameSize, const QSize &showSize) override;
     void keyEvent(const QKeyEvent *from, const QSize &frameSize, const QSize &showSize) override;
+    void setRawMouseMotion(bool enabled) override;
+    void rawMouseMotion(const QPointF &delta) override;
 
     void postGoBack() override;
     void postGoHome() override;
@@ -66,28 +76,99 @@ public:
 
     void screenshot() override;
     void showTouch(bool show) override;
+    void resetVideo() override;
+    void setDecodePriority(bool high) override;
 
     bool isReversePort(quint16 port) override;
     const QString &getSerial() override;
 
     void updateScript(QString script) override;
     bool isCurrentCustomKeymap() override;
+    quint64 mergedInputEventCount() override;
+    void takeInputTimingError(quint64 &count, double &avgMs, double &maxMs) override;
+
+    void startMacroRecord() override;
+    bool stopMacroRecord(const QString &fileName) override;
+    bool playMacro(const QString &fileName, int loops = 1) override;
+    void stopMacro() override;
+    bool isMacroPlaying() override;
+    void takeMacroTimingError(quint64 &count, double &avgMs, double &maxMs) override;
+    void takeInputLatency(quint64 &count, double &avgMs, double &maxMs) override;
+    void takeInputSkew(quint64 &count, double &avgMs, double &maxMs) override;
+
+    MemoryUsage memoryUsage() override;
+    MemoryUsage memoryPeak() override;
+    void setTextureMemory(qint64 bytes) override;
+    void setAudioMemory(qint64 bytes) override;
+    // reads a MemoryAccount, per device or the process totals
+    static MemoryUsage toMemoryUsage(std::function<qint64(int category)> read);
+
+    // group broadcast, see DeviceManage::broadcastMouseEvent()
+    QSize frameSize();
+    bool isNormalInput();
+    void sendSerializedControl(const QByteArray &serialized, qint64 releaseNs = 0);
+    // group macro replay, see DeviceManage::playMacro()
+    bool playMacroSteps(const QVector<InputScheduler::Step> &steps, int loops, qint64 startNs);
+    // governor, see DeviceGovernor
+    void setWindowVisible(bool visible) override;
+    bool isInView();
+    quint64 videoBytes();
+    int throttleLevel();
+    // returns true if the stream is restarted for it
+    bool setThrottleLevel(int level);
 
 private:
     void initSignals();
     bool saveFrame(int width, int height, uint8_t* dataRGB32);
+    void startServer();
+    void startStream(const QSize &size);
+    void releaseControlChannel();
+    void onConnectionLost();
+    void scheduleReconnect();
+    void onReconnectResult(bool success, const QSize &size);
+    void restartStream();
+    void onAdaptiveTimer();
 
 private:
     // server relevant
     QPointer<Server> m_server;
     bool m_serverStartSuccess = false;
+    bool m_firstFrameReceived = false;
+    QSize m_frameSize;
     QPointer<Decoder> m_decoder;
     QPointer<Controller> m_controller;
+    // lives on the control I/O thread, only released from here
+    ControlChannel* m_controlChannel = Q_NULLPTR;
+    // the input scheduler thread sends through m_controlChannel too
+    QMutex m_controlChannelMutex;
     QPointer<FileHandler> m_fileHandler;
     QPointer<Demuxer> m_stream;
     QPointer<Recorder> m_recorder;
 
     QElapsedTimer m_startTimeCount;
+    QElapsedTimer m_resetVideoTimeCount;
+
+    // auto reconnect, only the server and its sockets are restarted
+    bool m_reconnecting = false;
+    int m_reconnectAttempt = 0;
+    quint32 m_reconnectTotal = 0;
+    quint32 m_reconnectSuccess = 0;
+    QElapsedTimer m_reconnectTimeCount;
+    // restart asked by us (new stream settings), not a lost connection
+    bool m_restarting = false;
+    bool m_plannedRestart = false;
+    // gives up a restart whose stream does not stop
+    QTimer m_restartTimer;
+
+    AdaptiveStream* m_adaptiveStream = nullptr;
+    QTimer m_adaptiveTimer;
+    quint32 m_renderedFrames = 0;
+    quint32 m_skippedFrames = 0;
+    bool m_windowVisible = false;
+    bool m_focused = false;
+    int m_throttleLevel = GL_FULL;
+    // shared with the decoder, demuxer and recorder, they may outlive the device
+    QSharedPointer<MemoryAccount> m_memory;
     DeviceParams m_params;
     std::set<DeviceObserver*> m_deviceObservers;
     void* m_userData = nullptr;
@@ -11,6 +11,11 @@ Recorder::Recorder(const QString &fileName, QObject *parent) : QThread(parent),
 
 Recorder::~Recorder() {}
 
+void Recorder::setMemoryAccount(QSharedPointer<MemoryAccount> memory)
+{
+    m_memory = memory;
+}
+
 AVPacket *Recorder::packetNew(const AVPacket *packet)
 {
     AVPacket *rec = av_packet_alloc();
@@ -22,11 +27,17 @@ AVPacket *Recorder::packetNew(const AVPacket *packet)
         delete rec;
         return Q_NULLPTR;
     }
+    if (m_memory) {
+        m_memory->add(MemoryAccount::MC_RECORDER, rec->size);
+    }
     return rec;
 }
 
 void Recorder::packetDelete(AVPacket *packet)
 {
+    if (m_memory) {
+        m_memory->add(MemoryAccount::MC_RECORDER, -packet->size);
+    }
     av_packet_unref(packet);
     av_packet_free(&packet);
 }
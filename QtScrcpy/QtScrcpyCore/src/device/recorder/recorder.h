@@ -2,6 +2,7 @@
 #define RECORDER_H
 #include <QMutex>
 #include <QQueue>
+#include <QSharedPointer>
 #include <QSize>
 #include <QString>
 #include <QThread>
@@ -12,6 +13,8 @@ extern "C"
 #include "libavformat/avformat.h"
 }
 
+#include "memoryaccount.h"
+
 class Recorder : public QThread
 {
     Q_OBJECT
@@ -28,6 +31,8 @@ public:
 
     void setFrameSize(const QSize &declaredFrameSize);
     void setFormat(Recorder::RecorderFormat format);
+    // the packets queued for writing are counted as MC_RECORDER
+    void setMemoryAccount(QSharedPointer<MemoryAccount> memory);
     bool open();
     void close();
     bool write(AVPacket *packet);
@@ -66,6 +71,7 @@ private:
     // "previous" is only accessed from the recorder thread, so it does not
     // need to be protected by the mutex
     AVPacket *m_previous = Q_NULLPTR;
+    QSharedPointer<MemoryAccount> m_memory;
 };
 
 #endif // RECORDER_H
@@ -1,6 +1,9 @@
 #include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
 #include <QDebug>
 #include <QElapsedTimer>
+#include <QFile>
 #include <QFileInfo>
 #include <QThread>
 #include <QTimer>
@@ -12,6 +15,10 @@
 #define SOCKET_NAME_PREFIX "scrcpy"
 #define MAX_CONNECT_COUNT 30
 #define MAX_RESTART_COUNT 1
+#define CONNECT_RETRY_INTERVAL 300
+#define CONNECT_SOCKET_TIMEOUT 1000
+#define CONNECT_DUMMY_BYTE_TIMEOUT 1000
+#define DEVICE_INFO_TIMEOUT 3000
 
 static quint32 bufferRead32be(quint8 *buf)
 {
@@ -23,14 +30,23 @@ Server::Server(QObject *parent) : QObject(parent)
     connect(&m_workProcess, &qsc::AdbProcess::adbProcessResult, this, &Server::onWorkProcessResult);
     connect(&m_serverProcess, &qsc::AdbProcess::adbProcessResult, this, &Server::onWorkProcessResult);
 
+    m_connectStepTimer.setSingleShot(true);
+    connect(&m_connectStepTimer, &QTimer::timeout, this, &Server::onConnectStepTimeout);
+
     connect(&m_serverSocket, &QTcpServer::newConnection, this, [this]() {
         QTcpSocket *tmp = m_serverSocket.nextPendingConnection();
         if (dynamic_cast<VideoSocket *>(tmp)) {
             m_videoSocket = dynamic_cast<VideoSocket *>(tmp);
-            if (!m_videoSocket->isValid() || !readInfo(m_videoSocket, m_deviceName, m_deviceSize)) {
+            if (!m_videoSocket->isValid()) {
                 stop();
                 emit serverStarted(false);
+                return;
             }
+            // device info follows on the video socket, read it as it arrives
+            m_deviceInfoRead = false;
+            setConnectStep(SCS_DEVICE_INFO, DEVICE_INFO_TIMEOUT);
+            connect(m_videoSocket, &QTcpSocket::readyRead, this, &Server::onReverseVideoReadyRead);
+            onReverseVideoReadyRead();
         } else {
             m_controlSocket = tmp;
             if (m_controlSocket && m_controlSocket->isValid()) {
@@ -40,7 +56,7 @@ Server::Server(QObject *parent) : QObject(parent)
                 // we don't need the adb tunnel anymore
                 disableTunnelReverse();
                 m_tunnelEnabled = false;
-                emit serverStarted(true, m_deviceName, m_deviceSize);
+                checkReverseConnected();
             } else {
                 stop();
                 emit serverStarted(false);
@@ -52,6 +68,16 @@ Server::Server(QObject *parent) : QObject(parent)
 
 Server::~Server() {}
 
+bool Server::checkServer()
+{
+    if (m_workProcess.isRuning()) {
+        m_workProcess.kill();
+    }
+    // toybox md5sum is available since android 6, a failure just falls back to push
+    m_workProcess.execute(m_params.serial, QStringList() << "shell" << "md5sum" << m_params.serverRemotePath);
+    return true;
+}
+
 bool Server::pushServer()
 {
     if (m_workProcess.isRuning()) {
@@ -225,7 +251,17 @@ bool Server::execute()
 bool Server::start(Server::ServerParams params)
 {
     m_params = params;
-    m_serverStartStep = SSS_PUSH;
+    m_serverStartStep = SSS_NULL;
+    m_deviceInfoRead = false;
+    m_stepTimer.start();
+
+    // compare the device's jar with the local one and push only if they differ,
+    // always checked, the jar may have been wiped or replaced by another scrcpy since
+    if (localServerHash().isEmpty()) {
+        setStartStep(SSS_PUSH);
+    } else {
+        setStartStep(SSS_CHECK_SERVER);
+    }
     return startServerByStep();
 }
 
@@ -261,6 +297,9 @@ void Server::timerEvent(QTimerEvent *event)
         stopAcceptTimeoutTimer();
         emit serverStarted(false);
     } else if (event && m_connectTimeoutTimer == event->timerId()) {
+        // one attempt at a time, the next one is scheduled when this one fails
+        killTimer(m_connectTimeoutTimer);
+        m_connectTimeoutTimer = 0;
         onConnectTimer();
     }
 }
@@ -277,8 +316,16 @@ QTcpSocket *Server::getControlSocket()
     return m_controlSocket;
 }
 
+QTcpSocket *Server::removeControlSocket()
+{
+    QTcpSocket *socket = m_controlSocket;
+    m_controlSocket = Q_NULLPTR;
+    return socket;
+}
+
 void Server::stop()
 {
+    abortPendingConnect();
     if (m_tunnelForward) {
         stopConnectTimeoutTimer();
     } else {
@@ -301,6 +348,8 @@ void Server::stop()
         m_tunnelEnabled = false;
     }
     m_serverSocket.close();
+    // results of the killed server process belong to no running step anymore
+    m_serverStartStep = SSS_NULL;
 }
 
 bool Server::startServerByStep()
@@ -309,6 +358,9 @@ bool Server::startServerByStep()
     // push, enable tunnel et start the server
     if (SSS_NULL != m_serverStartStep) {
         switch (m_serverStartStep) {
+        case SSS_CHECK_SERVER:
+            stepSuccess = checkServer();
+            break;
         case SSS_PUSH:
             stepSuccess = pushServer();
             break;
@@ -335,17 +387,11 @@ bool Server::startServerByStep()
 
 bool Server::readInfo(VideoSocket *videoSocket, QString &deviceName, QSize &size)
 {
-    QElapsedTimer timer;
-    timer.start();
+    // never blocks, returns false until the whole header arrived
     unsigned char buf[DEVICE_NAME_FIELD_LENGTH + 12];
-    while (videoSocket->bytesAvailable() <= (DEVICE_NAME_FIELD_LENGTH + 12)) {
-        videoSocket->waitForReadyRead(300);
-        if (timer.elapsed() > 3000) {
-            qInfo("readInfo timeout");
-            return false;
-        }
+    if (videoSocket->bytesAvailable() < (qint64)sizeof(buf)) {
+        return false;
     }
-    qDebug() << "readInfo wait time:" << timer.elapsed();
 
     qint64 len = videoSocket->read((char *)buf, sizeof(buf));
     if (len < DEVICE_NAME_FIELD_LENGTH + 12) {
@@ -362,6 +408,73 @@ bool Server::readInfo(VideoSocket *videoSocket, QString &deviceName, QSize &size
     return true;
 }
 
+void Server::setConnectStep(SERVER_CONNECT_STEP step, int timeoutMs)
+{
+    m_connectStep = step;
+    if (SCS_NULL == step) {
+        m_connectStepTimer.stop();
+    } else {
+        m_connectStepTimer.start(timeoutMs);
+    }
+}
+
+void Server::onConnectStepTimeout()
+{
+    if (m_tunnelForward) {
+        qWarning("connect to server timeout at step %d", static_cast<int>(m_connectStep));
+        // 连接到adb很快的，连接阶段超时不重试
+        finishForwardConnect(false, m_connectStep >= SCS_DUMMY_BYTE);
+        return;
+    }
+
+    qInfo("readInfo timeout");
+    stop();
+    emit serverStarted(false);
+}
+
+void Server::onReverseVideoReadyRead()
+{
+    if (SCS_DEVICE_INFO != m_connectStep || !m_videoSocket) {
+        return;
+    }
+    if (!readInfo(m_videoSocket, m_deviceName, m_deviceSize)) {
+        return;
+    }
+    disconnect(m_videoSocket, &QTcpSocket::readyRead, this, &Server::onReverseVideoReadyRead);
+    setConnectStep(SCS_NULL, 0);
+    m_deviceInfoRead = true;
+    checkReverseConnected();
+}
+
+void Server::checkReverseConnected()
+{
+    if (!m_deviceInfoRead || !m_controlSocket) {
+        return;
+    }
+    emit serverStepFinished("connect", m_stepTimer.restart());
+    emit serverStarted(true, m_deviceName, m_deviceSize);
+}
+
+void Server::abortPendingConnect()
+{
+    setConnectStep(SCS_NULL, 0);
+    if (m_videoSocket) {
+        disconnect(m_videoSocket, &QTcpSocket::readyRead, this, &Server::onReverseVideoReadyRead);
+    }
+    if (m_pendingVideoSocket) {
+        m_pendingVideoSocket->disconnect(this);
+        m_pendingVideoSocket->abort();
+        m_pendingVideoSocket->deleteLater();
+        m_pendingVideoSocket = Q_NULLPTR;
+    }
+    if (m_pendingControlSocket) {
+        m_pendingControlSocket->disconnect(this);
+        m_pendingControlSocket->abort();
+        m_pendingControlSocket->deleteLater();
+        m_pendingControlSocket = Q_NULLPTR;
+    }
+}
+
 void Server::startAcceptTimeoutTimer()
 {
     stopAcceptTimeoutTimer();
@@ -379,7 +492,7 @@ void Server::stopAcceptTimeoutTimer()
 void Server::startConnectTimeoutTimer()
 {
     stopConnectTimeoutTimer();
-    m_connectTimeoutTimer = startTimer(300);
+    m_connectTimeoutTimer = startTimer(CONNECT_RETRY_INTERVAL);
 }
 
 void Server::stopConnectTimeoutTimer()
@@ -395,51 +508,95 @@ void Server::onConnectTimer()
 {
     // device server need time to start
     // 这里连接太早时间不够导致安卓监听socket还没有建立，readInfo会失败，所以采取定时重试策略
-    // 每隔100ms尝试一次，最多尝试MAX_CONNECT_COUNT次
-    QString deviceName;
-    QSize deviceSize;
-    bool success = false;
-
-    VideoSocket *videoSocket = new VideoSocket();
-    QTcpSocket *controlSocket = new QTcpSocket();
-
-    videoSocket->connectToHost(QHostAddress::LocalHost, m_params.localPort);
-    if (!videoSocket->waitForConnected(1000)) {
-        // 连接到adb很快的，这里失败不重试
-        m_connectCount = MAX_CONNECT_COUNT;
-        qWarning("video socket connect to server failed");
-        goto result;
+    // 每隔CONNECT_RETRY_INTERVAL尝试一次，最多尝试MAX_CONNECT_COUNT次
+    abortPendingConnect();
+
+    m_pendingVideoSocket = new VideoSocket();
+    m_pendingControlSocket = new QTcpSocket();
+    QList<QTcpSocket *> sockets;
+    sockets << m_pendingVideoSocket.data() << m_pendingControlSocket.data();
+    for (QTcpSocket *socket : sockets) {
+        connect(socket, &QTcpSocket::connected, this, &Server::onForwardSocketEvent);
+        connect(socket, &QTcpSocket::readyRead, this, &Server::onForwardSocketEvent);
+        connect(socket, &QTcpSocket::disconnected, this, &Server::onForwardSocketError);
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+        connect(socket, &QTcpSocket::errorOccurred, this, &Server::onForwardSocketError);
+#else
+        connect(socket, static_cast<void (QAbstractSocket::*)(QAbstractSocket::SocketError)>(&QAbstractSocket::error), this, &Server::onForwardSocketError);
+#endif
     }
 
-    controlSocket->connectToHost(QHostAddress::LocalHost, m_params.localPort);
-    if (!controlSocket->waitForConnected(1000)) {
-        // 连接到adb很快的，这里失败不重试
-        m_connectCount = MAX_CONNECT_COUNT;
-        qWarning("control socket connect to server failed");
-        goto result;
+    setConnectStep(SCS_VIDEO_CONNECT, CONNECT_SOCKET_TIMEOUT);
+    m_pendingVideoSocket->connectToHost(QHostAddress::LocalHost, m_params.localPort);
+}
+
+void Server::onForwardSocketEvent()
+{
+    if (!m_pendingVideoSocket || !m_pendingControlSocket) {
+        return;
     }
 
-    if (QTcpSocket::ConnectedState == videoSocket->state()) {
+    switch (m_connectStep) {
+    case SCS_VIDEO_CONNECT:
+        if (QTcpSocket::ConnectedState != m_pendingVideoSocket->state()) {
+            return;
+        }
+        setConnectStep(SCS_CONTROL_CONNECT, CONNECT_SOCKET_TIMEOUT);
+        m_pendingControlSocket->connectToHost(QHostAddress::LocalHost, m_params.localPort);
+        return;
+    case SCS_CONTROL_CONNECT:
+        if (QTcpSocket::ConnectedState != m_pendingControlSocket->state()) {
+            return;
+        }
         // connect will success even if devices offline, recv data is real connect success
         // because connect is to pc adb server
-        videoSocket->waitForReadyRead(1000);
+        setConnectStep(SCS_DUMMY_BYTE, CONNECT_DUMMY_BYTE_TIMEOUT);
+        Q_FALLTHROUGH();
+    case SCS_DUMMY_BYTE:
         // devices will send 1 byte first on tunnel forward mode
-        QByteArray data = videoSocket->read(1);
-        if (!data.isEmpty() && readInfo(videoSocket, deviceName, deviceSize)) {
-            success = true;
-            goto result;
-        } else {
-            qWarning("video socket connect to server read device info failed, try again");
-            goto result;
+        if (m_pendingVideoSocket->read(1).isEmpty()) {
+            return;
         }
-    } else {
-        qWarning("connect to server failed");
-        m_connectCount = MAX_CONNECT_COUNT;
-        goto result;
+        setConnectStep(SCS_DEVICE_INFO, DEVICE_INFO_TIMEOUT);
+        Q_FALLTHROUGH();
+    case SCS_DEVICE_INFO:
+        if (!readInfo(m_pendingVideoSocket, m_deviceName, m_deviceSize)) {
+            return;
+        }
+        finishForwardConnect(true, false);
+        return;
+    default:
+        return;
+    }
+}
+
+void Server::onForwardSocketError()
+{
+    if (SCS_NULL == m_connectStep) {
+        return;
     }
+    if (m_connectStep < SCS_DUMMY_BYTE) {
+        // 连接到adb很快的，这里失败不重试
+        qWarning("socket connect to server failed");
+        finishForwardConnect(false, false);
+        return;
+    }
+    // adb closes the tunnel while the device server is not listening yet
+    qWarning("video socket connect to server read device info failed, try again");
+    finishForwardConnect(false, true);
+}
 
-result:
+void Server::finishForwardConnect(bool success, bool retry)
+{
     if (success) {
+        setConnectStep(SCS_NULL, 0);
+        VideoSocket *videoSocket = m_pendingVideoSocket;
+        QTcpSocket *controlSocket = m_pendingControlSocket;
+        videoSocket->disconnect(this);
+        controlSocket->disconnect(this);
+        m_pendingVideoSocket = Q_NULLPTR;
+        m_pendingControlSocket = Q_NULLPTR;
+
         stopConnectTimeoutTimer();
         m_videoSocket = videoSocket;
         // devices will send 1 byte first on tunnel forward mode
@@ -449,17 +606,16 @@ result:
         disableTunnelForward();
         m_tunnelEnabled = false;
         m_restartCount = 0;
-        emit serverStarted(success, deviceName, deviceSize);
+        emit serverStepFinished("connect", m_stepTimer.restart());
+        emit serverStarted(true, m_deviceName, m_deviceSize);
         return;
     }
 
-    if (videoSocket) {
-        videoSocket->deleteLater();
-    }
-    if (controlSocket) {
-        controlSocket->deleteLater();
-    }
+    abortPendingConnect();
 
+    if (!retry) {
+        m_connectCount = MAX_CONNECT_COUNT;
+    }
     if (MAX_CONNECT_COUNT <= m_connectCount++) {
         stopConnectTimeoutTimer();
         stop();
@@ -470,7 +626,9 @@ result:
             m_restartCount = 0;
             emit serverStarted(false);
         }
+        return;
     }
+    m_connectTimeoutTimer = startTimer(CONNECT_RETRY_INTERVAL);
 }
 
 void Server::onWorkProcessResult(qsc::AdbProcess::ADB_EXEC_RESULT processResult)
@@ -478,18 +636,35 @@ void Server::onWorkProcessResult(qsc::AdbProcess::ADB_EXEC_RESULT processResult)
     if (sender() == &m_workProcess) {
         if (SSS_NULL != m_serverStartStep) {
             switch (m_serverStartStep) {
+            case SSS_CHECK_SERVER:
+                if (qsc::AdbProcess::AER_SUCCESS_EXEC == processResult
+                    && m_workProcess.getStdOut().trimmed().left(32).toLower().toUtf8() == localServerHash()) {
+                    qInfo("server is up to date on the device, skip push");
+                    if (m_params.useReverse) {
+                        setStartStep(SSS_ENABLE_TUNNEL_REVERSE);
+                    } else {
+                        m_tunnelForward = true;
+                        setStartStep(SSS_ENABLE_TUNNEL_FORWARD);
+                    }
+                    startServerByStep();
+                } else if (qsc::AdbProcess::AER_SUCCESS_START != processResult) {
+                    qInfo("server on the device is missing or outdated, push it");
+                    setStartStep(SSS_PUSH);
+                    startServerByStep();
+                }
+                break;
             case SSS_PUSH:
                 if (qsc::AdbProcess::AER_SUCCESS_EXEC == processResult) {
                     if (m_params.useReverse) {
-                        m_serverStartStep = SSS_ENABLE_TUNNEL_REVERSE;
+                        setStartStep(SSS_ENABLE_TUNNEL_REVERSE);
                     } else {
                         m_tunnelForward = true;
-                        m_serverStartStep = SSS_ENABLE_TUNNEL_FORWARD;
+                        setStartStep(SSS_ENABLE_TUNNEL_FORWARD);
                     }
                     startServerByStep();
                 } else if (qsc::AdbProcess::AER_SUCCESS_START != processResult) {
                     qCritical("adb push failed");
-                    m_serverStartStep = SSS_NULL;
+                    setStartStep(SSS_NULL);
                     emit serverStarted(false);
                 }
                 break;
@@ -501,32 +676,34 @@ void Server::onWorkProcessResult(qsc::AdbProcess::ADB_EXEC_RESULT processResult)
                     // client can listen before starting the server app, so there is no need to
                     // try to connect until the server socket is listening on the device.
                     m_serverSocket.setMaxPendingConnections(2);
+                    // a reconnect or restart listens again, its first socket is the video one
+                    m_serverSocket.resetSocketOrder();
                     if (!m_serverSocket.listen(QHostAddress::LocalHost, m_params.localPort)) {
                         qCritical() << QString("Could not listen on port %1").arg(m_params.localPort).toStdString().c_str();
-                        m_serverStartStep = SSS_NULL;
+                        setStartStep(SSS_NULL);
                         disableTunnelReverse();
                         emit serverStarted(false);
                         break;
                     }
 
-                    m_serverStartStep = SSS_EXECUTE_SERVER;
+                    setStartStep(SSS_EXECUTE_SERVER);
                     startServerByStep();
                 } else if (qsc::AdbProcess::AER_SUCCESS_START != processResult) {
                     // 有一些设备reverse会报错more than o'ne device，adb的bug
                     // https://github.com/Genymobile/scrcpy/issues/5
                     qCritical("adb reverse failed");
                     m_tunnelForward = true;
-                    m_serverStartStep = SSS_ENABLE_TUNNEL_FORWARD;
+                    setStartStep(SSS_ENABLE_TUNNEL_FORWARD);
                     startServerByStep();
                 }
                 break;
             case SSS_ENABLE_TUNNEL_FORWARD:
                 if (qsc::AdbProcess::AER_SUCCESS_EXEC == processResult) {
-                    m_serverStartStep = SSS_EXECUTE_SERVER;
+                    setStartStep(SSS_EXECUTE_SERVER);
                     startServerByStep();
                 } else if (qsc::AdbProcess::AER_SUCCESS_START != processResult) {
                     qCritical("adb forward failed");
-                    m_serverStartStep = SSS_NULL;
+                    setStartStep(SSS_NULL);
                     emit serverStarted(false);
                 }
                 break;
@@ -538,7 +715,7 @@ void Server::onWorkProcessResult(qsc::AdbProcess::ADB_EXEC_RESULT processResult)
     if (sender() == &m_serverProcess) {
         if (SSS_EXECUTE_SERVER == m_serverStartStep) {
             if (qsc::AdbProcess::AER_SUCCESS_START == processResult) {
-                m_serverStartStep = SSS_RUNNING;
+                setStartStep(SSS_RUNNING);
                 m_tunnelEnabled = true;
                 connectTo();
             } else if (qsc::AdbProcess::AER_ERROR_START == processResult) {
@@ -549,12 +726,75 @@ void Server::onWorkProcessResult(qsc::AdbProcess::ADB_EXEC_RESULT processResult)
                     disableTunnelForward();
                 }
                 qCritical("adb shell start server failed");
-                m_serverStartStep = SSS_NULL;
+                setStartStep(SSS_NULL);
                 emit serverStarted(false);
             }
         } else if (SSS_RUNNING == m_serverStartStep) {
-            m_serverStartStep = SSS_NULL;
+            setStartStep(SSS_NULL);
             emit serverStoped();
         }
     }
 }
+
+void Server::setStartStep(SERVER_START_STEP step)
+{
+    // steps after SSS_RUNNING are not part of the startup
+    if (SSS_NULL != m_serverStartStep && SSS_RUNNING > m_serverStartStep) {
+        qint64 elapsed = m_stepTimer.restart();
+        qInfo() << QString("server step %1 finished in %2ms").arg(stepName(m_serverStartStep)).arg(elapsed).toStdString().c_str();
+        emit serverStepFinished(stepName(m_serverStartStep), elapsed);
+    }
+    m_serverStartStep = step;
+}
+
+QString Server::stepName(SERVER_START_STEP step)
+{
+    switch (step) {
+    case SSS_CHECK_SERVER:
+        return "check";
+    case SSS_PUSH:
+        return "push";
+    case SSS_ENABLE_TUNNEL_REVERSE:
+        return "reverse";
+    case SSS_ENABLE_TUNNEL_FORWARD:
+        return "forward";
+    case SSS_EXECUTE_SERVER:
+        return "execute";
+    case SSS_RUNNING:
+        return "connect";
+    default:
+        return "null";
+    }
+}
+
+QByteArray Server::localServerHash()
+{
+    // hash once per file version, the jar is the same for all devices
+    static QString s_path;
+    static QDateTime s_lastModified;
+    static qint64 s_size = -1;
+    static QByteArray s_hash;
+
+    QFileInfo fileInfo(m_params.serverLocalPath);
+    if (!fileInfo.isFile()) {
+        return QByteArray();
+    }
+    if (s_path == fileInfo.absoluteFilePath() && s_lastModified == fileInfo.lastModified() && s_size == fileInfo.size()) {
+        return s_hash;
+    }
+
+    QFile file(fileInfo.absoluteFilePath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    if (!hash.addData(&file)) {
+        return QByteArray();
+    }
+
+    s_path = fileInfo.absoluteFilePath();
+    s_lastModified = fileInfo.lastModified();
+    s_size = fileInfo.size();
+    s_hash = hash.result().toHex();
+    return s_hash;
+}
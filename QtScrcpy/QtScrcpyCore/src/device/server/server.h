@@ -1,9 +1,11 @@
 #ifndef SERVER_H
 #define SERVER_H
 
+#include <QElapsedTimer>
 #include <QObject>
 #include <QPointer>
 #include <QSize>
+#include <QTimer>
 
 #include "adbprocess.h"
 #include "tcpserver.h"
@@ -16,6 +18,7 @@ class Server : public QObject
     enum SERVER_START_STEP
     {
         SSS_NULL,
+        SSS_CHECK_SERVER,
         SSS_PUSH,
         SSS_ENABLE_TUNNEL_REVERSE,
         SSS_ENABLE_TUNNEL_FORWARD,
@@ -23,6 +26,16 @@ class Server : public QObject
         SSS_RUNNING,
     };
 
+    // steps of a single connection attempt once the server runs
+    enum SERVER_CONNECT_STEP
+    {
+        SCS_NULL,
+        SCS_VIDEO_CONNECT,
+        SCS_CONTROL_CONNECT,
+        SCS_DUMMY_BYTE,
+        SCS_DEVICE_INFO,
+    };
+
 public:
     struct ServerParams
     {
@@ -64,18 +77,27 @@ public:
     Server::ServerParams getParams();
     VideoSocket *removeVideoSocket();
     QTcpSocket *getControlSocket();
+    // hands the control socket over, the server no longer closes it on stop
+    QTcpSocket *removeControlSocket();
 
 signals:
     void serverStarted(bool success, const QString &deviceName = "", const QSize &size = QSize());
     void serverStoped();
+    // emitted when a startup step finishes, elapsedMs is the time spent in that step
+    void serverStepFinished(const QString &step, qint64 elapsedMs);
 
 private slots:
     void onWorkProcessResult(qsc::AdbProcess::ADB_EXEC_RESULT processResult);
+    void onConnectStepTimeout();
+    void onForwardSocketEvent();
+    void onForwardSocketError();
+    void onReverseVideoReadyRead();
 
 protected:
     void timerEvent(QTimerEvent *event);
 
 private:
+    bool checkServer();
     bool pushServer();
     bool enableTunnelReverse();
     bool disableTunnelReverse();
@@ -85,11 +107,18 @@ private:
     bool connectTo();
     bool startServerByStep();
     bool readInfo(VideoSocket *videoSocket, QString &deviceName, QSize &size);
+    void setConnectStep(SERVER_CONNECT_STEP step, int timeoutMs);
+    void finishForwardConnect(bool success, bool retry);
+    void checkReverseConnected();
+    void abortPendingConnect();
     void startAcceptTimeoutTimer();
     void stopAcceptTimeoutTimer();
     void startConnectTimeoutTimer();
     void stopConnectTimeoutTimer();
     void onConnectTimer();
+    void setStartStep(SERVER_START_STEP step);
+    QString stepName(SERVER_START_STEP step);
+    QByteArray localServerHash();
 
 private:
     qsc::AdbProcess m_workProcess;
@@ -97,6 +126,12 @@ private:
     TcpServer m_serverSocket; // only used if !tunnel_forward
     QPointer<VideoSocket> m_videoSocket = Q_NULLPTR;
     QPointer<QTcpSocket> m_controlSocket = Q_NULLPTR;
+    // sockets of the forward connection attempt in progress
+    QPointer<VideoSocket> m_pendingVideoSocket = Q_NULLPTR;
+    QPointer<QTcpSocket> m_pendingControlSocket = Q_NULLPTR;
+    SERVER_CONNECT_STEP m_connectStep = SCS_NULL;
+    QTimer m_connectStepTimer;
+    bool m_deviceInfoRead = false;
     bool m_tunnelEnabled = false;
     bool m_tunnelForward = false; // use "adb forward" instead of "adb reverse"
     int m_acceptTimeoutTimer = 0;
@@ -108,6 +143,7 @@ private:
     ServerParams m_params;
 
     SERVER_START_STEP m_serverStartStep = SSS_NULL;
+    QElapsedTimer m_stepTimer;
 };
 
 #endif // SERVER_H
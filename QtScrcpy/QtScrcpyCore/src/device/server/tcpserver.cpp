@@ -5,6 +5,11 @@ TcpServer::TcpServer(QObject *parent) : QTcpServer(parent) {}
 
 TcpServer::~TcpServer() {}
 
+void TcpServer::resetSocketOrder()
+{
+    m_isVideoSocket = true;
+}
+
 void TcpServer::incomingConnection(qintptr handle)
 {
     if (m_isVideoSocket) {
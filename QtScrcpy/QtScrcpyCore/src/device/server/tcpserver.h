@@ -10,6 +10,9 @@ public:
     explicit TcpServer(QObject *parent = nullptr);
     virtual ~TcpServer();
 
+    // the next connection is the video socket again, call before each listen()
+    void resetSocketOrder();
+
 protected:
     virtual void incomingConnection(qintptr handle);
 
@@ -0,0 +1,141 @@
+#include <QDebug>
+
+#include "connectscheduler.h"
+
+// spacing between two server startups, each one runs several adb commands
+#define CS_START_INTERVAL 20
+#define CS_MAX_ATTEMPTS 3
+#define CS_RETRY_BACKOFF 500
+#define CS_RETRY_BACKOFF_MAX 8000
+
+namespace qsc {
+
+ConnectScheduler::ConnectScheduler(std::function<bool(const DeviceParams &params)> connector, QObject *parent)
+    : QObject(parent)
+    , m_connector(connector)
+{
+    m_clock.start();
+    m_pumpTimer.setSingleShot(true);
+    connect(&m_pumpTimer, &QTimer::timeout, this, &ConnectScheduler::pump);
+}
+
+ConnectScheduler::~ConnectScheduler() {}
+
+void ConnectScheduler::enqueue(const DeviceParams &params)
+{
+    if (params.serial.trimmed().isEmpty() || isScheduled(params.serial)) {
+        return;
+    }
+    ConnectJob job;
+    job.params = params;
+    m_pending.append(job);
+    if (!m_pumpTimer.isActive()) {
+        m_pumpTimer.start(0);
+    }
+}
+
+void ConnectScheduler::setMaxConcurrent(int count)
+{
+    m_maxConcurrent = qMax(1, count);
+    m_pumpTimer.start(0);
+}
+
+bool ConnectScheduler::isScheduled(const QString &serial)
+{
+    if (m_running.contains(serial)) {
+        return true;
+    }
+    for (const auto &job : m_pending) {
+        if (job.params.serial == serial) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ConnectScheduler::onDeviceConnected(bool success, const QString &serial)
+{
+    if (!m_running.contains(serial)) {
+        return false;
+    }
+
+    ConnectJob job = m_running.value(serial);
+    finishJob(serial);
+
+    if (success || CS_MAX_ATTEMPTS <= job.attempts) {
+        if (!success) {
+            qWarning("connect %s failed after %d attempts", serial.toUtf8().data(), job.attempts);
+        }
+        return false;
+    }
+
+    // 500ms, 1s, 2s ... so a busy adb server gets room to recover
+    qint64 backoff = qMin<qint64>(CS_RETRY_BACKOFF << (job.attempts - 1), CS_RETRY_BACKOFF_MAX);
+    job.notBefore = m_clock.elapsed() + backoff;
+    m_pending.append(job);
+    qInfo("connect %s failed, retry in %lldms", serial.toUtf8().data(), backoff);
+    m_pumpTimer.start(0);
+    return true;
+}
+
+void ConnectScheduler::cancel(const QString &serial)
+{
+    for (int i = m_pending.size() - 1; i >= 0; i--) {
+        if (m_pending[i].params.serial == serial) {
+            m_pending.removeAt(i);
+        }
+    }
+    if (m_running.contains(serial)) {
+        finishJob(serial);
+    }
+}
+
+void ConnectScheduler::pump()
+{
+    qint64 now = m_clock.elapsed();
+    qint64 nextWake = -1;
+
+    while (m_running.size() < m_maxConcurrent && !m_pending.isEmpty()) {
+        if (m_lastStart >= 0 && now - m_lastStart < CS_START_INTERVAL) {
+            nextWake = m_lastStart + CS_START_INTERVAL;
+            break;
+        }
+
+        int index = -1;
+        for (int i = 0; i < m_pending.size(); i++) {
+            if (m_pending[i].notBefore <= now) {
+                index = i;
+                break;
+            }
+            if (nextWake < 0 || m_pending[i].notBefore < nextWake) {
+                nextWake = m_pending[i].notBefore;
+            }
+        }
+        if (index < 0) {
+            break;
+        }
+
+        ConnectJob job = m_pending.takeAt(index);
+        job.attempts++;
+        m_lastStart = now;
+        m_running.insert(job.params.serial, job);
+        if (!m_connector(job.params)) {
+            qWarning("connect %s rejected", job.params.serial.toUtf8().data());
+            finishJob(job.params.serial);
+        }
+    }
+
+    if (nextWake >= 0 && !m_pending.isEmpty()) {
+        m_pumpTimer.start(static_cast<int>(qMax<qint64>(0, nextWake - now)));
+    }
+}
+
+void ConnectScheduler::finishJob(const QString &serial)
+{
+    m_running.remove(serial);
+    if (!m_pending.isEmpty()) {
+        m_pumpTimer.start(0);
+    }
+}
+
+}
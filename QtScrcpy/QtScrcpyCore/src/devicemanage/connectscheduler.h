@@ -0,0 +1,57 @@
+#ifndef CONNECTSCHEDULER_H
+#define CONNECTSCHEDULER_H
+
+#include <functional>
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QTimer>
+
+#include "../../include/QtScrcpyCoreDef.h"
+
+namespace qsc {
+
+// connects a batch of devices without flooding adb:
+// at most maxConcurrent server startups run at once, new startups are spaced out,
+// failures are retried with backoff
+class ConnectScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ConnectScheduler(std::function<bool(const DeviceParams &params)> connector, QObject *parent = Q_NULLPTR);
+    virtual ~ConnectScheduler();
+
+    void enqueue(const DeviceParams &params);
+    void setMaxConcurrent(int count);
+    bool isScheduled(const QString &serial);
+    // returns true if the failure was taken over by a retry
+    bool onDeviceConnected(bool success, const QString &serial);
+    void cancel(const QString &serial);
+
+private slots:
+    void pump();
+
+private:
+    struct ConnectJob
+    {
+        DeviceParams params;
+        int attempts = 0;
+        qint64 notBefore = 0; // ms on m_clock
+    };
+
+    void finishJob(const QString &serial);
+
+private:
+    std::function<bool(const DeviceParams &params)> m_connector = Q_NULLPTR;
+    QList<ConnectJob> m_pending;
+    QMap<QString, ConnectJob> m_running;
+    int m_maxConcurrent = 8;
+    qint64 m_lastStart = -1;
+    QElapsedTimer m_clock;
+    QTimer m_pumpTimer;
+};
+
+}
+#endif // CONNECTSCHEDULER_H
@@ -0,0 +1,203 @@
+#include <algorithm>
+
+#include <QDebug>
+#include <QThread>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "device.h"
+#include "devicegovernor.h"
+
+#define GOVERNOR_INTERVAL_MS 1000
+// released again below this share of the limits
+#define GOVERNOR_RELEASE_RATIO 0.7
+// a device keeps its level at least this long, the load needs time to follow
+#define GOVERNOR_HOLD_MS 3000
+// stream restarts per step, each one costs a server start on the device
+#define GOVERNOR_MAX_RESTARTS 4
+
+namespace qsc {
+
+DeviceGovernor::DeviceGovernor(std::function<QList<QPointer<IDevice>>()> devices, QObject *parent)
+    : QObject(parent)
+    , m_devices(devices)
+{
+    m_timer.setInterval(GOVERNOR_INTERVAL_MS);
+    connect(&m_timer, &QTimer::timeout, this, &DeviceGovernor::onTick);
+}
+
+DeviceGovernor::~DeviceGovernor()
+{
+}
+
+void DeviceGovernor::setLimits(int maxCpuPercent, int maxMbps)
+{
+    m_maxCpuPercent = qMax(0, maxCpuPercent);
+    m_maxMbps = qMax(0, maxMbps);
+    if (m_maxCpuPercent || m_maxMbps) {
+        if (!m_timer.isActive()) {
+            m_clock.start();
+            m_lastTickUs = 0;
+            m_lastCpuUs = processCpuUs();
+            m_states.clear();
+            m_timer.start();
+        }
+        return;
+    }
+
+    m_timer.stop();
+    int restarts = 0;
+    for (const auto &item : m_devices()) {
+        Device *device = qobject_cast<Device *>(item.data());
+        if (device) {
+            apply(device, GL_FULL, restarts);
+        }
+    }
+    m_states.clear();
+}
+
+qint64 DeviceGovernor::processCpuUs()
+{
+#ifdef Q_OS_WIN
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime)) {
+        return 0;
+    }
+    // 100ns units
+    quint64 kernel = (static_cast<quint64>(kernelTime.dwHighDateTime) << 32) | kernelTime.dwLowDateTime;
+    quint64 user = (static_cast<quint64>(userTime.dwHighDateTime) << 32) | userTime.dwLowDateTime;
+    return static_cast<qint64>((kernel + user) / 10);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage)) {
+        return 0;
+    }
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000LL + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#endif
+}
+
+bool DeviceGovernor::apply(Device *device, int level, int &restarts)
+{
+    if (device->throttleLevel() == level) {
+        return false;
+    }
+    QString serial = device->getSerial();
+    m_states[serial].lastChange = m_clock.elapsed();
+    if (device->setThrottleLevel(level)) {
+        restarts++;
+    }
+    qInfo("governor: %s to level %d (cpu %.0f%%, %.1fMbps)", serial.toUtf8().data(), level, m_cpuPercent, m_mbps);
+    emit decision(serial, level, m_cpuPercent, m_mbps);
+    return true;
+}
+
+void DeviceGovernor::onTick()
+{
+    qint64 nowUs = m_clock.nsecsElapsed() / 1000;
+    qint64 cpuUs = processCpuUs();
+    qint64 wallUs = nowUs - m_lastTickUs;
+    if (wallUs <= 0) {
+        return;
+    }
+
+    QList<Device *> devices;
+    quint64 bytes = 0;
+    for (const auto &item : m_devices()) {
+        Device *device = qobject_cast<Device *>(item.data());
+        if (!device) {
+            continue;
+        }
+        devices.append(device);
+        quint64 total = device->videoBytes();
+        if (!m_states.contains(device->getSerial())) {
+            // a new device counts from its first tick
+            m_states[device->getSerial()].lastBytes = total;
+            continue;
+        }
+        DeviceState &state = m_states[device->getSerial()];
+        if (total >= state.lastBytes) {
+            bytes += total - state.lastBytes;
+        }
+        state.lastBytes = total;
+    }
+
+    m_cpuPercent = 100.0 * (cpuUs - m_lastCpuUs) / wallUs / qMax(1, QThread::idealThreadCount());
+    // bits per microsecond
+    m_mbps = bytes * 8.0 / wallUs;
+    m_lastTickUs = nowUs;
+    m_lastCpuUs = cpuUs;
+
+    bool pressure = (m_maxCpuPercent && m_cpuPercent > m_maxCpuPercent) || (m_maxMbps && m_mbps > m_maxMbps);
+    bool relief = (!m_maxCpuPercent || m_cpuPercent < m_maxCpuPercent * GOVERNOR_RELEASE_RATIO)
+                  && (!m_maxMbps || m_mbps < m_maxMbps * GOVERNOR_RELEASE_RATIO);
+
+    int restarts = 0;
+    qint64 now = m_clock.elapsed();
+    QList<Device *> background;
+    for (Device *device : devices) {
+        if (device->isInView()) {
+            // right away, someone is looking at it
+            apply(device, GL_FULL, restarts);
+        } else {
+            background.append(device);
+        }
+    }
+
+    auto holding = [this, now](Device *device) {
+        qint64 lastChange = m_states[device->getSerial()].lastChange;
+        return lastChange >= 0 && now - lastChange < GOVERNOR_HOLD_MS;
+    };
+
+    if (pressure) {
+        // the least throttled first, so the load is shed evenly
+        std::stable_sort(background.begin(), background.end(), [](Device *a, Device *b) {
+            return a->throttleLevel() < b->throttleLevel();
+        });
+        for (Device *device : background) {
+            int level = device->throttleLevel() + 1;
+            if (level > GL_REDUCED_STREAM || holding(device)) {
+                continue;
+            }
+            if (level == GL_REDUCED_STREAM && restarts >= GOVERNOR_MAX_RESTARTS) {
+                continue;
+            }
+            apply(device, level, restarts);
+        }
+    } else if (relief) {
+        // one device per step, the most throttled first
+        Device *next = Q_NULLPTR;
+        for (Device *device : background) {
+            if (device->throttleLevel() == GL_FULL || holding(device)) {
+                continue;
+            }
+            if (!next || device->throttleLevel() > next->throttleLevel()) {
+                next = device;
+            }
+        }
+        if (next) {
+            apply(next, next->throttleLevel() - 1, restarts);
+        }
+    }
+
+    // the disconnected ones
+    for (auto it = m_states.begin(); it != m_states.end();) {
+        bool found = false;
+        for (Device *device : devices) {
+            if (device->getSerial() == it.key()) {
+                found = true;
+                break;
+            }
+        }
+        if (found) {
+            ++it;
+        } else {
+            it = m_states.erase(it);
+        }
+    }
+}
+
+}
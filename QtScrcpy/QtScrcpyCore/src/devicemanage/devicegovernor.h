@@ -0,0 +1,63 @@
+#ifndef DEVICEGOVERNOR_H
+#define DEVICEGOVERNOR_H
+
+#include <functional>
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+
+#include "../../include/QtScrcpyCore.h"
+
+namespace qsc {
+
+class Device;
+
+// keeps the process within a CPU and a video bandwidth budget when many devices stream:
+// the devices in view keep full quality, the others are throttled one GovernorLevel per step
+// under pressure (frames skipped by the decoder, then a smaller and slower stream) and released
+// one device per step once the load is well below the limits
+class DeviceGovernor : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DeviceGovernor(std::function<QList<QPointer<IDevice>>()> devices, QObject *parent = Q_NULLPTR);
+    virtual ~DeviceGovernor();
+
+    // both 0 stop it and release every device
+    void setLimits(int maxCpuPercent, int maxMbps);
+
+signals:
+    void decision(const QString &serial, int level, double cpuPercent, double mbps);
+
+private slots:
+    void onTick();
+
+private:
+    struct DeviceState
+    {
+        quint64 lastBytes = 0;
+        qint64 lastChange = -1; // ms on m_clock
+    };
+
+    static qint64 processCpuUs();
+    bool apply(Device *device, int level, int &restarts);
+
+private:
+    std::function<QList<QPointer<IDevice>>()> m_devices = Q_NULLPTR;
+    int m_maxCpuPercent = 0;
+    int m_maxMbps = 0;
+    QMap<QString, DeviceState> m_states;
+    QElapsedTimer m_clock;
+    qint64 m_lastTickUs = 0;
+    qint64 m_lastCpuUs = 0;
+    double m_cpuPercent = 0;
+    double m_mbps = 0;
+    QTimer m_timer;
+};
+
+}
+#endif // DEVICEGOVERNOR_H
@@ -1,15 +1,69 @@
 #include <QDebug>
 #include <QKeyEvent>
 #include <QMouseEvent>
+#include <QVarLengthArray>
 #include <QWheelEvent>
 
+#include "connectscheduler.h"
+#include "controlchannel.h"
+#include "controlmsg.h"
+#include "devicediscovery.h"
+#include "devicegovernor.h"
 #include "devicemanage.h"
 #include "device.h"
 #include "demuxer.h"
+#include "inputconvertnormal.h"
+#include "macro.h"
+#include "memoryaccount.h"
 
 namespace qsc {
 
 #define DM_MAX_DEVICES_NUM 1000
+// a group macro replay starts this much after it is submitted, so every device is in time
+#define DM_MACRO_START_LEAD_MS 20
+
+// convert(frameSize, controlMsg) runs once per distinct frame size, or once at all if the
+// message has no position, fallback(device) serves the devices with their own conversion
+template <typename Convert, typename Fallback>
+static void broadcastControlMsg(const QVector<QPointer<IDevice>> &devices, ControlMsg::ControlMsgType type, bool positional,
+                                int alignMs, Convert convert, Fallback fallback)
+{
+    // one release time for the whole group, the I/O thread flushes every socket at it
+    qint64 releaseNs = alignMs > 0 ? ControlChannel::nowNs() + alignMs * 1000000LL : 0;
+    // a group has a few distinct frame sizes at most
+    QVarLengthArray<QPair<QSize, QByteArray>, 4> serialized;
+    for (const auto &item : devices) {
+        Device *device = qobject_cast<Device *>(item.data());
+        if (!device) {
+            continue;
+        }
+        if (!device->isNormalInput()) {
+            fallback(device);
+            continue;
+        }
+
+        QSize frameSize = positional ? device->frameSize() : QSize();
+        if (positional && frameSize.isEmpty()) {
+            continue;
+        }
+        int index = 0;
+        while (index < serialized.size() && serialized[index].first != frameSize) {
+            ++index;
+        }
+        if (index == serialized.size()) {
+            QByteArray buffer;
+            ControlMsg controlMsg(type);
+            if (convert(frameSize, controlMsg)) {
+                buffer.resize(controlMsg.serializedSize());
+                int len = controlMsg.serializeTo(reinterpret_cast<uchar *>(buffer.data()), buffer.size());
+                buffer.resize(qMax(0, len));
+            }
+            serialized.append(qMakePair(frameSize, buffer));
+        }
+        // implicitly shared, every socket queues the same bytes
+        device->sendSerializedControl(serialized[index].second, releaseNs);
+    }
+}
 
 IDeviceManage& IDeviceManage::getInstance() {
     static DeviceManage dm;
@@ -18,6 +72,25 @@ IDeviceManage& IDeviceManage::getInstance() {
 
 DeviceManage::DeviceManage() {
     Demuxer::init();
+    m_scheduler = new ConnectScheduler([this](const DeviceParams &params) -> bool {
+        return startDevice(params);
+    }, this);
+
+    m_governor = new DeviceGovernor([this]() -> QList<QPointer<IDevice>> {
+        return m_devices.values();
+    }, this);
+    connect(m_governor, &DeviceGovernor::decision, this, &IDeviceManage::governorDecision);
+
+    m_discovery = new DeviceDiscovery(this);
+    connect(m_discovery, &DeviceDiscovery::deviceAdded, this, [this](const QString &serial, const QString &state) {
+        emit deviceAdded(serial, state);
+        onDiscoveredDeviceState(serial, state);
+    });
+    connect(m_discovery, &DeviceDiscovery::deviceStateChanged, this, [this](const QString &serial, const QString &state) {
+        emit deviceStateChanged(serial, state);
+        onDiscoveredDeviceState(serial, state);
+    });
+    connect(m_discovery, &DeviceDiscovery::deviceRemoved, this, &IDeviceManage::deviceRemoved);
 }
 
 DeviceManage::~DeviceManage() {
@@ -32,7 +105,178 @@ QPointer<IDevice> DeviceManage::getDevice(const QString &serial)
     return m_devices[serial];
 }
 
+void DeviceManage::playMacro(const QString &fileName, const QStringList &serials, int loops)
+{
+    // read once and planned once per frame size, every plan gets the same start on the input scheduler
+    Macro macro;
+    if (!macro.load(fileName) || macro.isEmpty()) {
+        qWarning() << "macro: load failed" << fileName;
+        return;
+    }
+    qint64 startNs = ControlChannel::nowNs() + DM_MACRO_START_LEAD_MS * 1000000LL;
+    QVarLengthArray<QPair<QSize, QVector<InputScheduler::Step>>, 4> plans;
+    for (const auto &serial : serials) {
+        Device *device = qobject_cast<Device *>(getDevice(serial).data());
+        if (!device) {
+            continue;
+        }
+        QSize frameSize = device->frameSize();
+        if (frameSize.isEmpty()) {
+            qWarning() << "macro: no frame yet on" << serial;
+            continue;
+        }
+        int index = 0;
+        while (index < plans.size() && plans[index].first != frameSize) {
+            ++index;
+        }
+        if (index == plans.size()) {
+            plans.append(qMakePair(frameSize, macro.plan(frameSize)));
+        }
+        if (!device->playMacroSteps(plans[index].second, loops, startNs)) {
+            qWarning() << "macro: play failed on" << serial;
+        }
+    }
+}
+
+void DeviceManage::stopMacro(const QStringList &serials)
+{
+    for (const auto &serial : serials) {
+        QPointer<IDevice> device = getDevice(serial);
+        if (device) {
+            device->stopMacro();
+        }
+    }
+}
+
+void DeviceManage::broadcastMouseEvent(const QVector<QPointer<IDevice>> &devices, const QMouseEvent *from, const QSize &showSize)
+{
+    broadcastControlMsg(devices, ControlMsg::CMT_INJECT_TOUCH, true, m_broadcastAlignMs,
+        [from, &showSize](const QSize &frameSize, ControlMsg &controlMsg) {
+            return InputConvertNormal::convertMouseEvent(from, frameSize, showSize, controlMsg);
+        },
+        [from, &showSize](Device *device) {
+            device->mouseEvent(from, device->frameSize(), showSize);
+        });
+}
+
+void DeviceManage::broadcastWheelEvent(const QVector<QPointer<IDevice>> &devices, const QWheelEvent *from, const QSize &showSize)
+{
+    broadcastControlMsg(devices, ControlMsg::CMT_INJECT_SCROLL, true, m_broadcastAlignMs,
+        [from, &showSize](const QSize &frameSize, ControlMsg &controlMsg) {
+            return InputConvertNormal::convertWheelEvent(from, frameSize, showSize, controlMsg);
+        },
+        [from, &showSize](Device *device) {
+            device->wheelEvent(from, device->frameSize(), showSize);
+        });
+}
+
+void DeviceManage::broadcastKeyEvent(const QVector<QPointer<IDevice>> &devices, const QKeyEvent *from, const QSize &showSize)
+{
+    broadcastControlMsg(devices, ControlMsg::CMT_INJECT_KEYCODE, false, m_broadcastAlignMs,
+        [this, from](const QSize &frameSize, ControlMsg &controlMsg) {
+            Q_UNUSED(frameSize)
+            return InputConvertNormal::convertKeyEvent(from, m_broadcastRepeat, controlMsg);
+        },
+        [from, &showSize](Device *device) {
+            device->keyEvent(from, device->frameSize(), showSize);
+        });
+}
+
+void DeviceManage::setBroadcastAlignment(int alignMs)
+{
+    m_broadcastAlignMs = qMax(0, alignMs);
+}
+
+void DeviceManage::takeBroadcastSpread(quint64 &count, double &avgMs, double &maxMs)
+{
+    qint64 sumNs = 0;
+    qint64 maxNs = 0;
+    ControlChannel::takeReleaseSpread(count, sumNs, maxNs);
+    avgMs = count ? sumNs / 1000000.0 / count : 0.0;
+    maxMs = maxNs / 1000000.0;
+}
+
+void DeviceManage::setGovernor(int maxCpuPercent, int maxMbps)
+{
+    m_governor->setLimits(maxCpuPercent, maxMbps);
+}
+
+MemoryUsage DeviceManage::totalMemoryUsage()
+{
+    return Device::toMemoryUsage(&MemoryAccount::processCurrent);
+}
+
+MemoryUsage DeviceManage::totalMemoryPeak()
+{
+    return Device::toMemoryUsage(&MemoryAccount::processPeak);
+}
+
 bool DeviceManage::connectDevice(qsc::DeviceParams params)
+{
+    if (m_scheduler->isScheduled(params.serial)) {
+        return false;
+    }
+    return startDevice(params);
+}
+
+void DeviceManage::connectDevices(const QList<DeviceParams> &paramsList)
+{
+    for (const auto &params : paramsList) {
+        if (!m_devices.contains(params.serial)) {
+            m_scheduler->enqueue(params);
+        }
+    }
+}
+
+void DeviceManage::setMaxConcurrentConnects(int count)
+{
+    m_scheduler->setMaxConcurrent(count);
+}
+
+void DeviceManage::startDeviceDiscovery(bool autoConnect, const DeviceParams &autoConnectParams)
+{
+    m_autoConnect = autoConnect;
+    m_autoConnectParams = autoConnectParams;
+    if (m_discovery->isActive()) {
+        // devices already online are picked up by the new auto connect setting
+        const QStringList serials = getOnlineDevices();
+        for (const auto &serial : serials) {
+            onDiscoveredDeviceState(serial, "device");
+        }
+        return;
+    }
+    m_discovery->start();
+}
+
+void DeviceManage::stopDeviceDiscovery()
+{
+    m_autoConnect = false;
+    m_discovery->stop();
+}
+
+QStringList DeviceManage::getOnlineDevices()
+{
+    QStringList serials;
+    QMap<QString, QString> devices = m_discovery->getDevices();
+    for (auto it = devices.constBegin(); it != devices.constEnd(); ++it) {
+        if ("device" == it.value()) {
+            serials << it.key();
+        }
+    }
+    return serials;
+}
+
+void DeviceManage::onDiscoveredDeviceState(const QString &serial, const QString &state)
+{
+    if (!m_autoConnect || "device" != state || m_devices.contains(serial)) {
+        return;
+    }
+    DeviceParams params = m_autoConnectParams;
+    params.serial = serial;
+    connectDevices(QList<DeviceParams>() << params);
+}
+
+bool DeviceManage::startDevice(DeviceParams params)
 {
     if (params.serial.trimmed().isEmpty()) {
         return false;
@@ -44,34 +288,37 @@ bool DeviceManage::connectDevice(qsc::DeviceParams params)
         qInfo("over the maximum number of connections");
         return false;
     }
-    /*
-    // 没有必要分配端口，都用27183即可，连接建立以后server会释放监听的
-    quint16 port = 0;
-    if (params.useReverse) {
-         port = getFreePort();
-        if (0 == port) {
-            qInfo("no port available, automatically switch to forward");
-            params.useReverse = false;
-        } else {
-            params.localPort = port;
-            qInfo("free port %d", port);
-        }
+    // every connecting device gets its own port, concurrent startups would
+    // otherwise race on the reverse listener or the forward tunnel
+    quint16 port = getFreePort();
+    if (0 == port) {
+        qInfo("no port available");
+        return false;
     }
-    */
+    params.localPort = port;
+    m_usedPorts.insert(port);
+    m_connectPorts[params.serial] = port;
+
     IDevice *device = new Device(params);
     connect(device, &Device::deviceConnected, this, &DeviceManage::onDeviceConnected);
     connect(device, &Device::deviceDisconnected, this, &DeviceManage::onDeviceDisconnected);
+    connect(device, &Device::firstFrameReceived, this, &DeviceManage::onDeviceFirstFrame);
     if (!device->connectDevice()) {
+        releasePort(params.serial);
         delete device;
         return false;
     }
     m_devices[params.serial] = device;
+    m_connectClocks[params.serial].start();
     return true;
 }
 
 bool DeviceManage::disconnectDevice(const QString &serial)
 {
     bool ret = false;
+    m_scheduler->cancel(serial);
+    releasePort(serial);
+    m_connectClocks.remove(serial);
     if (!serial.isEmpty() && m_devices.contains(serial)) {
         auto it = m_devices.find(serial);
         if (it->data()) {
@@ -87,6 +334,7 @@ void DeviceManage::disconnectAllDevice()
     QMapIterator<QString, QPointer<IDevice>> i(m_devices);
     while (i.hasNext()) {
         i.next();
+        m_scheduler->cancel(i.key());
         if (i.value()) {
             delete i.value();
         }
@@ -95,7 +343,11 @@ void DeviceManage::disconnectAllDevice()
 
 void DeviceManage::onDeviceConnected(bool success, const QString &serial, const QString &deviceName, const QSize &size)
 {
-    emit deviceConnected(success, serial, deviceName, size);
+    // the port stays with a connected device, a reconnect or stream restart listens on it again
+    // a scheduled connect that will be retried is not reported as failed yet
+    if (!m_scheduler->onDeviceConnected(success, serial)) {
+        emit deviceConnected(success, serial, deviceName, size);
+    }
     if (!success) {
         removeDevice(serial);
     }
@@ -107,21 +359,21 @@ void DeviceManage::onDeviceDisconnected(QString serial)
     removeDevice(serial);
 }
 
+void DeviceManage::onDeviceFirstFrame(const QString &serial)
+{
+    if (!m_connectClocks.contains(serial)) {
+        return;
+    }
+    qint64 elapsed = m_connectClocks.take(serial).elapsed();
+    qInfo("%s first frame in %lldms", serial.toUtf8().data(), elapsed);
+    emit deviceFirstFrame(serial, elapsed);
+}
+
 quint16 DeviceManage::getFreePort()
 {
     quint16 port = m_localPortStart;
     while (port < m_localPortStart + DM_MAX_DEVICES_NUM) {
-        bool used = false;
-        QMapIterator<QString, QPointer<IDevice>> i(m_devices);
-        while (i.hasNext()) {
-            i.next();
-            auto device = i.value();
-            if (device && device->isReversePort(port)) {
-                used = true;
-                break;
-            }
-        }
-        if (!used) {
+        if (!m_usedPorts.contains(port)) {
             return port;
         }
         port++;
@@ -129,8 +381,17 @@ quint16 DeviceManage::getFreePort()
     return 0;
 }
 
+void DeviceManage::releasePort(const QString &serial)
+{
+    if (m_connectPorts.contains(serial)) {
+        m_usedPorts.remove(m_connectPorts.take(serial));
+    }
+}
+
 void DeviceManage::removeDevice(const QString &serial)
 {
+    releasePort(serial);
+    m_connectClocks.remove(serial);
     if (!serial.isEmpty() && m_devices.contains(serial)) {
         m_devices[serial]->deleteLater();
         m_devices.remove(serial);
@@ -1,12 +1,18 @@
 #ifndef DEVICEMANAGE_H
 #define DEVICEMANAGE_H
 
+#include <QElapsedTimer>
 #include <QMap>
+#include <QSet>
 
 #include "../../include/QtScrcpyCore.h"
 
+class DeviceDiscovery;
+
 namespace qsc {
 
+class ConnectScheduler;
+class DeviceGovernor;
 class DeviceManage : public IDeviceManage
 {
     Q_OBJECT
@@ -15,23 +21,55 @@ public:
     virtual ~DeviceManage();
 
     virtual QPointer<IDevice> getDevice(const QString& serial) override;
+    void playMacro(const QString &fileName, const QStringList &serials, int loops = 1) override;
+    void stopMacro(const QStringList &serials) override;
+    void broadcastMouseEvent(const QVector<QPointer<IDevice>> &devices, const QMouseEvent *from, const QSize &showSize) override;
+    void broadcastWheelEvent(const QVector<QPointer<IDevice>> &devices, const QWheelEvent *from, const QSize &showSize) override;
+    void broadcastKeyEvent(const QVector<QPointer<IDevice>> &devices, const QKeyEvent *from, const QSize &showSize) override;
+    void setBroadcastAlignment(int alignMs) override;
+    void takeBroadcastSpread(quint64 &count, double &avgMs, double &maxMs) override;
+    void setGovernor(int maxCpuPercent, int maxMbps) override;
+    MemoryUsage totalMemoryUsage() override;
+    MemoryUsage totalMemoryPeak() override;
 
     bool connectDevice(qsc::DeviceParams params) override;
+    void connectDevices(const QList<qsc::DeviceParams>& paramsList) override;
+    void setMaxConcurrentConnects(int count) override;
+    void startDeviceDiscovery(bool autoConnect = false, const qsc::DeviceParams& autoConnectParams = qsc::DeviceParams()) override;
+    void stopDeviceDiscovery() override;
+    QStringList getOnlineDevices() override;
     bool disconnectDevice(const QString &serial) override;
     void disconnectAllDevice() override;
 
 protected slots:
     void onDeviceConnected(bool success, const QString& serial, const QString& deviceName, const QSize& size);
     void onDeviceDisconnected(QString serial);
+    void onDeviceFirstFrame(const QString& serial);
+    void onDiscoveredDeviceState(const QString& serial, const QString& state);
 
 private:
+    bool startDevice(qsc::DeviceParams params);
     quint16 getFreePort();
+    void releasePort(const QString& serial);
     void removeDevice(const QString& serial);
 
 private:
     QMap<QString, QPointer<IDevice>> m_devices;
     quint16 m_localPortStart = 27183;
+    // local ports held by the devices, kept while connected because a reconnect or
+    // stream restart starts the server on the same port again
+    QSet<quint16> m_usedPorts;
+    QMap<QString, quint16> m_connectPorts;
+    QMap<QString, QElapsedTimer> m_connectClocks;
+    ConnectScheduler* m_scheduler = nullptr;
+    DeviceGovernor* m_governor = nullptr;
+    DeviceDiscovery* m_discovery = nullptr;
+    bool m_autoConnect = false;
+    qsc::DeviceParams m_autoConnectParams;
     QString m_script;
+    // auto repeat count of the broadcast keys
+    unsigned m_broadcastRepeat = 0;
+    int m_broadcastAlignMs = 0;
 };
 
 }
@@ -0,0 +1,423 @@
+#include <QElapsedTimer>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QtEndian>
+#include <QtTest>
+
+#include "adaptivestream.h"
+#include "demuxer.h"
+#include "videosocket.h"
+
+#define LATENCY_BUDGET_MS 100
+// the live stream samples faster than the device's one second, the rates are scaled back to a second
+#define LIVE_BUDGET_MS 50
+#define LIVE_SAMPLE_MS 200
+#define LIVE_FPS 30
+#define LIVE_LINK_TICK_MS 5
+#define LIVE_THROTTLE_BPS 2000000
+#define LIVE_CONNECT_TIMEOUT_MS 5000
+
+// stands in for the device server on localhost: encodes LIVE_FPS scrcpy framed packets per second
+// at the bit rate of the current level and sends them through a link that carries capacityBps,
+// what the link cannot carry waits in the server queue and arrives late against its pts
+class StandInServer
+{
+public:
+    StandInServer();
+    ~StandInServer();
+
+    bool listen();
+    quint16 port();
+    // takes the connection of a new stream, the queue of the previous one is dropped
+    bool accept(quint32 bitRate);
+    void close();
+    // 0 is unthrottled
+    void setCapacity(double capacityBps);
+
+private:
+    void produce();
+    void drain(qint64 bytes);
+
+    QTcpServer m_server;
+    QTcpSocket *m_socket = Q_NULLPTR;
+    QTimer m_frameTimer;
+    QTimer m_linkTimer;
+    QElapsedTimer m_clock;
+    QElapsedTimer m_linkClock;
+    QByteArray m_queue;
+    int m_frameBytes = 0;
+    double m_capacityBps = 0;
+    double m_linkBytes = 0;
+};
+
+StandInServer::StandInServer()
+{
+    m_clock.start();
+    m_frameTimer.setTimerType(Qt::PreciseTimer);
+    m_frameTimer.setInterval(1000 / LIVE_FPS);
+    QObject::connect(&m_frameTimer, &QTimer::timeout, &m_server, [this]() { produce(); });
+    m_linkTimer.setTimerType(Qt::PreciseTimer);
+    m_linkTimer.setInterval(LIVE_LINK_TICK_MS);
+    QObject::connect(&m_linkTimer, &QTimer::timeout, &m_server, [this]() {
+        m_linkBytes += m_capacityBps / 8 * m_linkClock.restart() / 1000;
+        drain(static_cast<qint64>(m_linkBytes));
+    });
+}
+
+StandInServer::~StandInServer()
+{
+    close();
+}
+
+bool StandInServer::listen()
+{
+    return m_server.listen(QHostAddress::LocalHost);
+}
+
+quint16 StandInServer::port()
+{
+    return m_server.serverPort();
+}
+
+bool StandInServer::accept(quint32 bitRate)
+{
+    close();
+    if (!m_server.waitForNewConnection(LIVE_CONNECT_TIMEOUT_MS)) {
+        return false;
+    }
+    m_socket = m_server.nextPendingConnection();
+    m_frameBytes = static_cast<int>(bitRate / 8 / LIVE_FPS);
+    m_frameTimer.start();
+    return true;
+}
+
+void StandInServer::close()
+{
+    m_frameTimer.stop();
+    m_queue.clear();
+    m_linkBytes = 0;
+    if (m_socket) {
+        m_socket->abort();
+        delete m_socket;
+        m_socket = Q_NULLPTR;
+    }
+}
+
+void StandInServer::setCapacity(double capacityBps)
+{
+    m_capacityBps = capacityBps;
+    m_linkBytes = 0;
+    if (m_capacityBps > 0) {
+        m_linkClock.start();
+        m_linkTimer.start();
+    } else {
+        m_linkTimer.stop();
+        drain(m_queue.size());
+    }
+}
+
+void StandInServer::produce()
+{
+    // 12 bytes header (pts in us, packet size) then a filler NAL unit the parser skips
+    QByteArray packet(12 + m_frameBytes, '\xff');
+    uchar *data = reinterpret_cast<uchar *>(packet.data());
+    qToBigEndian<quint64>(static_cast<quint64>(m_clock.nsecsElapsed() / 1000), data);
+    qToBigEndian<quint32>(static_cast<quint32>(m_frameBytes), data + 8);
+    const uchar nal[] = { 0x00, 0x00, 0x00, 0x01, 0x0c };
+    memcpy(data + 12, nal, sizeof(nal));
+    data[packet.size() - 1] = 0x80;
+
+    m_queue.append(packet);
+    if (0 == m_capacityBps) {
+        drain(m_queue.size());
+    }
+}
+
+void StandInServer::drain(qint64 bytes)
+{
+    if (!m_socket) {
+        return;
+    }
+    qint64 len = qMin<qint64>(bytes, m_queue.size());
+    if (len > 0) {
+        m_socket->write(m_queue.constData(), len);
+        m_queue.remove(0, static_cast<int>(len));
+        m_linkBytes -= len;
+    }
+    if (m_queue.isEmpty()) {
+        // an idle link does not save up for a burst
+        m_linkBytes = 0;
+    }
+}
+
+// the ladder, throttledLink, recovery, hysteresisBand and decodeSkips cases feed the governor
+// samples of a simulated link, liveStream runs it on what a Demuxer measures from StandInServer
+class TestAdaptiveStream : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void ladder();
+    void throttledLink();
+    void recovery();
+    void hysteresisBand();
+    void decodeSkips();
+    void liveStream();
+
+private:
+    // the simulated link: the server sends at the bit rate of the current level, what the link
+    // cannot carry piles up in the socket, and a level change restarts with an empty socket
+    struct Link
+    {
+        double capacityBps = 0;
+        double backlogBits = 0;
+    };
+
+    static AdaptiveStream::Level top();
+    // one second of streaming, returns true if the stream was restarted
+    static bool step(AdaptiveStream &stream, Link &link);
+    static int levelFor(AdaptiveStream &stream, double capacityBps);
+
+    static Demuxer *openStream(StandInServer &server, quint32 bitRate);
+    static void closeStream(StandInServer &server, Demuxer *demuxer);
+    // one live sample, returns true if the stream was restarted
+    static bool liveStep(AdaptiveStream &stream, StandInServer &server, Demuxer *&demuxer);
+};
+
+void TestAdaptiveStream::initTestCase()
+{
+    QVERIFY(Demuxer::init());
+}
+
+void TestAdaptiveStream::cleanupTestCase()
+{
+    Demuxer::deInit();
+}
+
+AdaptiveStream::Level TestAdaptiveStream::top()
+{
+    AdaptiveStream::Level level;
+    level.bitRate = 8000000;
+    level.maxSize = 1920;
+    level.maxFps = 60;
+    return level;
+}
+
+bool TestAdaptiveStream::step(AdaptiveStream &stream, Link &link)
+{
+    double sentBits = stream.levels()[stream.currentLevel()].bitRate;
+    double pendingBits = link.backlogBits + sentBits;
+    double drainedBits = qMin(pendingBits, link.capacityBps);
+    link.backlogBits = pendingBits - drainedBits;
+
+    AdaptiveStream::Sample sample;
+    sample.throughputBps = drainedBits;
+    sample.jitterMs = 2;
+    sample.backlogBytes = static_cast<qint64>(link.backlogBits / 8);
+    sample.rendered = 60;
+
+    AdaptiveStream::Level next;
+    if (!stream.update(sample, next)) {
+        return false;
+    }
+    link.backlogBits = 0;
+    return true;
+}
+
+int TestAdaptiveStream::levelFor(AdaptiveStream &stream, double capacityBps)
+{
+    // the best level the link carries
+    int index = 0;
+    while (index + 1 < stream.levels().size() && stream.levels()[index].bitRate > capacityBps) {
+        ++index;
+    }
+    return index;
+}
+
+void TestAdaptiveStream::ladder()
+{
+    AdaptiveStream stream(top(), LATENCY_BUDGET_MS);
+    const QList<AdaptiveStream::Level> &levels = stream.levels();
+    QVERIFY(levels.size() > 1);
+    QCOMPARE(levels.first().bitRate, top().bitRate);
+    for (int i = 1; i < levels.size(); ++i) {
+        QVERIFY(levels[i].bitRate < levels[i - 1].bitRate);
+        QVERIFY(levels[i].maxSize <= levels[i - 1].maxSize);
+        QVERIFY(levels[i].maxFps <= levels[i - 1].maxFps);
+    }
+    QVERIFY(levels.last().maxFps <= 30);
+}
+
+void TestAdaptiveStream::throttledLink()
+{
+    AdaptiveStream stream(top(), LATENCY_BUDGET_MS);
+    Link link;
+    link.capacityBps = 3000000;
+    int fit = levelFor(stream, link.capacityBps);
+
+    // steps down to a level the link carries, one level per change
+    int samples = 0;
+    while (stream.currentLevel() < fit && samples < 30) {
+        int before = stream.currentLevel();
+        if (step(stream, link)) {
+            QCOMPARE(stream.currentLevel(), before + 1);
+        }
+        ++samples;
+    }
+    QCOMPARE(stream.currentLevel(), fit);
+    QVERIFY(samples <= 4 * fit);
+
+    // then stays there, only probing a level up now and then
+    int above = 0;
+    int changes = 0;
+    for (int i = 0; i < 200; ++i) {
+        changes += step(stream, link);
+        above += stream.currentLevel() < fit;
+        QVERIFY(stream.currentLevel() >= fit - 1);
+    }
+    QVERIFY(above < 200 / 4);
+    QVERIFY(changes <= 2 * 200 / 20);
+}
+
+void TestAdaptiveStream::recovery()
+{
+    AdaptiveStream stream(top(), LATENCY_BUDGET_MS);
+    Link link;
+    link.capacityBps = 1000000;
+    for (int i = 0; i < 40; ++i) {
+        step(stream, link);
+    }
+    QCOMPARE(stream.currentLevel(), static_cast<int>(stream.levels().size()) - 1);
+
+    // the throttle is lifted, the stream climbs back to the top
+    link.capacityBps = 100000000;
+    for (int i = 0; i < 200 && stream.currentLevel() > 0; ++i) {
+        step(stream, link);
+    }
+    QCOMPARE(stream.currentLevel(), 0);
+}
+
+void TestAdaptiveStream::hysteresisBand()
+{
+    // between half the budget and the budget the level is held either way
+    AdaptiveStream stream(top(), LATENCY_BUDGET_MS);
+    AdaptiveStream::Sample sample;
+    sample.throughputBps = 8000000;
+    sample.jitterMs = LATENCY_BUDGET_MS * 0.4;
+    sample.rendered = 60;
+    AdaptiveStream::Level next;
+    for (int i = 0; i < 100; ++i) {
+        QVERIFY(!stream.update(sample, next));
+    }
+    QCOMPARE(stream.currentLevel(), 0);
+}
+
+void TestAdaptiveStream::decodeSkips()
+{
+    // a decoder that cannot keep up lowers the level with a fast link
+    AdaptiveStream stream(top(), LATENCY_BUDGET_MS);
+    AdaptiveStream::Sample sample;
+    sample.throughputBps = 8000000;
+    sample.jitterMs = 1;
+    sample.rendered = 30;
+    sample.skipped = 30;
+    AdaptiveStream::Level next;
+    bool changed = false;
+    for (int i = 0; i < 5 && !changed; ++i) {
+        changed = stream.update(sample, next);
+    }
+    QVERIFY(changed);
+    QCOMPARE(next.bitRate, stream.levels()[1].bitRate);
+}
+
+Demuxer *TestAdaptiveStream::openStream(StandInServer &server, quint32 bitRate)
+{
+    VideoSocket *videoSocket = new VideoSocket();
+    videoSocket->connectToHost(QHostAddress::LocalHost, server.port());
+    if (!server.accept(bitRate) || !videoSocket->waitForConnected(LIVE_CONNECT_TIMEOUT_MS)) {
+        delete videoSocket;
+        return Q_NULLPTR;
+    }
+
+    // the thread mode, the socket moves to the demuxer thread
+    Demuxer *demuxer = new Demuxer();
+    demuxer->setReactorMode(false);
+    demuxer->installVideoSocket(videoSocket);
+    if (!demuxer->startDecode()) {
+        delete videoSocket;
+        delete demuxer;
+        return Q_NULLPTR;
+    }
+    return demuxer;
+}
+
+void TestAdaptiveStream::closeStream(StandInServer &server, Demuxer *demuxer)
+{
+    // the demuxer sees the end of the stream and deletes its socket
+    server.close();
+    demuxer->wait();
+    delete demuxer;
+}
+
+bool TestAdaptiveStream::liveStep(AdaptiveStream &stream, StandInServer &server, Demuxer *&demuxer)
+{
+    QTest::qWait(LIVE_SAMPLE_MS);
+
+    // built like Device::onAdaptiveTimer()
+    Demuxer::StreamStats stats = demuxer->takeStats();
+    AdaptiveStream::Sample sample;
+    sample.throughputBps = stats.bytes * 8.0 * 1000 / LIVE_SAMPLE_MS;
+    sample.jitterMs = stats.jitterMs;
+    sample.backlogBytes = stats.backlogBytes;
+    sample.rendered = stats.packets;
+
+    AdaptiveStream::Level next;
+    if (!stream.update(sample, next)) {
+        return false;
+    }
+    // restarted like Device::restartStream(), a new connection at the new bit rate
+    closeStream(server, demuxer);
+    demuxer = openStream(server, next.bitRate);
+    return true;
+}
+
+void TestAdaptiveStream::liveStream()
+{
+    StandInServer server;
+    QVERIFY(server.listen());
+    AdaptiveStream stream(top(), LIVE_BUDGET_MS);
+    Demuxer *demuxer = openStream(server, stream.levels().first().bitRate);
+    QVERIFY(demuxer);
+
+    // throttled, the frames arrive later and later against their pts and the governor steps down
+    server.setCapacity(LIVE_THROTTLE_BPS);
+    for (int i = 0; i < 40 && stream.currentLevel() < 2; ++i) {
+        int before = stream.currentLevel();
+        if (liveStep(stream, server, demuxer)) {
+            QCOMPARE(stream.currentLevel(), before + 1);
+        }
+        QVERIFY(demuxer);
+    }
+    QVERIFY(stream.currentLevel() >= 2);
+
+    // the throttle is lifted, after the up cooldown the governor steps back up
+    server.setCapacity(0);
+    bool up = false;
+    for (int i = 0; i < 60 && !up; ++i) {
+        int before = stream.currentLevel();
+        if (liveStep(stream, server, demuxer)) {
+            up = stream.currentLevel() < before;
+        }
+        QVERIFY(demuxer);
+    }
+    QVERIFY(up);
+
+    closeStream(server, demuxer);
+}
+
+QTEST_GUILESS_MAIN(TestAdaptiveStream)
+
+#include "tst_adaptivestream.moc"
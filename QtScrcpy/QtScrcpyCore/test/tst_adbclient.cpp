@@ -0,0 +1,184 @@
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QtEndian>
+#include <QtTest>
+
+#include "adbclient.h"
+
+// answers the smart-socket requests of one connection from a script: one reply per
+// request, then the stream data, then the connection is closed unless told to stay
+class FakeAdbServer : public QObject
+{
+    Q_OBJECT
+public:
+    FakeAdbServer()
+    {
+        connect(&m_server, &QTcpServer::newConnection, this, [this]() {
+            QTcpSocket *socket = m_server.nextPendingConnection();
+            connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { onReadyRead(socket); });
+        });
+    }
+
+    bool listen()
+    {
+        return m_server.listen(QHostAddress::LocalHost, 0);
+    }
+
+    quint16 port()
+    {
+        return m_server.serverPort();
+    }
+
+    QList<QByteArray> replies;
+    QList<QByteArray> stream;
+    bool keepOpen = false;
+    QStringList requests;
+
+private:
+    void onReadyRead(QTcpSocket *socket)
+    {
+        m_buffer.append(socket->readAll());
+        while (m_buffer.size() >= 4) {
+            bool ok = false;
+            int len = m_buffer.left(4).toInt(&ok, 16);
+            if (!ok || m_buffer.size() < 4 + len) {
+                return;
+            }
+            requests << QString::fromUtf8(m_buffer.mid(4, len));
+            m_buffer.remove(0, 4 + len);
+            if (!replies.isEmpty()) {
+                socket->write(replies.takeFirst());
+            }
+            if (replies.isEmpty()) {
+                for (const QByteArray &data : stream) {
+                    socket->write(data);
+                }
+                if (!keepOpen) {
+                    socket->disconnectFromHost();
+                }
+            }
+        }
+    }
+
+    QTcpServer m_server;
+    QByteArray m_buffer;
+};
+
+static QByteArray shellPacket(quint8 id, const QByteArray &data)
+{
+    QByteArray packet(5, '\0');
+    packet[0] = static_cast<char>(id);
+    qToLittleEndian<quint32>(static_cast<quint32>(data.size()), reinterpret_cast<uchar *>(packet.data() + 1));
+    return packet + data;
+}
+
+class TestAdbClient : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void forward();
+    void fail();
+    void shellSplitUtf8();
+    void kill();
+    void noServer();
+
+private:
+    void collect(AdbClient &client);
+
+    FakeAdbServer *m_server = Q_NULLPTR;
+    QList<int> m_results;
+};
+
+void TestAdbClient::init()
+{
+    delete m_server;
+    m_server = new FakeAdbServer();
+    QVERIFY(m_server->listen());
+    AdbClient::setServerPort(m_server->port());
+    m_results.clear();
+}
+
+void TestAdbClient::collect(AdbClient &client)
+{
+    connect(&client, &AdbClient::adbClientResult, this, [this](qsc::AdbProcess::ADB_EXEC_RESULT processResult) {
+        m_results << processResult;
+    });
+}
+
+void TestAdbClient::forward()
+{
+    // OKAY for the request, OKAY once the forward is set up
+    m_server->replies << "OKAYOKAY";
+    AdbClient client;
+    collect(client);
+    client.forward("serial", 27183, "scrcpy");
+
+    QTRY_COMPARE(int(m_results.size()), 2);
+    QCOMPARE(m_results[0], int(qsc::AdbProcess::AER_SUCCESS_START));
+    QCOMPARE(m_results[1], int(qsc::AdbProcess::AER_SUCCESS_EXEC));
+    QCOMPARE(m_server->requests, QStringList() << "host-serial:serial:forward:tcp:27183;localabstract:scrcpy");
+}
+
+void TestAdbClient::fail()
+{
+    m_server->replies << "FAIL0010device not found";
+    AdbClient client;
+    collect(client);
+    client.reverse("serial", "scrcpy", 27183);
+
+    QTRY_COMPARE(int(m_results.size()), 2);
+    QCOMPARE(m_results[1], int(qsc::AdbProcess::AER_ERROR_EXEC));
+    QCOMPARE(client.getErrorOut(), QString("device not found"));
+}
+
+void TestAdbClient::shellSplitUtf8()
+{
+    // "é" is 0xc3 0xa9, split across two stdout packets
+    m_server->replies << "OKAY" << "OKAY";
+    m_server->stream << shellPacket(1, "h\xc3") << shellPacket(1, "\xa9llo") << shellPacket(3, QByteArray(1, '\0'));
+    AdbClient client;
+    collect(client);
+    client.shell("serial", "echo");
+
+    QTRY_COMPARE(int(m_results.size()), 2);
+    QCOMPARE(m_results[1], int(qsc::AdbProcess::AER_SUCCESS_EXEC));
+    QCOMPARE(client.getStdOut(), QString::fromUtf8("h\xc3\xa9llo"));
+    QCOMPARE(m_server->requests, QStringList() << "host:transport:serial" << "shell,v2,raw:echo");
+}
+
+void TestAdbClient::kill()
+{
+    // a running shell, like the device server
+    m_server->replies << "OKAY" << "OKAY";
+    m_server->keepOpen = true;
+    AdbClient client;
+    collect(client);
+    client.shell("serial", "app_process");
+    QTRY_COMPARE(int(m_server->requests.size()), 2);
+    QVERIFY(client.isRuning());
+
+    client.kill();
+    QVERIFY(!client.isRuning());
+    QTRY_COMPARE(int(m_results.size()), 2);
+    QCOMPARE(m_results[1], int(qsc::AdbProcess::AER_ERROR_EXEC));
+}
+
+void TestAdbClient::noServer()
+{
+    quint16 port = m_server->port();
+    delete m_server;
+    m_server = Q_NULLPTR;
+    AdbClient::setServerPort(port);
+
+    AdbClient client;
+    collect(client);
+    client.forwardRemove("serial", 27183);
+    QTRY_COMPARE(int(m_results.size()), 1);
+    QCOMPARE(m_results[0], int(qsc::AdbProcess::AER_ERROR_START));
+}
+
+QTEST_GUILESS_MAIN(TestAdbClient)
+
+#include "tst_adbclient.moc"
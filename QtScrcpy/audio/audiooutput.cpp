@@ -5,6 +5,8 @@
 #include <QThread>
 #include <QFileInfo>
 
+#include "../QtScrcpyCore/include/QtScrcpyCore.h"
+
 #if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
 #include <QAudioSink>
 #include <QMediaDevices>
@@ -131,6 +133,7 @@ bool AudioOutput::start(const QString& serial, int port) {
 
     QMetaObject::invokeMethod(m_serverWorker, "startServer", Qt::BlockingQueuedConnection);
 
+    m_currentSerial = serial;
     setupAudioDevice();
 
     QString portStr = QString::number(port);
@@ -234,6 +237,7 @@ void AudioOutput::setupAudioDevice() {
     m_audioOutput->setBufferSize(1920 * 4);
 
     m_audioIO = m_audioOutput->start();
+    reportMemory(m_audioOutput->bufferSize());
     #else
     format.setSampleFormat(QAudioFormat::Int16);
     QAudioDevice device = QMediaDevices::defaultAudioOutput();
@@ -243,9 +247,17 @@ void AudioOutput::setupAudioDevice() {
     m_audioSink->setBufferSize(1920 * 4);
 
     m_audioIO = m_audioSink->start();
+    reportMemory(m_audioSink->bufferSize());
     #endif
 }
 
+void AudioOutput::reportMemory(qint64 bytes) {
+    auto device = qsc::IDeviceManage::getInstance().getDevice(m_currentSerial);
+    if (device) {
+        device->setAudioMemory(bytes);
+    }
+}
+
 void AudioOutput::cleanupAudioDevice() {
     #if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
     if (m_audioOutput) {
@@ -261,6 +273,7 @@ void AudioOutput::cleanupAudioDevice() {
     }
     #endif
     m_audioIO = nullptr;
+    reportMemory(0);
 }
 
 void AudioOutput::onDataReceived(const QByteArray &data) {
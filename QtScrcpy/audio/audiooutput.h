@@ -60,6 +60,8 @@ private:
     bool runAppProcess(const QString& serial, int port);
     void setupAudioDevice();
     void cleanupAudioDevice();
+    // the output buffer is counted in the device's memory usage
+    void reportMemory(qint64 bytes);
 
 private slots:
     void onDataReceived(const QByteArray &data);
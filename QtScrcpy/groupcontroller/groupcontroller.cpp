@@ -1,11 +1,42 @@
 #include <QPointer>
 
+#include "config.h"
 #include "groupcontroller.h"
 #include "videoform.h"
 
+#define GROUP_SKEW_REPORT_INTERVAL 10000
+
 GroupController::GroupController(QObject *parent) : QObject(parent)
 {
+    int alignMs = Config::getInstance().getGroupAlignMs();
+    qsc::IDeviceManage::getInstance().setBroadcastAlignment(alignMs);
+    if (alignMs > 0) {
+        connect(&m_skewReportTimer, &QTimer::timeout, this, &GroupController::reportSkew);
+        m_skewReportTimer.start(GROUP_SKEW_REPORT_INTERVAL);
+    }
+}
 
+void GroupController::reportSkew()
+{
+    quint64 count = 0;
+    double avgMs = 0.0;
+    double maxMs = 0.0;
+    qsc::IDeviceManage::getInstance().takeBroadcastSpread(count, avgMs, maxMs);
+    if (0 == count) {
+        return;
+    }
+    qInfo("group input: %d devices, %llu broadcasts, spread avg %.3fms max %.3fms",
+          m_members.size(), count, avgMs, maxMs);
+
+    for (const auto& device : m_members) {
+        if (!device) {
+            continue;
+        }
+        device->takeInputSkew(count, avgMs, maxMs);
+        if (count) {
+            qInfo("group input: %s skew avg %.3fms max %.3fms", qPrintable(device->getSerial()), avgMs, maxMs);
+        }
+    }
 }
 
 bool GroupController::isHost(const QString &serial)
@@ -18,14 +49,17 @@ bool GroupController::isHost(const QString &serial)
     return static_cast<VideoForm*>(data)->isHost();
 }
 
-QSize GroupController::getFrameSize(const QString &serial)
+void GroupController::updateMembers()
 {
-    auto data = qsc::IDeviceManage::getInstance().getDevice(serial)->getUserData();
-    if (!data) {
-        return QSize();
+    // looked up once here instead of on every event
+    m_members.clear();
+    for (const auto& serial : m_devices) {
+        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
+        if (!device || isHost(serial)) {
+            continue;
+        }
+        m_members.append(device);
     }
-
-    return static_cast<VideoForm*>(data)->frameSize();
 }
 
 GroupController &GroupController::instance()
@@ -50,6 +84,7 @@ void GroupController::updateDeviceState(const QString &serial)
     } else {
         device->deRegisterDeviceObserver(this);
     }
+    updateMembers();
 }
 
 void GroupController::addDevice(const QString &serial)
@@ -59,6 +94,7 @@ void GroupController::addDevice(const QString &serial)
     }
 
     m_devices.append(serial);
+    updateMembers();
 }
 
 void GroupController::removeDevice(const QString &serial)
@@ -68,6 +104,7 @@ void GroupController::removeDevice(const QString &serial)
     }
 
     m_devices.removeOne(serial);
+    updateMembers();
 
     auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
     if (!device) {
@@ -82,58 +119,24 @@ void GroupController::removeDevice(const QString &serial)
 void GroupController::mouseEvent(const QMouseEvent *from, const QSize &frameSize, const QSize &showSize)
 {
     Q_UNUSED(frameSize);
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
-            continue;
-        }
-
-        device->mouseEvent(from, getFrameSize(serial), showSize);
-    }
+    qsc::IDeviceManage::getInstance().broadcastMouseEvent(m_members, from, showSize);
 }
 
 void GroupController::wheelEvent(const QWheelEvent *from, const QSize &frameSize, const QSize &showSize)
 {
     Q_UNUSED(frameSize);
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
-            continue;
-        }
-
-        device->wheelEvent(from, getFrameSize(serial), showSize);
-    }
+    qsc::IDeviceManage::getInstance().broadcastWheelEvent(m_members, from, showSize);
 }
 
 void GroupController::keyEvent(const QKeyEvent *from, const QSize &frameSize, const QSize &showSize)
 {
     Q_UNUSED(frameSize);
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
-            continue;
-        }
-
-        device->keyEvent(from, getFrameSize(serial), showSize);
-    }
+    qsc::IDeviceManage::getInstance().broadcastKeyEvent(m_members, from, showSize);
 }
 
 void GroupController::postGoBack()
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
+    for (const auto& device : m_members) {
         if (!device) {
             continue;
         }
@@ -144,11 +147,7 @@ void GroupController::postGoBack()
 
 void GroupController::postGoHome()
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
+    for (const auto& device : m_members) {
         if (!device) {
             continue;
         }
@@ -159,11 +158,7 @@ void GroupController::postGoHome()
 
 void GroupController::postGoMenu()
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
+    for (const auto& device : m_members) {
         if (!device) {
             continue;
         }
@@ -174,11 +169,7 @@ void GroupController::postGoMenu()
 
 void GroupController::postAppSwitch()
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
+    for (const auto& device : m_members) {
         if (!device) {
             continue;
         }
@@ -189,11 +180,7 @@ void GroupController::postAppSwitch()
 
 void GroupController::postPower()
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
+    for (const auto& device : m_members) {
         if (!device) {
             continue;
         }
@@ -204,11 +191,7 @@ void GroupController::postPower()
 
 void GroupController::postVolumeUp()
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
+    for (const auto& device : m_members) {
         if (!device) {
             continue;
         }
@@ -219,11 +202,7 @@ void GroupController::postVolumeUp()
 
 void GroupController::postVolumeDown()
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
+    for (const auto& device : m_members) {
         if (!device) {
             continue;
         }
@@ -234,11 +213,7 @@ void GroupController::postVolumeDown()
 
 void GroupController::postCopy()
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
+    for (const auto& device : m_members) {
         if (!device) {
             continue;
         }
@@ -249,11 +224,7 @@ void GroupController::postCopy()
 
 void GroupController::postCut()
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
+    for (const auto& device : m_members) {
         if (!device) {
             continue;
         }
@@ -264,11 +235,7 @@ void GroupController::postCut()
 
 void GroupController::setDisplayPower(bool on)
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
+    for (const auto& device : m_members) {
         if (!device) {
             continue;
         }
@@ -279,11 +246,7 @@ void GroupController::setDisplayPower(bool on)
 
 void GroupController::expandNotificationPanel()
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
+    for (const auto& device : m_members) {
         if (!device) {
             continue;
         }
@@ -294,11 +257,7 @@ void GroupController::expandNotificationPanel()
 
 void GroupController::collapsePanel()
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
+    for (const auto& device : m_members) {
         if (!device) {
             continue;
         }
@@ -309,11 +268,7 @@ void GroupController::collapsePanel()
 
 void GroupController::postBackOrScreenOn(bool down)
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
+    for (const auto& device : m_members) {
         if (!device) {
             continue;
         }
@@ -324,11 +279,7 @@ void GroupController::postBackOrScreenOn(bool down)
 
 void GroupController::postTextInput(QString &text)
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
+    for (const auto& device : m_members) {
         if (!device) {
             continue;
         }
@@ -339,11 +290,7 @@ void GroupController::postTextInput(QString &text)
 
 void GroupController::requestDeviceClipboard()
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
+    for (const auto& device : m_members) {
         if (!device) {
             continue;
         }
@@ -354,11 +301,7 @@ void GroupController::requestDeviceClipboard()
 
 void GroupController::setDeviceClipboard(bool pause)
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
+    for (const auto& device : m_members) {
         if (!device) {
             continue;
         }
@@ -369,11 +312,7 @@ void GroupController::setDeviceClipboard(bool pause)
 
 void GroupController::clipboardPaste()
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
+    for (const auto& device : m_members) {
         if (!device) {
             continue;
         }
@@ -384,11 +323,7 @@ void GroupController::clipboardPaste()
 
 void GroupController::pushFileRequest(const QString &file, const QString &devicePath)
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
+    for (const auto& device : m_members) {
         if (!device) {
             continue;
         }
@@ -399,11 +334,7 @@ void GroupController::pushFileRequest(const QString &file, const QString &device
 
 void GroupController::installApkRequest(const QString &apkFile)
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
+    for (const auto& device : m_members) {
         if (!device) {
             continue;
         }
@@ -414,11 +345,7 @@ void GroupController::installApkRequest(const QString &apkFile)
 
 void GroupController::screenshot()
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
+    for (const auto& device : m_members) {
         if (!device) {
             continue;
         }
@@ -429,11 +356,7 @@ void GroupController::screenshot()
 
 void GroupController::showTouch(bool show)
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
+    for (const auto& device : m_members) {
         if (!device) {
             continue;
         }
@@ -2,6 +2,8 @@
 #define GROUPCONTROLLER_H
 
 #include <QObject>
+#include <QPointer>
+#include <QTimer>
 #include <QVector>
 
 #include "QtScrcpyCore.h"
@@ -47,10 +49,14 @@ private:
 private:
     explicit GroupController(QObject *parent = nullptr);
     bool isHost(const QString& serial);
-    QSize getFrameSize(const QString& serial);
+    void updateMembers();
+    void reportSkew();
 
 private:
     QVector<QString> m_devices;
+    // the devices following the hosts
+    QVector<QPointer<qsc::IDevice>> m_members;
+    QTimer m_skewReportTimer;
 };
 
 #endif // GROUPCONTROLLER_H
@@ -41,10 +41,15 @@ Dialog::Dialog(QWidget *parent) : QWidget(parent), ui(new Ui::Widget)
     on_useSingleModeCheck_clicked();
     on_updateDevice_clicked();
 
-    connect(&m_autoUpdatetimer, &QTimer::timeout, this, &Dialog::on_updateDevice_clicked);
+    // adb pushes device changes, no need to poll "adb devices"
+    auto refreshDevices = [this]() { updateDeviceList(qsc::IDeviceManage::getInstance().getOnlineDevices()); };
+    connect(&qsc::IDeviceManage::getInstance(), &qsc::IDeviceManage::deviceAdded, this, refreshDevices);
+    connect(&qsc::IDeviceManage::getInstance(), &qsc::IDeviceManage::deviceRemoved, this, refreshDevices);
+    connect(&qsc::IDeviceManage::getInstance(), &qsc::IDeviceManage::deviceStateChanged, this, refreshDevices);
     if (ui->autoUpdatecheckBox->isChecked()) {
-        m_autoUpdatetimer.start(5000);
+        qsc::IDeviceManage::getInstance().startDeviceDiscovery();
     }
+    qsc::IDeviceManage::getInstance().setGovernor(Config::getInstance().getGovernorMaxCpu(), Config::getInstance().getGovernorMaxMbps());
 
     connect(&m_adb, &qsc::AdbProcess::adbProcessResult, this, [this](qsc::AdbProcess::ADB_EXEC_RESULT processResult) {
         QString log = "";
@@ -70,13 +75,7 @@ Dialog::Dialog(QWidget *parent) : QWidget(parent), ui(new Ui::Widget)
         case qsc::AdbProcess::AER_SUCCESS_EXEC:
             //log = m_adb.getStdOut();
             if (args.contains("devices")) {
-                QStringList devices = m_adb.getDevicesSerialFromStdOut();
-                ui->serialBox->clear();
-                ui->connectedPhoneList->clear();
-                for (auto &item : devices) {
-                    ui->serialBox->addItem(item);
-                    ui->connectedPhoneList->addItem(Config::getInstance().getNickName(item) + "-" + item);
-                }
+                updateDeviceList(m_adb.getDevicesSerialFromStdOut());
             } else if (args.contains("show") && args.contains("wlan0")) {
                 QString ip = m_adb.getDeviceIPFromStdOut();
                 if (ip.isEmpty()) {
@@ -345,6 +344,8 @@ void Dialog::on_startServerBtn_clicked()
     params.useReverse = ui->useReverseCheck->isChecked();
     params.display = !ui->notDisplayCheck->isChecked();
     params.renderExpiredFrames = Config::getInstance().getRenderExpiredFrames();
+    params.demuxReactor = Config::getInstance().getDemuxReactor();
+    params.sharedDecode = Config::getInstance().getSharedDecode();
     if (ui->lockOrientationBox->currentIndex() > 0) {
         params.captureOrientationLock = 1;
         params.captureOrientation = (ui->lockOrientationBox->currentIndex() - 1) * 90;
@@ -361,6 +362,7 @@ void Dialog::on_startServerBtn_clicked()
     params.codecOptions = Config::getInstance().getCodecOptions();
     params.codecName = Config::getInstance().getCodecName();
     params.scid = QRandomGenerator::global()->bounded(1, 10000) & 0x7FFFFFFF;
+    params.autoReconnect = true;
 
     qsc::IDeviceManage::getInstance().connectDevice(params);
 }
@@ -829,9 +831,25 @@ void Dialog::on_installSndcpyBtn_clicked()
 void Dialog::on_autoUpdatecheckBox_toggled(bool checked)
 {
     if (checked) {
-        m_autoUpdatetimer.start(5000);
+        qsc::IDeviceManage::getInstance().startDeviceDiscovery();
     } else {
-        m_autoUpdatetimer.stop();
+        qsc::IDeviceManage::getInstance().stopDeviceDiscovery();
+    }
+}
+
+void Dialog::updateDeviceList(const QStringList &devices)
+{
+    // keep the selection, the list now changes whenever a device comes or goes
+    QString curSerial = ui->serialBox->currentText();
+    ui->serialBox->clear();
+    ui->connectedPhoneList->clear();
+    for (auto &item : devices) {
+        ui->serialBox->addItem(item);
+        ui->connectedPhoneList->addItem(Config::getInstance().getNickName(item) + "-" + item);
+    }
+    int index = ui->serialBox->findText(curSerial);
+    if (index >= 0) {
+        ui->serialBox->setCurrentIndex(index);
     }
 }
 
@@ -78,6 +78,7 @@ private:
     QString getGameScript(const QString &fileName);
     void slotActivated(QSystemTrayIcon::ActivationReason reason);
     int findDeviceFromeSerialBox(bool wifi);
+    void updateDeviceList(const QStringList &devices);
     quint32 getBitRate();
     const QString &getServerPath();
     void loadIpHistory();
@@ -98,7 +99,6 @@ private:
     QAction *m_showWindow;
     QAction *m_quit;
     AudioOutput m_audioOutput;
-    QTimer m_autoUpdatetimer;
 };
 
 #endif // DIALOG_H
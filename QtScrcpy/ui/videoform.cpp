@@ -22,6 +22,9 @@
 #include "qyuvopenglwidget.h"
 #include "toolform.h"
 #include "mousetap/mousetap.h"
+#ifdef HAVE_XCB_XINPUT
+#include "mousetap/xrawmotion.h"
+#endif
 #include "ui_videoform.h"
 #include "videoform.h"
 
@@ -158,6 +161,13 @@ void VideoForm::updateRender(int width, int height, uint8_t* dataY, uint8_t* dat
     }
 
     updateShowSize(QSize(width, height));
+    if (m_videoWidget->frameSize() != QSize(width, height)) {
+        auto device = qsc::IDeviceManage::getInstance().getDevice(m_serial);
+        if (device) {
+            // one luminance texture per plane, U and V at half size
+            device->setTextureMemory(static_cast<qint64>(width) * height * 3 / 2);
+        }
+    }
     m_videoWidget->setFrameSize(QSize(width, height));
     m_videoWidget->updateTextures(dataY, dataU, dataV, linesizeY, linesizeU, linesizeV);
 }
@@ -535,6 +545,27 @@ void VideoForm::grabCursor(bool grab)
 {
     QRect rc = getGrabCursorRect();
     MouseTap::getInstance()->enableMouseEventTap(rc, grab);
+
+#ifdef HAVE_XCB_XINPUT
+    // while grabbed the mouse move map takes the raw deltas, the cursor is not warped back
+    QPointer<qsc::IDevice> device = qsc::IDeviceManage::getInstance().getDevice(m_serial);
+    XRawMotion *rawMotion = XRawMotion::getInstance();
+    bool raw = grab && !rc.isEmpty() && device && rawMotion->isAvailable();
+    rawMotion->disconnect(this);
+    if (raw) {
+        qreal ratio = devicePixelRatioF();
+        connect(rawMotion, &XRawMotion::motion, this, [device, ratio](const QPointF &delta) {
+            if (device) {
+                // device counts match physical pixels, the show size is in logical ones
+                device->rawMouseMotion(delta / ratio);
+            }
+        });
+    }
+    rawMotion->setEnabled(this, raw);
+    if (device) {
+        device->setRawMouseMotion(raw);
+    }
+#endif
 }
 
 void VideoForm::onFrame(int width, int height, uint8_t *dataY, uint8_t *dataU, uint8_t *dataV, int linesizeY, int linesizeU, int linesizeV)
@@ -759,6 +790,7 @@ void VideoForm::paintEvent(QPaintEvent *paint)
 void VideoForm::showEvent(QShowEvent *event)
 {
     Q_UNUSED(event)
+    updateViewState();
     if (!isFullScreen() && this->show_toolbar) {
         QTimer::singleShot(500, this, [this](){
             showToolForm(this->show_toolbar);
@@ -766,6 +798,12 @@ void VideoForm::showEvent(QShowEvent *event)
     }
 }
 
+void VideoForm::hideEvent(QHideEvent *event)
+{
+    Q_UNUSED(event)
+    updateViewState();
+}
+
 void VideoForm::resizeEvent(QResizeEvent *event)
 {
     Q_UNUSED(event)
@@ -803,6 +841,25 @@ void VideoForm::closeEvent(QCloseEvent *event)
     device->disconnectDevice();
 }
 
+void VideoForm::changeEvent(QEvent *event)
+{
+    QWidget::changeEvent(event);
+    if (event->type() == QEvent::ActivationChange || event->type() == QEvent::WindowStateChange) {
+        updateViewState();
+    }
+}
+
+void VideoForm::updateViewState()
+{
+    auto device = qsc::IDeviceManage::getInstance().getDevice(m_serial);
+    if (!device) {
+        return;
+    }
+    // the window being used decodes first, a window in view is not throttled by the governor
+    device->setDecodePriority(isActiveWindow());
+    device->setWindowVisible(isVisible() && !isMinimized());
+}
+
 void VideoForm::dragEnterEvent(QDragEnterEvent *event)
 {
     event->acceptProposedAction();
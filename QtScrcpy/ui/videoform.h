@@ -48,6 +48,7 @@ private:
     void moveCenter();
     void installShortcut();
     QRect getScreenRect();
+    void updateViewState();
 
 protected:
     void mousePressEvent(QMouseEvent *event) override;
@@ -60,8 +61,10 @@ protected:
 
     void paintEvent(QPaintEvent *) override;
     void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
     void closeEvent(QCloseEvent *event) override;
+    void changeEvent(QEvent *event) override;
 
     void dragEnterEvent(QDragEnterEvent *event) override;
     void dragMoveEvent(QDragMoveEvent *event) override;
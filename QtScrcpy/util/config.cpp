@@ -47,6 +47,21 @@
 #define COMMON_CODEC_NAME_KEY "CodecName"
 #define COMMON_CODEC_NAME_DEF ""
 
+#define COMMON_GROUP_ALIGN_MS_KEY "GroupAlignMs"
+#define COMMON_GROUP_ALIGN_MS_DEF 0
+
+#define COMMON_DEMUX_REACTOR_KEY "DemuxReactor"
+#define COMMON_DEMUX_REACTOR_DEF 0
+
+#define COMMON_SHARED_DECODE_KEY "SharedDecode"
+#define COMMON_SHARED_DECODE_DEF 0
+
+#define COMMON_GOVERNOR_MAX_CPU_KEY "GovernorMaxCpu"
+#define COMMON_GOVERNOR_MAX_CPU_DEF 0
+
+#define COMMON_GOVERNOR_MAX_MBPS_KEY "GovernorMaxMbps"
+#define COMMON_GOVERNOR_MAX_MBPS_DEF 0
+
 // user config
 #define COMMON_RECORD_KEY "RecordPath"
 #define COMMON_RECORD_DEF ""
@@ -355,6 +370,51 @@ QString Config::getCodecName()
     return codecName;
 }
 
+int Config::getGroupAlignMs()
+{
+    int alignMs = 0;
+    m_settings->beginGroup(GROUP_COMMON);
+    alignMs = m_settings->value(COMMON_GROUP_ALIGN_MS_KEY, COMMON_GROUP_ALIGN_MS_DEF).toInt();
+    m_settings->endGroup();
+    return alignMs;
+}
+
+int Config::getDemuxReactor()
+{
+    int demuxReactor = 0;
+    m_settings->beginGroup(GROUP_COMMON);
+    demuxReactor = m_settings->value(COMMON_DEMUX_REACTOR_KEY, COMMON_DEMUX_REACTOR_DEF).toInt();
+    m_settings->endGroup();
+    return demuxReactor;
+}
+
+int Config::getSharedDecode()
+{
+    int sharedDecode = 0;
+    m_settings->beginGroup(GROUP_COMMON);
+    sharedDecode = m_settings->value(COMMON_SHARED_DECODE_KEY, COMMON_SHARED_DECODE_DEF).toInt();
+    m_settings->endGroup();
+    return sharedDecode;
+}
+
+int Config::getGovernorMaxCpu()
+{
+    int maxCpu = 0;
+    m_settings->beginGroup(GROUP_COMMON);
+    maxCpu = m_settings->value(COMMON_GOVERNOR_MAX_CPU_KEY, COMMON_GOVERNOR_MAX_CPU_DEF).toInt();
+    m_settings->endGroup();
+    return maxCpu;
+}
+
+int Config::getGovernorMaxMbps()
+{
+    int maxMbps = 0;
+    m_settings->beginGroup(GROUP_COMMON);
+    maxMbps = m_settings->value(COMMON_GOVERNOR_MAX_MBPS_KEY, COMMON_GOVERNOR_MAX_MBPS_DEF).toInt();
+    m_settings->endGroup();
+    return maxMbps;
+}
+
 QStringList Config::getConnectedGroups()
 {
     return m_userData->childGroups();
@@ -46,6 +46,11 @@ public:
     QString getLogLevel();
     QString getCodecOptions();
     QString getCodecName();
+    int getGroupAlignMs();
+    int getDemuxReactor();
+    int getSharedDecode();
+    int getGovernorMaxCpu();
+    int getGovernorMaxMbps();
     QStringList getConnectedGroups();
 
     // user data:common
@@ -0,0 +1,142 @@
+#include <QCoreApplication>
+#include <QtGlobal>
+
+#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
+#include <QtX11Extras/QX11Info>
+#else
+#include <QtGui/private/qtx11extras_p.h>
+#endif
+
+#include <xcb/xcb.h>
+#include <xcb/xinput.h>
+#include <stdlib.h>
+
+#include "xrawmotion.h"
+
+XRawMotion *XRawMotion::s_instance = Q_NULLPTR;
+
+XRawMotion *XRawMotion::getInstance()
+{
+    if (s_instance == Q_NULLPTR) {
+        s_instance = new XRawMotion();
+    }
+    return s_instance;
+}
+
+XRawMotion::XRawMotion() : QObject(Q_NULLPTR) {}
+
+bool XRawMotion::isAvailable()
+{
+    if (m_checked) {
+        return m_available;
+    }
+    m_checked = true;
+
+    if (!QX11Info::isPlatformX11()) {
+        return false;
+    }
+    xcb_connection_t *dpy = QX11Info::connection();
+    const xcb_query_extension_reply_t *extension = xcb_get_extension_data(dpy, &xcb_input_id);
+    if (!extension || !extension->present) {
+        qInfo("raw mouse motion: no XInputExtension");
+        return false;
+    }
+
+    // raw events on the root window need 2.1
+    xcb_input_xi_query_version_cookie_t cookie = xcb_input_xi_query_version(dpy, 2, 1);
+    xcb_input_xi_query_version_reply_t *version = xcb_input_xi_query_version_reply(dpy, cookie, NULL);
+    if (!version) {
+        return false;
+    }
+    m_available = version->major_version > 2 || (version->major_version == 2 && version->minor_version >= 1);
+    qInfo("raw mouse motion: XInput %d.%d", version->major_version, version->minor_version);
+    free(version);
+
+    if (m_available) {
+        m_opcode = extension->major_opcode;
+        qApp->installNativeEventFilter(this);
+    }
+    return m_available;
+}
+
+void XRawMotion::setEnabled(QObject *owner, bool enabled)
+{
+    if (!owner || m_owners.contains(owner) == enabled || !isAvailable()) {
+        return;
+    }
+    if (enabled) {
+        // a window closed while grabbing gives its reference back
+        connect(owner, &QObject::destroyed, this, [this, owner]() {
+            setEnabled(owner, false);
+        });
+        m_owners.insert(owner);
+        if (m_owners.size() == 1) {
+            selectEvents(true);
+        }
+    } else {
+        disconnect(owner, &QObject::destroyed, this, Q_NULLPTR);
+        m_owners.remove(owner);
+        if (m_owners.isEmpty()) {
+            selectEvents(false);
+        }
+    }
+}
+
+void XRawMotion::selectEvents(bool enabled)
+{
+    xcb_connection_t *dpy = QX11Info::connection();
+
+    struct
+    {
+        xcb_input_event_mask_t head;
+        uint32_t mask;
+    } mask;
+    // a mask of its own, the selections Qt makes for all devices are left alone
+    mask.head.deviceid = XCB_INPUT_DEVICE_ALL_MASTER;
+    mask.head.mask_len = 1;
+    mask.mask = enabled ? XCB_INPUT_XI_EVENT_MASK_RAW_MOTION : 0;
+
+    xcb_input_xi_select_events(dpy, QX11Info::appRootWindow(QX11Info::appScreen()), 1, &mask.head);
+    xcb_flush(dpy);
+}
+
+#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
+bool XRawMotion::nativeEventFilter(const QByteArray &eventType, void *message, long *result)
+#else
+bool XRawMotion::nativeEventFilter(const QByteArray &eventType, void *message, qintptr *result)
+#endif
+{
+    Q_UNUSED(result)
+    if (m_owners.isEmpty() || eventType != "xcb_generic_event_t") {
+        return false;
+    }
+
+    xcb_generic_event_t *event = static_cast<xcb_generic_event_t *>(message);
+    if ((event->response_type & ~0x80) != XCB_GE_GENERIC) {
+        return false;
+    }
+    xcb_ge_generic_event_t *ge = reinterpret_cast<xcb_ge_generic_event_t *>(event);
+    if (ge->extension != m_opcode || ge->event_type != XCB_INPUT_RAW_MOTION) {
+        return false;
+    }
+
+    xcb_input_raw_motion_event_t *raw = reinterpret_cast<xcb_input_raw_motion_event_t *>(event);
+    const uint32_t *valuators = xcb_input_raw_motion_valuator_mask(raw);
+    int valuatorBits = xcb_input_raw_motion_valuator_mask_length(raw) * 32;
+    // only the valuators set in the mask have a value, in axis order: x is 0, y is 1
+    const xcb_input_fp3232_t *values = xcb_input_raw_motion_axisvalues_raw(raw);
+    double delta[2] = { 0.0, 0.0 };
+    int index = 0;
+    for (int axis = 0; axis < 2 && axis < valuatorBits; ++axis) {
+        if (valuators[axis / 32] & (1u << (axis % 32))) {
+            delta[axis] = values[index].integral + values[index].frac / 4294967296.0;
+            ++index;
+        }
+    }
+
+    if (delta[0] != 0.0 || delta[1] != 0.0) {
+        emit motion(QPointF(delta[0], delta[1]));
+    }
+    // Qt does not handle raw events, let it see the event anyway
+    return false;
+}
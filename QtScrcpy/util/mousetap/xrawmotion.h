@@ -0,0 +1,43 @@
+#ifndef XRAWMOTION_H
+#define XRAWMOTION_H
+
+#include <QAbstractNativeEventFilter>
+#include <QObject>
+#include <QPointF>
+#include <QSet>
+
+// XInput2 raw motion of the master pointer: unaccelerated relative deltas,
+// one per report of the mouse, which keep coming at the edge of the screen
+class XRawMotion : public QObject, public QAbstractNativeEventFilter
+{
+    Q_OBJECT
+public:
+    static XRawMotion *getInstance();
+
+    // an X11 session with XInput 2.1 or later
+    bool isAvailable();
+    // raw motion is selected on the root window while at least one owner enables it
+    void setEnabled(QObject *owner, bool enabled);
+
+#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
+    bool nativeEventFilter(const QByteArray &eventType, void *message, long *result) override;
+#else
+    bool nativeEventFilter(const QByteArray &eventType, void *message, qintptr *result) override;
+#endif
+
+signals:
+    void motion(const QPointF &delta);
+
+private:
+    XRawMotion();
+    void selectEvents(bool enabled);
+
+private:
+    static XRawMotion *s_instance;
+    bool m_checked = false;
+    bool m_available = false;
+    QSet<QObject *> m_owners;
+    quint8 m_opcode = 0;
+};
+
+#endif // XRAWMOTION_H